@@ -0,0 +1,260 @@
+/**
+ * @file e2e_test.c
+ * @brief Host test of the rolling counter and CRC checks of the RX path.
+ *
+ * @details
+ * Captures the frames of two protected IDs on the simulated FDCAN1
+ * (host_sim.c), with faults injected by the sender, and checks the
+ * can_E2E_Counters totals against a tally kept while generating them:
+ *   1. CRC-8 failures, with the two polynomials of the descriptors
+ *      (SAE J1850 with a 16-bit Data ID, AUTOSAR CRC8H2F), computed here
+ *      bit by bit,
+ *   2. frames skipped by the sender counted as skips and lost frames of the
+ *      sender (not of the sniffer), also right after a CRC failure and
+ *      across the wrap of a counter below its field range (counter_max 14),
+ *   3. repeated counters, and frames too short or with a counter above
+ *      counter_max counted as invalid,
+ *   4. frames of an ID without descriptor not counted.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DHOST_SIMULATION -IHost/stubs -IMy_Modules/Drivers/can
+ *       -IMy_Modules/Drivers/debug -IMy_Modules/Drivers/mempool -IMy_Modules/Drivers/payload -IMy_Modules/Drivers/stdio
+ *       -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp
+ *       -IMy_Modules/Features/e2e -IMy_Modules/Features/history -IMy_Modules/Features/ids
+ *       -IMy_Modules/Features/logger -IMy_Modules/Features/power
+ *       Host/bench/e2e_test.c Host/stubs/host_sim.c
+ *       My_Modules/Drivers/can/my_can.c My_Modules/Drivers/can/my_can_wire.c
+ *       My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/mempool/my_mempool.c My_Modules/Drivers/payload/my_payload.c
+ *       My_Modules/Drivers/stdio/my_stdio.c My_Modules/Drivers/uart/my_uart.c
+ *       My_Modules/Features/e2e/can_e2e.c My_Modules/Features/history/can_history.c
+ *       My_Modules/Features/ids/can_ids.c My_Modules/Features/logger/can_logger.c
+ *       My_Modules/Features/power/can_power.c -o e2e_test
+ *   ./e2e_test
+ */
+
+#include <string.h>
+#include "host_sim.h"
+#include "my_can.h"
+#include "my_mempool.h"
+#include "can_e2e.h"
+
+/**
+ * @def TEST_BITRATE
+ * @brief Bit rate of the simulated bus.
+ */
+#define TEST_BITRATE 500000
+
+/**
+ * @def TEST_FRAMES
+ * @brief Frames sent by the sender of each protected ID.
+ */
+#define TEST_FRAMES 300
+
+/**
+ * @def TEST_BURST
+ * @brief Frames put on the bus before the output is drained.
+ */
+#define TEST_BURST 50
+
+/**
+ * @def TEST_FRAME_SPACING_NS
+ * @brief Time between two frames on the bus.
+ */
+#define TEST_FRAME_SPACING_NS 500000ULL
+
+/**
+ * @def OTHER_ID
+ * @brief ID without descriptor, sent between the protected frames.
+ */
+#define OTHER_ID 0x300
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+FDCAN_HandleTypeDef hfdcan1 = {.Instance = FDCAN1, .Init = {.RxFifo0ElmtsNbr = 64}};
+
+/**
+ * @var descriptors
+ * @brief Profile 1 like layout (CRC in byte 0, 4-bit counter 0..14 in byte 1)
+ * 		  and a layout with the CRC in the last byte and the counter in a high nibble.
+ */
+static const can_E2E_Descriptor descriptors[2] = {
+	{.Identifier = 0x1A0, .counter_bit = 8, .counter_length = 4, .counter_max = 14, .crc_byte = 0,
+	 .crc_polynomial = 0x1D, .crc_init = 0xFF, .crc_xor = 0xFF, .data_id_bytes = 2, .data_id = 0x0234},
+	{.Identifier = 0x2B0, .counter_bit = 52, .counter_length = 4, .counter_max = 15, .crc_byte = 7,
+	 .crc_polynomial = 0x2F, .crc_init = 0xFF, .crc_xor = 0xFF, .data_id_bytes = 0},
+};
+
+/**
+ * @var expected
+ * @brief Counters the injected faults must produce.
+ */
+static can_E2E_Counters expected = {0};
+
+/**
+ * @var queued
+ * @brief Frames queued in the current burst.
+ */
+static uint32_t queued = 0;
+
+/**
+ * @fn uint32_t my_timestamp_get(void)
+ * @brief Simulated microsecond time base (replaces the TIM2 counter).
+ */
+uint32_t my_timestamp_get(void) {
+	return (uint32_t)(host_sim_now_ns() / 1000);
+}
+
+/**
+ * @fn static uint8_t reference_crc(const can_E2E_Descriptor* d, const uint8_t* data, uint8_t length)
+ * @brief CRC-8 of a payload computed bit by bit, as defined in can_E2E_Descriptor.
+ */
+static uint8_t reference_crc(const can_E2E_Descriptor* d, const uint8_t* data, uint8_t length) {
+	uint8_t bytes[2 + 8];
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < d->data_id_bytes; i++) bytes[count++] = (uint8_t)(d->data_id >> (8 * i));
+	for (uint32_t i = 0; i < length; i++) {
+		if (i != d->crc_byte) bytes[count++] = data[i];
+	}
+	uint8_t crc = d->crc_init;
+	for (uint32_t i = 0; i < count; i++) {
+		crc ^= bytes[i];
+		for (int bit = 0; bit < 8; bit++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ d->crc_polynomial) : (uint8_t)(crc << 1);
+	}
+	return crc ^ d->crc_xor;
+}
+
+/**
+ * @fn static bool reference_crc_ok(void)
+ * @brief Check values of the reference CRC: CRC-8 SAE J1850 and AUTOSAR CRC8H2F of "123456789".
+ */
+static bool reference_crc_ok(void) {
+	const can_E2E_Descriptor j1850 = {.crc_polynomial = 0x1D, .crc_init = 0xFF, .crc_xor = 0xFF, .crc_byte = CAN_E2E_NO_CRC};
+	const can_E2E_Descriptor h2f = {.crc_polynomial = 0x2F, .crc_init = 0xFF, .crc_xor = 0xFF, .crc_byte = CAN_E2E_NO_CRC};
+	const uint8_t check[9] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+	return (reference_crc(&j1850, check, 9) == 0x4B) && (reference_crc(&h2f, check, 9) == 0xDF);
+}
+
+/**
+ * @fn static void drain(void)
+ * @brief Run the simulation until the queued frames arrived and send them out.
+ */
+static void drain(void) {
+	host_sim_advance(host_sim_bus_last_ns());
+	send_frame_over_UART();
+	queued = 0;
+}
+
+/**
+ * @fn static void send(uint32_t identifier, const uint8_t* data, uint8_t length)
+ * @brief Put a frame on the bus after the previous one.
+ */
+static void send(uint32_t identifier, const uint8_t* data, uint8_t length) {
+	FDCAN_RxHeaderTypeDef header = {.Identifier = identifier, .IdType = FDCAN_STANDARD_ID, .RxFrameType = FDCAN_DATA_FRAME,
+									.DataLength = length, .BitRateSwitch = FDCAN_BRS_OFF, .FDFormat = FDCAN_CLASSIC_CAN};
+	host_sim_bus_queue(&header, data, host_sim_now_ns() + (queued + 1) * TEST_FRAME_SPACING_NS);
+	if (++queued == TEST_BURST) drain();
+}
+
+/**
+ * @fn static void send_protected(const can_E2E_Descriptor* d, uint8_t counter, uint32_t index, bool corrupt, uint8_t length)
+ * @brief Send a frame of a protected ID with a counter and a valid (or corrupted) CRC.
+ */
+static void send_protected(const can_E2E_Descriptor* d, uint8_t counter, uint32_t index, bool corrupt, uint8_t length) {
+	uint8_t data[8];
+	for (int j = 0; j < 8; j++) data[j] = (uint8_t)(index * 29 + j * 7);
+	const uint8_t shift = d->counter_bit % 8;
+	const uint8_t mask = (uint8_t)(((1u << d->counter_length) - 1) << shift);
+	data[d->counter_bit / 8] = (uint8_t)((data[d->counter_bit / 8] & ~mask) | ((counter << shift) & mask));
+	data[d->crc_byte] = reference_crc(d, data, 8);
+	if (corrupt) data[(d->crc_byte + 3) % 8] ^= 0x10;
+	send(d->Identifier, data, length);
+	expected.frames++;
+}
+
+/**
+ * @fn static void run_sender(const can_E2E_Descriptor* d)
+ * @brief Send TEST_FRAMES frames of a protected ID with faults every few frames, and tally them.
+ */
+static void run_sender(const can_E2E_Descriptor* d) {
+	uint8_t counter = 0;
+	for (uint32_t i = 0; i < TEST_FRAMES; i++) {
+		uint32_t skipped = 0;
+		switch (i % 40) {
+			case 7: /* sender skips 1 + i % 3 counter values */
+				skipped = 1 + i % 3;
+				break;
+			case 13: /* the same counter again */
+				send_protected(d, counter, i, false, 8);
+				send_protected(d, counter, i, false, 8);
+				expected.repeats++;
+				counter = (counter == d->counter_max) ? 0 : counter + 1;
+				continue;
+			case 19: /* corrupted in transit: its counter still counts */
+				send_protected(d, counter, i, true, 8);
+				expected.crc_failures++;
+				counter = (counter == d->counter_max) ? 0 : counter + 1;
+				continue;
+			case 20: /* ... and skips right after a CRC failure */
+				skipped = 2;
+				break;
+			case 27: /* a frame too short for the descriptor */
+				send_protected(d, counter, i, false, d->crc_byte < d->counter_bit / 8 ? d->counter_bit / 8 : d->crc_byte);
+				expected.invalid++;
+				break;
+			case 33: /* a counter above counter_max (only possible below the field range) */
+				if (d->counter_max < (1u << d->counter_length) - 1) {
+					send_protected(d, d->counter_max + 1, i, false, 8);
+					expected.invalid++;
+				}
+				break;
+			default:
+				break;
+		}
+		if (skipped > 0) {
+			expected.skips++;
+			expected.lost_frames += skipped;
+			for (uint32_t k = 0; k < skipped; k++) counter = (counter == d->counter_max) ? 0 : counter + 1;
+		}
+		send_protected(d, counter, i, false, 8);
+		counter = (counter == d->counter_max) ? 0 : counter + 1;
+
+		const uint8_t other[8] = {(uint8_t)i, 0x55};
+		send(OTHER_ID, other, 2);
+	}
+	drain();
+}
+
+int main(void) {
+	host_sim_init(TEST_BITRATE, NULL, NULL);
+	my_uart_dma_init();
+	(void)my_mempool_init();
+	if (!my_CAN_manual_configuration(TEST_BITRATE).is_set) return 1;
+	my_CAN_set_output_mode(CAN_OUTPUT_BINARY);
+	can_e2e_clear();
+	if (!can_e2e_add(&descriptors[0]) || !can_e2e_add(&descriptors[1])) return 1;
+	my_CAN_start();
+
+	bool reference_ok = reference_crc_ok();
+	run_sender(&descriptors[0]);
+	run_sender(&descriptors[1]);
+
+	const can_E2E_Counters total = get_can_e2e_status(false).total;
+	const my_CAN_Buffer_Stats buffer = get_my_CAN_buffer_stats(false);
+	bool path_ok = (buffer.fifo_overflows == 0) && (buffer.dropped_frames == 0);
+	bool crc_ok = reference_ok && (total.frames == expected.frames) && (total.crc_failures == expected.crc_failures);
+	bool counter_ok = (total.skips == expected.skips) && (total.lost_frames == expected.lost_frames) &&
+					  (total.sniffer_skips == 0) && (total.sniffer_lost_frames == 0) && (total.repeats == expected.repeats) &&
+					  (total.invalid == expected.invalid);
+
+	printf("Capture: %lu FIFO overflows, %lu frames dropped -> %s\n", (unsigned long)buffer.fifo_overflows,
+		   (unsigned long)buffer.dropped_frames, path_ok ? "PASS" : "FAIL");
+	printf("CRC: %lu of %lu frames checked, %lu of %lu failures -> %s\n", (unsigned long)total.frames,
+		   (unsigned long)expected.frames, (unsigned long)total.crc_failures, (unsigned long)expected.crc_failures,
+		   crc_ok ? "PASS" : "FAIL");
+	printf("Counter: %lu/%lu skips, %lu/%lu frames lost by the sender, %lu by the sniffer, %lu/%lu repeats, "
+		   "%lu/%lu invalid -> %s\n", (unsigned long)total.skips, (unsigned long)expected.skips,
+		   (unsigned long)total.lost_frames, (unsigned long)expected.lost_frames, (unsigned long)total.sniffer_lost_frames,
+		   (unsigned long)total.repeats, (unsigned long)expected.repeats, (unsigned long)total.invalid,
+		   (unsigned long)expected.invalid, counter_ok ? "PASS" : "FAIL");
+	return (path_ok && crc_ok && counter_ok) ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file fifo_overrun_test.c
+ * @brief Host test of the RX FIFO0 overrun accounting on simulated FDCAN.
+ *
+ * @details
+ * Overruns a small RX FIFO0 of the simulated FDCAN1 (host_sim.c) while the
+ * new message interrupt is held off, as when a higher priority interrupt
+ * keeps the RX interrupt waiting, and checks that:
+ *   1. the message lost interrupt reaches HAL_FDCAN_RxFifo0Callback() and
+ *      counts the overrun in my_CAN_Buffer_Stats.fifo_overflows,
+ *   2. the sniffer loss count passed to the RX stages goes up, so that the
+ *      rolling counter gap of the lost frames is attributed to the sniffer
+ *      (can_E2E_Counters.sniffer_lost_frames), not to the sender.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DHOST_SIMULATION -IHost/stubs -IMy_Modules/Drivers/can
+ *       -IMy_Modules/Drivers/debug -IMy_Modules/Drivers/mempool -IMy_Modules/Drivers/payload -IMy_Modules/Drivers/stdio
+ *       -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp
+ *       -IMy_Modules/Features/e2e -IMy_Modules/Features/history -IMy_Modules/Features/ids
+ *       -IMy_Modules/Features/logger -IMy_Modules/Features/power
+ *       Host/bench/fifo_overrun_test.c Host/stubs/host_sim.c
+ *       My_Modules/Drivers/can/my_can.c My_Modules/Drivers/can/my_can_wire.c
+ *       My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/mempool/my_mempool.c My_Modules/Drivers/payload/my_payload.c
+ *       My_Modules/Drivers/stdio/my_stdio.c My_Modules/Drivers/uart/my_uart.c
+ *       My_Modules/Features/e2e/can_e2e.c My_Modules/Features/history/can_history.c
+ *       My_Modules/Features/ids/can_ids.c My_Modules/Features/logger/can_logger.c
+ *       My_Modules/Features/power/can_power.c -o fifo_overrun_test
+ *   ./fifo_overrun_test
+ */
+
+#include "host_sim.h"
+#include "my_can.h"
+#include "my_mempool.h"
+#include "can_e2e.h"
+
+/**
+ * @def TEST_BITRATE
+ * @brief Bit rate of the simulated bus.
+ */
+#define TEST_BITRATE 500000
+
+/**
+ * @def TEST_FIFO_SIZE
+ * @brief RX FIFO0 elements, small so that the FIFO overruns within one interrupt.
+ */
+#define TEST_FIFO_SIZE 8
+
+/**
+ * @def TEST_ID
+ * @brief ID of the test frames, with a 4-bit rolling counter in byte 0.
+ */
+#define TEST_ID 0x100
+
+/**
+ * @def TEST_FRAME_SPACING_NS
+ * @brief Time between two test frames on the bus.
+ */
+#define TEST_FRAME_SPACING_NS 1000000ULL
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+FDCAN_HandleTypeDef hfdcan1 = {.Instance = FDCAN1, .Init = {.RxFifo0ElmtsNbr = TEST_FIFO_SIZE}};
+
+/**
+ * @var counter
+ * @brief Rolling counter of the next test frame.
+ */
+static uint8_t counter = 0;
+
+/**
+ * @fn uint32_t my_timestamp_get(void)
+ * @brief Simulated microsecond time base (replaces the TIM2 counter).
+ */
+uint32_t my_timestamp_get(void) {
+	return (uint32_t)(host_sim_now_ns() / 1000);
+}
+
+/**
+ * @fn static void send_frames(uint32_t count)
+ * @brief Put count test frames on the bus and run the simulation until they arrived.
+ */
+static void send_frames(uint32_t count) {
+	FDCAN_RxHeaderTypeDef header = {.Identifier = TEST_ID, .IdType = FDCAN_STANDARD_ID, .RxFrameType = FDCAN_DATA_FRAME,
+									.DataLength = 8, .BitRateSwitch = FDCAN_BRS_OFF, .FDFormat = FDCAN_CLASSIC_CAN};
+	for (uint32_t i = 0; i < count; i++) {
+		uint8_t data[8] = {counter};
+		counter = (counter + 1) & 0x0F;
+		host_sim_bus_queue(&header, data, host_sim_now_ns() + (i + 1) * TEST_FRAME_SPACING_NS);
+	}
+	host_sim_advance(host_sim_bus_last_ns());
+	send_frame_over_UART();
+}
+
+int main(void) {
+	host_sim_init(TEST_BITRATE, NULL, NULL);
+	my_uart_dma_init();
+	(void)my_mempool_init();
+	if (!my_CAN_manual_configuration(TEST_BITRATE).is_set) return 1;
+	my_CAN_set_output_mode(CAN_OUTPUT_BINARY);
+	can_e2e_clear();
+	const can_E2E_Descriptor descriptor = {.Identifier = TEST_ID, .counter_bit = 0, .counter_length = 4, .counter_max = 15,
+										   .crc_byte = CAN_E2E_NO_CRC};
+	if (!can_e2e_add(&descriptor)) return 1;
+	my_CAN_start();
+
+	/* In sequence, with the interrupts of my_CAN_start() */
+	send_frames(4);
+
+	/* RX interrupt held off: the FIFO fills up and the next frame is lost */
+	HAL_FDCAN_DeactivateNotification(&hfdcan1, FDCAN_IT_RX_FIFO0_NEW_MESSAGE);
+	send_frames(TEST_FIFO_SIZE + 1);
+	HAL_FDCAN_ActivateNotification(&hfdcan1, FDCAN_IT_RX_FIFO0_NEW_MESSAGE, 0);
+	send_frames(4);
+
+	const host_Sim_Stats sim = host_sim_get_stats();
+	const my_CAN_Buffer_Stats buffer = get_my_CAN_buffer_stats(false);
+	const can_E2E_Status e2e = get_can_e2e_status(false);
+	bool fifo_ok = (sim.fifo_lost_frames > 0) && (buffer.fifo_overflows > 0);
+	bool losses_ok = (e2e.total.sniffer_lost_frames == sim.fifo_lost_frames) && (e2e.total.lost_frames == 0);
+
+	printf("FIFO: %llu frames lost in RX FIFO0, %lu FIFO overflows counted -> %s\n",
+		   (unsigned long long)sim.fifo_lost_frames, (unsigned long)buffer.fifo_overflows, fifo_ok ? "PASS" : "FAIL");
+	printf("E2E: %lu frames lost by the sniffer, %lu by the sender -> %s\n",
+		   (unsigned long)e2e.total.sniffer_lost_frames, (unsigned long)e2e.total.lost_frames, losses_ok ? "PASS" : "FAIL");
+	return (fifo_ok && losses_ok) ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+/**
+ * @file history_test.c
+ * @brief Host test of the per-ID history queries over the command channel.
+ *
+ * @details
+ * Captures frames of a tracked and of an untracked ID on the simulated
+ * FDCAN1 (host_sim.c), then sends "h 0x<id>" commands over the simulated
+ * USART3 while capture runs and checks the replies of
+ * send_history_over_UART():
+ *   1. the tracked ID reports all its frames, the byte ranges and the bit
+ *      flips of all of them, and its last CAN_HISTORY_DEPTH payloads,
+ *      oldest first, with increasing timestamps,
+ *   2. the untracked ID is reported as not tracked.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DHOST_SIMULATION -IHost/stubs -IMy_Modules/Drivers/can
+ *       -IMy_Modules/Drivers/debug -IMy_Modules/Drivers/mempool -IMy_Modules/Drivers/payload -IMy_Modules/Drivers/stdio
+ *       -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp -IMy_Modules/Features/command
+ *       -IMy_Modules/Features/e2e -IMy_Modules/Features/history -IMy_Modules/Features/ids
+ *       -IMy_Modules/Features/logger -IMy_Modules/Features/power
+ *       Host/bench/history_test.c Host/stubs/host_sim.c
+ *       My_Modules/Drivers/can/my_can.c My_Modules/Drivers/can/my_can_wire.c
+ *       My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/mempool/my_mempool.c My_Modules/Drivers/payload/my_payload.c
+ *       My_Modules/Drivers/stdio/my_stdio.c My_Modules/Drivers/uart/my_uart.c
+ *       My_Modules/Features/command/command_channel.c My_Modules/Features/e2e/can_e2e.c
+ *       My_Modules/Features/history/can_history.c My_Modules/Features/ids/can_ids.c
+ *       My_Modules/Features/logger/can_logger.c My_Modules/Features/power/can_power.c -o history_test
+ *   ./history_test
+ */
+
+#include <string.h>
+#include "host_sim.h"
+#include "my_can.h"
+#include "my_mempool.h"
+#include "can_history.h"
+#include "command_channel.h"
+
+/**
+ * @def TEST_BITRATE
+ * @brief Bit rate of the simulated bus.
+ */
+#define TEST_BITRATE 500000
+
+/**
+ * @def TEST_ID
+ * @brief Tracked ID.
+ */
+#define TEST_ID 0x123
+
+/**
+ * @def OTHER_ID
+ * @brief Untracked ID, sent between the frames of TEST_ID.
+ */
+#define OTHER_ID 0x200
+
+/**
+ * @def TEST_FRAMES
+ * @brief Frames of TEST_ID, more than CAN_HISTORY_DEPTH.
+ */
+#define TEST_FRAMES (CAN_HISTORY_DEPTH + 5)
+
+/**
+ * @def TEST_DLC
+ * @brief Payload length of the test frames.
+ */
+#define TEST_DLC 3
+
+/**
+ * @def TEST_FRAME_SPACING_NS
+ * @brief Time between two test frames on the bus.
+ */
+#define TEST_FRAME_SPACING_NS 1000000ULL
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+FDCAN_HandleTypeDef hfdcan1 = {.Instance = FDCAN1, .Init = {.RxFifo0ElmtsNbr = 64}};
+
+/**
+ * @var reply
+ * @brief UART output collected since the last command.
+ */
+static char reply[4096];
+
+/**
+ * @var reply_length
+ * @brief Characters in reply.
+ */
+static uint32_t reply_length = 0;
+
+/**
+ * @fn uint32_t my_timestamp_get(void)
+ * @brief Simulated microsecond time base (replaces the TIM2 counter).
+ */
+uint32_t my_timestamp_get(void) {
+	return (uint32_t)(host_sim_now_ns() / 1000);
+}
+
+/**
+ * @fn static void collect(const uint8_t* data, uint32_t size, uint64_t start_ns, void* context)
+ * @brief UART output callback (host_Sim_Output): keep the text of the replies.
+ */
+static void collect(const uint8_t* data, uint32_t size, uint64_t start_ns, void* context) {
+	(void)start_ns;
+	(void)context;
+	for (uint32_t i = 0; i < size && reply_length < sizeof(reply) - 1; i++) {
+		reply[reply_length++] = (char)data[i];
+	}
+	reply[reply_length] = '\0';
+}
+
+/**
+ * @fn static void test_payload(uint32_t index, uint8_t* data)
+ * @brief Payload of the index-th frame of TEST_ID.
+ */
+static void test_payload(uint32_t index, uint8_t* data) {
+	data[0] = (uint8_t)index;
+	data[1] = (uint8_t)(0x40 + (index % 3));
+	data[2] = 0xA5;
+}
+
+/**
+ * @fn static void run_command(const char* command)
+ * @brief Send a command line and collect its reply.
+ */
+static void run_command(const char* command) {
+	reply_length = 0;
+	reply[0] = '\0';
+	host_sim_uart_receive(command);
+	command_channel_poll();
+	host_sim_advance(host_sim_now_ns() + 1000000);
+}
+
+/**
+ * @fn static bool check_history(void)
+ * @brief Check the reply to "h 0x<TEST_ID>".
+ */
+static bool check_history(void) {
+	uint8_t data[8], previous[8] = {0}, min[8], max[8];
+	uint32_t changed_bits = 0;
+	memset(min, 0xFF, sizeof(min));
+	memset(max, 0x00, sizeof(max));
+	for (uint32_t i = 0; i < TEST_FRAMES; i++) {
+		memset(data, 0, sizeof(data));
+		test_payload(i, data);
+		for (int j = 0; j < 8; j++) {
+			if (data[j] < min[j]) min[j] = data[j];
+			if (data[j] > max[j]) max[j] = data[j];
+			if (i > 0) changed_bits += __builtin_popcount(data[j] ^ previous[j]);
+		}
+		memcpy(previous, data, sizeof(previous));
+	}
+
+	const char* line = reply;
+	unsigned long identifier, frames, changed;
+	if (sscanf(line, "History ID: 0x%lX, Frames: %lu, Changed bits: %lu", &identifier, &frames, &changed) != 3 ||
+		identifier != TEST_ID || frames != TEST_FRAMES || changed != changed_bits) {
+		printf("Unexpected header: %.80s\n", line);
+		return false;
+	}
+
+	line = strstr(line, "Byte min:");
+	unsigned reported[16];
+	if (line == NULL || sscanf(line, "Byte min: %x %x %x %x %x %x %x %x, max: %x %x %x %x %x %x %x %x",
+							   &reported[0], &reported[1], &reported[2], &reported[3], &reported[4], &reported[5],
+							   &reported[6], &reported[7], &reported[8], &reported[9], &reported[10], &reported[11],
+							   &reported[12], &reported[13], &reported[14], &reported[15]) != 16) {
+		printf("No byte ranges\n");
+		return false;
+	}
+	for (int j = 0; j < 8; j++) {
+		if (reported[j] != min[j] || reported[8 + j] != max[j]) {
+			printf("Byte %d range %02X..%02X, expected %02X..%02X\n", j, reported[j], reported[8 + j], min[j], max[j]);
+			return false;
+		}
+	}
+
+	unsigned long last_time = 0;
+	for (uint32_t i = TEST_FRAMES - CAN_HISTORY_DEPTH; i < TEST_FRAMES; i++) {
+		unsigned long time, dlc;
+		unsigned bytes[TEST_DLC];
+		line = strstr(line + 1, "Time: ");
+		if (line == NULL || sscanf(line, "Time: %lu us, DLC: %lu, Bytes: %x %x %x", &time, &dlc,
+								   &bytes[0], &bytes[1], &bytes[2]) != 2 + TEST_DLC) {
+			printf("Entry of frame %lu missing\n", (unsigned long)i);
+			return false;
+		}
+		test_payload(i, data);
+		if (dlc != TEST_DLC || bytes[0] != data[0] || bytes[1] != data[1] || bytes[2] != data[2] || time <= last_time) {
+			printf("Entry of frame %lu: %.60s\n", (unsigned long)i, line);
+			return false;
+		}
+		last_time = time;
+	}
+	if (strstr(line + 1, "Time: ") != NULL) {
+		printf("More than %d entries\n", CAN_HISTORY_DEPTH);
+		return false;
+	}
+	return true;
+}
+
+int main(void) {
+	host_sim_init(TEST_BITRATE, collect, NULL);
+	my_uart_dma_init();
+	(void)my_mempool_init();
+	if (!my_CAN_manual_configuration(TEST_BITRATE).is_set) return 1;
+	my_CAN_set_output_mode(CAN_OUTPUT_BINARY);
+	can_history_set_mode(CAN_HISTORY_CONFIGURED);
+	if (!can_history_add_id(TEST_ID)) return 1;
+	my_CAN_start();
+
+	FDCAN_RxHeaderTypeDef header = {.IdType = FDCAN_STANDARD_ID, .RxFrameType = FDCAN_DATA_FRAME, .DataLength = TEST_DLC,
+									.BitRateSwitch = FDCAN_BRS_OFF, .FDFormat = FDCAN_CLASSIC_CAN};
+	for (uint32_t i = 0; i < TEST_FRAMES; i++) {
+		uint8_t data[8] = {0};
+		test_payload(i, data);
+		header.Identifier = TEST_ID;
+		host_sim_bus_queue(&header, data, (2 * i + 1) * TEST_FRAME_SPACING_NS);
+		header.Identifier = OTHER_ID;
+		host_sim_bus_queue(&header, data, (2 * i + 2) * TEST_FRAME_SPACING_NS);
+	}
+	host_sim_advance(host_sim_bus_last_ns());
+	send_frame_over_UART();
+	host_sim_advance(host_sim_now_ns() + 10000000);
+
+	run_command("h 0x123\r");
+	bool history_ok = check_history();
+	printf("History: %lu frames of 0x%03X queried, last %d payloads -> %s\n", (unsigned long)TEST_FRAMES, TEST_ID,
+		   CAN_HISTORY_DEPTH, history_ok ? "PASS" : "FAIL");
+
+	run_command("h 0x200\r");
+	bool untracked_ok = strstr(reply, "History ID: 0x200 not tracked.") != NULL;
+	printf("Untracked: 0x%03X -> %s\n", OTHER_ID, untracked_ok ? "PASS" : "FAIL");
+
+	return (history_ok && untracked_ok) ? 0 : 1;
+}
@@ -0,0 +1,236 @@
+/**
+ * @file logger_bench.c
+ * @brief Host test and write throughput benchmark of the SD card logging sink.
+ *
+ * @details
+ * Runs can_logger on FatFs over a RAM or file disk image (diskio_image.c):
+ *   1. Throughput: logs LOG_FRAMES frames, calling can_logger_poll() after
+ *      every FRAMES_PER_POLL frames like the main loop, and reports frames/s,
+ *      MB/s, sectors per disk write and the slowest block write.
+ *   2. Read back: every block of every log file must pass
+ *      can_logger_check_block() and the records must follow in sequence.
+ *   3. Power loss: the log files are deleted, so the next file reuses their
+ *      clusters, and logging is cut without can_logger_stop(). The volume is
+ *      remounted and exactly the blocks written before the cut must be
+ *      recovered, none of the stale ones.
+ *
+ * FatFs is not part of this repository. Use FatFs R0.14 or later
+ * (elm-chan.org) with FF_USE_MKFS and FF_USE_EXPAND set to 1 in ffconf.h.
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -IHost/stubs -I<ff>/source -IMy_Modules/Drivers/can -IMy_Modules/Drivers/debug
+ *       -IMy_Modules/Drivers/stdio -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp
+ *       -IMy_Modules/Features/logger Host/bench/logger_bench.c Host/stubs/diskio_image.c
+ *       <ff>/source/ff.c <ff>/source/ffunicode.c My_Modules/Features/logger/can_logger.c
+ *       My_Modules/Drivers/can/my_can_wire.c My_Modules/Drivers/debug/my_debug.c
+ *       My_Modules/Drivers/stdio/my_stdio.c My_Modules/Drivers/uart/my_uart.c -o logger_bench
+ *   ./logger_bench            (RAM image)
+ *   ./logger_bench disk.img   (file image)
+ */
+
+#include <stdlib.h>
+#include "ff.h"
+#include "can_logger.h"
+#include "my_can_wire.h"
+#include "diskio_image.h"
+
+/**
+ * @def IMAGE_SECTORS
+ * @brief Disk image size in sectors (256 MB).
+ */
+#define IMAGE_SECTORS (512UL * 1024)
+
+/**
+ * @def LOG_FRAMES
+ * @brief Frames logged in the throughput run (spans several files).
+ */
+#define LOG_FRAMES 8000000UL
+
+/**
+ * @def CUT_FRAMES
+ * @brief Frames logged before the simulated power loss.
+ */
+#define CUT_FRAMES 100000UL
+
+/**
+ * @def FRAMES_PER_POLL
+ * @brief Frames "received" between two main loop iterations.
+ */
+#define FRAMES_PER_POLL 64
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+
+/**
+ * @fn uint32_t my_timestamp_get(void)
+ * @brief Host microsecond time base (replaces the TIM2 counter).
+ */
+uint32_t my_timestamp_get(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+
+/**
+ * @fn static double now_s(void)
+ * @brief Monotonic time in seconds.
+ */
+static double now_s(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @fn static void make_frame(my_CAN_Frame* frame, uint32_t n)
+ * @brief Deterministic pseudo-random frame number n.
+ */
+static void make_frame(my_CAN_Frame* frame, uint32_t n) {
+	uint32_t x = n * 2654435761UL;
+	frame->Timestamp = n * 100;
+	frame->Identifier = (x >> 8) & 0x7FF;
+	frame->DataLength = (uint8_t)(x % 9);
+	for (int i = 0; i < 8; i++) frame->Data[i] = (uint8_t)(x >> (i * 3));
+}
+
+/**
+ * @fn static void log_frames(uint32_t first, uint32_t count)
+ * @brief Feed frames to the logger, polling it like the main loop.
+ */
+static void log_frames(uint32_t first, uint32_t count) {
+	my_CAN_Frame frame;
+	for (uint32_t n = first; n < first + count; n++) {
+		make_frame(&frame, n);
+		can_logger_record_frame(&frame);
+		if ((n % FRAMES_PER_POLL) == 0) can_logger_poll();
+	}
+}
+
+/**
+ * @fn static uint32_t read_back(uint32_t number, uint32_t* frames, bool* in_sequence)
+ * @brief Read a log file and count its valid blocks and frames.
+ *
+ * @details
+ * Stops at the first block that fails can_logger_check_block(). Checks that
+ * every record decodes and continues the sequence of the previous one.
+ */
+static uint32_t read_back(uint32_t number, uint32_t* frames, bool* in_sequence) {
+	static uint8_t block[CAN_LOGGER_BLOCK_SIZE];
+	static bool have_sequence = false;
+	static uint16_t next_sequence = 0;
+	char name[24];
+	FIL file;
+	UINT got = 0;
+	uint32_t blocks = 0;
+	uint32_t file_id = 0;
+
+	snprintf(name, sizeof(name), "%sCAN%05lu.LOG", CAN_LOGGER_DRIVE, (unsigned long)number);
+	if (f_open(&file, name, FA_READ) != FR_OK) return 0;
+
+	while (f_read(&file, block, sizeof(block), &got) == FR_OK && got == sizeof(block)) {
+		const can_Logger_Block_Header* header = (const can_Logger_Block_Header*)block;
+		if (blocks == 0) file_id = header->file_id;
+		if (!can_logger_check_block(block, file_id, blocks)) break;
+
+		uint32_t offset = sizeof(can_Logger_Block_Header);
+		uint32_t end = offset + header->payload_bytes;
+		while (offset < end) {
+			my_CAN_Frame frame;
+			uint16_t sequence;
+			uint32_t size = my_CAN_wire_decode(&block[offset], end - offset, &frame, &sequence);
+			if (size == 0) {
+				*in_sequence = false;
+				break;
+			}
+			if (have_sequence && sequence != next_sequence) *in_sequence = false;
+			have_sequence = true;
+			next_sequence = sequence + 1;
+			offset += size;
+			(*frames)++;
+		}
+		blocks++;
+	}
+	f_close(&file);
+	return blocks;
+}
+
+int main(int argc, char** argv) {
+	static FATFS bench_fs;
+	static uint8_t mkfs_work[4096];
+	const char* image = (argc > 1) ? argv[1] : NULL;
+
+	if (!disk_image_open(image, IMAGE_SECTORS)) {
+		printf("Cannot create disk image\n");
+		return 1;
+	}
+	MKFS_PARM format = {FM_ANY, 0, 0, 0, 0};
+	if (f_mkfs(CAN_LOGGER_DRIVE, &format, mkfs_work, sizeof(mkfs_work)) != FR_OK) {
+		printf("f_mkfs failed\n");
+		return 1;
+	}
+	printf("Disk image: %s, %lu MB, block %d B, file %lu MB\n\n", image ? image : "RAM",
+			(unsigned long)(IMAGE_SECTORS / 2048), CAN_LOGGER_BLOCK_SIZE, (unsigned long)(CAN_LOGGER_FILE_SIZE >> 20));
+
+	/* 1. Sustained write throughput */
+	can_logger_enable(true);
+	double start = now_s();
+	if (!can_logger_start()) return 1;
+	uint32_t first_file = get_can_logger_status(false).file_number;
+	(void) disk_image_get_stats(true);
+	log_frames(0, LOG_FRAMES);
+	can_logger_stop();
+	double elapsed = now_s() - start;
+
+	can_Logger_Status status = get_can_logger_status(false);
+	disk_Image_Stats disk = disk_image_get_stats(true);
+	double megabytes = (double)status.blocks_written * CAN_LOGGER_BLOCK_SIZE / 1e6;
+	printf("Throughput: %lu frames in %.2f s, %.0f frames/s, %.1f MB/s\n",
+			(unsigned long)LOG_FRAMES, elapsed, LOG_FRAMES / elapsed, megabytes / elapsed);
+	printf("Files: %lu, blocks: %lu, dropped frames: %lu, max block write: %lu us\n",
+			(unsigned long)status.files, (unsigned long)status.blocks_written,
+			(unsigned long)status.dropped_frames, (unsigned long)status.max_write_us);
+	printf("Disk: %lu writes, %.1f sectors/write, %lu syncs\n\n", (unsigned long)disk.writes,
+			disk.writes ? (double)disk.sectors_written / disk.writes : 0.0, (unsigned long)disk.syncs);
+
+	/* 2. Read back */
+	f_mount(&bench_fs, CAN_LOGGER_DRIVE, 1);
+	uint32_t frames = 0;
+	uint32_t blocks = 0;
+	bool in_sequence = true;
+	for (uint32_t number = first_file; number <= status.file_number; number++) {
+		blocks += read_back(number, &frames, &in_sequence);
+	}
+	bool read_ok = (blocks == status.blocks_written) && (frames == status.logged_frames) &&
+				   (frames + status.dropped_frames == LOG_FRAMES) && in_sequence;
+	printf("Read back: %lu blocks, %lu frames, in sequence: %s -> %s\n\n", (unsigned long)blocks,
+			(unsigned long)frames, in_sequence ? "yes" : "no", read_ok ? "PASS" : "FAIL");
+
+	/* 3. Power loss: stale clusters, cut without can_logger_stop() */
+	for (uint32_t number = first_file; number <= status.file_number; number++) {
+		char name[24];
+		snprintf(name, sizeof(name), "%sCAN%05lu.LOG", CAN_LOGGER_DRIVE, (unsigned long)number);
+		f_unlink(name);
+	}
+	f_mount(NULL, CAN_LOGGER_DRIVE, 0);
+
+	if (!can_logger_start()) return 1;
+	uint32_t cut_file = get_can_logger_status(false).file_number;
+	uint32_t blocks_before = get_can_logger_status(false).blocks_written;
+	log_frames(0, CUT_FRAMES);
+	uint32_t blocks_cut = get_can_logger_status(false).blocks_written - blocks_before;
+
+	f_mount(&bench_fs, CAN_LOGGER_DRIVE, 1);
+	FILINFO info;
+	char name[24];
+	snprintf(name, sizeof(name), "%sCAN%05lu.LOG", CAN_LOGGER_DRIVE, (unsigned long)cut_file);
+	f_stat(name, &info);
+	frames = 0;
+	in_sequence = true;
+	uint32_t recovered = read_back(cut_file, &frames, &in_sequence);
+	bool cut_ok = (recovered == blocks_cut) && in_sequence;
+	printf("Power loss: %lu blocks written before the cut, file size %lu KB, %lu blocks (%lu frames) recovered -> %s\n",
+			(unsigned long)blocks_cut, (unsigned long)(info.fsize / 1024), (unsigned long)recovered,
+			(unsigned long)frames, cut_ok ? "PASS" : "FAIL");
+
+	disk_image_close();
+	return (read_ok && cut_ok) ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file mempool_bench.c
+ * @brief Host allocation-rate benchmark of the firmware memory pool.
+ *
+ * @details
+ * Compares my_mempool against the C library malloc/free with:
+ *   - Back-to-back alloc/free of one block per size class
+ *   - A random mix of allocations and releases over a set of live blocks
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -IHost/stubs -IMy_Modules/Drivers/mempool -IMy_Modules/Drivers/stdio \
+ *       -IMy_Modules/Drivers/uart Host/bench/mempool_bench.c \
+ *       My_Modules/Drivers/mempool/my_mempool.c My_Modules/Drivers/stdio/my_stdio.c \
+ *       My_Modules/Drivers/uart/my_uart.c -o mempool_bench
+ *   ./mempool_bench
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include "my_mempool.h"
+
+/**
+ * @def ITERATIONS
+ * @brief Operations per measurement.
+ */
+#define ITERATIONS 10000000
+
+/**
+ * @def LIVE_BLOCKS
+ * @brief Number of live block slots in the random mix.
+ */
+#define LIVE_BLOCKS 64
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+
+/**
+ * @fn static double now_s(void)
+ * @brief Monotonic time in seconds.
+ */
+static double now_s(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @fn static uint32_t next_random(uint32_t* state)
+ * @brief xorshift32 pseudo-random generator (same sequence for both allocators).
+ */
+static uint32_t next_random(uint32_t* state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+/**
+ * @fn static double random_mix(bool use_pool, uint32_t* failures)
+ * @brief Random alloc/free mix. Returns operations per second.
+ *
+ * @details
+ * Each step picks a live slot: frees it if used, otherwise allocates a
+ * random size. Sizes are drawn per class in proportion to its block count,
+ * anywhere between the previous class size and its own block size.
+ */
+static double random_mix(bool use_pool, uint32_t* failures) {
+	void* live[LIVE_BLOCKS] = {0};
+	uint32_t state = 0x12345678;
+	uint32_t total_blocks = 0;
+	for (int i = 0; i < mempool_classes_nbr; i++) total_blocks += mempool_classes[i].block_count;
+
+	*failures = 0;
+	double start = now_s();
+	for (uint32_t i = 0; i < ITERATIONS; i++) {
+		uint32_t r = next_random(&state);
+		void** slot = &live[r % LIVE_BLOCKS];
+		if (*slot != NULL) {
+			if (use_pool) my_mempool_free(*slot); else free(*slot);
+			*slot = NULL;
+		} else {
+			uint32_t block = (r >> 8) % total_blocks;
+			int i = 0;
+			while (block >= mempool_classes[i].block_count) block -= mempool_classes[i++].block_count;
+			uint16_t low = (i == 0) ? 0 : mempool_classes[i - 1].block_size;
+			size_t size = low + 1 + (next_random(&state) % (mempool_classes[i].block_size - low));
+			*slot = use_pool ? my_mempool_alloc(size) : malloc(size);
+			if (*slot == NULL) (*failures)++;
+		}
+	}
+	double elapsed = now_s() - start;
+
+	for (int i = 0; i < LIVE_BLOCKS; i++) {
+		if (use_pool) my_mempool_free(live[i]); else free(live[i]);
+	}
+	return ITERATIONS / elapsed;
+}
+
+int main(void) {
+	if (!my_mempool_init()) {
+		printf("Size classes do not fit in MEMPOOL_REGION_SIZE\n");
+		return 1;
+	}
+
+	printf("Back-to-back alloc/free pairs (%d per class)\n", ITERATIONS);
+	for (int i = 0; i < mempool_classes_nbr; i++) {
+		uint16_t size = mempool_classes[i].block_size;
+
+		double start = now_s();
+		for (uint32_t j = 0; j < ITERATIONS; j++) {
+			void* volatile block = my_mempool_alloc(size);
+			my_mempool_free(block);
+		}
+		double pool_rate = ITERATIONS / (now_s() - start);
+
+		start = now_s();
+		for (uint32_t j = 0; j < ITERATIONS; j++) {
+			void* volatile block = malloc(size);
+			free(block);
+		}
+		double malloc_rate = ITERATIONS / (now_s() - start);
+
+		printf("  %4d B: pool %7.1f Mpairs/s, malloc %7.1f Mpairs/s\n", size, pool_rate / 1e6, malloc_rate / 1e6);
+	}
+
+	uint32_t pool_failures, malloc_failures;
+	double pool_rate = random_mix(true, &pool_failures);
+	double malloc_rate = random_mix(false, &malloc_failures);
+	printf("Random mix (%d live slots, %d ops)\n", LIVE_BLOCKS, ITERATIONS);
+	printf("  pool   %7.1f Mops/s, %u failed allocations\n", pool_rate / 1e6, pool_failures);
+	printf("  malloc %7.1f Mops/s, %u failed allocations\n", malloc_rate / 1e6, malloc_failures);
+
+	printf("Pool statistics\n");
+	(void) get_my_mempool_stats(true);
+	return 0;
+}
@@ -0,0 +1,181 @@
+/**
+ * @file payload_test.c
+ * @brief Host test of the word-wide payload kernels against byte-by-byte loops.
+ *
+ * @details
+ * Runs every kernel of my_payload.h, for classic CAN and CAN FD payloads at
+ * every alignment, over pseudo-random payloads rich in the byte values where
+ * lane tricks go wrong (0x00, 0x7F, 0x80, 0xFF, equal bytes), and checks
+ * that it gives the same result as a plain loop over the bytes:
+ *   1. match: masked compare, also with differences outside the mask only,
+ *   2. diff: changed-byte mask,
+ *   3. out of range: per-byte bounds, including empty ranges (low > high),
+ *   4. minmax: running byte-lane minimum and maximum,
+ *   5. changed bits: population count of a ^ b.
+ *
+ * Build and run from the repository root, once for the portable kernels and
+ * once for the Cortex-M7 SIMD kernels (USUB8/SEL modelled in Host/stubs):
+ *
+ *   gcc -O2 -IHost/stubs -IMy_Modules/Drivers/debug -IMy_Modules/Drivers/mempool
+ *       -IMy_Modules/Drivers/payload -IMy_Modules/Drivers/stdio -IMy_Modules/Drivers/uart
+ *       Host/bench/payload_test.c My_Modules/Drivers/payload/my_payload.c
+ *       My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/mempool/my_mempool.c
+ *       My_Modules/Drivers/stdio/my_stdio.c My_Modules/Drivers/uart/my_uart.c -o payload_test
+ *   ./payload_test
+ *   (same command with -D__ARM_FEATURE_SIMD32)
+ */
+
+#include <string.h>
+#include "my_payload.h"
+
+/**
+ * @def TEST_ROUNDS
+ * @brief Random payload sets per payload size and alignment.
+ */
+#define TEST_ROUNDS 20000
+
+/**
+ * @def TEST_ALIGNMENTS
+ * @brief Byte offsets of the payloads tried (any alignment is allowed).
+ */
+#define TEST_ALIGNMENTS 4
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+
+/**
+ * @var random_state
+ * @brief State of the xorshift generator.
+ */
+static uint32_t random_state = 2463534242U;
+
+/**
+ * @var failures
+ * @brief Mismatches per kernel: match, diff, out of range, minmax, changed bits.
+ */
+static uint32_t failures[5] = {0};
+
+/**
+ * @fn static uint32_t next_random(void)
+ * @brief xorshift32 pseudo-random number.
+ */
+static uint32_t next_random(void) {
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+/**
+ * @fn static uint8_t random_byte(void)
+ * @brief Random byte, half of the time one of the lane edge values.
+ */
+static uint8_t random_byte(void) {
+	static const uint8_t edges[] = {0x00, 0x01, 0x7E, 0x7F, 0x80, 0x81, 0xFE, 0xFF};
+	uint32_t r = next_random();
+	return (r & 0x100) ? edges[r & 7] : (uint8_t)(r >> 16);
+}
+
+/**
+ * @fn static void random_payload(uint8_t* data, uint32_t size)
+ * @brief Fill a payload with random bytes.
+ */
+static void random_payload(uint8_t* data, uint32_t size) {
+	for (uint32_t i = 0; i < size; i++) data[i] = random_byte();
+}
+
+/**
+ * @fn static void mutate(const uint8_t* from, uint8_t* to, uint32_t size)
+ * @brief Copy a payload with a few bytes changed (by one bit or at random), as between frames of an ID.
+ */
+static void mutate(const uint8_t* from, uint8_t* to, uint32_t size) {
+	memcpy(to, from, size);
+	uint32_t changes = next_random() % 4;
+	for (uint32_t k = 0; k < changes; k++) {
+		uint32_t r = next_random();
+		to[r % size] ^= (r & 0x10000) ? (uint8_t)(1u << ((r >> 8) & 7)) : random_byte();
+	}
+}
+
+/**
+ * @fn static void check_size(uint32_t size, uint32_t offset)
+ * @brief Compare the kernels of one payload size with byte loops, payloads at a byte offset.
+ */
+static void check_size(uint32_t size, uint32_t offset) {
+	uint8_t buffers[6][PAYLOAD_FD_SIZE + TEST_ALIGNMENTS];
+	uint8_t* a = &buffers[0][offset];
+	uint8_t* b = &buffers[1][offset];
+	uint8_t* mask = &buffers[2][offset];
+	uint8_t* low = &buffers[3][offset];
+	uint8_t* high = &buffers[4][offset];
+	uint8_t* out = &buffers[5][offset];
+	uint8_t min[PAYLOAD_FD_SIZE], max[PAYLOAD_FD_SIZE], ref_min[PAYLOAD_FD_SIZE], ref_max[PAYLOAD_FD_SIZE];
+	memset(min, 0xFF, size);
+	memset(max, 0x00, size);
+	memset(ref_min, 0xFF, size);
+	memset(ref_max, 0x00, size);
+	const bool classic = (size == PAYLOAD_CLASSIC_SIZE);
+
+	for (uint32_t round = 0; round < TEST_ROUNDS; round++) {
+		random_payload(a, size);
+		mutate(a, b, size);
+		random_payload(mask, size);
+		if (round % 3 == 0) {
+			/* differences outside the mask only */
+			for (uint32_t i = 0; i < size; i++) b[i] = (uint8_t)((a[i] & mask[i]) | (b[i] & ~mask[i]));
+		}
+		random_payload(low, size);
+		random_payload(high, size);
+
+		bool ref_match = true;
+		uint64_t ref_outside = 0;
+		uint32_t ref_bits = 0;
+		for (uint32_t i = 0; i < size; i++) {
+			if ((a[i] ^ b[i]) & mask[i]) ref_match = false;
+			if (a[i] < low[i] || a[i] > high[i]) ref_outside |= 1ULL << i;
+			if (a[i] < ref_min[i]) ref_min[i] = a[i];
+			if (a[i] > ref_max[i]) ref_max[i] = a[i];
+			ref_bits += (uint32_t)__builtin_popcount(a[i] ^ b[i]);
+		}
+
+		bool got_match = classic ? my_payload_match8(a, b, mask) : my_payload_match64(a, b, mask);
+		if (got_match != ref_match) failures[0]++;
+
+		classic ? my_payload_diff8(a, b, out) : my_payload_diff64(a, b, out);
+		for (uint32_t i = 0; i < size; i++) {
+			if (out[i] != ((a[i] != b[i]) ? 0xFF : 0x00)) {
+				failures[1]++;
+				break;
+			}
+		}
+
+		uint64_t got_outside = classic ? my_payload_out_of_range8(a, low, high) : my_payload_out_of_range64(a, low, high);
+		if (got_outside != ref_outside) failures[2]++;
+
+		classic ? my_payload_minmax8(a, min, max) : my_payload_minmax64(a, min, max);
+		if (memcmp(min, ref_min, size) != 0 || memcmp(max, ref_max, size) != 0) failures[3]++;
+
+		uint32_t got_bits = classic ? my_payload_changed_bits8(a, b) : my_payload_changed_bits64(a, b);
+		if (got_bits != ref_bits) failures[4]++;
+	}
+}
+
+int main(void) {
+	static const char* const names[5] = {"match", "diff", "out of range", "minmax", "changed bits"};
+	for (uint32_t offset = 0; offset < TEST_ALIGNMENTS; offset++) {
+		check_size(PAYLOAD_CLASSIC_SIZE, offset);
+		check_size(PAYLOAD_FD_SIZE, offset);
+	}
+
+	bool all_ok = true;
+#if defined(__ARM_FEATURE_SIMD32)
+	printf("Kernels: SIMD (USUB8/SEL)\n");
+#else
+	printf("Kernels: portable\n");
+#endif
+	for (int k = 0; k < 5; k++) {
+		printf("%s: %lu mismatches in %lu payload sets -> %s\n", names[k], (unsigned long)failures[k],
+			   (unsigned long)(2 * TEST_ALIGNMENTS * TEST_ROUNDS), failures[k] ? "FAIL" : "PASS");
+		if (failures[k]) all_ok = false;
+	}
+	return all_ok ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+/**
+ * @file pipeline_bench.c
+ * @brief Host per-frame cost of the RX handler for each pipeline profile.
+ *
+ * @details
+ * Calls HAL_FDCAN_RxFifo0Callback() of my_can.c directly, with a FIFO that
+ * always holds 32 frames (a synthetic traffic of BENCH_IDS IDs with a
+ * rolling counter and a few changing bytes), and measures the time per
+ * frame with the host clock. The UART output is drained after every
+ * callback and written to /dev/null, outside the measured time.
+ *
+ * Build once per profile (my_can_pipeline.h) and compare with the dynamic
+ * build running the same stages:
+ *
+ *   for p in FULL RAW CENSUS LOGGER DYNAMIC; do
+ *     gcc -O2 -DCAN_PIPELINE_PROFILE=CAN_PIPELINE_$p -IHost/stubs -IMy_Modules/Drivers/can
+ *         -IMy_Modules/Drivers/debug -IMy_Modules/Drivers/mempool -IMy_Modules/Drivers/payload
+ *         -IMy_Modules/Drivers/stdio -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp
+ *         -IMy_Modules/Features/e2e -IMy_Modules/Features/history -IMy_Modules/Features/ids
+ *         -IMy_Modules/Features/logger Host/bench/pipeline_bench.c
+ *         My_Modules/Drivers/can/my_can.c My_Modules/Drivers/can/my_can_wire.c
+ *         My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/mempool/my_mempool.c
+ *         My_Modules/Drivers/payload/my_payload.c My_Modules/Drivers/stdio/my_stdio.c
+ *         My_Modules/Drivers/uart/my_uart.c My_Modules/Features/e2e/can_e2e.c
+ *         My_Modules/Features/history/can_history.c My_Modules/Features/ids/can_ids.c
+ *         My_Modules/Features/logger/can_logger.c -o pipeline_bench_$p
+ *   done
+ *   ./pipeline_bench_FULL [--frames N]
+ *   ./pipeline_bench_DYNAMIC [--stages full|raw|census|logger] [--frames N]
+ *
+ * History runs in CAN_HISTORY_TOP mode and the intrusion detector trains
+ * for BENCH_TRAINING_MS, then detects. The logger is not started (no SD
+ * card on the host), so its stage only costs its enabled check.
+ *
+ * On target, the RX cycles/frame of get_my_CAN_cycle_stats() (command 'c')
+ * give the same comparison in CPU cycles.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "my_can.h"
+#include "can_history.h"
+#include "can_ids.h"
+
+/**
+ * @def BENCH_FRAMES
+ * @brief Default number of frames through the handler.
+ */
+#define BENCH_FRAMES 10000000UL
+
+/**
+ * @def BENCH_BATCH
+ * @brief Frames read per callback (the FIFO0 watermark of the firmware).
+ */
+#define BENCH_BATCH 32
+
+/**
+ * @def BENCH_IDS
+ * @brief Number of distinct IDs in the synthetic traffic.
+ */
+#define BENCH_IDS 64
+
+/**
+ * @def BENCH_TRAINING_MS
+ * @brief Intrusion detector training window.
+ */
+#define BENCH_TRAINING_MS 100
+
+FDCAN_HandleTypeDef hfdcan1;
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+
+/**
+ * @var fifo_frames
+ * @brief Frames left in the simulated FIFO0 for the current callback.
+ */
+static uint32_t fifo_frames = 0;
+
+/**
+ * @var frame_index
+ * @brief Sequence number of the next synthetic frame.
+ */
+static uint32_t frame_index = 0;
+
+/**
+ * @fn uint32_t my_timestamp_get(void)
+ * @brief Host microsecond time base (replaces the TIM2 counter).
+ */
+uint32_t my_timestamp_get(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Init(FDCAN_HandleTypeDef* hfdcan) { (void)hfdcan; return HAL_OK; }
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef* hfdcan, uint32_t non_matching_std, uint32_t non_matching_ext,
+											   uint32_t reject_remote_std, uint32_t reject_remote_ext) {
+	(void)hfdcan; (void)non_matching_std; (void)non_matching_ext; (void)reject_remote_std; (void)reject_remote_ext;
+	return HAL_OK;
+}
+HAL_StatusTypeDef HAL_FDCAN_ConfigFilter(FDCAN_HandleTypeDef* hfdcan, const FDCAN_FilterTypeDef* filter) { (void)hfdcan; (void)filter; return HAL_OK; }
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef* hfdcan) { (void)hfdcan; return HAL_OK; }
+HAL_StatusTypeDef HAL_FDCAN_Stop(FDCAN_HandleTypeDef* hfdcan) { (void)hfdcan; return HAL_OK; }
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef* hfdcan, uint32_t active_its, uint32_t buffer_indexes) {
+	(void)hfdcan; (void)active_its; (void)buffer_indexes;
+	return HAL_OK;
+}
+HAL_StatusTypeDef HAL_FDCAN_DeactivateNotification(FDCAN_HandleTypeDef* hfdcan, uint32_t inactive_its) { (void)hfdcan; (void)inactive_its; return HAL_OK; }
+uint32_t HAL_FDCAN_GetRxFifoFillLevel(FDCAN_HandleTypeDef* hfdcan, uint32_t rx_fifo) { (void)hfdcan; (void)rx_fifo; return fifo_frames; }
+void HAL_FDCAN_ClearFlag(FDCAN_HandleTypeDef* hfdcan, uint32_t flag) { (void)hfdcan; (void)flag; }
+HAL_StatusTypeDef HAL_FDCAN_GetProtocolStatus(FDCAN_HandleTypeDef* hfdcan, FDCAN_ProtocolStatusTypeDef* status) {
+	(void)hfdcan;
+	status->LastErrorCode = FDCAN_PROTOCOL_ERROR_NO_CHANGE;
+	status->DataLastErrorCode = FDCAN_PROTOCOL_ERROR_NO_CHANGE;
+	status->Activity = FDCAN_COM_STATE_IDLE;
+	return HAL_OK;
+}
+
+/**
+ * @fn HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef* hfdcan, uint32_t rx_location, FDCAN_RxHeaderTypeDef* header, uint8_t* data)
+ * @brief Next synthetic frame: byte 0 is a rolling counter per ID, bytes 1-2
+ * a slowly changing signal, the rest constant.
+ */
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef* hfdcan, uint32_t rx_location, FDCAN_RxHeaderTypeDef* header, uint8_t* data) {
+	(void)hfdcan; (void)rx_location;
+	if (fifo_frames == 0) return HAL_ERROR;
+	fifo_frames--;
+
+	uint32_t id = frame_index % BENCH_IDS;
+	uint32_t round = frame_index / BENCH_IDS;
+	header->Identifier = 0x100 + id * 8;
+	header->IdType = FDCAN_STANDARD_ID;
+	header->RxFrameType = FDCAN_DATA_FRAME;
+	header->FDFormat = FDCAN_CLASSIC_CAN;
+	header->BitRateSwitch = FDCAN_BRS_OFF;
+	header->DataLength = 8;
+	header->RxTimestamp = 0;
+	data[0] = (uint8_t)(round & 0x0F);
+	data[1] = (uint8_t)(round >> 4);
+	data[2] = (uint8_t)(round >> 12);
+	memset(&data[3], (int)id, 5);
+	frame_index++;
+	return HAL_OK;
+}
+
+/**
+ * @fn static uint64_t now_ns(void)
+ * @brief Monotonic time in ns.
+ */
+static uint64_t now_ns(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+	uint64_t frames = BENCH_FRAMES;
+	const char* stages_name = CAN_PIPELINE_NAME;
+#if CAN_PIPELINE_PROFILE == CAN_PIPELINE_DYNAMIC
+	uint32_t stages = CAN_PIPELINE_MASK(CAN_PIPELINE_FULL_STAGES);
+	stages_name = "full";
+#endif
+
+	for (int arg = 1; arg < argc; arg++) {
+		if (strcmp(argv[arg], "--frames") == 0 && arg + 1 < argc) {
+			frames = strtoull(argv[++arg], NULL, 0);
+#if CAN_PIPELINE_PROFILE == CAN_PIPELINE_DYNAMIC
+		} else if (strcmp(argv[arg], "--stages") == 0 && arg + 1 < argc) {
+			stages_name = argv[++arg];
+			if (strcmp(stages_name, "full") == 0) stages = CAN_PIPELINE_MASK(CAN_PIPELINE_FULL_STAGES);
+			else if (strcmp(stages_name, "raw") == 0) stages = CAN_PIPELINE_MASK(CAN_PIPELINE_RAW_STAGES);
+			else if (strcmp(stages_name, "census") == 0) stages = CAN_PIPELINE_MASK(CAN_PIPELINE_CENSUS_STAGES);
+			else if (strcmp(stages_name, "logger") == 0) stages = CAN_PIPELINE_MASK(CAN_PIPELINE_LOGGER_STAGES);
+			else {
+				printf("Unknown stages %s\n", stages_name);
+				return 1;
+			}
+#endif
+		} else {
+			printf("Usage: %s [--frames N]%s\n", argv[0],
+				   (CAN_PIPELINE_PROFILE == CAN_PIPELINE_DYNAMIC) ? " [--stages full|raw|census|logger]" : "");
+			return 1;
+		}
+	}
+
+	/* Results to the original stdout, UART output to /dev/null */
+	FILE* report = fdopen(dup(fileno(stdout)), "w");
+	if (report == NULL || freopen("/dev/null", "w", stdout) == NULL) return 1;
+
+	my_CAN_manual_configuration(500000);
+	can_history_set_mode(CAN_HISTORY_TOP);
+	can_ids_start_training(BENCH_TRAINING_MS);
+#if CAN_PIPELINE_PROFILE == CAN_PIPELINE_DYNAMIC
+	my_CAN_set_rx_stages(stages);
+#endif
+	my_CAN_start();
+
+	uint64_t handler_ns = 0;
+	uint64_t done = 0;
+	while (done < frames) {
+		fifo_frames = BENCH_BATCH;
+		uint64_t start = now_ns();
+		HAL_FDCAN_RxFifo0Callback(&hfdcan1, FDCAN_IT_RX_FIFO0_NEW_MESSAGE);
+		handler_ns += now_ns() - start;
+		done += BENCH_BATCH;
+		send_frame_over_UART();
+		send_frame_over_UART();
+	}
+	my_CAN_stop();
+
+	my_CAN_Status status = get_my_CAN_status(false);
+	my_CAN_Buffer_Stats buffer = get_my_CAN_buffer_stats(false);
+	fprintf(report, "Pipeline: %s, stages: %s, output: %s\n", CAN_PIPELINE_NAME, stages_name,
+			(status.output_mode == CAN_OUTPUT_BINARY) ? "binary" : "text");
+	fprintf(report, "Frames: %llu, dropped: %lu\n", (unsigned long long)done, (unsigned long)buffer.dropped_frames);
+	fprintf(report, "RX handler: %.1f ns/frame\n", (double)handler_ns / (double)done);
+	fclose(report);
+	return 0;
+}
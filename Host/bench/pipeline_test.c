@@ -0,0 +1,209 @@
+/**
+ * @file pipeline_test.c
+ * @brief Host test of the stages run by each RX pipeline profile.
+ *
+ * @details
+ * Captures the same traffic on the simulated FDCAN1 (host_sim.c) with text
+ * output requested, and checks that exactly the stages of the profile ran:
+ *   1. ids: frames counted by the intrusion detector (training),
+ *   2. e2e: frames of the protected ID counted by the E2E checks,
+ *   3. history: IDs tracked by the history store (CAN_HISTORY_TOP),
+ *   4. output / binary: every frame sent over UART, as a text line (output
+ *      stage) or a binary record (binary stage alone, whatever the requested
+ *      format), or no frame output at all.
+ * The dynamic build runs the traffic once per static profile, with the
+ * stage mask of that profile (my_CAN_set_rx_stages()), and must give the
+ * same results. The logger stage needs an SD card (see logger_bench.c) and
+ * is not checked here.
+ *
+ * Build and run once per profile from the repository root:
+ *
+ *   for p in FULL RAW CENSUS LOGGER DYNAMIC; do
+ *     gcc -O2 -DHOST_SIMULATION -DCAN_PIPELINE_PROFILE=CAN_PIPELINE_$p -IHost/stubs -IMy_Modules/Drivers/can
+ *         -IMy_Modules/Drivers/debug -IMy_Modules/Drivers/mempool -IMy_Modules/Drivers/payload -IMy_Modules/Drivers/stdio
+ *         -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp
+ *         -IMy_Modules/Features/e2e -IMy_Modules/Features/history -IMy_Modules/Features/ids
+ *         -IMy_Modules/Features/logger -IMy_Modules/Features/power
+ *         Host/bench/pipeline_test.c Host/stubs/host_sim.c
+ *         My_Modules/Drivers/can/my_can.c My_Modules/Drivers/can/my_can_wire.c
+ *         My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/mempool/my_mempool.c My_Modules/Drivers/payload/my_payload.c
+ *         My_Modules/Drivers/stdio/my_stdio.c My_Modules/Drivers/uart/my_uart.c
+ *         My_Modules/Features/e2e/can_e2e.c My_Modules/Features/history/can_history.c
+ *         My_Modules/Features/ids/can_ids.c My_Modules/Features/logger/can_logger.c
+ *         My_Modules/Features/power/can_power.c -o pipeline_test_$p && ./pipeline_test_$p
+ *   done
+ */
+
+#include <string.h>
+#include "host_sim.h"
+#include "my_can.h"
+#include "my_can_wire.h"
+#include "my_mempool.h"
+#include "can_e2e.h"
+#include "can_history.h"
+#include "can_ids.h"
+
+/**
+ * @def TEST_BITRATE
+ * @brief Bit rate of the simulated bus.
+ */
+#define TEST_BITRATE 500000
+
+/**
+ * @def TEST_FRAMES
+ * @brief Frames of a run.
+ */
+#define TEST_FRAMES 120
+
+/**
+ * @def TEST_IDS
+ * @brief Distinct IDs of the traffic (fewer than CAN_HISTORY_SLABS).
+ */
+#define TEST_IDS 6
+
+/**
+ * @def TEST_E2E_ID
+ * @brief ID with a 4-bit rolling counter in byte 0, checked by the E2E stage.
+ */
+#define TEST_E2E_ID 0x100
+
+/**
+ * @def TEST_FRAME_SPACING_NS
+ * @brief Time between two frames on the bus.
+ */
+#define TEST_FRAME_SPACING_NS 400000ULL
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+FDCAN_HandleTypeDef hfdcan1 = {.Instance = FDCAN1, .Init = {.RxFifo0ElmtsNbr = 64}};
+
+/**
+ * @var output
+ * @brief UART output of the current run.
+ */
+static uint8_t output[TEST_FRAMES * CAN_TEXT_MAX_SIZE];
+
+/**
+ * @var output_length
+ * @brief Bytes in output.
+ */
+static uint32_t output_length = 0;
+
+/**
+ * @fn uint32_t my_timestamp_get(void)
+ * @brief Simulated microsecond time base (replaces the TIM2 counter).
+ */
+uint32_t my_timestamp_get(void) {
+	return (uint32_t)(host_sim_now_ns() / 1000);
+}
+
+/**
+ * @fn static void collect(const uint8_t* data, uint32_t size, uint64_t start_ns, void* context)
+ * @brief UART output callback (host_Sim_Output).
+ */
+static void collect(const uint8_t* data, uint32_t size, uint64_t start_ns, void* context) {
+	(void)start_ns;
+	(void)context;
+	if (size > sizeof(output) - output_length) size = sizeof(output) - output_length;
+	memcpy(&output[output_length], data, size);
+	output_length += size;
+}
+
+/**
+ * @fn static uint32_t count_records(bool* binary)
+ * @brief Frames in the output: binary records if it starts with a sync byte, else text lines ("ID: ...").
+ */
+static uint32_t count_records(bool* binary) {
+	uint32_t count = 0;
+	*binary = (output_length > 0 && output[0] == CAN_WIRE_SYNC);
+	if (*binary) {
+		for (uint32_t at = 0; at + 1 < output_length && output[at] == CAN_WIRE_SYNC; at += output[at + 1]) count++;
+	} else {
+		for (uint32_t i = 0; i + 3 <= output_length; i++) count += (memcmp(&output[i], "ID:", 3) == 0);
+	}
+	return count;
+}
+
+/**
+ * @fn static bool run(const char* name, uint32_t stages)
+ * @brief Capture the test traffic and check the effects of the stages of a mask.
+ */
+static bool run(const char* name, uint32_t stages) {
+	my_CAN_stop();
+#if CAN_PIPELINE_PROFILE == CAN_PIPELINE_DYNAMIC
+	my_CAN_set_rx_stages(stages);
+#endif
+	my_CAN_set_output_mode(CAN_OUTPUT_TEXT);
+	can_history_set_mode(CAN_HISTORY_TOP);
+	can_e2e_resume();
+	my_CAN_start();
+	const uint32_t ids_before = get_can_ids_status(false).frames;
+	const uint32_t e2e_before = get_can_e2e_status(false).total.frames;
+	host_sim_advance(host_sim_now_ns() + 1000000);
+	output_length = 0;
+
+	FDCAN_RxHeaderTypeDef header = {.IdType = FDCAN_STANDARD_ID, .RxFrameType = FDCAN_DATA_FRAME, .DataLength = 8,
+									.BitRateSwitch = FDCAN_BRS_OFF, .FDFormat = FDCAN_CLASSIC_CAN};
+	const uint64_t start_ns = host_sim_now_ns();
+	uint32_t e2e_frames = 0;
+	for (uint32_t i = 0; i < TEST_FRAMES; i++) {
+		uint8_t data[8] = {0, 0x11, 0x22, (uint8_t)i};
+		header.Identifier = TEST_E2E_ID + i % TEST_IDS;
+		if (header.Identifier == TEST_E2E_ID) data[0] = (uint8_t)(e2e_frames++ & 0x0F);
+		host_sim_bus_queue(&header, data, start_ns + (i + 1) * TEST_FRAME_SPACING_NS);
+	}
+	host_sim_advance(host_sim_bus_last_ns());
+	send_frame_over_UART();
+	host_sim_advance(host_sim_now_ns() + 20000000);
+
+	const uint32_t ids_frames = get_can_ids_status(false).frames - ids_before;
+	const uint32_t e2e_checked = get_can_e2e_status(false).total.frames - e2e_before;
+	const uint32_t tracked = get_can_history_status(false).tracked_ids;
+	bool binary;
+	const uint32_t records = count_records(&binary);
+
+	const bool ids_ok = ids_frames == ((stages & CAN_PIPELINE_STAGE_BIT_ids) ? TEST_FRAMES : 0);
+	const bool e2e_ok = e2e_checked == ((stages & CAN_PIPELINE_STAGE_BIT_e2e) ? e2e_frames : 0);
+	const bool history_ok = tracked == ((stages & CAN_PIPELINE_STAGE_BIT_history) ? TEST_IDS : 0);
+	bool output_ok;
+	const char* format;
+	if (stages & CAN_PIPELINE_STAGE_BIT_output) {
+		output_ok = !binary && records == TEST_FRAMES;
+		format = "text";
+	} else if (stages & CAN_PIPELINE_STAGE_BIT_binary) {
+		output_ok = binary && records == TEST_FRAMES;
+		format = "binary";
+	} else {
+		output_ok = output_length == 0;
+		format = "none";
+	}
+
+	printf("%-7s ids %3lu, e2e %3lu, history %lu IDs, output %lu %s (%lu B, expected %s) -> %s\n", name,
+		   (unsigned long)ids_frames, (unsigned long)e2e_checked, (unsigned long)tracked, (unsigned long)records,
+		   binary ? "records" : "lines", (unsigned long)output_length, format,
+		   (ids_ok && e2e_ok && history_ok && output_ok) ? "PASS" : "FAIL");
+	return ids_ok && e2e_ok && history_ok && output_ok;
+}
+
+int main(void) {
+	host_sim_init(TEST_BITRATE, collect, NULL);
+	my_uart_dma_init();
+	(void)my_mempool_init();
+	if (!my_CAN_manual_configuration(TEST_BITRATE).is_set) return 1;
+	can_e2e_clear();
+	const can_E2E_Descriptor descriptor = {.Identifier = TEST_E2E_ID, .counter_bit = 0, .counter_length = 4,
+										   .counter_max = 15, .crc_byte = CAN_E2E_NO_CRC};
+	if (!can_e2e_add(&descriptor)) return 1;
+	can_ids_start_training(60000);
+
+	bool all_ok = true;
+	printf("Pipeline: %s\n", CAN_PIPELINE_NAME);
+#if CAN_PIPELINE_PROFILE == CAN_PIPELINE_DYNAMIC
+	all_ok &= run("full", CAN_PIPELINE_MASK(CAN_PIPELINE_FULL_STAGES));
+	all_ok &= run("raw", CAN_PIPELINE_MASK(CAN_PIPELINE_RAW_STAGES));
+	all_ok &= run("census", CAN_PIPELINE_MASK(CAN_PIPELINE_CENSUS_STAGES));
+	all_ok &= run("logger", CAN_PIPELINE_MASK(CAN_PIPELINE_LOGGER_STAGES));
+#else
+	all_ok &= run(CAN_PIPELINE_NAME, CAN_PIPELINE_MASK(CAN_PIPELINE_STAGES));
+#endif
+	return all_ok ? 0 : 1;
+}
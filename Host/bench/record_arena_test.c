@@ -0,0 +1,163 @@
+/**
+ * @file record_arena_test.c
+ * @brief Host test of the variable-length record arena of the text output path.
+ *
+ * @details
+ * Captures frames of every DLC in text output mode on the simulated FDCAN1
+ * (host_sim.c), in bursts that fit in the software CAN buffer, so that the
+ * records wrap around the arena many times, and checks that:
+ *   1. the UART output is exactly the text line of every frame, in order
+ *      (no record lost, duplicated or corrupted at a wrap),
+ *   2. the buffer counters add up: one record per frame of
+ *      CAN_RECORD_SIZE(DLC) bytes, padding at the wraps, no drops, and a
+ *      fill that never exceeded the arena,
+ *   3. the average record is smaller than a fixed my_CAN_Frame slot.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DHOST_SIMULATION -IHost/stubs -IMy_Modules/Drivers/can
+ *       -IMy_Modules/Drivers/debug -IMy_Modules/Drivers/mempool -IMy_Modules/Drivers/payload -IMy_Modules/Drivers/stdio
+ *       -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp
+ *       -IMy_Modules/Features/e2e -IMy_Modules/Features/history -IMy_Modules/Features/ids
+ *       -IMy_Modules/Features/logger -IMy_Modules/Features/power
+ *       Host/bench/record_arena_test.c Host/stubs/host_sim.c
+ *       My_Modules/Drivers/can/my_can.c My_Modules/Drivers/can/my_can_wire.c
+ *       My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/mempool/my_mempool.c My_Modules/Drivers/payload/my_payload.c
+ *       My_Modules/Drivers/stdio/my_stdio.c My_Modules/Drivers/uart/my_uart.c
+ *       My_Modules/Features/e2e/can_e2e.c My_Modules/Features/history/can_history.c
+ *       My_Modules/Features/ids/can_ids.c My_Modules/Features/logger/can_logger.c
+ *       My_Modules/Features/power/can_power.c -o record_arena_test
+ *   ./record_arena_test
+ */
+
+#include <string.h>
+#include "host_sim.h"
+#include "my_can.h"
+#include "my_can_wire.h"
+#include "my_mempool.h"
+
+/**
+ * @def TEST_BITRATE
+ * @brief Bit rate of the simulated bus.
+ */
+#define TEST_BITRATE 500000
+
+/**
+ * @def TEST_BURSTS
+ * @brief Bursts of frames, each drained before the next one.
+ */
+#define TEST_BURSTS 20
+
+/**
+ * @def TEST_BURST_FRAMES
+ * @brief Frames of a burst (their records fit in SOFTWARE_CAN_BUFFER_SIZE).
+ */
+#define TEST_BURST_FRAMES 150
+
+/**
+ * @def TEST_FRAME_SPACING_NS
+ * @brief Time between two frames of a burst on the bus.
+ */
+#define TEST_FRAME_SPACING_NS 300000ULL
+
+/**
+ * @def TEST_OUTPUT_SIZE
+ * @brief Bytes of output kept for the comparison.
+ */
+#define TEST_OUTPUT_SIZE (TEST_BURSTS * TEST_BURST_FRAMES * CAN_TEXT_MAX_SIZE)
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+FDCAN_HandleTypeDef hfdcan1 = {.Instance = FDCAN1, .Init = {.RxFifo0ElmtsNbr = 64}};
+
+/**
+ * @var output
+ * @brief UART output of the firmware.
+ */
+static char output[TEST_OUTPUT_SIZE];
+
+/**
+ * @var output_length
+ * @brief Characters in output.
+ */
+static uint32_t output_length = 0;
+
+/**
+ * @var expected
+ * @brief Text lines of the frames put on the bus.
+ */
+static char expected[TEST_OUTPUT_SIZE];
+
+/**
+ * @var expected_length
+ * @brief Characters in expected.
+ */
+static uint32_t expected_length = 0;
+
+/**
+ * @fn uint32_t my_timestamp_get(void)
+ * @brief Simulated microsecond time base (replaces the TIM2 counter).
+ */
+uint32_t my_timestamp_get(void) {
+	return (uint32_t)(host_sim_now_ns() / 1000);
+}
+
+/**
+ * @fn static void collect(const uint8_t* data, uint32_t size, uint64_t start_ns, void* context)
+ * @brief UART output callback (host_Sim_Output).
+ */
+static void collect(const uint8_t* data, uint32_t size, uint64_t start_ns, void* context) {
+	(void)start_ns;
+	(void)context;
+	if (size > sizeof(output) - output_length) size = sizeof(output) - output_length;
+	memcpy(&output[output_length], data, size);
+	output_length += size;
+}
+
+int main(void) {
+	host_sim_init(TEST_BITRATE, collect, NULL);
+	my_uart_dma_init();
+	(void)my_mempool_init();
+	if (!my_CAN_manual_configuration(TEST_BITRATE).is_set) return 1;
+	my_CAN_set_output_mode(CAN_OUTPUT_TEXT);
+	my_CAN_start();
+
+	uint32_t frames = 0;
+	uint64_t record_bytes = 0;
+	for (int burst = 0; burst < TEST_BURSTS; burst++) {
+		uint64_t start_ns = host_sim_now_ns();
+		for (uint32_t i = 0; i < TEST_BURST_FRAMES; i++, frames++) {
+			uint8_t data[8];
+			FDCAN_RxHeaderTypeDef header = {.Identifier = 0x100 + (frames * 37) % 0x600, .IdType = FDCAN_STANDARD_ID,
+											.RxFrameType = FDCAN_DATA_FRAME, .DataLength = (frames * 5) % 9,
+											.BitRateSwitch = FDCAN_BRS_OFF, .FDFormat = FDCAN_CLASSIC_CAN};
+			for (int j = 0; j < 8; j++) data[j] = (uint8_t)(frames * 13 + j);
+			host_sim_bus_queue(&header, data, start_ns + (i + 1) * TEST_FRAME_SPACING_NS);
+			expected_length += my_CAN_text_format(header.Identifier, (uint8_t)header.DataLength, data, &expected[expected_length]);
+			record_bytes += CAN_RECORD_SIZE(header.DataLength);
+		}
+		host_sim_advance(host_sim_bus_last_ns());
+		send_frame_over_UART();
+	}
+
+	const my_CAN_Buffer_Stats buffer = get_my_CAN_buffer_stats(false);
+	bool output_ok = (output_length == expected_length) && (memcmp(output, expected, expected_length) == 0);
+	bool stats_ok = (buffer.records == frames) && (buffer.record_bytes == record_bytes) && (buffer.dropped_frames == 0) &&
+					(buffer.padding_bytes > 0) && (buffer.max_fill_bytes < SOFTWARE_CAN_BUFFER_SIZE) &&
+					(record_bytes + buffer.padding_bytes > 2 * SOFTWARE_CAN_BUFFER_SIZE);
+	double average = (double)buffer.record_bytes / (buffer.records ? buffer.records : 1);
+	bool gain_ok = average < sizeof(my_CAN_Frame);
+
+	if (!output_ok) {
+		uint32_t at = 0;
+		while (at < output_length && at < expected_length && output[at] == expected[at]) at++;
+		printf("Output differs at byte %lu: \"%.40s\" instead of \"%.40s\"\n", (unsigned long)at, &output[at], &expected[at]);
+	}
+	printf("Output: %lu frames, %lu of %lu bytes as expected -> %s\n", (unsigned long)frames,
+		   (unsigned long)(output_ok ? output_length : 0), (unsigned long)expected_length, output_ok ? "PASS" : "FAIL");
+	printf("Arena: %lu records, %lu record bytes, %lu padding bytes, %lu dropped, high-water %lu B -> %s\n",
+		   (unsigned long)buffer.records, (unsigned long)buffer.record_bytes, (unsigned long)buffer.padding_bytes,
+		   (unsigned long)buffer.dropped_frames, (unsigned long)buffer.max_fill_bytes, stats_ok ? "PASS" : "FAIL");
+	printf("Record: %.1f B on average, %lu B per fixed slot -> %s\n", average, (unsigned long)sizeof(my_CAN_Frame),
+		   gain_ok ? "PASS" : "FAIL");
+	return (output_ok && stats_ok && gain_ok) ? 0 : 1;
+}
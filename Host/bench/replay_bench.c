@@ -0,0 +1,578 @@
+/**
+ * @file replay_bench.c
+ * @brief Host replay of a recorded capture through the firmware capture path.
+ *
+ * @details
+ * Runs the firmware modules of the capture path (my_can.c with intrusion
+ * detection, history and logger, my_uart.c, command channel) on the
+ * simulated FDCAN1 and USART3 of host_sim.c, and puts the frames of a
+ * capture file (any format of can_capture.h), loaded in memory first
+ * (24 bytes per frame), on the simulated bus:
+ *   - with their recorded timing divided by --speed, or back to back with
+ *     --speed max
+ *   - never faster than the bus bit rate allows (a frame starts after the
+ *     previous one ended), so the offered load is physically possible
+ * Between frame arrivals the main loop of main.c runs. Only UART
+ * transmission takes simulated time: CPU time of the interrupt and of the
+ * main loop is not modelled, so the results show the limits of buffering
+ * and UART bandwidth, not of the CPU.
+ *
+ * The UART output is decoded (binary records and text lines) and matched to
+ * the frames put on the bus, giving the frames lost on the way and the
+ * latency from the end of a frame on the bus to the end of its output
+ * record, next to the output latency histograms of the firmware
+ * (my_CAN_Latency_Stats). All loss counters are reported: FDCAN RX FIFO0, software buffer /
+ * UART arena (my_CAN_Buffer_Stats) and SD card logger.
+ *
+ * With --idle sleep|stop the low-power idle of can_power.c runs after
+ * --silence ms of bus silence (CAN_POWER_SILENCE_MS by default), and the
+ * frames not received during the wakes from Stop are compared with the
+ * bound of the firmware. The Stop wake-up time of the chip is
+ * CAN_POWER_STOP_WAKEUP_US, or --wake us.
+ *
+ * With --trajectory, the backlog (frames received and not dropped whose
+ * output has not started yet) is written every --interval ms of simulated
+ * time as CSV, to be compared with the prediction of can_capacity.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -DHOST_SIMULATION -IHost/stubs -IHost/tools -IMy_Modules/Drivers/can
+ *       -IMy_Modules/Drivers/debug -IMy_Modules/Drivers/mempool -IMy_Modules/Drivers/payload -IMy_Modules/Drivers/stdio
+ *       -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp -IMy_Modules/Features/command
+ *       -IMy_Modules/Features/e2e -IMy_Modules/Features/history -IMy_Modules/Features/ids
+ *       -IMy_Modules/Features/logger -IMy_Modules/Features/power
+ *       Host/bench/replay_bench.c Host/stubs/host_sim.c Host/tools/can_capture.c
+ *       My_Modules/Drivers/can/my_can.c My_Modules/Drivers/can/my_can_wire.c
+ *       My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/mempool/my_mempool.c My_Modules/Drivers/payload/my_payload.c
+ *       My_Modules/Drivers/stdio/my_stdio.c My_Modules/Drivers/uart/my_uart.c
+ *       My_Modules/Features/command/command_channel.c My_Modules/Features/e2e/can_e2e.c
+ *       My_Modules/Features/history/can_history.c My_Modules/Features/ids/can_ids.c
+ *       My_Modules/Features/logger/can_logger.c My_Modules/Features/power/can_power.c -o replay_bench
+ *   ./replay_bench [--speed N|max] [--bitrate B] [--text] [--filter ID MASK] [-o output.bin]
+ *                 [--trajectory backlog.csv [--interval MS]]
+ *                 [--idle sleep|stop [--silence MS] [--wake US]] capture
+ */
+
+#include <stdlib.h>
+#include "host_sim.h"
+#include "can_capture.h"
+#include "my_can.h"
+#include "my_can_wire.h"
+#include "my_mempool.h"
+#include "can_ids.h"
+#include "can_history.h"
+#include "can_logger.h"
+#include "command_channel.h"
+#include "can_power.h"
+
+/**
+ * @def LATENCY_BIN_NS
+ * @brief Latency histogram resolution.
+ */
+#define LATENCY_BIN_NS 10000
+
+/**
+ * @def LATENCY_BINS
+ * @brief Latency histogram bins (the last one collects everything above).
+ */
+#define LATENCY_BINS 100000
+
+/**
+ * @def OUTPUT_BUFFER_SIZE
+ * @brief UART output bytes kept while decoding (two maximum transfers).
+ */
+#define OUTPUT_BUFFER_SIZE (2 * 65536)
+
+/**
+ * @struct replay_Frame
+ * @brief Capture frame with its arrival time on the simulated bus.
+ */
+typedef struct {
+	uint64_t arrival_ns;
+	uint32_t identifier;
+	uint8_t data_length;
+	uint8_t data[8];
+} replay_Frame;
+
+/**
+ * @struct replay_Stats
+ * @brief Counters of the replay.
+ *
+ * @details
+ * bus_delayed_frames counts the frames that started later than their
+ * scaled recorded time because the bus was still busy with the previous one.
+ */
+typedef struct {
+	uint64_t frames;
+	uint64_t bus_delayed_frames;
+	uint64_t bus_busy_ns;
+	uint64_t output_frames;
+	uint64_t unmatched_output_frames;
+	uint64_t other_lines;
+	uint64_t latency_sum_ns;
+	uint64_t latency_max_ns;
+} replay_Stats;
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+FDCAN_HandleTypeDef hfdcan1 = {.Instance = FDCAN1, .Init = {.RxFifo0ElmtsNbr = 64}};
+
+/**
+ * @var frames
+ * @brief Frames of the capture in bus order.
+ */
+static replay_Frame* frames = NULL;
+
+/**
+ * @var frame_count
+ * @brief Number of frames.
+ */
+static uint64_t frame_count = 0;
+
+/**
+ * @var frame_capacity
+ * @brief Allocated entries of frames.
+ */
+static uint64_t frame_capacity = 0;
+
+/**
+ * @var next_frame
+ * @brief Index of the next frame to put on the bus.
+ */
+static uint64_t next_frame = 0;
+
+/**
+ * @var next_match
+ * @brief Index of the oldest frame on the bus not seen in the output yet.
+ */
+static uint64_t next_match = 0;
+
+/**
+ * @var latency_bins
+ * @brief Latency histogram.
+ */
+static uint64_t latency_bins[LATENCY_BINS];
+
+/**
+ * @var output_buffer
+ * @brief UART output not decoded yet.
+ */
+static uint8_t output_buffer[OUTPUT_BUFFER_SIZE];
+
+/**
+ * @var output_length
+ * @brief Bytes in output_buffer.
+ */
+static uint32_t output_length = 0;
+
+/**
+ * @var output_file
+ * @brief Copy of the UART output (-o), NULL if not requested.
+ */
+static FILE* output_file = NULL;
+
+/**
+ * @var speed
+ * @brief Replay speed factor, 0 = back to back.
+ */
+static double speed = 1.0;
+
+/**
+ * @var trajectory_file
+ * @brief Backlog CSV (--trajectory), NULL if not requested.
+ */
+static FILE* trajectory_file = NULL;
+
+/**
+ * @var trajectory_interval_ns
+ * @brief Time between two backlog samples.
+ */
+static uint64_t trajectory_interval_ns = 10000000;
+
+/**
+ * @var idle_mode
+ * @brief Low-power idle mode (--idle).
+ */
+static can_Power_Mode idle_mode = CAN_POWER_OFF;
+
+/**
+ * @var bus_free_ns
+ * @brief End of the last frame put on the bus.
+ */
+static uint64_t bus_free_ns = 0;
+
+/**
+ * @var replay
+ * @brief Counters of the replay.
+ */
+static replay_Stats replay;
+
+/**
+ * @fn uint32_t my_timestamp_get(void)
+ * @brief Simulated microsecond time base (replaces the TIM2 counter).
+ */
+uint32_t my_timestamp_get(void) {
+	return (uint32_t)(host_sim_now_ns() / 1000);
+}
+
+/**
+ * @fn static void main_loop(void)
+ * @brief One iteration of the STATE_RUN main loop of main.c.
+ */
+static void main_loop(void) {
+	send_frame_over_UART();
+	send_ids_alerts_over_UART();
+	can_history_poll();
+	can_logger_poll();
+	command_channel_poll();
+	can_power_poll();
+}
+
+/**
+ * @fn static void write_sample(uint64_t now_ns, void* context)
+ * @brief Write the backlog to the trajectory file (host_Sim_Probe).
+ *
+ * @details
+ * Output is decoded when its transfer starts, so the backlog excludes the
+ * frames being transmitted.
+ */
+static void write_sample(uint64_t now_ns, void* context) {
+	(void)context;
+	const host_Sim_Stats sim = host_sim_get_stats();
+	const my_CAN_Buffer_Stats buffer = get_my_CAN_buffer_stats(false);
+	fprintf(trajectory_file, "%.3f,%lld,%lu\n", now_ns * 1e-9,
+			(long long)(sim.received_frames - replay.output_frames - buffer.dropped_frames), (unsigned long)buffer.dropped_frames);
+}
+
+/**
+ * @fn static void run(void)
+ * @brief Run the main loop and the simulated peripherals until nothing is left to do.
+ *
+ * @details
+ * The main loop takes no simulated time, so one iteration after every
+ * event is enough. With --idle it also runs at every ms tick, to see the
+ * bus silence.
+ */
+static void run(void) {
+	for (;;) {
+		main_loop();
+		uint64_t next = host_sim_next_event_ns();
+		if (next == UINT64_MAX) break;
+		if (idle_mode != CAN_POWER_OFF) {
+			uint64_t tick = (host_sim_now_ns() / 1000000 + 1) * 1000000;
+			if (tick < next) next = tick;
+		}
+		host_sim_advance(next);
+	}
+}
+
+/**
+ * @fn static void match_output(const my_CAN_Frame* frame, uint64_t end_ns)
+ * @brief Find the frame of an output record among the frames put on the bus.
+ *
+ * @details
+ * Output keeps the bus order, so the frames before the match were lost
+ * (or filtered out).
+ */
+static void match_output(const my_CAN_Frame* frame, uint64_t end_ns) {
+	while (next_match < next_frame) {
+		const replay_Frame* p = &frames[next_match++];
+		if (p->identifier != frame->Identifier || p->data_length != frame->DataLength ||
+				memcmp(p->data, frame->Data, frame->DataLength) != 0) {
+			continue;
+		}
+		uint64_t latency = end_ns - p->arrival_ns;
+		replay.output_frames++;
+		replay.latency_sum_ns += latency;
+		if (latency > replay.latency_max_ns) replay.latency_max_ns = latency;
+		latency_bins[(latency / LATENCY_BIN_NS < LATENCY_BINS) ? latency / LATENCY_BIN_NS : LATENCY_BINS - 1]++;
+		return;
+	}
+	replay.unmatched_output_frames++;
+}
+
+/**
+ * @fn static void on_output(const uint8_t* data, uint32_t size, uint64_t start_ns, void* context)
+ * @brief Decode a UART transfer (host_Sim_Output).
+ *
+ * @details
+ * Binary records and text lines may be cut between transfers: the
+ * undecoded rest is kept for the next one. A record ends with the
+ * transmission of its last byte.
+ */
+static void on_output(const uint8_t* data, uint32_t size, uint64_t start_ns, void* context) {
+	(void)context;
+	if (output_file) fwrite(data, 1, size, output_file);
+	if (output_length + size > OUTPUT_BUFFER_SIZE) output_length = 0;
+	const uint32_t base = output_length;
+	memcpy(&output_buffer[output_length], data, size);
+	output_length += size;
+
+	uint32_t position = 0;
+	while (position < output_length) {
+		my_CAN_Frame frame;
+		uint32_t end;
+		if (output_buffer[position] == CAN_WIRE_SYNC) {
+			if (output_length - position < 2 || output_buffer[position + 1] > output_length - position) break;
+			uint32_t record_size = my_CAN_wire_decode(&output_buffer[position], output_length - position, &frame, NULL);
+			if (record_size == 0) {
+				position++;
+				continue;
+			}
+			end = position + record_size;
+		} else {
+			uint8_t* newline = memchr(&output_buffer[position], '\n', output_length - position);
+			if (newline == NULL) break;
+			end = (uint32_t)(newline - output_buffer) + 1;
+			*newline = '\0';
+			unsigned identifier, dlc;
+			int offset = 0;
+			const char* line = (const char*)&output_buffer[position];
+			if (sscanf(line, "ID: 0x%x, DLC: %u, Data:%n", &identifier, &dlc, &offset) == 2 && offset > 0 && dlc <= 8) {
+				frame.Identifier = identifier;
+				frame.DataLength = (uint8_t)dlc;
+				for (unsigned i = 0; i < dlc; i++) {
+					unsigned value = 0;
+					sscanf(line + offset + 3 * i, " %2x", &value);
+					frame.Data[i] = (uint8_t)value;
+				}
+			} else {
+				if (line[0] != '\0' && line[0] != '\r') replay.other_lines++;
+				position = end;
+				continue;
+			}
+		}
+		match_output(&frame, start_ns + (uint64_t)(end - base) * 10 * 1000000000ULL / HOST_SIM_UART_BAUD);
+		position = end;
+	}
+	memmove(output_buffer, &output_buffer[position], output_length - position);
+	output_length -= position;
+}
+
+/**
+ * @fn static void on_frame(const my_CAN_Frame* frame, uint64_t time_us, void* context)
+ * @brief Load a capture frame with its arrival time (can_Capture_Callback).
+ */
+static void on_frame(const my_CAN_Frame* frame, uint64_t time_us, void* context) {
+	(void)context;
+	uint64_t start_ns = (speed > 0) ? (uint64_t)(time_us * 1000.0 / speed) : 0;
+	if (start_ns < bus_free_ns) {
+		if (speed > 0) replay.bus_delayed_frames++;
+		start_ns = bus_free_ns;
+	}
+	uint64_t duration = host_sim_frame_ns(frame->Identifier, frame->DataLength);
+	bus_free_ns = start_ns + duration;
+	replay.bus_busy_ns += duration;
+
+	if (frame_count == frame_capacity) {
+		frame_capacity = frame_capacity ? 2 * frame_capacity : (1UL << 20);
+		frames = realloc(frames, frame_capacity * sizeof(replay_Frame));
+		if (frames == NULL) {
+			printf("Out of memory at %llu frames\n", (unsigned long long)frame_count);
+			exit(1);
+		}
+	}
+	replay_Frame* p = &frames[frame_count++];
+	p->arrival_ns = bus_free_ns;
+	p->identifier = frame->Identifier;
+	p->data_length = frame->DataLength;
+	memcpy(p->data, frame->Data, frame->DataLength);
+}
+
+/**
+ * @fn static bool bus_source(FDCAN_RxHeaderTypeDef* header, uint8_t* data, uint64_t* arrival_ns, void* context)
+ * @brief Give the next capture frame to the simulated bus (host_Sim_Bus_Source).
+ */
+static bool bus_source(FDCAN_RxHeaderTypeDef* header, uint8_t* data, uint64_t* arrival_ns, void* context) {
+	(void)context;
+	if (next_frame == frame_count) return false;
+	const replay_Frame* p = &frames[next_frame++];
+	memset(header, 0, sizeof(*header));
+	header->Identifier = p->identifier;
+	header->IdType = (p->identifier > 0x7FF) ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+	header->RxFrameType = FDCAN_DATA_FRAME;
+	header->FDFormat = FDCAN_CLASSIC_CAN;
+	header->BitRateSwitch = FDCAN_BRS_OFF;
+	header->DataLength = p->data_length;
+	memcpy(data, p->data, p->data_length);
+	*arrival_ns = p->arrival_ns;
+	return true;
+}
+
+/**
+ * @fn static double latency_percentile(double fraction)
+ * @brief Latency in microseconds below which fraction of the output frames are.
+ */
+static double latency_percentile(double fraction) {
+	uint64_t target = (uint64_t)(fraction * replay.output_frames);
+	uint64_t count = 0;
+	for (uint32_t i = 0; i < LATENCY_BINS; i++) {
+		count += latency_bins[i];
+		if (count > target) return (i + 1) * (LATENCY_BIN_NS / 1000.0);
+	}
+	return replay.latency_max_ns / 1000.0;
+}
+
+/**
+ * @fn static double now_s(void)
+ * @brief Monotonic host time in seconds.
+ */
+static double now_s(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv) {
+	uint32_t bitrate = 500000;
+	my_CAN_Output_Mode mode = CAN_OUTPUT_BINARY;
+	uint32_t filter_id = 0, mask_id = 0;
+	const char* output_path = NULL;
+	const char* trajectory_path = NULL;
+	uint32_t silence_ms = 0;
+	uint64_t wake_ns = CAN_POWER_STOP_WAKEUP_US * 1000ULL;
+	bool idle_error = false;
+	int arg = 1;
+
+	for (; arg < argc && argv[arg][0] == '-'; arg++) {
+		if (strcmp(argv[arg], "--speed") == 0 && arg + 1 < argc) {
+			arg++;
+			speed = (strcmp(argv[arg], "max") == 0) ? 0 : atof(argv[arg]);
+		} else if (strcmp(argv[arg], "--bitrate") == 0 && arg + 1 < argc) {
+			bitrate = (uint32_t)strtoul(argv[++arg], NULL, 0);
+		} else if (strcmp(argv[arg], "--text") == 0) {
+			mode = CAN_OUTPUT_TEXT;
+		} else if (strcmp(argv[arg], "--filter") == 0 && arg + 2 < argc) {
+			filter_id = (uint32_t)strtoul(argv[++arg], NULL, 0);
+			mask_id = (uint32_t)strtoul(argv[++arg], NULL, 0);
+		} else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+			output_path = argv[++arg];
+		} else if (strcmp(argv[arg], "--trajectory") == 0 && arg + 1 < argc) {
+			trajectory_path = argv[++arg];
+		} else if (strcmp(argv[arg], "--interval") == 0 && arg + 1 < argc) {
+			trajectory_interval_ns = (uint64_t)(atof(argv[++arg]) * 1e6);
+		} else if (strcmp(argv[arg], "--idle") == 0 && arg + 1 < argc) {
+			arg++;
+			if (strcmp(argv[arg], "sleep") == 0) {
+				idle_mode = CAN_POWER_SLEEP;
+			} else if (strcmp(argv[arg], "stop") == 0) {
+				idle_mode = CAN_POWER_STOP;
+			} else {
+				idle_error = true;
+			}
+		} else if (strcmp(argv[arg], "--silence") == 0 && arg + 1 < argc) {
+			silence_ms = (uint32_t)strtoul(argv[++arg], NULL, 0);
+		} else if (strcmp(argv[arg], "--wake") == 0 && arg + 1 < argc) {
+			wake_ns = (uint64_t)(atof(argv[++arg]) * 1e3);
+		} else {
+			break;
+		}
+	}
+	if (arg != argc - 1 || speed < 0 || trajectory_interval_ns == 0 || idle_error) {
+		printf("Usage: replay_bench [--speed N|max] [--bitrate B] [--text] [--filter ID MASK] [-o output.bin]\n"
+			   "                    [--trajectory backlog.csv [--interval MS]]\n"
+			   "                    [--idle sleep|stop [--silence MS] [--wake US]] capture\n");
+		return 1;
+	}
+	if (output_path && (output_file = fopen(output_path, "wb")) == NULL) {
+		printf("Cannot write %s\n", output_path);
+		return 1;
+	}
+	if (trajectory_path) {
+		if ((trajectory_file = fopen(trajectory_path, "w")) == NULL) {
+			printf("Cannot write %s\n", trajectory_path);
+			return 1;
+		}
+		fprintf(trajectory_file, "time_s,backlog_frames,dropped_frames\n");
+	}
+
+	host_sim_init(bitrate, on_output, NULL);
+	my_uart_dma_init();
+	(void)my_mempool_init();
+	if (!my_CAN_manual_configuration(bitrate).is_set) {
+		printf("Bit rate %lu is not in can_timings[]\n", (unsigned long)bitrate);
+		return 1;
+	}
+	my_CAN_set_filter_mask(filter_id, mask_id);
+	my_CAN_set_output_mode(mode);
+	host_sim_set_stop_wake(wake_ns);
+	can_power_set_mode(idle_mode, silence_ms);
+	my_CAN_start();
+
+	can_Capture capture;
+	can_capture_init(&capture, on_frame, NULL);
+	if (!can_capture_read(&capture, argv[arg])) {
+		printf("Cannot read the capture %s\n", argv[arg]);
+		return 1;
+	}
+	replay.frames = frame_count;
+
+	double begin = now_s();
+	host_sim_set_bus_source(bus_source, NULL);
+	if (trajectory_file) host_sim_set_probe(write_sample, trajectory_interval_ns, NULL);
+	run();
+	double elapsed = now_s() - begin;
+	if (output_file) fclose(output_file);
+	if (trajectory_file) fclose(trajectory_file);
+
+	const host_Sim_Stats sim = host_sim_get_stats();
+	const my_CAN_Buffer_Stats buffer = get_my_CAN_buffer_stats(false);
+	const can_Logger_Status logger = get_can_logger_status(false);
+	const double simulated_s = host_sim_now_ns() * 1e-9;
+	const uint64_t delivered = sim.received_frames;
+	const uint64_t lost = delivered - replay.output_frames;
+
+	printf("Capture: %s, %llu frames over %.1f s\n", argv[arg], (unsigned long long)replay.frames, capture.last_us / 1e6);
+	if (speed > 0) {
+		printf("Replay: %gx, %lu bit/s, %s output, filter 0x%03lX mask 0x%03lX\n", speed, (unsigned long)bitrate,
+			   (mode == CAN_OUTPUT_BINARY) ? "binary" : "text", (unsigned long)filter_id, (unsigned long)mask_id);
+	} else {
+		printf("Replay: back to back, %lu bit/s, %s output, filter 0x%03lX mask 0x%03lX\n", (unsigned long)bitrate,
+			   (mode == CAN_OUTPUT_BINARY) ? "binary" : "text", (unsigned long)filter_id, (unsigned long)mask_id);
+	}
+	printf("Simulated %.2f s in %.2f s (%.1fx real time)\n\n", simulated_s, elapsed, simulated_s / (elapsed > 0 ? elapsed : 1));
+
+	printf("Bus: load %.1f%%, %llu frames delayed by the bus\n", 100.0 * replay.bus_busy_ns / (host_sim_now_ns() ? host_sim_now_ns() : 1),
+		   (unsigned long long)replay.bus_delayed_frames);
+	printf("FDCAN: %llu received, %llu filtered, %llu not received (bit rate), %llu lost in RX FIFO0 (max fill %lu)\n",
+		   (unsigned long long)sim.received_frames, (unsigned long long)sim.filtered_frames,
+		   (unsigned long long)sim.wrong_bitrate_frames, (unsigned long long)sim.fifo_lost_frames, (unsigned long)sim.fifo_max_fill);
+	printf("Firmware: %lu dropped (software buffer / UART arena), %lu FIFO overflows, buffer high-water %lu B\n",
+		   (unsigned long)buffer.dropped_frames, (unsigned long)buffer.fifo_overflows, (unsigned long)buffer.max_fill_bytes);
+	printf("Logger: %lu logged, %lu dropped%s\n", (unsigned long)logger.logged_frames, (unsigned long)logger.dropped_frames,
+		   logger.running ? "" : " (not running)");
+	printf("Output: %llu bytes in %llu transfers, UART busy %.1f%%, %llu other lines\n",
+		   (unsigned long long)sim.uart_bytes, (unsigned long long)sim.uart_transfers,
+		   100.0 * sim.uart_busy_ns / (host_sim_now_ns() ? host_sim_now_ns() : 1), (unsigned long long)replay.other_lines);
+	if (idle_mode != CAN_POWER_OFF) {
+		const can_Power_Status power = get_can_power_status(false);
+		printf("Idle: %s after %lu ms, %lu idle periods, %.1f s in WFI, %lu wakes from Stop (wake-up %.1f us)\n",
+			   (idle_mode == CAN_POWER_SLEEP) ? "sleep" : "stop", (unsigned long)power.silence_ms,
+			   (unsigned long)power.idle_periods, power.sleep_us / 1e6, (unsigned long)power.wakes, wake_ns / 1000.0);
+		if (power.wakes) {
+			printf("Wakes: %llu frames not received (bound %lu per wake, %lu total), %lu sync timeouts\n",
+				   (unsigned long long)(sim.unsynchronized_frames + sim.wrong_bitrate_frames),
+				   (unsigned long)power.max_lost_frames, (unsigned long)(power.max_lost_frames * power.wakes),
+				   (unsigned long)power.sync_timeouts);
+		}
+	}
+	printf("Frames: %llu output, %llu lost (%.3f%% of received)%s\n", (unsigned long long)replay.output_frames,
+		   (unsigned long long)lost, delivered ? 100.0 * lost / delivered : 0.0,
+		   replay.unmatched_output_frames ? ", output not matching the bus!" : "");
+	if (replay.output_frames) {
+		printf("Latency (us): avg %.1f, p50 %.0f, p99 %.0f, p99.9 %.0f, max %.1f\n",
+			   replay.latency_sum_ns / 1000.0 / replay.output_frames, latency_percentile(0.5), latency_percentile(0.99),
+			   latency_percentile(0.999), replay.latency_max_ns / 1000.0);
+	}
+
+	const my_CAN_Latency_Stats* firmware_latency = get_my_CAN_latency_stats(false);
+	for (uint32_t latency_class = 0; latency_class < CAN_LATENCY_CLASSES; latency_class++) {
+		const my_CAN_Latency_Histogram* residence = &firmware_latency->residence[latency_class];
+		const my_CAN_Latency_Histogram* end_to_end = &firmware_latency->end_to_end[latency_class];
+		if (end_to_end->frames == 0) continue;
+		printf("Firmware class %lu (us): ring residence avg %.1f, max %lu; end to end avg %.1f, max %lu (%lu frames)\n",
+			   (unsigned long)latency_class, residence->frames ? (double)residence->total_us / residence->frames : 0.0,
+			   (unsigned long)residence->max_us, (double)end_to_end->total_us / end_to_end->frames,
+			   (unsigned long)end_to_end->max_us, (unsigned long)end_to_end->frames);
+	}
+	return 0;
+}
@@ -0,0 +1,162 @@
+/**
+ * @file diskio_image.c
+ * @brief Host FatFs disk driver backed by a RAM or file disk image.
+ *
+ * @details
+ * A file image is accessed with pread()/pwrite(); CTRL_SYNC calls
+ * fdatasync(), like a card cache flush. Works with FatFs R0.12c (Cube
+ * package) and later.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "ff.h"
+#include "diskio.h"
+#include "diskio_image.h"
+
+#ifndef FF_LBA64
+typedef DWORD LBA_t; /* FatFs before R0.14 */
+#endif
+
+/**
+ * @var image_ram
+ * @brief RAM image, NULL for a file image.
+ */
+static uint8_t* image_ram = NULL;
+
+/**
+ * @var image_fd
+ * @brief File descriptor of a file image, -1 for a RAM image.
+ */
+static int image_fd = -1;
+
+/**
+ * @var image_sectors
+ * @brief Size of the image in sectors, 0 if no image is open.
+ */
+static uint32_t image_sectors = 0;
+
+/**
+ * @var image_stats
+ * @brief Access counters.
+ */
+static disk_Image_Stats image_stats;
+
+/**
+ * @fn bool disk_image_open(const char* path, uint32_t sector_count)
+ * @brief Create the disk image.
+ */
+bool disk_image_open(const char* path, uint32_t sector_count) {
+	size_t size = (size_t)sector_count * DISK_IMAGE_SECTOR_SIZE;
+
+	disk_image_close();
+	if (path == NULL) {
+		image_ram = calloc(1, size);
+		if (image_ram == NULL) return false;
+	} else {
+		image_fd = open(path, O_RDWR | O_CREAT, 0644);
+		if (image_fd < 0) return false;
+		if (ftruncate(image_fd, (off_t)size) != 0) {
+			disk_image_close();
+			return false;
+		}
+	}
+	image_sectors = sector_count;
+	memset(&image_stats, 0, sizeof(image_stats));
+	return true;
+}
+
+/**
+ * @fn void disk_image_close(void)
+ * @brief Release the disk image (a file image is kept on disk).
+ */
+void disk_image_close(void) {
+	free(image_ram);
+	image_ram = NULL;
+	if (image_fd >= 0) close(image_fd);
+	image_fd = -1;
+	image_sectors = 0;
+}
+
+/**
+ * @fn disk_Image_Stats disk_image_get_stats(bool reset)
+ * @brief Get the access counters.
+ */
+disk_Image_Stats disk_image_get_stats(bool reset) {
+	disk_Image_Stats stats = image_stats;
+	if (reset) memset(&image_stats, 0, sizeof(image_stats));
+	return stats;
+}
+
+DSTATUS disk_status(BYTE pdrv) {
+	return (pdrv == 0 && image_sectors != 0) ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_initialize(BYTE pdrv) {
+	return disk_status(pdrv);
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE* buff, LBA_t sector, UINT count) {
+	if (disk_status(pdrv) != 0) return RES_NOTRDY;
+	if ((uint64_t)sector + count > image_sectors) return RES_PARERR;
+
+	size_t offset = (size_t)sector * DISK_IMAGE_SECTOR_SIZE;
+	size_t length = (size_t)count * DISK_IMAGE_SECTOR_SIZE;
+	if (image_ram != NULL) {
+		memcpy(buff, image_ram + offset, length);
+	} else if (pread(image_fd, buff, length, (off_t)offset) != (ssize_t)length) {
+		return RES_ERROR;
+	}
+	image_stats.reads++;
+	image_stats.sectors_read += count;
+	return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE* buff, LBA_t sector, UINT count) {
+	if (disk_status(pdrv) != 0) return RES_NOTRDY;
+	if ((uint64_t)sector + count > image_sectors) return RES_PARERR;
+
+	size_t offset = (size_t)sector * DISK_IMAGE_SECTOR_SIZE;
+	size_t length = (size_t)count * DISK_IMAGE_SECTOR_SIZE;
+	if (image_ram != NULL) {
+		memcpy(image_ram + offset, buff, length);
+	} else if (pwrite(image_fd, buff, length, (off_t)offset) != (ssize_t)length) {
+		return RES_ERROR;
+	}
+	image_stats.writes++;
+	image_stats.sectors_written += count;
+	return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void* buff) {
+	if (disk_status(pdrv) != 0) return RES_NOTRDY;
+
+	switch (cmd) {
+		case CTRL_SYNC:
+			image_stats.syncs++;
+			if (image_fd >= 0 && fdatasync(image_fd) != 0) return RES_ERROR;
+			return RES_OK;
+		case GET_SECTOR_COUNT:
+			*(LBA_t*)buff = image_sectors;
+			return RES_OK;
+		case GET_SECTOR_SIZE:
+			*(WORD*)buff = DISK_IMAGE_SECTOR_SIZE;
+			return RES_OK;
+		case GET_BLOCK_SIZE:
+			*(DWORD*)buff = 1;
+			return RES_OK;
+		default:
+			return RES_PARERR;
+	}
+}
+
+DWORD get_fattime(void) {
+	time_t now = time(NULL);
+	struct tm* t = localtime(&now);
+	return ((DWORD)(t->tm_year - 80) << 25) | ((DWORD)(t->tm_mon + 1) << 21) | ((DWORD)t->tm_mday << 16) |
+		   ((DWORD)t->tm_hour << 11) | ((DWORD)t->tm_min << 5) | ((DWORD)t->tm_sec >> 1);
+}
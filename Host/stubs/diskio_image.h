@@ -0,0 +1,60 @@
+/**
+ * @file diskio_image.h
+ * @brief Host FatFs disk driver backed by a RAM or file disk image.
+ *
+ * @details
+ * Replaces the SD card driver when FatFs runs on a PC, so modules using
+ * FatFs (e.g. can_logger) can be tested and benchmarked. Implements the
+ * FatFs disk_*() functions for physical drive 0 with 512-byte sectors.
+ */
+
+#ifndef DISKIO_IMAGE_H
+#define DISKIO_IMAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @def DISK_IMAGE_SECTOR_SIZE
+ * @brief Sector size (in bytes) of the disk image.
+ */
+#define DISK_IMAGE_SECTOR_SIZE 512
+
+/**
+ * @struct disk_Image_Stats
+ * @brief Disk access counters.
+ */
+typedef struct {
+	uint32_t reads;
+	uint32_t writes;
+	uint32_t syncs;
+	uint64_t sectors_read;
+	uint64_t sectors_written;
+} disk_Image_Stats;
+
+/**
+ * @fn bool disk_image_open(const char* path, uint32_t sector_count)
+ * @brief Create the disk image.
+ *
+ * @param path Image file (created or resized), or NULL for a RAM image.
+ * @param sector_count Size of the image in sectors.
+ * @retval true On success, else false.
+ */
+bool disk_image_open(const char* path, uint32_t sector_count);
+
+/**
+ * @fn void disk_image_close(void)
+ * @brief Release the disk image (a file image is kept on disk).
+ */
+void disk_image_close(void);
+
+/**
+ * @fn disk_Image_Stats disk_image_get_stats(bool reset)
+ * @brief Get the access counters.
+ *
+ * @param reset If true, the counters are cleared after reading.
+ * @retval Access counters since the last reset.
+ */
+disk_Image_Stats disk_image_get_stats(bool reset);
+
+#endif /* DISKIO_IMAGE_H */
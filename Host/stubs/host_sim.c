@@ -0,0 +1,632 @@
+/**
+ * @file host_sim.c
+ * @brief Host simulation of FDCAN1, USART3 and time, to run the capture path off-target.
+ */
+
+#include <string.h>
+#include "host_sim.h"
+
+/**
+ * @struct bus_Frame
+ * @brief Frame waiting on the simulated bus.
+ */
+typedef struct {
+	FDCAN_RxHeaderTypeDef header;
+	uint8_t data[8];
+	uint64_t arrival_ns;
+} bus_Frame;
+
+/**
+ * @var now_ns
+ * @brief Simulated time.
+ */
+static uint64_t now_ns = 0;
+
+/**
+ * @var bus_bitrate
+ * @brief Bit rate of the simulated bus.
+ */
+static uint32_t bus_bitrate = 500000;
+
+/**
+ * @var bus[HOST_SIM_BUS_QUEUE]
+ * @brief Ring of frames queued on the bus, in arrival order.
+ */
+static bus_Frame bus[HOST_SIM_BUS_QUEUE];
+
+/**
+ * @var bus_head
+ * @brief Index of the next frame to arrive.
+ */
+static uint32_t bus_head = 0;
+
+/**
+ * @var bus_count
+ * @brief Frames queued on the bus.
+ */
+static uint32_t bus_count = 0;
+
+/**
+ * @var bus_source
+ * @brief Frame source pulled when the bus queue is empty, NULL if none.
+ */
+static host_Sim_Bus_Source bus_source = NULL;
+
+/**
+ * @var bus_source_context
+ * @brief Context passed to bus_source.
+ */
+static void* bus_source_context = NULL;
+
+/**
+ * @var probe
+ * @brief Function called every probe_interval_ns, NULL if none.
+ */
+static host_Sim_Probe probe = NULL;
+
+/**
+ * @var probe_interval_ns
+ * @brief Time between two probe calls.
+ */
+static uint64_t probe_interval_ns = 0;
+
+/**
+ * @var probe_next_ns
+ * @brief Time of the next probe call.
+ */
+static uint64_t probe_next_ns = 0;
+
+/**
+ * @var probe_context
+ * @brief Context passed to probe.
+ */
+static void* probe_context = NULL;
+
+/**
+ * @var bus_last_ns
+ * @brief Arrival time of the last queued frame.
+ */
+static uint64_t bus_last_ns = 0;
+
+/**
+ * @var fdcan
+ * @brief Handle passed to HAL_FDCAN_Start() (NULL when stopped).
+ */
+static FDCAN_HandleTypeDef* fdcan = NULL;
+
+/**
+ * @var fdcan_start_ns
+ * @brief Time of the last HAL_FDCAN_Start(): frames started before are not received.
+ */
+static uint64_t fdcan_start_ns = 0;
+
+/**
+ * @var fdcan_sync_ns
+ * @brief End of the frame in progress at the last HAL_FDCAN_Start(), when FDCAN1 is synchronized.
+ */
+static uint64_t fdcan_sync_ns = 0;
+
+/**
+ * @var stop_wake_ns
+ * @brief Time from the wake-up edge to the first instruction after Stop.
+ */
+static uint64_t stop_wake_ns = 0;
+
+/**
+ * @var fifo[HOST_SIM_FIFO_SIZE]
+ * @brief RX FIFO0 elements.
+ */
+static bus_Frame fifo[HOST_SIM_FIFO_SIZE];
+
+/**
+ * @var fifo_get
+ * @brief Index of the oldest RX FIFO0 element.
+ */
+static uint32_t fifo_get = 0;
+
+/**
+ * @var fifo_fill
+ * @brief RX FIFO0 fill level.
+ */
+static uint32_t fifo_fill = 0;
+
+/**
+ * @var fifo_lost
+ * @brief RX FIFO0 message lost flag.
+ */
+static bool fifo_lost = false;
+
+/**
+ * @var active_its
+ * @brief Activated FDCAN notifications.
+ */
+static uint32_t active_its = 0;
+
+/**
+ * @var global_filter
+ * @brief HAL_FDCAN_ConfigGlobalFilter() arguments: non matching standard / extended.
+ */
+static uint32_t global_filter[2] = {FDCAN_ACCEPT_IN_RX_FIFO0, FDCAN_ACCEPT_IN_RX_FIFO0};
+
+/**
+ * @var filter
+ * @brief Standard ID filter element 0.
+ */
+static FDCAN_FilterTypeDef filter;
+
+/**
+ * @var filter_set
+ * @brief Whether filter is configured.
+ */
+static bool filter_set = false;
+
+/**
+ * @var output
+ * @brief UART output callback.
+ */
+static host_Sim_Output output = NULL;
+
+/**
+ * @var output_context
+ * @brief Passed to output.
+ */
+static void* output_context = NULL;
+
+/**
+ * @var uart_busy_until_ns
+ * @brief End of the UART transfer in progress.
+ */
+static uint64_t uart_busy_until_ns = 0;
+
+/**
+ * @var uart_dma
+ * @brief UART handle of the DMA transfer in progress (NULL if none).
+ */
+static UART_HandleTypeDef* uart_dma = NULL;
+
+/**
+ * @var uart_rx[HOST_SIM_UART_RX_SIZE]
+ * @brief Characters received by USART3 and not read yet.
+ */
+static uint8_t uart_rx[HOST_SIM_UART_RX_SIZE];
+
+/**
+ * @var uart_rx_get
+ * @brief Index of the next character to read in uart_rx.
+ */
+static uint32_t uart_rx_get = 0;
+
+/**
+ * @var uart_rx_count
+ * @brief Characters in uart_rx.
+ */
+static uint32_t uart_rx_count = 0;
+
+/**
+ * @var stats
+ * @brief Counters of the simulated peripherals.
+ */
+static host_Sim_Stats stats;
+
+/**
+ * @fn void host_sim_init(uint32_t bitrate, host_Sim_Output output_callback, void* context)
+ * @brief Reset the simulation to time 0.
+ */
+void host_sim_init(uint32_t bitrate, host_Sim_Output output_callback, void* context) {
+	now_ns = 0;
+	bus_bitrate = bitrate;
+	bus_head = bus_count = 0;
+	bus_last_ns = 0;
+	bus_source = NULL;
+	bus_source_context = NULL;
+	probe = NULL;
+	fdcan = NULL;
+	fdcan_start_ns = fdcan_sync_ns = 0;
+	stop_wake_ns = 0;
+	fifo_get = fifo_fill = 0;
+	fifo_lost = false;
+	active_its = 0;
+	filter_set = false;
+	output = output_callback;
+	output_context = context;
+	uart_busy_until_ns = 0;
+	uart_dma = NULL;
+	uart_rx_get = uart_rx_count = 0;
+	memset(&stats, 0, sizeof(stats));
+}
+
+/**
+ * @fn uint64_t host_sim_now_ns(void)
+ * @brief Current simulated time in nanoseconds.
+ */
+uint64_t host_sim_now_ns(void) {
+	return now_ns;
+}
+
+/**
+ * @fn uint64_t host_sim_frame_ns(uint32_t identifier, uint8_t data_length)
+ * @brief Bus time of a data frame including the interframe space (no stuff bits).
+ *
+ * @details
+ * 47 bits + payload for a standard frame (SOF, ID, RTR, IDE, r0, DLC, CRC,
+ * delimiters, ACK, EOF, IFS), 20 more for an extended one.
+ */
+uint64_t host_sim_frame_ns(uint32_t identifier, uint8_t data_length) {
+	uint32_t bits = ((identifier > 0x7FF) ? 67 : 47) + 8U * data_length;
+	return (uint64_t)bits * 1000000000ULL / bus_bitrate;
+}
+
+/**
+ * @fn bool host_sim_bus_queue(const FDCAN_RxHeaderTypeDef* header, const uint8_t* data, uint64_t arrival_ns)
+ * @brief Put a frame on the bus, received completely at arrival_ns.
+ */
+bool host_sim_bus_queue(const FDCAN_RxHeaderTypeDef* header, const uint8_t* data, uint64_t arrival_ns) {
+	if (bus_count == HOST_SIM_BUS_QUEUE) return false;
+	bus_Frame* frame = &bus[(bus_head + bus_count) % HOST_SIM_BUS_QUEUE];
+	frame->header = *header;
+	memcpy(frame->data, data, (header->DataLength > 8) ? 8 : header->DataLength);
+	frame->arrival_ns = arrival_ns;
+	bus_count++;
+	bus_last_ns = arrival_ns;
+	return true;
+}
+
+/**
+ * @fn void host_sim_set_bus_source(host_Sim_Bus_Source source, void* context)
+ * @brief Pull the bus frames from source once the queued ones have arrived.
+ */
+void host_sim_set_bus_source(host_Sim_Bus_Source source, void* context) {
+	bus_source = source;
+	bus_source_context = context;
+}
+
+/**
+ * @fn void host_sim_set_probe(host_Sim_Probe probe, uint64_t interval_ns, void* context)
+ * @brief Call probe every interval_ns of simulated time, from the next multiple on.
+ */
+void host_sim_set_probe(host_Sim_Probe probe_callback, uint64_t interval_ns, void* context) {
+	probe = (interval_ns != 0) ? probe_callback : NULL;
+	probe_interval_ns = interval_ns;
+	probe_next_ns = (interval_ns != 0) ? (now_ns + interval_ns - 1) / interval_ns * interval_ns : 0;
+	probe_context = context;
+}
+
+/**
+ * @fn void host_sim_set_stop_wake(uint64_t wake_ns)
+ * @brief Set the time from the wake-up edge to the first instruction after Stop.
+ */
+void host_sim_set_stop_wake(uint64_t wake_ns) {
+	stop_wake_ns = wake_ns;
+}
+
+/**
+ * @fn uint32_t host_sim_bus_pending(void)
+ * @brief Frames queued on the bus that have not arrived yet.
+ */
+uint32_t host_sim_bus_pending(void) {
+	return bus_count;
+}
+
+/**
+ * @fn uint64_t host_sim_bus_last_ns(void)
+ * @brief Arrival time of the last queued frame (0 if none was queued).
+ */
+uint64_t host_sim_bus_last_ns(void) {
+	return bus_last_ns;
+}
+
+/**
+ * @fn uint64_t host_sim_next_event_ns(void)
+ * @brief Time of the next frame arrival or end of a UART DMA transfer.
+ *
+ * @details
+ * Pulls the next frame from the bus source if no frame is queued.
+ */
+uint64_t host_sim_next_event_ns(void) {
+	if (bus_count == 0 && bus_source != NULL) {
+		FDCAN_RxHeaderTypeDef header;
+		uint8_t data[8];
+		uint64_t arrival_ns;
+		if (bus_source(&header, data, &arrival_ns, bus_source_context)) {
+			host_sim_bus_queue(&header, data, arrival_ns);
+		} else {
+			bus_source = NULL;
+		}
+	}
+
+	uint64_t next = UINT64_MAX;
+	if (bus_count) next = bus[bus_head].arrival_ns;
+	if (uart_dma && uart_busy_until_ns < next) next = uart_busy_until_ns;
+	return next;
+}
+
+/**
+ * @fn static uint64_t start_of_frame_ns(const bus_Frame* frame)
+ * @brief Time of the SOF bit of a frame.
+ */
+static uint64_t start_of_frame_ns(const bus_Frame* frame) {
+	uint64_t duration = host_sim_frame_ns(frame->header.Identifier, (uint8_t)frame->header.DataLength);
+	return (frame->arrival_ns > duration) ? frame->arrival_ns - duration : 0;
+}
+
+/**
+ * @fn static bool accepted(const FDCAN_RxHeaderTypeDef* header)
+ * @brief Whether the filters store a frame in the RX FIFO0.
+ */
+static bool accepted(const FDCAN_RxHeaderTypeDef* header) {
+	const bool extended = (header->IdType == FDCAN_EXTENDED_ID);
+	if (filter_set && filter.IdType == header->IdType && filter.FilterConfig == FDCAN_FILTER_TO_RXFIFO0 &&
+			(header->Identifier & filter.FilterID2) == (filter.FilterID1 & filter.FilterID2)) {
+		return true;
+	}
+	return global_filter[extended ? 1 : 0] == FDCAN_ACCEPT_IN_RX_FIFO0;
+}
+
+/**
+ * @fn static void receive(const bus_Frame* frame)
+ * @brief A frame arrives at FDCAN1.
+ */
+static void receive(const bus_Frame* frame) {
+	stats.bus_frames++;
+	if (fdcan == NULL) {
+		stats.wrong_bitrate_frames++;
+		return;
+	}
+	const FDCAN_InitTypeDef* init = &fdcan->Init;
+	uint32_t bit_quanta = init->NominalPrescaler * (1 + init->NominalTimeSeg1 + init->NominalTimeSeg2);
+	if (bit_quanta == 0 || HOST_SIM_FDCAN_CLOCK / bit_quanta != bus_bitrate) {
+		stats.wrong_bitrate_frames++;
+		return;
+	}
+	if (start_of_frame_ns(frame) < fdcan_start_ns) {
+		stats.unsynchronized_frames++;
+		return;
+	}
+	if (!accepted(&frame->header)) {
+		stats.filtered_frames++;
+		return;
+	}
+
+	uint32_t its = FDCAN_IT_RX_FIFO0_NEW_MESSAGE;
+	uint32_t size = (init->RxFifo0ElmtsNbr == 0 || init->RxFifo0ElmtsNbr > HOST_SIM_FIFO_SIZE) ? HOST_SIM_FIFO_SIZE : init->RxFifo0ElmtsNbr;
+	if (fifo_fill == size) {
+		stats.fifo_lost_frames++;
+		fifo_lost = true;
+		its = FDCAN_IT_RX_FIFO0_MESSAGE_LOST;
+	} else {
+		fifo[(fifo_get + fifo_fill) % HOST_SIM_FIFO_SIZE] = *frame;
+		fifo[(fifo_get + fifo_fill) % HOST_SIM_FIFO_SIZE].header.RxTimestamp = (uint32_t)(now_ns / 1000);
+		fifo_fill++;
+		stats.received_frames++;
+		if (fifo_fill > stats.fifo_max_fill) stats.fifo_max_fill = fifo_fill;
+		if (fifo_fill == size) its |= FDCAN_IT_RX_FIFO0_FULL;
+	}
+	if (its & active_its) HAL_FDCAN_RxFifo0Callback(fdcan, its & active_its);
+}
+
+/**
+ * @fn void host_sim_advance(uint64_t until_ns)
+ * @brief Run the simulated peripherals up to until_ns.
+ */
+void host_sim_advance(uint64_t until_ns) {
+	for (;;) {
+		uint64_t next = host_sim_next_event_ns();
+		while (probe != NULL && probe_next_ns <= until_ns && probe_next_ns <= next) {
+			if (probe_next_ns > now_ns) now_ns = probe_next_ns;
+			probe(probe_next_ns, probe_context);
+			probe_next_ns += probe_interval_ns;
+		}
+		if (next > until_ns) break;
+		if (next > now_ns) now_ns = next;
+		if (uart_dma && uart_busy_until_ns == next) {
+			UART_HandleTypeDef* huart = uart_dma;
+			uart_dma = NULL;
+			HAL_UART_TxCpltCallback(huart);
+			continue;
+		}
+		bus_Frame frame = bus[bus_head];
+		bus_head = (bus_head + 1) % HOST_SIM_BUS_QUEUE;
+		bus_count--;
+		receive(&frame);
+	}
+	if (until_ns > now_ns) now_ns = until_ns;
+}
+
+/**
+ * @fn bool host_sim_uart_idle(void)
+ * @brief Whether no UART transfer is in progress.
+ */
+bool host_sim_uart_idle(void) {
+	return uart_dma == NULL && uart_busy_until_ns <= now_ns;
+}
+
+/**
+ * @fn uint32_t host_sim_uart_receive(const char* text)
+ * @brief Queue characters received by USART3.
+ */
+uint32_t host_sim_uart_receive(const char* text) {
+	uint32_t count = 0;
+	while (text[count] != '\0' && uart_rx_count < HOST_SIM_UART_RX_SIZE) {
+		uart_rx[(uart_rx_get + uart_rx_count++) % HOST_SIM_UART_RX_SIZE] = (uint8_t)text[count++];
+	}
+	return count;
+}
+
+/**
+ * @fn host_Sim_Stats host_sim_get_stats(void)
+ * @brief Counters of the simulated peripherals.
+ */
+host_Sim_Stats host_sim_get_stats(void) {
+	return stats;
+}
+
+uint32_t HAL_GetTick(void) {
+	return (uint32_t)(now_ns / 1000000);
+}
+
+void HAL_Delay(uint32_t delay) {
+	host_sim_advance(now_ns + (uint64_t)delay * 1000000);
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Init(FDCAN_HandleTypeDef* hfdcan) {
+	(void)hfdcan;
+	fifo_get = fifo_fill = 0;
+	fifo_lost = false;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef* hfdcan, uint32_t non_matching_std, uint32_t non_matching_ext,
+											   uint32_t reject_remote_std, uint32_t reject_remote_ext) {
+	(void)hfdcan; (void)reject_remote_std; (void)reject_remote_ext;
+	global_filter[0] = non_matching_std;
+	global_filter[1] = non_matching_ext;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ConfigFilter(FDCAN_HandleTypeDef* hfdcan, const FDCAN_FilterTypeDef* filter_config) {
+	(void)hfdcan;
+	if (filter_config->FilterIndex != 0 || filter_config->FilterType != FDCAN_FILTER_MASK) return HAL_ERROR;
+	filter = *filter_config;
+	filter_set = true;
+	return HAL_OK;
+}
+
+/**
+ * @details
+ * A frame already in progress is not received: FDCAN1 is synchronized at
+ * its end (the recessive EOF and interframe space).
+ */
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef* hfdcan) {
+	fdcan = hfdcan;
+	fdcan_start_ns = fdcan_sync_ns = now_ns;
+	(void)host_sim_next_event_ns();
+	if (bus_count && start_of_frame_ns(&bus[bus_head]) < now_ns) {
+		fdcan_sync_ns = bus[bus_head].arrival_ns;
+	}
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_Stop(FDCAN_HandleTypeDef* hfdcan) {
+	(void)hfdcan;
+	fdcan = NULL;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef* hfdcan, uint32_t its, uint32_t buffer_indexes) {
+	(void)hfdcan; (void)buffer_indexes;
+	active_its |= its;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_DeactivateNotification(FDCAN_HandleTypeDef* hfdcan, uint32_t its) {
+	(void)hfdcan;
+	active_its &= ~its;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef* hfdcan, uint32_t rx_location, FDCAN_RxHeaderTypeDef* header, uint8_t* data) {
+	(void)hfdcan;
+	if (rx_location != FDCAN_RX_FIFO0 || fifo_fill == 0) return HAL_ERROR;
+	const bus_Frame* frame = &fifo[fifo_get];
+	*header = frame->header;
+	memcpy(data, frame->data, (frame->header.DataLength > 8) ? 8 : frame->header.DataLength);
+	fifo_get = (fifo_get + 1) % HOST_SIM_FIFO_SIZE;
+	fifo_fill--;
+	return HAL_OK;
+}
+
+uint32_t HAL_FDCAN_GetRxFifoFillLevel(FDCAN_HandleTypeDef* hfdcan, uint32_t rx_fifo) {
+	(void)hfdcan;
+	return (rx_fifo == FDCAN_RX_FIFO0) ? fifo_fill : 0;
+}
+
+void HAL_FDCAN_ClearFlag(FDCAN_HandleTypeDef* hfdcan, uint32_t flag) {
+	(void)hfdcan;
+	if (flag & FDCAN_FLAG_RX_FIFO0_MESSAGE_LOST) fifo_lost = false;
+}
+
+/**
+ * @details
+ * Each call takes one bit time, so a polling loop sees the time advance.
+ */
+HAL_StatusTypeDef HAL_FDCAN_GetProtocolStatus(FDCAN_HandleTypeDef* hfdcan, FDCAN_ProtocolStatusTypeDef* status) {
+	(void)hfdcan;
+	host_sim_advance(now_ns + 1000000000ULL / bus_bitrate);
+	status->LastErrorCode = FDCAN_PROTOCOL_ERROR_NO_CHANGE;
+	status->DataLastErrorCode = FDCAN_PROTOCOL_ERROR_NO_CHANGE;
+	status->Activity = (fdcan != NULL && now_ns >= fdcan_sync_ns) ? FDCAN_COM_STATE_IDLE : FDCAN_COM_STATE_SYNC;
+	return HAL_OK;
+}
+
+/**
+ * @details
+ * Returns at the next event or SysTick interrupt (every ms).
+ */
+void HAL_PWR_EnterSLEEPMode(uint32_t regulator, uint8_t sleep_entry) {
+	(void)regulator; (void)sleep_entry;
+	uint64_t next = host_sim_next_event_ns();
+	uint64_t tick = (now_ns / 1000000 + 1) * 1000000;
+	host_sim_advance((next < tick) ? next : tick);
+}
+
+/**
+ * @details
+ * Returns stop_wake_ns after the SOF of the next frame on the bus (the first
+ * falling edge), or at once if no frame will come. The UART must be idle.
+ */
+void HAL_PWREx_EnterSTOPMode(uint32_t regulator, uint8_t stop_entry, uint32_t domain) {
+	(void)regulator; (void)stop_entry; (void)domain;
+	stats.stops++;
+	(void)host_sim_next_event_ns();
+	if (bus_count == 0) return;
+	uint64_t wake = start_of_frame_ns(&bus[bus_head]) + stop_wake_ns;
+	if (wake > now_ns) host_sim_advance(wake);
+}
+
+/**
+ * @fn static uint64_t uart_start(const uint8_t* data, uint32_t size)
+ * @brief Wait for the UART to be free and pass a transfer to the output callback.
+ *
+ * @retval End time of the transfer.
+ */
+static uint64_t uart_start(const uint8_t* data, uint32_t size) {
+	while (!host_sim_uart_idle()) {
+		host_sim_advance(uart_busy_until_ns);
+	}
+	uint64_t duration = (uint64_t)size * 10 * 1000000000ULL / HOST_SIM_UART_BAUD;
+	if (output) output(data, size, now_ns, output_context);
+	stats.uart_bytes += size;
+	stats.uart_transfers++;
+	stats.uart_busy_ns += duration;
+	return uart_busy_until_ns = now_ns + duration;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, const uint8_t* data, uint16_t size, uint32_t timeout) {
+	(void)huart; (void)timeout;
+	host_sim_advance(uart_start(data, size));
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, const uint8_t* data, uint16_t size) {
+	uart_start(data, size);
+	uart_dma = huart;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortTransmit(UART_HandleTypeDef* huart) {
+	(void)huart;
+	uart_dma = NULL;
+	uart_busy_until_ns = now_ns;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef* huart, uint8_t* data, uint16_t size, uint32_t timeout) {
+	(void)huart;
+	if (uart_rx_count < size) return (timeout == 0) ? HAL_TIMEOUT : HAL_ERROR;
+	for (uint16_t i = 0; i < size; i++) {
+		data[i] = uart_rx[uart_rx_get];
+		uart_rx_get = (uart_rx_get + 1) % HOST_SIM_UART_RX_SIZE;
+		uart_rx_count--;
+	}
+	return HAL_OK;
+}
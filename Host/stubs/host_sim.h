@@ -0,0 +1,246 @@
+/**
+ * @file host_sim.h
+ * @brief Host simulation of FDCAN1, USART3 and time, to run the capture path off-target.
+ *
+ * @details
+ * Build the firmware modules with HOST_SIMULATION defined (see stm32h7xx.h)
+ * and link host_sim.c. The simulation runs on a virtual clock in
+ * nanoseconds that only advances through host_sim_advance(), blocking UART
+ * transmissions and HAL_Delay(), so results do not depend on the speed of
+ * the host.
+ *
+ * FDCAN1: frames put on the bus with host_sim_bus_queue(), or pulled from a
+ * source set with host_sim_set_bus_source() whenever no frame is queued, are received at
+ * their arrival time if the peripheral is started with the bus bit rate,
+ * pass the configured filters, and fit in the RX FIFO0 (Init.RxFifo0ElmtsNbr
+ * elements, blocking mode: a frame arriving to a full FIFO is lost). The RX
+ * FIFO0 callback runs at once (interrupt latency and cost are not modelled)
+ * with the notifications activated by the firmware.
+ *
+ * USART3: bytes leave at HOST_SIM_UART_BAUD (10 bits per byte), one transfer
+ * at a time. HAL_UART_Transmit() blocks the caller until its last byte is
+ * sent, while frames keep arriving. HAL_UART_Transmit_DMA() returns at once
+ * and calls HAL_UART_TxCpltCallback() when its last byte is sent. Every
+ * transfer is passed to the output callback with the time of its first byte.
+ * Characters given to host_sim_uart_receive() are read by HAL_UART_Receive().
+ *
+ * PWR: HAL_PWR_EnterSLEEPMode() returns at the next event or ms tick.
+ * HAL_PWREx_EnterSTOPMode() returns after the SOF of the next frame plus the
+ * wake-up time set with host_sim_set_stop_wake(). A frame in progress when
+ * FDCAN1 is started is not received.
+ */
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stdbool.h>
+#include "stm32h7xx.h"
+
+/**
+ * @def HOST_SIM_UART_BAUD
+ * @brief USART3 baud rate (8N1).
+ */
+#ifndef HOST_SIM_UART_BAUD
+#define HOST_SIM_UART_BAUD 921600
+#endif
+
+/**
+ * @def HOST_SIM_UART_RX_SIZE
+ * @brief Received characters USART3 can hold until the firmware reads them.
+ */
+#define HOST_SIM_UART_RX_SIZE 256
+
+/**
+ * @def HOST_SIM_FDCAN_CLOCK
+ * @brief FDCAN kernel clock in Hz (see can_timings[] in my_can.c).
+ */
+#define HOST_SIM_FDCAN_CLOCK 40000000UL
+
+/**
+ * @def HOST_SIM_BUS_QUEUE
+ * @brief Frames that can be queued on the bus ahead of the simulated time.
+ */
+#define HOST_SIM_BUS_QUEUE 65536
+
+/**
+ * @def HOST_SIM_FIFO_SIZE
+ * @brief Largest RX FIFO0 (elements of the FDCAN message RAM).
+ */
+#define HOST_SIM_FIFO_SIZE 64
+
+/**
+ * @typedef host_Sim_Output
+ * @brief Called for every UART transfer, start_ns = time its first byte starts.
+ */
+typedef void (*host_Sim_Output)(const uint8_t* data, uint32_t size, uint64_t start_ns, void* context);
+
+/**
+ * @typedef host_Sim_Bus_Source
+ * @brief Gives the next frame of the bus, false when there is none.
+ *
+ * @details
+ * arrival_ns must not be before the arrival of the previous frame. The
+ * source is called from within host_sim_advance(), including while the
+ * firmware blocks in HAL_UART_Transmit(), so the bus never runs dry while a
+ * caller that pushes frames with host_sim_bus_queue() could not run.
+ */
+typedef bool (*host_Sim_Bus_Source)(FDCAN_RxHeaderTypeDef* header, uint8_t* data, uint64_t* arrival_ns, void* context);
+
+/**
+ * @typedef host_Sim_Probe
+ * @brief Called at every multiple of the probe interval of simulated time.
+ *
+ * @details
+ * Runs between events, also while the firmware blocks in a HAL call: it
+ * may read firmware state but must not call into the firmware.
+ */
+typedef void (*host_Sim_Probe)(uint64_t now_ns, void* context);
+
+/**
+ * @struct host_Sim_Stats
+ * @brief Counters of the simulated peripherals.
+ *
+ * @details
+ * bus_frames counts the frames that arrived on the bus. Of these,
+ * wrong_bitrate_frames were not received because FDCAN1 was stopped or set
+ * to another bit rate, unsynchronized_frames had started before FDCAN1
+ * was started (e.g. on a wake from Stop), filtered_frames were rejected by
+ * the filters and fifo_lost_frames found the RX FIFO0 full. stops counts
+ * the entries in Stop mode.
+ */
+typedef struct {
+	uint64_t bus_frames;
+	uint64_t wrong_bitrate_frames;
+	uint64_t unsynchronized_frames;
+	uint64_t filtered_frames;
+	uint64_t fifo_lost_frames;
+	uint64_t received_frames;
+	uint32_t fifo_max_fill;
+	uint64_t uart_bytes;
+	uint64_t uart_transfers;
+	uint64_t uart_busy_ns;
+	uint64_t stops;
+} host_Sim_Stats;
+
+/**
+ * @fn void host_sim_init(uint32_t bus_bitrate, host_Sim_Output output, void* context)
+ * @brief Reset the simulation to time 0.
+ *
+ * @param bus_bitrate Bit rate of the simulated bus.
+ * @param output Called for every UART transfer (NULL to discard the output).
+ * @param context Passed to output.
+ * @retval None
+ */
+void host_sim_init(uint32_t bus_bitrate, host_Sim_Output output, void* context);
+
+/**
+ * @fn uint64_t host_sim_now_ns(void)
+ * @brief Current simulated time in nanoseconds.
+ */
+uint64_t host_sim_now_ns(void);
+
+/**
+ * @fn uint64_t host_sim_frame_ns(uint32_t identifier, uint8_t data_length)
+ * @brief Bus time of a data frame including the interframe space (no stuff bits).
+ *
+ * @param identifier Extended if above 0x7FF.
+ * @param data_length Payload bytes.
+ * @retval Duration in nanoseconds at the bus bit rate.
+ */
+uint64_t host_sim_frame_ns(uint32_t identifier, uint8_t data_length);
+
+/**
+ * @fn bool host_sim_bus_queue(const FDCAN_RxHeaderTypeDef* header, const uint8_t* data, uint64_t arrival_ns)
+ * @brief Put a frame on the bus, received completely at arrival_ns.
+ *
+ * @param header Identifier, IdType and DataLength (bytes) of the frame.
+ * @param data Payload.
+ * @param arrival_ns Not before the arrival of the previously queued frame.
+ * @retval false If HOST_SIM_BUS_QUEUE frames are already waiting.
+ */
+bool host_sim_bus_queue(const FDCAN_RxHeaderTypeDef* header, const uint8_t* data, uint64_t arrival_ns);
+
+/**
+ * @fn void host_sim_set_bus_source(host_Sim_Bus_Source source, void* context)
+ * @brief Pull the bus frames from source once the queued ones have arrived.
+ *
+ * @param source Frame source, NULL to stop pulling. Dropped once it returns false.
+ * @param context Passed to source.
+ * @retval None
+ */
+void host_sim_set_bus_source(host_Sim_Bus_Source source, void* context);
+
+/**
+ * @fn void host_sim_set_probe(host_Sim_Probe probe, uint64_t interval_ns, void* context)
+ * @brief Call probe every interval_ns of simulated time, from the next multiple on.
+ *
+ * @param probe Function to call, NULL to stop.
+ * @param interval_ns Time between two calls.
+ * @param context Passed to probe.
+ * @retval None
+ */
+void host_sim_set_probe(host_Sim_Probe probe, uint64_t interval_ns, void* context);
+
+/**
+ * @fn void host_sim_set_stop_wake(uint64_t wake_ns)
+ * @brief Set the time from the wake-up edge to the first instruction after Stop.
+ *
+ * @details
+ * HAL_PWREx_EnterSTOPMode() returns wake_ns after the SOF of the next frame
+ * (0 after host_sim_init()). Stands for the wake-up time of the chip and the
+ * PLL lock, which the firmware cannot measure; take it from the datasheet.
+ */
+void host_sim_set_stop_wake(uint64_t wake_ns);
+
+/**
+ * @fn uint32_t host_sim_bus_pending(void)
+ * @brief Frames queued on the bus that have not arrived yet.
+ */
+uint32_t host_sim_bus_pending(void);
+
+/**
+ * @fn uint64_t host_sim_bus_last_ns(void)
+ * @brief Arrival time of the last queued frame (0 if none was queued).
+ */
+uint64_t host_sim_bus_last_ns(void);
+
+/**
+ * @fn uint64_t host_sim_next_event_ns(void)
+ * @brief Time of the next frame arrival or end of a UART DMA transfer.
+ *
+ * @retval UINT64_MAX If nothing is pending.
+ */
+uint64_t host_sim_next_event_ns(void);
+
+/**
+ * @fn void host_sim_advance(uint64_t until_ns)
+ * @brief Run the simulated peripherals up to until_ns.
+ *
+ * @details
+ * Frames arriving and DMA transfers ending up to until_ns are processed in
+ * time order, calling the firmware interrupt callbacks, and the probe is
+ * called at its times.
+ */
+void host_sim_advance(uint64_t until_ns);
+
+/**
+ * @fn bool host_sim_uart_idle(void)
+ * @brief Whether no UART transfer is in progress.
+ */
+bool host_sim_uart_idle(void);
+
+/**
+ * @fn uint32_t host_sim_uart_receive(const char* text)
+ * @brief Queue characters received by USART3.
+ *
+ * @retval Number of characters queued (the rest did not fit).
+ */
+uint32_t host_sim_uart_receive(const char* text);
+
+/**
+ * @fn host_Sim_Stats host_sim_get_stats(void)
+ * @brief Counters of the simulated peripherals.
+ */
+host_Sim_Stats host_sim_get_stats(void);
+
+#endif /* HOST_SIM_H */
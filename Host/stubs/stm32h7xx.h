@@ -0,0 +1,321 @@
+/**
+ * @file stm32h7xx.h
+ * @brief Host replacement of the STM32H7 device/HAL header.
+ *
+ * @details
+ * Lets firmware modules that only need a small part of the HAL be compiled
+ * and exercised on a PC (benchmarks, simulation). Put Host/stubs first in the
+ * include path instead of the CubeMX generated Drivers/ folders.
+ *
+ * Provides:
+ *   - CMSIS interrupt masking (no-op, host code is single threaded) and __CLZ()
+ *   - With __ARM_FEATURE_SIMD32 defined by hand, C models of __USUB8() and
+ *     __SEL() (APSR.GE flags), to run the Cortex-M7 SIMD path of my_payload.c
+ *   - DWT/CoreDebug registers (the cycle counter does not advance)
+ *   - HAL status codes, HAL_GetTick() (monotonic host clock) and HAL_Delay()
+ *     (returns at once)
+ *   - FDCAN types and API (implemented by host_sim.c)
+ *   - USART: transmit to stdout, receive from stdin. DMA transfers complete
+ *     immediately (HAL_UART_TxCpltCallback is called before returning).
+ *   - DMA and NVIC configuration (accepted and ignored)
+ *   - PWR low-power modes, EXTI, SysTick suspension and PLL2 (return at once)
+ *
+ * With HOST_SIMULATION defined, HAL_GetTick(), HAL_Delay(), the USART
+ * functions and the PWR low-power modes are implemented by host_sim.c
+ * instead, on its simulated clock (see host_sim.h).
+ */
+
+#ifndef HOST_STM32H7XX_H
+#define HOST_STM32H7XX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+#define __ALIGNED(x) __attribute__((aligned(x)))
+
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t primask) { (void)primask; }
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+static inline void __DMB(void) { __sync_synchronize(); }
+static inline uint8_t __CLZ(uint32_t value) { return value ? (uint8_t)__builtin_clz(value) : 32; }
+static inline void __SEV(void) {}
+static inline void __WFE(void) {}
+
+#if defined(__ARM_FEATURE_SIMD32)
+static uint32_t host_apsr_ge __attribute__((unused)); /* GE[3:0] as 0xFF byte lanes */
+static inline uint32_t __USUB8(uint32_t a, uint32_t b) {
+	uint32_t result = 0;
+	host_apsr_ge = 0;
+	for (uint32_t shift = 0; shift < 32; shift += 8) {
+		uint32_t x = (a >> shift) & 0xFF, y = (b >> shift) & 0xFF;
+		if (x >= y) host_apsr_ge |= 0xFFU << shift;
+		result |= ((x - y) & 0xFF) << shift;
+	}
+	return result;
+}
+static inline uint32_t __SEL(uint32_t a, uint32_t b) { return (a & host_apsr_ge) | (b & ~host_apsr_ge); }
+#endif
+
+typedef struct {
+	volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+} DWT_Type;
+
+static inline CoreDebug_Type* host_core_debug(void) { static CoreDebug_Type core_debug; return &core_debug; }
+static inline DWT_Type* host_dwt(void) { static DWT_Type dwt; return &dwt; }
+
+#define CoreDebug (host_core_debug())
+#define DWT (host_dwt())
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+
+typedef enum {
+	HAL_OK = 0x00,
+	HAL_ERROR = 0x01,
+	HAL_BUSY = 0x02,
+	HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+
+#ifdef HOST_SIMULATION
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t delay);
+#else
+static inline uint32_t HAL_GetTick(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+static inline void HAL_Delay(uint32_t delay) { (void)delay; }
+#endif
+
+#define FDCAN1 ((void*)1)
+#define FDCAN_STANDARD_ID 0x00000000U
+#define FDCAN_EXTENDED_ID 0x40000000U
+#define FDCAN_DATA_FRAME 0x00000000U
+#define FDCAN_FILTER_MASK 0x00000002U
+#define FDCAN_FILTER_TO_RXFIFO0 0x00000001U
+#define FDCAN_ACCEPT_IN_RX_FIFO0 0x00000000U
+#define FDCAN_REJECT 0x00000002U
+#define FDCAN_REJECT_REMOTE 0x00000001U
+#define FDCAN_RX_FIFO0 0x00000040U
+#define FDCAN_IT_RX_FIFO0_NEW_MESSAGE (1UL << 0)
+#define FDCAN_IT_RX_FIFO0_FULL (1UL << 1)
+#define FDCAN_IT_RX_FIFO0_MESSAGE_LOST (1UL << 3)
+#define FDCAN_FLAG_RX_FIFO0_MESSAGE_LOST FDCAN_IT_RX_FIFO0_MESSAGE_LOST
+#define FDCAN_COM_STATE_SYNC 0x00000000U
+#define FDCAN_COM_STATE_IDLE 0x00000008U
+#define FDCAN_FRAME_CLASSIC 0x00000000U
+#define FDCAN_FRAME_FD_NO_BRS 0x00000100U
+#define FDCAN_FRAME_FD_BRS 0x00000300U
+#define FDCAN_DATA_BYTES_8 0x00000004U
+#define FDCAN_DATA_BYTES_64 0x00000007U
+#define FDCAN_CLASSIC_CAN 0x00000000U
+#define FDCAN_FD_CAN 0x00200000U
+#define FDCAN_BRS_OFF 0x00000000U
+#define FDCAN_BRS_ON 0x00100000U
+#define FDCAN_PROTOCOL_ERROR_NONE 0x00000000U
+#define FDCAN_PROTOCOL_ERROR_NO_CHANGE 0x00000007U
+
+typedef struct {
+	uint32_t FrameFormat;
+	uint32_t NominalPrescaler;
+	uint32_t NominalTimeSeg1;
+	uint32_t NominalTimeSeg2;
+	uint32_t DataPrescaler;
+	uint32_t DataSyncJumpWidth;
+	uint32_t DataTimeSeg1;
+	uint32_t DataTimeSeg2;
+	uint32_t RxFifo0ElmtsNbr;
+	uint32_t RxFifo0ElmtSize;
+} FDCAN_InitTypeDef;
+
+typedef struct {
+	void* Instance;
+	FDCAN_InitTypeDef Init;
+} FDCAN_HandleTypeDef;
+
+typedef struct {
+	uint32_t Identifier;
+	uint32_t IdType;
+	uint32_t RxFrameType;
+	uint32_t DataLength;
+	uint32_t BitRateSwitch;
+	uint32_t FDFormat;
+	uint32_t RxTimestamp;
+} FDCAN_RxHeaderTypeDef;
+
+typedef struct {
+	uint32_t IdType;
+	uint32_t FilterIndex;
+	uint32_t FilterType;
+	uint32_t FilterConfig;
+	uint32_t FilterID1;
+	uint32_t FilterID2;
+} FDCAN_FilterTypeDef;
+
+typedef struct {
+	uint32_t LastErrorCode;
+	uint32_t DataLastErrorCode;
+	uint32_t Activity;
+} FDCAN_ProtocolStatusTypeDef;
+
+HAL_StatusTypeDef HAL_FDCAN_Init(FDCAN_HandleTypeDef* hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_ConfigGlobalFilter(FDCAN_HandleTypeDef* hfdcan, uint32_t non_matching_std, uint32_t non_matching_ext,
+											   uint32_t reject_remote_std, uint32_t reject_remote_ext);
+HAL_StatusTypeDef HAL_FDCAN_ConfigFilter(FDCAN_HandleTypeDef* hfdcan, const FDCAN_FilterTypeDef* filter);
+HAL_StatusTypeDef HAL_FDCAN_Start(FDCAN_HandleTypeDef* hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_Stop(FDCAN_HandleTypeDef* hfdcan);
+HAL_StatusTypeDef HAL_FDCAN_ActivateNotification(FDCAN_HandleTypeDef* hfdcan, uint32_t active_its, uint32_t buffer_indexes);
+HAL_StatusTypeDef HAL_FDCAN_DeactivateNotification(FDCAN_HandleTypeDef* hfdcan, uint32_t inactive_its);
+HAL_StatusTypeDef HAL_FDCAN_GetRxMessage(FDCAN_HandleTypeDef* hfdcan, uint32_t rx_location, FDCAN_RxHeaderTypeDef* header, uint8_t* data);
+uint32_t HAL_FDCAN_GetRxFifoFillLevel(FDCAN_HandleTypeDef* hfdcan, uint32_t rx_fifo);
+void HAL_FDCAN_ClearFlag(FDCAN_HandleTypeDef* hfdcan, uint32_t flag);
+HAL_StatusTypeDef HAL_FDCAN_GetProtocolStatus(FDCAN_HandleTypeDef* hfdcan, FDCAN_ProtocolStatusTypeDef* status);
+void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef* hfdcan, uint32_t RxFifo0ITs);
+
+#define __HAL_FDCAN_CLEAR_FLAG(handle, flag) HAL_FDCAN_ClearFlag((handle), (flag))
+
+typedef enum {
+	DMA1_Stream0_IRQn = 11,
+	USART3_IRQn = 39
+} IRQn_Type;
+
+static inline void HAL_NVIC_SetPriority(IRQn_Type irqn, uint32_t preempt, uint32_t sub) { (void)irqn; (void)preempt; (void)sub; }
+static inline void HAL_NVIC_EnableIRQ(IRQn_Type irqn) { (void)irqn; }
+static inline void HAL_NVIC_DisableIRQ(IRQn_Type irqn) { (void)irqn; }
+
+#define PWR_MAINREGULATOR_ON 0x00000000U
+#define PWR_LOWPOWERREGULATOR_ON 0x00000001U
+#define PWR_SLEEPENTRY_WFI 0x01U
+#define PWR_STOPENTRY_WFE 0x02U
+#define PWR_D1_DOMAIN 0x00000000U
+
+#ifdef HOST_SIMULATION
+void HAL_PWR_EnterSLEEPMode(uint32_t regulator, uint8_t sleep_entry);
+void HAL_PWREx_EnterSTOPMode(uint32_t regulator, uint8_t stop_entry, uint32_t domain);
+#else
+static inline void HAL_PWR_EnterSLEEPMode(uint32_t regulator, uint8_t sleep_entry) { (void)regulator; (void)sleep_entry; }
+static inline void HAL_PWREx_EnterSTOPMode(uint32_t regulator, uint8_t stop_entry, uint32_t domain) { (void)regulator; (void)stop_entry; (void)domain; }
+#endif
+
+static inline void HAL_SuspendTick(void) {}
+static inline void HAL_ResumeTick(void) {}
+
+#define RESET 0U
+#define RCC_FLAG_PLL2RDY 0x3BU
+#define __HAL_RCC_PLL2_ENABLE() do {} while (0)
+#define __HAL_RCC_GET_FLAG(flag) (1U)
+
+#define EXTI_LINE_0 0x16000000U
+#define EXTI_MODE_EVENT 0x02U
+#define EXTI_TRIGGER_FALLING 0x02U
+#define EXTI_GPIOD 0x03U
+
+typedef struct {
+	uint32_t Line;
+} EXTI_HandleTypeDef;
+
+typedef struct {
+	uint32_t Line;
+	uint32_t Mode;
+	uint32_t Trigger;
+	uint32_t GPIOSel;
+} EXTI_ConfigTypeDef;
+
+static inline HAL_StatusTypeDef HAL_EXTI_SetConfigLine(EXTI_HandleTypeDef* hexti, EXTI_ConfigTypeDef* config) {
+	hexti->Line = config->Line;
+	return HAL_OK;
+}
+static inline HAL_StatusTypeDef HAL_EXTI_ClearConfigLine(EXTI_HandleTypeDef* hexti) { (void)hexti; return HAL_OK; }
+
+#define DMA1_Stream0 ((void*)0)
+#define DMA_REQUEST_USART3_TX 46U
+#define DMA_MEMORY_TO_PERIPH 0x40U
+#define DMA_PINC_DISABLE 0U
+#define DMA_MINC_ENABLE 0x400U
+#define DMA_PDATAALIGN_BYTE 0U
+#define DMA_MDATAALIGN_BYTE 0U
+#define DMA_NORMAL 0U
+#define DMA_PRIORITY_LOW 0U
+#define DMA_FIFOMODE_DISABLE 0U
+#define __HAL_RCC_DMA1_CLK_ENABLE() do {} while (0)
+#define __HAL_LINKDMA(handle, field, dma) do { (handle)->field = &(dma); (dma).Parent = (handle); } while (0)
+
+typedef struct {
+	uint32_t Request;
+	uint32_t Direction;
+	uint32_t PeriphInc;
+	uint32_t MemInc;
+	uint32_t PeriphDataAlignment;
+	uint32_t MemDataAlignment;
+	uint32_t Mode;
+	uint32_t Priority;
+	uint32_t FIFOMode;
+} DMA_InitTypeDef;
+
+typedef struct {
+	void* Instance;
+	DMA_InitTypeDef Init;
+	void* Parent;
+} DMA_HandleTypeDef;
+
+static inline HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef* hdma) { (void)hdma; return HAL_OK; }
+static inline void HAL_DMA_IRQHandler(DMA_HandleTypeDef* hdma) { (void)hdma; }
+
+typedef enum {
+	HAL_UART_STATE_RESET = 0x00,
+	HAL_UART_STATE_READY = 0x20,
+	HAL_UART_STATE_BUSY_TX = 0x21
+} HAL_UART_StateTypeDef;
+
+typedef struct {
+	void* Instance;
+	DMA_HandleTypeDef* hdmatx;
+	volatile HAL_UART_StateTypeDef gState;
+} UART_HandleTypeDef;
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart);
+
+static inline void HAL_UART_IRQHandler(UART_HandleTypeDef* huart) { (void)huart; }
+
+#ifdef HOST_SIMULATION
+HAL_StatusTypeDef HAL_UART_AbortTransmit(UART_HandleTypeDef* huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, const uint8_t* data, uint16_t size, uint32_t timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, const uint8_t* data, uint16_t size);
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef* huart, uint8_t* data, uint16_t size, uint32_t timeout);
+#else
+static inline HAL_StatusTypeDef HAL_UART_AbortTransmit(UART_HandleTypeDef* huart) { (void)huart; return HAL_OK; }
+
+static inline HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, const uint8_t* data, uint16_t size, uint32_t timeout) {
+	(void)huart; (void)timeout;
+	return (fwrite(data, 1, size, stdout) == size) ? HAL_OK : HAL_ERROR;
+}
+
+static inline HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, const uint8_t* data, uint16_t size) {
+	if (fwrite(data, 1, size, stdout) != size) return HAL_ERROR;
+	HAL_UART_TxCpltCallback(huart);
+	return HAL_OK;
+}
+
+static inline HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef* huart, uint8_t* data, uint16_t size, uint32_t timeout) {
+	(void)huart;
+	if (timeout == 0) return HAL_TIMEOUT;
+	for (uint16_t i = 0; i < size; i++) {
+		int ch = getchar();
+		if (ch == EOF) return HAL_ERROR;
+		data[i] = (uint8_t)ch;
+	}
+	return HAL_OK;
+}
+#endif /* HOST_SIMULATION */
+
+#endif /* HOST_STM32H7XX_H */
@@ -0,0 +1,422 @@
+"""Query and subscription API of the capture daemon.
+
+The daemon (can_daemon.py, socket path set with --api-socket) keeps live
+tables of the bus: the last frame, frame count and rate of every ID, the last
+value of every signal of a dashboard config (--signals) and the loss counters. Tools ask for a snapshot
+of them instead of decoding the whole stream, or subscribe to the frames of
+some IDs or to the samples of some signals; the filtering is done by the
+daemon, so a client only receives what it asked for.
+
+The API socket (DAEMON_API_SOCKET) carries one JSON object per line. Every
+request gets exactly one reply line, {"ok": true, ...} or
+{"ok": false, "error": "..."}:
+
+    {"op": "stats"}                      totals, frame rate and loss counters
+    {"op": "ids"}                        count, rate (frames/s), last timestamp
+                                         and payload of every ID
+    {"op": "frame", "id": 416}           the same for one ID
+    {"op": "signals"}                    last time and value of every signal
+    {"op": "signal", "name": "speed"}    the same for one signal
+    {"op": "subscribe", "ids": "100-1FF,7DF", "signals": ["speed"]}
+    {"op": "unsubscribe"}
+
+"ids" of a subscription is a filter as in can_monitor.py ("100-1FF,7DF" or
+"700/F00", hexadecimal). After the reply, the frames of the matching IDs
+arrive as binary wire records (my_can_wire.h) and the samples of the
+subscribed signals as lines {"signal": "speed", "t": 12.5, "value": 88.0},
+mixed with the replies of later requests: ApiDecoder splits such a stream
+into frames and lines. Records and lines are never cut by each other, and a
+line has no length limit (the reply of "ids" grows with the bus). As on the frame socket, a
+subscriber that cannot keep up loses data (counted in "dropped": the
+frames and samples it subscribed to).
+
+    python can_api.py stats
+    python can_api.py ids
+    python can_api.py frame 0x1A0
+    python can_api.py signal speed
+    python can_api.py watch --ids 100-1FF --signals speed,rpm
+"""
+
+import argparse
+import json
+import os
+import selectors
+import socket
+import sys
+import time
+
+from can_signals import SignalDecoder
+from can_stream import DAEMON_SOCKET, WIRE_HEADER, WIRE_MAX_SIZE, WIRE_SYNC, Frame, parse_filter
+
+DAEMON_API_SOCKET = os.environ.get("CAN_SNIFFER_API_SOCKET", DAEMON_SOCKET + ".api")
+RATE_PERIOD = 1.0          # seconds between two rate updates
+SEQUENCE_WRAP = 1 << 16    # wire record sequence numbers are 16-bit
+REQUEST_LIMIT = 1 << 16    # bytes of a request line at most
+
+
+class IdState:
+    __slots__ = ("count", "timestamp", "data", "rate", "_rate_count")
+
+    def __init__(self):
+        self.count = 0
+        self.timestamp = 0
+        self.data = b""
+        self.rate = 0.0
+        self._rate_count = 0
+
+    def snapshot(self, identifier):
+        return {"id": identifier, "count": self.count, "rate": round(self.rate, 1),
+                "timestamp": self.timestamp, "data": self.data.hex()}
+
+
+class LiveTables:
+    """In-memory state of the bus, updated with every batch of the daemon."""
+
+    def __init__(self, signals=()):
+        self.ids = {}      # identifier -> IdState
+        self.signals = {signal.name: None for signal in signals}  # name -> (time, value)
+        self.decoder = SignalDecoder(signals) if signals else None
+        self.frames = 0
+        self.rate = 0.0
+        self.sequence_gaps = 0  # frames lost before the daemon (sniffer buffers, UART)
+        self._next_sequence = None
+        self._rate_frames = 0
+        self._rate_time = time.monotonic()
+
+    def update(self, frames):
+        """Account a batch of frames. Returns its signal samples [(signal, time, value)]."""
+        ids = self.ids
+        for frame in frames:
+            state = ids.get(frame.identifier)
+            if state is None:
+                state = ids[frame.identifier] = IdState()
+            state.count += 1
+            state.timestamp = frame.timestamp
+            state.data = frame.data
+            if frame.sequence is not None:
+                if self._next_sequence is not None:
+                    gap = (frame.sequence - self._next_sequence) % SEQUENCE_WRAP
+                    if gap < SEQUENCE_WRAP // 2:  # else a restart of the sniffer or of a file
+                        self.sequence_gaps += gap
+                self._next_sequence = (frame.sequence + 1) % SEQUENCE_WRAP
+        self.frames += len(frames)
+        if self.decoder is None:
+            return []
+        samples = list(self.decoder.decode(frames))
+        for signal, t, value in samples:
+            self.signals[signal.name] = (t, value)
+        return samples
+
+    def tick(self, now):
+        """Update the rates every RATE_PERIOD."""
+        elapsed = now - self._rate_time
+        if elapsed < RATE_PERIOD:
+            return
+        for state in self.ids.values():
+            state.rate = (state.count - state._rate_count) / elapsed
+            state._rate_count = state.count
+        self.rate = (self.frames - self._rate_frames) / elapsed
+        self._rate_frames = self.frames
+        self._rate_time = now
+
+
+class Session:
+    __slots__ = ("request", "pending", "match", "matched", "signals", "dropped")
+
+    def __init__(self):
+        self.request = bytearray()
+        self.pending = bytearray()
+        self.match = None     # ID filter of the frame subscription
+        self.matched = {}     # identifier -> bool, memo of match
+        self.signals = set()  # subscribed signal names
+        self.dropped = 0
+
+
+class ApiServer:
+    """Request/response and subscription server, on the selector of the daemon."""
+
+    def __init__(self, daemon, socket_path, tables, backlog):
+        self.daemon = daemon
+        self.tables = tables
+        self.backlog = backlog
+        self.sessions = {}  # socket -> Session
+        self.dropped = 0
+
+        if os.path.exists(socket_path):
+            os.unlink(socket_path)
+        self.server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.server.bind(socket_path)
+        self.server.listen()
+        self.server.setblocking(False)
+        daemon.selector.register(self.server, selectors.EVENT_READ, self.accept)
+
+    def accept(self, server, mask):
+        client, _ = server.accept()
+        client.setblocking(False)
+        self.sessions[client] = Session()
+        self.daemon.selector.register(client, selectors.EVENT_READ, self.client_event)
+
+    def close_client(self, client):
+        self.daemon.selector.unregister(client)
+        del self.sessions[client]
+        client.close()
+
+    def client_event(self, client, mask):
+        session = self.sessions[client]
+        if mask & selectors.EVENT_READ:
+            try:
+                data = client.recv(65536)
+            except OSError:
+                data = b""
+            if not data:
+                self.close_client(client)
+                return
+            session.request += data
+            while True:
+                newline = session.request.find(b"\n")
+                if newline < 0:
+                    break
+                line = bytes(session.request[:newline])
+                del session.request[:newline + 1]
+                session.pending += self.reply(session, line)
+            if len(session.request) > REQUEST_LIMIT:
+                self.close_client(client)
+                return
+            if session.pending:
+                self.flush(client)
+        elif mask & selectors.EVENT_WRITE:
+            self.flush(client)
+
+    def flush(self, client):
+        pending = self.sessions[client].pending
+        try:
+            sent = client.send(pending)
+        except BlockingIOError:
+            sent = 0
+        except OSError:
+            self.close_client(client)
+            return
+        del pending[:sent]
+        events = selectors.EVENT_READ | (selectors.EVENT_WRITE if pending else 0)
+        self.daemon.selector.modify(client, events, self.client_event)
+
+    def reply(self, session, line):
+        try:
+            request = json.loads(line)
+            response = self.handle(session, request)
+        except (ValueError, KeyError, TypeError) as error:
+            response = {"ok": False, "error": "%s: %s" % (type(error).__name__, error)}
+        return json.dumps(response, separators=(",", ":")).encode() + b"\n"
+
+    def handle(self, session, request):
+        op = request["op"]
+        tables = self.tables
+        if op == "stats":
+            return {"ok": True, "frames": tables.frames, "rate": round(tables.rate, 1), "ids": len(tables.ids),
+                    "sequence_gaps": tables.sequence_gaps, "bad_records": self.daemon.bad_records(),
+                    "dropped": self.daemon.dropped + self.dropped, "clients": len(self.daemon.clients),
+                    "sessions": len(self.sessions)}
+        if op == "ids":
+            return {"ok": True, "ids": [state.snapshot(identifier) for identifier, state in sorted(tables.ids.items())]}
+        if op == "frame":
+            identifier = int(request["id"], 16) if isinstance(request["id"], str) else request["id"]
+            state = tables.ids.get(identifier)
+            if state is None:
+                return {"ok": False, "error": "no frame of ID 0x%X" % identifier}
+            return {"ok": True, **state.snapshot(identifier)}
+        if op == "signals":
+            return {"ok": True, "signals": {name: last and {"t": last[0], "value": last[1]}
+                                            for name, last in tables.signals.items()}}
+        if op == "signal":
+            if request["name"] not in tables.signals:
+                return {"ok": False, "error": "unknown signal %s" % request["name"]}
+            last = tables.signals[request["name"]]
+            return {"ok": True, "name": request["name"], "t": last and last[0], "value": last and last[1]}
+        if op == "subscribe":
+            names = set(request.get("signals", ()))
+            unknown = names - tables.signals.keys()
+            if unknown:
+                return {"ok": False, "error": "unknown signals: %s" % ", ".join(sorted(unknown))}
+            if "ids" in request:
+                session.match = parse_filter(request["ids"])
+                session.matched = {}
+            session.signals |= names
+            return {"ok": True}
+        if op == "unsubscribe":
+            session.match = None
+            session.signals = set()
+            return {"ok": True, "dropped": session.dropped}
+        return {"ok": False, "error": "unknown op %s" % op}
+
+    def publish(self, frames, records, samples):
+        """Forward a batch to the subscribers. records are the wire records of frames."""
+        for client, session in list(self.sessions.items()):
+            if session.match is None and not session.signals:
+                continue
+            backlogged = len(session.pending) > self.backlog
+            was_empty = not session.pending
+            lost = 0
+            if session.match is not None:
+                matched, match = session.matched, session.match
+                for frame, record in zip(frames, records):
+                    hit = matched.get(frame.identifier)
+                    if hit is None:
+                        hit = matched[frame.identifier] = match(frame.identifier)
+                    if not hit:
+                        continue
+                    if backlogged:
+                        lost += 1
+                    else:
+                        session.pending += record
+            if session.signals:
+                for signal, t, value in samples:
+                    if signal.name not in session.signals:
+                        continue
+                    if backlogged:
+                        lost += 1
+                    else:
+                        session.pending += b'{"signal":%s,"t":%r,"value":%r}\n' % (json.dumps(signal.name).encode(), t, value)
+            session.dropped += lost
+            self.dropped += lost
+            if was_empty and session.pending:
+                self.flush(client)
+
+
+class ApiDecoder:
+    """Splits the API stream into wire records and JSON lines.
+
+    can_stream.StreamDecoder is made for the serial stream: it resynchronizes
+    on damaged data and drops text without a line end after 4 KiB. The API
+    stream is not damaged and replies can be much longer, so a line is only
+    complete at its line end. JSON lines are ASCII, so a record starts at
+    WIRE_SYNC and a line anywhere else.
+    """
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self._scanned = 0  # bytes of the buffer known to hold no line end
+
+    def feed(self, data):
+        """Add received bytes. Returns (frames, lines) completed by them."""
+        self.buffer += data
+        frames, lines = [], []
+        buf = self.buffer
+        pos = 0
+        end = len(buf)
+        while pos < end:
+            if buf[pos] == WIRE_SYNC:
+                if end - pos < 2:
+                    break
+                size = buf[pos + 1]
+                if not WIRE_HEADER.size + 1 <= size <= WIRE_MAX_SIZE:
+                    raise ValueError("bad wire record size %d on the API socket" % size)
+                if end - pos < size:
+                    break
+                _, _, sequence, timestamp, identifier, _ = WIRE_HEADER.unpack_from(buf, pos)
+                frames.append(Frame(timestamp, identifier, bytes(buf[pos + WIRE_HEADER.size:pos + size - 1]), sequence))
+                pos += size
+                continue
+            newline = buf.find(b"\n", max(pos, self._scanned))
+            if newline < 0:
+                self._scanned = end
+                break
+            line = bytes(buf[pos:newline]).strip()
+            pos = newline + 1
+            if line:
+                lines.append(line.decode())
+        del buf[:pos]
+        self._scanned = max(0, self._scanned - pos)
+        return frames, lines
+
+
+def connect_api(path=DAEMON_API_SOCKET):
+    """Connect to the API socket of the capture daemon."""
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(path)
+    return sock
+
+
+class ApiClient:
+    """Blocking client: request() returns the reply, subscribed data is kept in frames and lines."""
+
+    def __init__(self, path=DAEMON_API_SOCKET):
+        self.sock = connect_api(path)
+        self.decoder = ApiDecoder()
+        self.frames = []
+        self.lines = []
+
+    def receive(self):
+        """Read once. Returns False when the daemon has closed the socket."""
+        data = self.sock.recv(65536)
+        if not data:
+            return False
+        frames, lines = self.decoder.feed(data)
+        self.frames += frames
+        self.lines += lines
+        return True
+
+    def request(self, op, **arguments):
+        self.sock.sendall(json.dumps(dict(arguments, op=op)).encode() + b"\n")
+        while True:
+            for i, line in enumerate(self.lines):
+                if line.startswith('{"ok"'):
+                    del self.lines[i]
+                    return json.loads(line)
+            if not self.receive():
+                raise ConnectionError("daemon closed the API socket")
+
+
+def watch(client, args):
+    arguments = {}
+    if args.ids:
+        arguments["ids"] = args.ids
+    if args.signals:
+        arguments["signals"] = args.signals.split(",")
+    reply = client.request("subscribe", **arguments)
+    if not reply["ok"]:
+        print(reply["error"], file=sys.stderr)
+        return 1
+    try:
+        while client.receive():
+            for frame in client.frames:
+                print("%10d  %03X  %s" % (frame.timestamp, frame.identifier, frame.data.hex(" ")))
+            for line in client.lines:
+                sample = json.loads(line)
+                print("%10.6f  %s = %g" % (sample["t"], sample["signal"], sample["value"]))
+            client.frames, client.lines = [], []
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--socket", default=DAEMON_API_SOCKET, help="daemon API socket (default %(default)s)")
+    commands = parser.add_subparsers(dest="command", required=True)
+    commands.add_parser("stats", help="totals and loss counters")
+    commands.add_parser("ids", help="count, rate and last payload of every ID")
+    frame = commands.add_parser("frame", help="last frame of an ID")
+    frame.add_argument("id", help="CAN ID (hexadecimal)")
+    commands.add_parser("signals", help="last value of every signal")
+    signal = commands.add_parser("signal", help="last value of a signal")
+    signal.add_argument("name")
+    watcher = commands.add_parser("watch", help="print the frames of some IDs and the samples of some signals")
+    watcher.add_argument("--ids", help='ID filter, e.g. "100-1FF,7DF" or "700/F00"')
+    watcher.add_argument("--signals", help="comma-separated signal names")
+    args = parser.parse_args()
+
+    client = ApiClient(args.socket)
+    if args.command == "watch":
+        return watch(client, args)
+    arguments = {"frame": {"id": args.id} if args.command == "frame" else None,
+                 "signal": {"name": args.name} if args.command == "signal" else None}.get(args.command) or {}
+    start = time.perf_counter()
+    reply = client.request(args.command, **arguments)
+    elapsed = time.perf_counter() - start
+    print(json.dumps(reply, indent=1))
+    print("round trip %.0f us" % (elapsed * 1e6), file=sys.stderr)
+    return 0 if reply["ok"] else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
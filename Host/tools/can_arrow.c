@@ -0,0 +1,920 @@
+/**
+ * @file can_arrow.c
+ * @brief Host tool: export captures as an Apache Arrow IPC file.
+ *
+ * @details
+ * Writes one row per frame in the Arrow IPC file format (Feather v2,
+ * uncompressed), which pandas, Polars, DuckDB or R open without parsing and
+ * can memory-map: column buffers are 64-byte aligned in the file.
+ *
+ *     | Column    | Arrow type                         | Content                          |
+ *     |-----------|------------------------------------|----------------------------------|
+ *     | timestamp | duration[us]                       | Time since the first frame       |
+ *     | channel   | uint8                              | Bus (candump interface or file)  |
+ *     | id        | dictionary<values=uint32, int16>   | CAN ID                           |
+ *     | flags     | uint8                              | FLAG_EXTENDED                    |
+ *     | dlc       | uint8                              | Payload bytes                    |
+ *     | payload   | fixed_size_binary[8]               | Payload, zero padded             |
+ *
+ * The channel is the interface of a multi-bus candump log (see
+ * can_capture.h), or with --split-channels the index of the capture file.
+ *
+ * The IDs are dictionary encoded: the dictionary (sorted IDs) is written
+ * once before the record batches, each row stores a 16-bit index, and
+ * pandas reads the column as a categorical. The file is only seekable
+ * after the footer, which lists the dictionary and the batches.
+ *
+ * The captures (any format read by can_capture.c) are read twice: a first
+ * pass collects the IDs for the dictionary, the second one cuts the frames
+ * into batches of --batch rows. Batches are handed to worker threads that
+ * build the column buffers and the batch metadata, and a writer thread
+ * appends them to the file in capture order, so reading, encoding and
+ * writing overlap. The Arrow metadata (flatbuffers) is built by hand, with
+ * no library dependency.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -IHost/stubs -IMy_Modules/Drivers/can -IMy_Modules/Drivers/debug
+ *       -IMy_Modules/Drivers/stdio -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp
+ *       -IMy_Modules/Features/logger Host/tools/can_arrow.c Host/tools/can_capture.c
+ *       My_Modules/Drivers/can/my_can_wire.c My_Modules/Features/logger/can_logger.c
+ *       My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/stdio/my_stdio.c
+ *       My_Modules/Drivers/uart/my_uart.c -lpthread -o can_arrow
+ *   ./can_arrow -o capture.arrow CAN00003.LOG CAN00004.LOG
+ *   ./can_arrow --split-channels -o buses.arrow body.pcap powertrain.pcap
+ *
+ * Reading it back:
+ *
+ *   pyarrow.ipc.open_file(pyarrow.memory_map("capture.arrow")).read_all()
+ *   pandas.read_feather("capture.arrow")
+ *   polars.read_ipc("capture.arrow", memory_map=True)
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "can_capture.h"
+
+/**
+ * @def MAX_IDS
+ * @brief Number of distinct CAN IDs a capture may contain (16-bit dictionary indices).
+ */
+#define MAX_IDS 32768
+
+/**
+ * @def MAX_CHANNELS
+ * @brief Number of capture files with --split-channels.
+ */
+#define MAX_CHANNELS 256
+
+/**
+ * @def BATCH_ROWS
+ * @brief Default number of rows per record batch.
+ */
+#define BATCH_ROWS 65536
+
+/**
+ * @def BATCH_SLOTS_PER_THREAD
+ * @brief Batches in flight per worker thread.
+ */
+#define BATCH_SLOTS_PER_THREAD 2
+
+/**
+ * @def ARROW_ALIGNMENT
+ * @brief Alignment of the column buffers in the file.
+ */
+#define ARROW_ALIGNMENT 64
+
+/**
+ * @def ARROW_COLUMNS
+ * @brief Number of columns of the schema.
+ */
+#define ARROW_COLUMNS 6
+
+/**
+ * @def FLAG_EXTENDED
+ * @brief flags bit set for identifiers above 11 bits.
+ */
+#define FLAG_EXTENDED 0x01
+
+/**
+ * @def ARROW_METADATA_V5
+ * @brief MetadataVersion of the written messages.
+ */
+#define ARROW_METADATA_V5 4
+
+/**
+ * @enum arrow_Message_Header
+ * @brief Arrow MessageHeader union types.
+ */
+typedef enum {
+	ARROW_HEADER_SCHEMA = 1,
+	ARROW_HEADER_DICTIONARY_BATCH = 2,
+	ARROW_HEADER_RECORD_BATCH = 3
+} arrow_Message_Header;
+
+/**
+ * @enum arrow_Type
+ * @brief Arrow Type union types.
+ */
+typedef enum {
+	ARROW_TYPE_INT = 2,
+	ARROW_TYPE_FIXED_SIZE_BINARY = 15,
+	ARROW_TYPE_DURATION = 18
+} arrow_Type;
+
+/**
+ * @struct fb_Builder
+ * @brief Flatbuffer under construction.
+ *
+ * @details
+ * Built front to back: a table is written before the tables, vectors and
+ * strings it refers to, and each reference is patched once its target is
+ * placed (flatbuffer offsets always point forward; a vtable is placed just
+ * before its table). Positions are byte offsets from the start of data.
+ */
+typedef struct {
+	uint8_t* data;
+	uint32_t size;
+	uint32_t capacity;
+} fb_Builder;
+
+/**
+ * @struct capture_Row
+ * @brief Frame as gathered by the reader for a batch.
+ */
+typedef struct {
+	uint64_t time_us;
+	uint32_t identifier;
+	uint8_t channel;
+	uint8_t data_length;
+	uint8_t data[8];
+} capture_Row;
+
+/**
+ * @enum batch_State
+ * @brief Stage of a batch slot in the pipeline.
+ */
+typedef enum {
+	BATCH_FREE,
+	BATCH_FILLED,
+	BATCH_ENCODED
+} batch_State;
+
+/**
+ * @struct batch_Slot
+ * @brief One record batch on its way from the reader to the file.
+ */
+typedef struct {
+	batch_State state;
+	uint32_t rows;
+	capture_Row* input;
+	uint8_t* body;
+	uint64_t body_length;
+	fb_Builder metadata;
+} batch_Slot;
+
+/**
+ * @struct arrow_Block
+ * @brief Position of a message in the file, for the footer.
+ */
+typedef struct {
+	int64_t offset;
+	int32_t metadata_length;
+	int64_t body_length;
+} arrow_Block;
+
+/**
+ * @var id_values
+ * @brief Distinct CAN IDs (sorted after the first pass): the dictionary.
+ */
+static uint32_t id_values[MAX_IDS];
+
+/**
+ * @var id_count
+ * @brief Number of used entries of id_values.
+ */
+static uint32_t id_count = 0;
+
+/**
+ * @var id_table
+ * @brief Open addressing hash table: CAN ID -> dictionary index + 1 (0 = free).
+ */
+static uint32_t id_table[2 * MAX_IDS];
+
+/**
+ * @var too_many_ids
+ * @brief Set when a capture has more than MAX_IDS distinct IDs.
+ */
+static bool too_many_ids = false;
+
+/**
+ * @var slots
+ * @brief Batch slots, used in turn (batch n in slots[n % slot_count]).
+ */
+static batch_Slot* slots = NULL;
+
+/**
+ * @var slot_count
+ * @brief Number of batch slots.
+ */
+static uint32_t slot_count = 0;
+
+/**
+ * @var batch_rows
+ * @brief Rows per record batch.
+ */
+static uint32_t batch_rows = BATCH_ROWS;
+
+/**
+ * @var filled_batches
+ * @brief Batches handed over by the reader.
+ */
+static uint64_t filled_batches = 0;
+
+/**
+ * @var next_encode
+ * @brief Next batch to be taken by a worker thread.
+ */
+static uint64_t next_encode = 0;
+
+/**
+ * @var exported_frames
+ * @brief Frames read in the second pass.
+ */
+static uint64_t exported_frames = 0;
+
+/**
+ * @var file_channel
+ * @brief Channel of the file being read with --split-channels, -1 otherwise.
+ */
+static int file_channel = -1;
+
+/**
+ * @var reading_done
+ * @brief Set by the reader after the last batch.
+ */
+static bool reading_done = false;
+
+/**
+ * @var pipeline_lock
+ * @brief Protects the slot states and the batch counters.
+ */
+static pthread_mutex_t pipeline_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @var pipeline_changed
+ * @brief Signalled on every slot state change.
+ */
+static pthread_cond_t pipeline_changed = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @var output
+ * @brief Arrow file being written.
+ */
+static FILE* output = NULL;
+
+/**
+ * @var output_offset
+ * @brief Bytes written to output.
+ */
+static int64_t output_offset = 0;
+
+/**
+ * @var batch_blocks
+ * @brief Record batch positions, in file order.
+ */
+static arrow_Block* batch_blocks = NULL;
+
+/**
+ * @var batch_block_count
+ * @brief Number of used entries of batch_blocks.
+ */
+static uint64_t batch_block_count = 0;
+
+/**
+ * @var write_failed
+ * @brief Set when writing to output fails.
+ */
+static bool write_failed = false;
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+
+/**
+ * @fn static double now_s(void)
+ * @brief Monotonic time in seconds.
+ */
+static double now_s(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @fn static void* checked_calloc(size_t count, size_t size)
+ * @brief calloc() that exits when out of memory.
+ */
+static void* checked_calloc(size_t count, size_t size) {
+	void* memory = calloc(count, size);
+	if (memory == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	return memory;
+}
+
+/**
+ * @fn static uint64_t aligned(uint64_t size)
+ * @brief size rounded up to ARROW_ALIGNMENT.
+ */
+static uint64_t aligned(uint64_t size) {
+	return (size + ARROW_ALIGNMENT - 1) & ~(uint64_t)(ARROW_ALIGNMENT - 1);
+}
+
+/**
+ * @fn static void fb_pad(fb_Builder* b, uint32_t align, uint32_t extra)
+ * @brief Append zero bytes until size + extra is a multiple of align.
+ */
+static void fb_pad(fb_Builder* b, uint32_t align, uint32_t extra) {
+	uint32_t padding = (align - (b->size + extra) % align) % align;
+	if (b->size + padding + extra > b->capacity || b->data == NULL) {
+		b->capacity = 2 * (b->size + padding + extra) + 256;
+		b->data = realloc(b->data, b->capacity);
+		if (b->data == NULL) exit(1);
+	}
+	memset(&b->data[b->size], 0, padding);
+	b->size += padding;
+}
+
+/**
+ * @fn static uint32_t fb_reserve(fb_Builder* b, uint32_t size, uint32_t align)
+ * @brief Append size zero bytes aligned on align, return their position.
+ */
+static uint32_t fb_reserve(fb_Builder* b, uint32_t size, uint32_t align) {
+	fb_pad(b, align, 0);
+	fb_pad(b, 1, size);
+	uint32_t position = b->size;
+	memset(&b->data[position], 0, size);
+	b->size += size;
+	return position;
+}
+
+/**
+ * @fn static void fb_put(fb_Builder* b, uint32_t at, uint64_t value, uint32_t size)
+ * @brief Store a little-endian scalar of size bytes.
+ */
+static void fb_put(fb_Builder* b, uint32_t at, uint64_t value, uint32_t size) {
+	for (uint32_t i = 0; i < size; i++) {
+		b->data[at + i] = (uint8_t)(value >> (8 * i));
+	}
+}
+
+/**
+ * @fn static void fb_link(fb_Builder* b, uint32_t at, uint32_t target)
+ * @brief Make the offset field at position at refer to target.
+ */
+static void fb_link(fb_Builder* b, uint32_t at, uint32_t target) {
+	fb_put(b, at, target - at, 4);
+}
+
+/**
+ * @fn static uint32_t fb_table(fb_Builder* b, uint32_t count, const uint8_t* sizes, uint32_t* fields)
+ * @brief Append a table with its vtable.
+ *
+ * @param b Builder.
+ * @param count Number of fields of the table type.
+ * @param sizes Byte size of each field (4 for references), 0 if absent.
+ * @param fields Position of each field (output), to be filled by the caller.
+ * @retval Position of the table.
+ */
+static uint32_t fb_table(fb_Builder* b, uint32_t count, const uint8_t* sizes, uint32_t* fields) {
+	uint32_t vtable = fb_reserve(b, 4 + 2 * count, 2);
+	uint32_t table = fb_reserve(b, 4, 8);
+	for (uint32_t i = 0; i < count; i++) {
+		if (sizes[i] == 0) continue;
+		fields[i] = fb_reserve(b, sizes[i], sizes[i]);
+		fb_put(b, vtable + 4 + 2 * i, fields[i] - table, 2);
+	}
+	fb_put(b, vtable, 4 + 2 * count, 2);
+	fb_put(b, vtable + 2, b->size - table, 2);
+	fb_put(b, table, table - vtable, 4);
+	return table;
+}
+
+/**
+ * @fn static uint32_t fb_vector(fb_Builder* b, uint32_t at, uint32_t count, uint32_t element_size, uint32_t align)
+ * @brief Append a zeroed vector referred to by the field at position at.
+ * @retval Position of the first element.
+ */
+static uint32_t fb_vector(fb_Builder* b, uint32_t at, uint32_t count, uint32_t element_size, uint32_t align) {
+	fb_pad(b, align > 4 ? align : 4, 4);
+	uint32_t vector = fb_reserve(b, 4 + count * element_size, 1);
+	fb_put(b, vector, count, 4);
+	fb_link(b, at, vector);
+	return vector + 4;
+}
+
+/**
+ * @fn static void fb_string(fb_Builder* b, uint32_t at, const char* text)
+ * @brief Append a string referred to by the field at position at.
+ */
+static void fb_string(fb_Builder* b, uint32_t at, const char* text) {
+	uint32_t length = (uint32_t)strlen(text);
+	uint32_t characters = fb_vector(b, at, length + 1, 1, 4);
+	memcpy(&b->data[characters], text, length);
+	fb_put(b, characters - 4, length, 4);
+}
+
+/**
+ * @fn static void fb_int_type(fb_Builder* b, uint32_t at, uint32_t bit_width, bool is_signed)
+ * @brief Append an Arrow Int type table.
+ */
+static void fb_int_type(fb_Builder* b, uint32_t at, uint32_t bit_width, bool is_signed) {
+	static const uint8_t sizes[] = {4, 1};
+	uint32_t fields[2];
+	uint32_t table = fb_table(b, 2, sizes, fields);
+	fb_put(b, fields[0], bit_width, 4);
+	fb_put(b, fields[1], is_signed, 1);
+	fb_link(b, at, table);
+}
+
+/**
+ * @fn static void fb_field(fb_Builder* b, uint32_t at, uint32_t column)
+ * @brief Append the Arrow Field table of a column.
+ */
+static void fb_field(fb_Builder* b, uint32_t at, uint32_t column) {
+	static const char* const names[ARROW_COLUMNS] = {"timestamp", "channel", "id", "flags", "dlc", "payload"};
+	/* name, nullable, type_type, type, dictionary, children */
+	const uint8_t sizes[] = {4, 1, 1, 4, (column == 2) ? 4 : 0, 4};
+	uint32_t fields[6];
+	uint32_t table = fb_table(b, 6, sizes, fields);
+	fb_link(b, at, table);
+	fb_string(b, fields[0], names[column]);
+	fb_vector(b, fields[5], 0, 4, 4);
+
+	if (column == 0) {
+		static const uint8_t duration_sizes[] = {2};
+		uint32_t unit;
+		fb_put(b, fields[2], ARROW_TYPE_DURATION, 1);
+		fb_link(b, fields[3], fb_table(b, 1, duration_sizes, &unit));
+		fb_put(b, unit, 2, 2); /* MICROSECOND */
+	} else if (column == 5) {
+		static const uint8_t binary_sizes[] = {4};
+		uint32_t byte_width;
+		fb_put(b, fields[2], ARROW_TYPE_FIXED_SIZE_BINARY, 1);
+		fb_link(b, fields[3], fb_table(b, 1, binary_sizes, &byte_width));
+		fb_put(b, byte_width, 8, 4);
+	} else {
+		fb_put(b, fields[2], ARROW_TYPE_INT, 1);
+		fb_int_type(b, fields[3], (column == 2) ? 32 : 8, false);
+	}
+	if (column == 2) {
+		/* id, indexType, isOrdered, dictionaryKind */
+		static const uint8_t dictionary_sizes[] = {8, 4};
+		uint32_t dictionary_fields[2];
+		fb_link(b, fields[4], fb_table(b, 2, dictionary_sizes, dictionary_fields));
+		fb_int_type(b, dictionary_fields[1], 16, true);
+	}
+}
+
+/**
+ * @fn static void fb_schema(fb_Builder* b, uint32_t at)
+ * @brief Append the Arrow Schema table.
+ */
+static void fb_schema(fb_Builder* b, uint32_t at) {
+	/* endianness (Little = default), fields */
+	static const uint8_t sizes[] = {0, 4};
+	uint32_t fields[2];
+	uint32_t table = fb_table(b, 2, sizes, fields);
+	fb_link(b, at, table);
+	uint32_t columns = fb_vector(b, fields[1], ARROW_COLUMNS, 4, 4);
+	for (uint32_t column = 0; column < ARROW_COLUMNS; column++) {
+		fb_field(b, columns + 4 * column, column);
+	}
+}
+
+/**
+ * @fn static void fb_record_batch(fb_Builder* b, uint32_t at, uint64_t rows, uint32_t columns, const uint64_t* buffer_lengths)
+ * @brief Append an Arrow RecordBatch table.
+ *
+ * @details
+ * Every column has no nulls and two buffers (an empty validity bitmap, then
+ * the values), laid out one after the other at ARROW_ALIGNMENT.
+ */
+static void fb_record_batch(fb_Builder* b, uint32_t at, uint64_t rows, uint32_t columns, const uint64_t* buffer_lengths) {
+	/* length, nodes, buffers */
+	static const uint8_t sizes[] = {8, 4, 4};
+	uint32_t fields[3];
+	uint32_t table = fb_table(b, 3, sizes, fields);
+	fb_link(b, at, table);
+	fb_put(b, fields[0], rows, 8);
+
+	uint32_t nodes = fb_vector(b, fields[1], columns, 16, 8);
+	for (uint32_t column = 0; column < columns; column++) {
+		fb_put(b, nodes + 16 * column, rows, 8);
+	}
+	uint32_t buffers = fb_vector(b, fields[2], 2 * columns, 16, 8);
+	uint64_t offset = 0;
+	for (uint32_t column = 0; column < columns; column++) {
+		fb_put(b, buffers + 32 * column, offset, 8);
+		fb_put(b, buffers + 32 * column + 16, offset, 8);
+		fb_put(b, buffers + 32 * column + 24, buffer_lengths[column], 8);
+		offset += aligned(buffer_lengths[column]);
+	}
+}
+
+/**
+ * @fn static uint32_t fb_message(fb_Builder* b, arrow_Message_Header header_type, uint64_t body_length)
+ * @brief Start an Arrow Message flatbuffer.
+ * @retval Position of the header reference, to be filled by the caller.
+ */
+static uint32_t fb_message(fb_Builder* b, arrow_Message_Header header_type, uint64_t body_length) {
+	/* version, header_type, header, bodyLength */
+	static const uint8_t sizes[] = {2, 1, 4, 8};
+	uint32_t fields[4];
+	b->size = 0;
+	uint32_t root = fb_reserve(b, 4, 4);
+	fb_link(b, root, fb_table(b, 4, sizes, fields));
+	fb_put(b, fields[0], ARROW_METADATA_V5, 2);
+	fb_put(b, fields[1], header_type, 1);
+	fb_put(b, fields[3], body_length, 8);
+	return fields[2];
+}
+
+/**
+ * @fn static void write_bytes(const void* data, uint64_t length)
+ * @brief Append to the output file.
+ */
+static void write_bytes(const void* data, uint64_t length) {
+	if (length > 0 && fwrite(data, 1, length, output) != length) write_failed = true;
+	output_offset += length;
+}
+
+/**
+ * @fn static arrow_Block write_message(const fb_Builder* metadata, const uint8_t* body, uint64_t body_length)
+ * @brief Append an encapsulated message (continuation marker, metadata size, metadata, body).
+ *
+ * @details
+ * The metadata is padded so that the body starts at ARROW_ALIGNMENT in the
+ * file.
+ */
+static arrow_Block write_message(const fb_Builder* metadata, const uint8_t* body, uint64_t body_length) {
+	static const uint8_t zeros[ARROW_ALIGNMENT] = {0};
+	arrow_Block block = {output_offset, 0, (int64_t)body_length};
+	uint32_t padding = (uint32_t)(aligned(output_offset + 8 + metadata->size) - (output_offset + 8 + metadata->size));
+	uint32_t prefix[2] = {0xFFFFFFFFUL, metadata->size + padding};
+	write_bytes(prefix, sizeof(prefix));
+	write_bytes(metadata->data, metadata->size);
+	write_bytes(zeros, padding);
+	write_bytes(body, body_length);
+	block.metadata_length = (int32_t)(8 + metadata->size + padding);
+	return block;
+}
+
+/**
+ * @fn static void write_blocks(fb_Builder* b, uint32_t at, const arrow_Block* blocks, uint64_t count)
+ * @brief Append a vector of Arrow Block structs.
+ */
+static void write_blocks(fb_Builder* b, uint32_t at, const arrow_Block* blocks, uint64_t count) {
+	uint32_t elements = fb_vector(b, at, (uint32_t)count, 24, 8);
+	for (uint64_t i = 0; i < count; i++) {
+		fb_put(b, elements + 24 * i, blocks[i].offset, 8);
+		fb_put(b, elements + 24 * i + 8, blocks[i].metadata_length, 4);
+		fb_put(b, elements + 24 * i + 16, blocks[i].body_length, 8);
+	}
+}
+
+/**
+ * @fn static uint32_t find_id(uint32_t identifier)
+ * @brief Hash table slot of a CAN ID (its entry, or the free slot to use).
+ */
+static uint32_t find_id(uint32_t identifier) {
+	uint32_t slot = (identifier * 2654435761UL) % (2 * MAX_IDS);
+	while (id_table[slot] != 0 && id_values[id_table[slot] - 1] != identifier) {
+		slot = (slot + 1) % (2 * MAX_IDS);
+	}
+	return slot;
+}
+
+/**
+ * @fn static void collect_id(const my_CAN_Frame* frame, uint64_t time_us, void* context)
+ * @brief First pass: record the distinct IDs (can_Capture_Callback).
+ */
+static void collect_id(const my_CAN_Frame* frame, uint64_t time_us, void* context) {
+	(void)time_us;
+	(void)context;
+	uint32_t slot = find_id(frame->Identifier);
+	if (id_table[slot] != 0) return;
+	if (id_count == MAX_IDS) {
+		too_many_ids = true;
+		return;
+	}
+	id_values[id_count++] = frame->Identifier;
+	id_table[slot] = id_count;
+}
+
+/**
+ * @fn static int compare_ids(const void* a, const void* b)
+ * @brief Ascending CAN ID order.
+ */
+static int compare_ids(const void* a, const void* b) {
+	uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @fn static void encode_batch(batch_Slot* slot)
+ * @brief Build the column buffers and the message metadata of a batch.
+ */
+static void encode_batch(batch_Slot* slot) {
+	const uint32_t n = slot->rows;
+	const uint64_t lengths[ARROW_COLUMNS] = {8ULL * n, n, 2ULL * n, n, n, 8ULL * n};
+	uint64_t offsets[ARROW_COLUMNS];
+	slot->body_length = 0;
+	for (uint32_t column = 0; column < ARROW_COLUMNS; column++) {
+		offsets[column] = slot->body_length;
+		slot->body_length += aligned(lengths[column]);
+	}
+	memset(slot->body, 0, slot->body_length);
+
+	int64_t* time_us = (int64_t*)&slot->body[offsets[0]];
+	uint8_t* channel = &slot->body[offsets[1]];
+	int16_t* id_index = (int16_t*)&slot->body[offsets[2]];
+	uint8_t* flags = &slot->body[offsets[3]];
+	uint8_t* dlc = &slot->body[offsets[4]];
+	uint8_t* payload = &slot->body[offsets[5]];
+	for (uint32_t i = 0; i < n; i++) {
+		const capture_Row* row = &slot->input[i];
+		time_us[i] = (int64_t)row->time_us;
+		channel[i] = row->channel;
+		id_index[i] = (int16_t)(id_table[find_id(row->identifier)] - 1);
+		flags[i] = (row->identifier > 0x7FF) ? FLAG_EXTENDED : 0;
+		dlc[i] = row->data_length;
+		memcpy(&payload[8 * i], row->data, 8);
+	}
+
+	uint32_t header = fb_message(&slot->metadata, ARROW_HEADER_RECORD_BATCH, slot->body_length);
+	fb_record_batch(&slot->metadata, header, n, ARROW_COLUMNS, lengths);
+}
+
+/**
+ * @fn static void* encode_worker(void* argument)
+ * @brief Worker thread: encodes filled batches until the reader is done.
+ */
+static void* encode_worker(void* argument) {
+	(void)argument;
+	pthread_mutex_lock(&pipeline_lock);
+	for (;;) {
+		while (next_encode == filled_batches && !reading_done) {
+			pthread_cond_wait(&pipeline_changed, &pipeline_lock);
+		}
+		if (next_encode == filled_batches) break;
+		batch_Slot* slot = &slots[next_encode++ % slot_count];
+		pthread_mutex_unlock(&pipeline_lock);
+
+		encode_batch(slot);
+
+		pthread_mutex_lock(&pipeline_lock);
+		slot->state = BATCH_ENCODED;
+		pthread_cond_broadcast(&pipeline_changed);
+	}
+	pthread_mutex_unlock(&pipeline_lock);
+	return NULL;
+}
+
+/**
+ * @fn static void* write_worker(void* argument)
+ * @brief Writer thread: appends the encoded batches to the file in order.
+ */
+static void* write_worker(void* argument) {
+	(void)argument;
+	uint64_t next_write = 0;
+	uint64_t block_capacity = 0;
+	pthread_mutex_lock(&pipeline_lock);
+	for (;;) {
+		batch_Slot* slot = &slots[next_write % slot_count];
+		while (!(next_write < filled_batches && slot->state == BATCH_ENCODED) &&
+			   !(reading_done && next_write == filled_batches)) {
+			pthread_cond_wait(&pipeline_changed, &pipeline_lock);
+		}
+		if (next_write == filled_batches) break;
+		pthread_mutex_unlock(&pipeline_lock);
+
+		if (batch_block_count == block_capacity) {
+			block_capacity = block_capacity ? 2 * block_capacity : 1024;
+			batch_blocks = realloc(batch_blocks, block_capacity * sizeof(arrow_Block));
+			if (batch_blocks == NULL) exit(1);
+		}
+		batch_blocks[batch_block_count++] = write_message(&slot->metadata, slot->body, slot->body_length);
+
+		pthread_mutex_lock(&pipeline_lock);
+		slot->state = BATCH_FREE;
+		slot->rows = 0;
+		next_write++;
+		pthread_cond_broadcast(&pipeline_changed);
+	}
+	pthread_mutex_unlock(&pipeline_lock);
+	return NULL;
+}
+
+/**
+ * @fn static void submit_batch(batch_Slot* slot)
+ * @brief Hand a filled batch to the workers and wait for the next slot to be free.
+ */
+static void submit_batch(batch_Slot* slot) {
+	pthread_mutex_lock(&pipeline_lock);
+	slot->state = BATCH_FILLED;
+	filled_batches++;
+	pthread_cond_broadcast(&pipeline_changed);
+	while (slots[filled_batches % slot_count].state != BATCH_FREE) {
+		pthread_cond_wait(&pipeline_changed, &pipeline_lock);
+	}
+	pthread_mutex_unlock(&pipeline_lock);
+}
+
+/**
+ * @fn static void add_row(const my_CAN_Frame* frame, uint64_t time_us, void* context)
+ * @brief Second pass: append a frame to the current batch (can_Capture_Callback).
+ *
+ * @details
+ * context is the can_Capture being read.
+ */
+static void add_row(const my_CAN_Frame* frame, uint64_t time_us, void* context) {
+	batch_Slot* slot = &slots[filled_batches % slot_count];
+	capture_Row* row = &slot->input[slot->rows++];
+	uint8_t length = (frame->DataLength > 8) ? 8 : frame->DataLength;
+	row->time_us = time_us;
+	row->identifier = frame->Identifier;
+	row->channel = (file_channel >= 0) ? (uint8_t)file_channel : ((const can_Capture*)context)->channel;
+	row->data_length = length;
+	memset(row->data, 0, sizeof(row->data));
+	memcpy(row->data, frame->Data, length);
+	exported_frames++;
+	if (slot->rows == batch_rows) submit_batch(slot);
+}
+
+/**
+ * @fn static void usage(void)
+ * @brief Print the command line help.
+ */
+static void usage(void) {
+	printf("Usage: can_arrow [options] -o output.arrow capture [capture ...]\n"
+		   "  --split-channels  each capture is a bus (channel = its index, own time line);\n"
+		   "                    by default the captures continue one time line and the\n"
+		   "                    channel is the candump interface\n"
+		   "  --batch ROWS      rows per record batch (default %d)\n"
+		   "  --threads N       encoding threads (default: all CPUs)\n", BATCH_ROWS);
+}
+
+int main(int argc, char** argv) {
+	static const struct option options[] = {
+		{"split-channels", no_argument, NULL, 's'}, {"batch", required_argument, NULL, 'b'},
+		{"threads", required_argument, NULL, 'j'}, {"help", no_argument, NULL, 'h'}, {NULL, 0, NULL, 0}
+	};
+	const char* path = NULL;
+	bool split_channels = false;
+	long rows = BATCH_ROWS;
+	int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int option;
+
+	while ((option = getopt_long(argc, argv, "o:", options, NULL)) != -1) {
+		switch (option) {
+			case 'o': path = optarg; break;
+			case 's': split_channels = true; break;
+			case 'b': rows = atol(optarg); break;
+			case 'j': threads = atoi(optarg); break;
+			default: usage(); return 1;
+		}
+	}
+	const int files = argc - optind;
+	if (path == NULL || files < 1 || rows < 1 || rows > (1L << 24) || threads < 1 ||
+		(split_channels && files > MAX_CHANNELS)) {
+		usage();
+		return 1;
+	}
+	batch_rows = (uint32_t)rows;
+
+	/* First pass: dictionary */
+	double start = now_s();
+	can_Capture capture;
+	can_capture_init(&capture, collect_id, NULL);
+	for (int i = optind; i < argc; i++) {
+		if (split_channels) can_capture_init(&capture, collect_id, NULL);
+		if (!can_capture_read(&capture, argv[i])) {
+			fprintf(stderr, "Cannot read the capture %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (too_many_ids) {
+		fprintf(stderr, "More than %d distinct IDs\n", MAX_IDS);
+		return 1;
+	}
+	qsort(id_values, id_count, sizeof(uint32_t), compare_ids);
+	memset(id_table, 0, sizeof(id_table));
+	for (uint32_t i = 0; i < id_count; i++) {
+		id_table[find_id(id_values[i])] = i + 1;
+	}
+	double dictionary_s = now_s() - start;
+
+	output = fopen(path, "wb");
+	if (output == NULL) {
+		fprintf(stderr, "Cannot write %s\n", path);
+		return 1;
+	}
+	static char output_buffer[1 << 20];
+	setvbuf(output, output_buffer, _IOFBF, sizeof(output_buffer));
+
+	/* Magic, schema, dictionary */
+	fb_Builder metadata = {0};
+	write_bytes("ARROW1\0\0", 8);
+	fb_schema(&metadata, fb_message(&metadata, ARROW_HEADER_SCHEMA, 0));
+	write_message(&metadata, NULL, 0);
+
+	const uint64_t dictionary_length = 4ULL * id_count;
+	uint8_t* dictionary_body = checked_calloc(1, aligned(dictionary_length) + 1);
+	memcpy(dictionary_body, id_values, dictionary_length);
+	uint32_t header = fb_message(&metadata, ARROW_HEADER_DICTIONARY_BATCH, aligned(dictionary_length));
+	/* id (0), data */
+	static const uint8_t dictionary_sizes[] = {8, 4};
+	uint32_t dictionary_fields[2];
+	fb_link(&metadata, header, fb_table(&metadata, 2, dictionary_sizes, dictionary_fields));
+	fb_record_batch(&metadata, dictionary_fields[1], id_count, 1, &dictionary_length);
+	arrow_Block dictionary_block = write_message(&metadata, dictionary_body, aligned(dictionary_length));
+	free(dictionary_body);
+
+	/* Second pass: record batches */
+	slot_count = BATCH_SLOTS_PER_THREAD * (uint32_t)threads + 1;
+	slots = checked_calloc(slot_count, sizeof(batch_Slot));
+	for (uint32_t i = 0; i < slot_count; i++) {
+		slots[i].input = checked_calloc(batch_rows, sizeof(capture_Row));
+		slots[i].body = checked_calloc(1, 21ULL * batch_rows + ARROW_COLUMNS * ARROW_ALIGNMENT);
+	}
+	pthread_t* encoders = checked_calloc(threads, sizeof(pthread_t));
+	pthread_t writer;
+	for (int i = 0; i < threads; i++) {
+		pthread_create(&encoders[i], NULL, encode_worker, NULL);
+	}
+	pthread_create(&writer, NULL, write_worker, NULL);
+
+	start = now_s();
+	can_capture_init(&capture, add_row, &capture);
+	for (int i = optind; i < argc; i++) {
+		if (split_channels) {
+			file_channel = i - optind;
+			can_capture_init(&capture, add_row, &capture);
+		}
+		can_capture_read(&capture, argv[i]);
+	}
+	batch_Slot* last = &slots[filled_batches % slot_count];
+	if (last->rows > 0) submit_batch(last);
+	pthread_mutex_lock(&pipeline_lock);
+	reading_done = true;
+	pthread_cond_broadcast(&pipeline_changed);
+	pthread_mutex_unlock(&pipeline_lock);
+	for (int i = 0; i < threads; i++) {
+		pthread_join(encoders[i], NULL);
+	}
+	pthread_join(writer, NULL);
+	free(encoders);
+
+	/* End of stream, footer */
+	for (uint32_t i = 0; i < slot_count; i++) {
+		free(slots[i].input);
+		free(slots[i].body);
+		free(slots[i].metadata.data);
+	}
+	const uint32_t end_of_stream[2] = {0xFFFFFFFFUL, 0};
+	write_bytes(end_of_stream, sizeof(end_of_stream));
+	/* version, schema, dictionaries, recordBatches */
+	static const uint8_t footer_sizes[] = {2, 4, 4, 4};
+	uint32_t footer_fields[4];
+	metadata.size = 0;
+	uint32_t root = fb_reserve(&metadata, 4, 4);
+	fb_link(&metadata, root, fb_table(&metadata, 4, footer_sizes, footer_fields));
+	fb_put(&metadata, footer_fields[0], ARROW_METADATA_V5, 2);
+	fb_schema(&metadata, footer_fields[1]);
+	write_blocks(&metadata, footer_fields[2], &dictionary_block, 1);
+	write_blocks(&metadata, footer_fields[3], batch_blocks, batch_block_count);
+	fb_pad(&metadata, 8, 0);
+	const uint32_t footer_length = metadata.size;
+	write_bytes(metadata.data, metadata.size);
+	write_bytes(&footer_length, 4);
+	write_bytes("ARROW1", 6);
+	if (fclose(output) != 0 || write_failed) {
+		fprintf(stderr, "Cannot write %s\n", path);
+		return 1;
+	}
+
+	double elapsed = now_s() - start;
+	fprintf(stderr, "%llu frames, %lu IDs, %llu batches -> %s (%.1f MB)\n",
+			(unsigned long long)exported_frames, (unsigned long)id_count, (unsigned long long)batch_block_count,
+			path, output_offset / 1e6);
+	fprintf(stderr, "Dictionary pass %.2f s, export %.2f s (%.0f frames/s, %d threads)\n",
+			dictionary_s, elapsed, exported_frames / (elapsed > 0 ? elapsed : 1), threads);
+	free(batch_blocks);
+	free(metadata.data);
+	return 0;
+}
@@ -0,0 +1,177 @@
+/**
+ * @file can_batch.c
+ * @brief Columnar frame batches and signal extraction, for the Python bindings.
+ *
+ * @details
+ * Built as a shared library loaded by Host/tools/can_native.py. Build from
+ * the repository root:
+ *
+ *   gcc -O2 -shared -fPIC -IHost/stubs -IMy_Modules/Drivers/can -IMy_Modules/Drivers/debug
+ *       -IMy_Modules/Drivers/stdio -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp
+ *       -IMy_Modules/Features/logger Host/tools/can_batch.c Host/tools/can_capture.c
+ *       My_Modules/Drivers/can/my_can_wire.c My_Modules/Features/logger/can_logger.c
+ *       My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/stdio/my_stdio.c
+ *       My_Modules/Drivers/uart/my_uart.c -o Host/tools/libcan_batch.so
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "can_batch.h"
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+
+/**
+ * @fn static bool grow(can_Batch* batch)
+ * @brief Double the capacity of every column.
+ */
+static bool grow(can_Batch* batch) {
+	uint64_t capacity = batch->capacity ? batch->capacity * 2 : CAN_BATCH_INITIAL_ROWS;
+	uint64_t* time_us = realloc(batch->time_us, capacity * sizeof(*batch->time_us));
+	if (time_us != NULL) batch->time_us = time_us;
+	uint32_t* identifier = realloc(batch->identifier, capacity * sizeof(*batch->identifier));
+	if (identifier != NULL) batch->identifier = identifier;
+	uint8_t* channel = realloc(batch->channel, capacity * sizeof(*batch->channel));
+	if (channel != NULL) batch->channel = channel;
+	uint8_t* dlc = realloc(batch->dlc, capacity * sizeof(*batch->dlc));
+	if (dlc != NULL) batch->dlc = dlc;
+	uint8_t (*data)[8] = realloc(batch->data, capacity * sizeof(*batch->data));
+	if (data != NULL) batch->data = data;
+	if (time_us == NULL || identifier == NULL || channel == NULL || dlc == NULL || data == NULL) return false;
+	batch->capacity = capacity;
+	return true;
+}
+
+/**
+ * @fn static void add_row(const my_CAN_Frame* frame, uint64_t time_us, void* context)
+ * @brief can_Capture callback: append a frame to the columns.
+ */
+static void add_row(const my_CAN_Frame* frame, uint64_t time_us, void* context) {
+	can_Batch* batch = context;
+	if (batch->rows == batch->capacity && (batch->failed || !grow(batch))) {
+		batch->failed = true;
+		return;
+	}
+	uint64_t row = batch->rows++;
+	uint8_t length = frame->DataLength > 8 ? 8 : frame->DataLength;
+	batch->time_us[row] = time_us;
+	batch->identifier[row] = frame->Identifier;
+	batch->channel[row] = batch->capture.channel;
+	batch->dlc[row] = length;
+	memset(batch->data[row], 0, 8);
+	memcpy(batch->data[row], frame->Data, length);
+}
+
+/**
+ * @fn can_Batch* can_batch_new(void)
+ * @brief Allocate an empty batch.
+ *
+ * @param None
+ * @retval The batch, or NULL if out of memory.
+ */
+can_Batch* can_batch_new(void) {
+	can_Batch* batch = calloc(1, sizeof(*batch));
+	if (batch != NULL) can_capture_init(&batch->capture, add_row, batch);
+	return batch;
+}
+
+/**
+ * @fn void can_batch_free(can_Batch* batch)
+ * @brief Free a batch and its columns.
+ *
+ * @param batch Batch, may be NULL.
+ * @retval None
+ */
+void can_batch_free(can_Batch* batch) {
+	if (batch == NULL) return;
+	free(batch->time_us);
+	free(batch->identifier);
+	free(batch->channel);
+	free(batch->dlc);
+	free(batch->data);
+	free(batch);
+}
+
+/**
+ * @fn void can_batch_clear(can_Batch* batch)
+ * @brief Drop the rows, keep the columns and the time line.
+ *
+ * @param batch Batch.
+ * @retval None
+ */
+void can_batch_clear(can_Batch* batch) {
+	batch->rows = 0;
+	batch->failed = false;
+}
+
+/**
+ * @fn bool can_batch_read(can_Batch* batch, const char* path)
+ * @brief Append the frames of a capture file.
+ *
+ * @param batch Batch.
+ * @param path Capture file of any format read by can_capture_read().
+ * @retval false If the file cannot be opened or memory runs out.
+ */
+bool can_batch_read(can_Batch* batch, const char* path) {
+	return can_capture_read(&batch->capture, path) && !batch->failed;
+}
+
+/**
+ * @fn uint32_t can_batch_feed(can_Batch* batch, const uint8_t* data, uint32_t length)
+ * @brief Append the frames of received wire records (capture daemon socket).
+ *
+ * @param batch Batch.
+ * @param data Received bytes.
+ * @param length Number of bytes.
+ * @retval Number of bytes consumed; the rest starts a record cut by the end
+ * 		   of data and must be passed again with the next bytes.
+ */
+uint32_t can_batch_feed(can_Batch* batch, const uint8_t* data, uint32_t length) {
+	return can_capture_feed(&batch->capture, data, length, false);
+}
+
+/**
+ * @fn uint64_t can_batch_extract(const can_Batch* batch, uint32_t identifier, uint32_t start, uint32_t length, bool big_endian, bool is_signed, double scale, double offset, double* times, double* values)
+ * @brief Decode a signal from every frame of one ID.
+ *
+ * @param batch Batch.
+ * @param identifier CAN ID carrying the signal.
+ * @param start Start bit (DBC convention: LSB for little endian, MSB for big endian).
+ * @param length Length in bits (1 to 64).
+ * @param big_endian Motorola byte order if true, Intel if false.
+ * @param is_signed Two's complement value if true.
+ * @param scale Physical value = raw * scale + offset.
+ * @param offset Physical value = raw * scale + offset.
+ * @param times Output, time (s) of each sample; room for batch->rows values.
+ * @param values Output, physical value of each sample; room for batch->rows values.
+ * @retval Number of samples. Frames too short for the signal are skipped.
+ *
+ * @details
+ * The payload is loaded as one 64-bit word (little or big endian, zero
+ * padded), so the field is a single shift and mask. Big endian: the MSB is
+ * bit (start / 8) * 8 + 7 - start % 8 counted from the first bit on the wire.
+ */
+uint64_t can_batch_extract(const can_Batch* batch, uint32_t identifier, uint32_t start, uint32_t length, bool big_endian,
+						   bool is_signed, double scale, double offset, double* times, double* values) {
+	if (length < 1 || length > 64) return 0;
+	uint64_t mask = (length == 64) ? ~0ULL : (1ULL << length) - 1;
+	uint64_t sign = 1ULL << (length - 1);
+	/* last bit used, counted from the first bit on the wire (big endian) or from bit 0 (little endian) */
+	uint32_t last = big_endian ? (start / 8) * 8 + 7 - start % 8 + length - 1 : start + length - 1;
+	if (last >= 64) return 0;
+	uint32_t shift = big_endian ? 63 - last : start;
+	uint8_t min_dlc = (uint8_t)(last / 8 + 1);
+
+	uint64_t count = 0;
+	for (uint64_t row = 0; row < batch->rows; row++) {
+		if (batch->identifier[row] != identifier || batch->dlc[row] < min_dlc) continue;
+		uint64_t word;
+		memcpy(&word, batch->data[row], 8);
+		if (big_endian) word = __builtin_bswap64(word);
+		uint64_t raw = (word >> shift) & mask;
+		double value = (is_signed && (raw & sign)) ? (double)(int64_t)(raw | ~mask) : (double)raw;
+		times[count] = (double)batch->time_us[row] * 1e-6;
+		values[count] = value * scale + offset;
+		count++;
+	}
+	return count;
+}
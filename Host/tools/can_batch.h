@@ -0,0 +1,121 @@
+/**
+ * @file can_batch.h
+ * @brief Columnar frame batches and signal extraction, for the Python bindings.
+ *
+ * @details
+ * A can_Batch holds decoded frames as one array per field (time, ID,
+ * channel, DLC, payload), filled from capture files (any format read by
+ * can_capture.c) or from the wire record stream of the capture daemon. The
+ * arrays are plain C memory that can_native.py exposes as NumPy arrays
+ * without copying them and without a Python object per frame.
+ *
+ * can_batch_extract() decodes a signal (bit field, byte order, sign, scale
+ * and offset, as can_signals.Signal) from every frame of one ID in a single
+ * call.
+ *
+ * The column pointers change when the batch grows: they are only valid
+ * until the next can_batch_read(), can_batch_feed() or can_batch_free().
+ */
+
+#ifndef CAN_BATCH_H
+#define CAN_BATCH_H
+
+#include "can_capture.h"
+
+/**
+ * @def CAN_BATCH_INITIAL_ROWS
+ * @brief Rows allocated by the first growth of a batch.
+ */
+#define CAN_BATCH_INITIAL_ROWS 65536
+
+/**
+ * @struct can_Batch
+ * @brief Frame columns, the row count and the reader state.
+ *
+ * @details
+ * time_us is the time since the first frame read into the batch (see
+ * can_capture.h), data the payload zero padded to 8 bytes. failed is set
+ * when growing the columns runs out of memory; later frames are dropped.
+ * The layout of the fields before capture is shared with can_native.py.
+ */
+typedef struct {
+	uint64_t* time_us;
+	uint32_t* identifier;
+	uint8_t* channel;
+	uint8_t* dlc;
+	uint8_t (*data)[8];
+	uint64_t rows;
+	uint64_t capacity;
+	bool failed;
+	can_Capture capture;
+} can_Batch;
+
+/**
+ * @fn can_Batch* can_batch_new(void)
+ * @brief Allocate an empty batch.
+ *
+ * @param None
+ * @retval The batch, or NULL if out of memory.
+ */
+can_Batch* can_batch_new(void);
+
+/**
+ * @fn void can_batch_free(can_Batch* batch)
+ * @brief Free a batch and its columns.
+ *
+ * @param batch Batch, may be NULL.
+ * @retval None
+ */
+void can_batch_free(can_Batch* batch);
+
+/**
+ * @fn void can_batch_clear(can_Batch* batch)
+ * @brief Drop the rows, keep the columns and the time line.
+ *
+ * @param batch Batch.
+ * @retval None
+ */
+void can_batch_clear(can_Batch* batch);
+
+/**
+ * @fn bool can_batch_read(can_Batch* batch, const char* path)
+ * @brief Append the frames of a capture file.
+ *
+ * @param batch Batch.
+ * @param path Capture file of any format read by can_capture_read().
+ * @retval false If the file cannot be opened or memory runs out.
+ */
+bool can_batch_read(can_Batch* batch, const char* path);
+
+/**
+ * @fn uint32_t can_batch_feed(can_Batch* batch, const uint8_t* data, uint32_t length)
+ * @brief Append the frames of received wire records (capture daemon socket).
+ *
+ * @param batch Batch.
+ * @param data Received bytes.
+ * @param length Number of bytes.
+ * @retval Number of bytes consumed; the rest starts a record cut by the end
+ * 		   of data and must be passed again with the next bytes.
+ */
+uint32_t can_batch_feed(can_Batch* batch, const uint8_t* data, uint32_t length);
+
+/**
+ * @fn uint64_t can_batch_extract(const can_Batch* batch, uint32_t identifier, uint32_t start, uint32_t length, bool big_endian, bool is_signed, double scale, double offset, double* times, double* values)
+ * @brief Decode a signal from every frame of one ID.
+ *
+ * @param batch Batch.
+ * @param identifier CAN ID carrying the signal.
+ * @param start Start bit (DBC convention: LSB for little endian, MSB for big endian).
+ * @param length Length in bits (1 to 64).
+ * @param big_endian Motorola byte order if true, Intel if false.
+ * @param is_signed Two's complement value if true.
+ * @param scale Physical value = raw * scale + offset.
+ * @param offset Physical value = raw * scale + offset.
+ * @param times Output, time (s) of each sample; room for batch->rows values.
+ * @param values Output, physical value of each sample; room for batch->rows values.
+ * @retval Number of samples. Frames too short for the signal are skipped.
+ */
+uint64_t can_batch_extract(const can_Batch* batch, uint32_t identifier, uint32_t start, uint32_t length, bool big_endian,
+						   bool is_signed, double scale, double offset, double* times, double* values);
+
+#endif /* CAN_BATCH_H */
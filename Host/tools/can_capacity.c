@@ -0,0 +1,628 @@
+/**
+ * @file can_capacity.c
+ * @brief Host tool: UART link capacity of each output format for a traffic profile.
+ *
+ * @details
+ * The traffic profile is either a capture (any format of can_capture.h),
+ * replayed at --speed times its recorded rate, or an ID/DLC/rate mix given
+ * with --mix (periodic frames over --duration seconds). Frames never
+ * overlap on the bus: a frame starts at the end of the previous one at the
+ * earliest. As in the firmware, only standard IDs passing --filter ID MASK
+ * (default: all) are received.
+ *
+ * For every frame, the output bytes of both formats are computed with the
+ * firmware formatters (my_CAN_wire_encode(), my_CAN_text_format()), giving
+ * the exact bytes per frame of the mix and the maximum sustained frame rate
+ * of the UART at --baud.
+ *
+ * The firmware buffering of each format is then modelled as a queue in
+ * front of the UART:
+ *   - binary: the RX interrupt writes CAN_WIRE_SIZE() bytes into the
+ *     UART_TX_ARENA_SIZE DMA arena. While the DMA is idle, everything
+ *     committed is sent as one transfer, and its space is released at the
+ *     end of the transfer.
+ *   - text: the RX interrupt writes a CAN_RECORD_SIZE() record into the
+ *     SOFTWARE_CAN_BUFFER_SIZE software buffer. The main loop sends one line
+ *     at a time (blocking) and releases the record after it.
+ * A frame that does not fit is dropped. In text mode, send_frame_over_UART()
+ * then prints an overflow notice (CAN_NOTICE_SIZE bytes) when the software
+ * buffer has been emptied, before the next line, which also takes link time.
+ * Binary mode prints no notice (it would corrupt the record stream), the
+ * drops only show in the statistics. Records are placed
+ * in the buffers as the firmware does, wrap-around waste included. CPU time
+ * is not modelled.
+ *
+ * The model predicts the dropped frames, the peak buffer fill and, with
+ * --trajectory, the backlog over time: frames received and not dropped whose
+ * output has not started yet, the quantity written by
+ * replay_bench --trajectory, which runs the firmware itself on the simulated
+ * peripherals.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -IHost/stubs -IMy_Modules/Drivers/can -IMy_Modules/Drivers/debug
+ *       -IMy_Modules/Drivers/stdio -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp
+ *       -IMy_Modules/Features/logger Host/tools/can_capacity.c Host/tools/can_capture.c
+ *       My_Modules/Drivers/can/my_can_wire.c My_Modules/Features/logger/can_logger.c
+ *       My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/stdio/my_stdio.c
+ *       My_Modules/Drivers/uart/my_uart.c -o can_capacity
+ *   ./can_capacity [--baud B] [--bitrate B] [--filter ID MASK] [--speed N|max] [--trajectory backlog.csv [--interval MS]] capture
+ *   ./can_capacity [--baud B] [--bitrate B] --mix ID:DLC:HZ[,ID:DLC:HZ ...] [--duration S] [...]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "can_capture.h"
+
+/**
+ * @def CAN_NOTICE_SIZE
+ * @brief Bytes of the "Software CAN buffer overflow!" debug message of
+ * 		  send_frame_over_UART(), banners of DEBUG_printf() included.
+ */
+#define CAN_NOTICE_SIZE (sizeof("\n\n\n$$$$$$$$$ DEBUG print START $$$$$$$$$\r\n") - 1 + \
+						 sizeof("Software CAN buffer overflow!\r\n") - 1 + \
+						 sizeof("$$$$$$$$$ DEBUG print END $$$$$$$$$$$\r\n\n\n") - 1)
+
+/**
+ * @def MODEL_QUEUE
+ * @brief Frames a model queue can hold (more than fit in either buffer).
+ */
+#define MODEL_QUEUE 2048
+
+/**
+ * @def MAX_MIX
+ * @brief Entries of a --mix.
+ */
+#define MAX_MIX 256
+
+/**
+ * @enum link_State
+ * @brief What the modelled UART is sending.
+ */
+typedef enum {
+	LINK_IDLE,
+	LINK_FRAMES,
+	LINK_NOTICE
+} link_State;
+
+/**
+ * @struct output_Model
+ * @brief Queue model of one output format.
+ *
+ * @details
+ * Each queued frame has a buffer cost (memory), a link cost (bytes sent)
+ * and an offset in the buffer. The buffer is placed as by
+ * my_uart_tx_arena_reserve() and reserve_record_in_software_CAN_buffer():
+ * a record that does not fit before the end goes to the start, the rest up
+ * to wrap is skipped. batch is true when one transfer takes every queued
+ * frame up to the end of the contiguous span (binary DMA), false when it
+ * takes one (text lines). sending_frames are the frames of the transfer in
+ * progress, at the start of the queue. notice_pending is the overflow flag
+ * of the firmware, notice_queued a notice the main loop has committed to
+ * (it cleared the flag and waits for the link in DEBUG_printf()). Both stay
+ * false in batch mode, which sends no notice.
+ */
+typedef struct {
+	const char* name;
+	bool batch;
+	uint32_t capacity;
+	uint32_t head_offset;
+	uint32_t tail_offset;
+	uint32_t wrap;
+	uint16_t offset[MODEL_QUEUE];
+	uint16_t memory[MODEL_QUEUE];
+	uint16_t bytes[MODEL_QUEUE];
+	uint32_t first;
+	uint32_t count;
+	uint32_t sending_frames;
+	uint32_t sending_memory;
+	link_State link;
+	uint64_t link_end_ns;
+	bool notice_pending;
+	bool notice_queued;
+	uint64_t frames;
+	uint64_t frame_bytes;
+	uint32_t min_bytes;
+	uint32_t max_bytes;
+	uint64_t dropped;
+	uint64_t notices;
+	uint64_t output_bytes;
+	uint64_t busy_ns;
+	uint32_t max_used;
+	uint32_t max_backlog;
+	uint64_t first_drop_ns;
+} output_Model;
+
+/**
+ * @struct mix_Entry
+ * @brief Periodic frame of a --mix.
+ */
+typedef struct {
+	uint32_t identifier;
+	uint8_t data_length;
+	double period_ns;
+	double next_ns;
+} mix_Entry;
+
+/**
+ * @var models
+ * @brief Binary (0) and text (1) output models.
+ */
+static output_Model models[2];
+
+/**
+ * @var byte_ns
+ * @brief Time to send one UART byte (8N1).
+ */
+static double byte_ns;
+
+/**
+ * @var bitrate
+ * @brief CAN bus bit rate.
+ */
+static uint32_t bitrate = 500000;
+
+/**
+ * @var speed
+ * @brief Replay speed factor of a capture, 0 = back to back.
+ */
+static double speed = 1.0;
+
+/**
+ * @var bus_free_ns
+ * @brief End of the last frame on the bus.
+ */
+static uint64_t bus_free_ns = 0;
+
+/**
+ * @var bus_busy_ns
+ * @brief Total bus time of the frames.
+ */
+static uint64_t bus_busy_ns = 0;
+
+/**
+ * @var bus_frames
+ * @brief Frames of the profile.
+ */
+static uint64_t bus_frames = 0;
+
+/**
+ * @var filter_id
+ * @brief Standard ID filter (see my_CAN_set_filter_mask()).
+ */
+static uint32_t filter_id = 0;
+
+/**
+ * @var mask_id
+ * @brief Standard ID filter mask, 0 accepts every standard ID.
+ */
+static uint32_t mask_id = 0;
+
+/**
+ * @var filtered_frames
+ * @brief Frames rejected by the filter (extended IDs included).
+ */
+static uint64_t filtered_frames = 0;
+
+/**
+ * @var bus_delayed_frames
+ * @brief Frames that started later than their time because the bus was busy.
+ */
+static uint64_t bus_delayed_frames = 0;
+
+/**
+ * @var trajectory_file
+ * @brief Backlog CSV (--trajectory), NULL if not requested.
+ */
+static FILE* trajectory_file = NULL;
+
+/**
+ * @var trajectory_interval_ns
+ * @brief Time between two backlog samples.
+ */
+static uint64_t trajectory_interval_ns = 10000000;
+
+/**
+ * @var next_sample_ns
+ * @brief Time of the next backlog sample.
+ */
+static uint64_t next_sample_ns = 0;
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+
+/**
+ * @fn static uint32_t frame_bits(uint32_t identifier, uint8_t data_length)
+ * @brief Bus bits of a data frame with interframe space, no stuff bits (as host_sim_frame_ns()).
+ */
+static uint32_t frame_bits(uint32_t identifier, uint8_t data_length) {
+	return ((identifier > 0x7FF) ? 67 : 47) + 8 * data_length;
+}
+
+/**
+ * @fn static void model_init(output_Model* model, const char* name, bool batch, uint32_t capacity)
+ * @brief Reset a model to an empty buffer and an idle link.
+ */
+static void model_init(output_Model* model, const char* name, bool batch, uint32_t capacity) {
+	memset(model, 0, sizeof(*model));
+	model->name = name;
+	model->batch = batch;
+	model->capacity = capacity;
+	model->wrap = capacity;
+	model->min_bytes = UINT32_MAX;
+	model->first_drop_ns = UINT64_MAX;
+}
+
+/**
+ * @fn static uint32_t model_backlog(const output_Model* model)
+ * @brief Frames queued whose transfer has not started.
+ */
+static uint32_t model_backlog(const output_Model* model) {
+	return model->count - model->sending_frames;
+}
+
+/**
+ * @fn static uint32_t model_used(const output_Model* model)
+ * @brief Buffer bytes in use, skipped end included.
+ */
+static uint32_t model_used(const output_Model* model) {
+	return (model->head_offset + model->capacity - model->tail_offset) % model->capacity;
+}
+
+/**
+ * @fn static int32_t model_reserve(output_Model* model, uint32_t size)
+ * @brief Offset of a new record, -1 if the buffer is full.
+ *
+ * @details
+ * head_offset never catches up with tail_offset, so equal offsets always
+ * mean empty.
+ */
+static int32_t model_reserve(output_Model* model, uint32_t size) {
+	uint32_t h = model->head_offset;
+	uint32_t t = model->tail_offset;
+
+	if (h < t) return (size < t - h) ? (int32_t)h : -1;
+	uint32_t space_to_end = model->capacity - h;
+	if (size < space_to_end) return (int32_t)h;
+	if (size == space_to_end && t != 0) {
+		model->wrap = model->capacity;
+		return (int32_t)h;
+	}
+	if (size >= t) return -1;
+	model->wrap = h;
+	return 0;
+}
+
+/**
+ * @fn static void model_notice(output_Model* model, uint64_t now_ns)
+ * @brief Send the overflow notice of text mode from now_ns.
+ */
+static void model_notice(output_Model* model, uint64_t now_ns) {
+	model->notice_queued = false;
+	model->notices++;
+	model->output_bytes += CAN_NOTICE_SIZE;
+	model->link = LINK_NOTICE;
+	model->link_end_ns = now_ns + (uint64_t)(CAN_NOTICE_SIZE * byte_ns);
+	model->busy_ns += model->link_end_ns - now_ns;
+}
+
+/**
+ * @fn static void model_send(output_Model* model, uint64_t now_ns)
+ * @brief Start the next transfer at now_ns, after the one in model->link.
+ *
+ * @details
+ * A queued notice (text mode only) goes first.
+ */
+static void model_send(output_Model* model, uint64_t now_ns) {
+	if (model->notice_queued) {
+		model_notice(model, now_ns);
+		return;
+	}
+
+	uint32_t backlog = model_backlog(model);
+	if (backlog == 0) {
+		model->link = LINK_IDLE;
+	} else {
+		if (model->head_offset < model->tail_offset && model->tail_offset == model->wrap) model->tail_offset = 0;
+		uint32_t size = 0;
+		for (uint32_t i = 0; i < backlog; i++) {
+			uint32_t index = (model->first + i) % MODEL_QUEUE;
+			if (i > 0 && (!model->batch || model->offset[index] < model->tail_offset)) break;
+			size += model->bytes[index];
+			model->sending_memory += model->memory[index];
+			model->sending_frames++;
+		}
+		model->output_bytes += size;
+		model->link = LINK_FRAMES;
+		model->link_end_ns = now_ns + (uint64_t)(size * byte_ns);
+		model->busy_ns += model->link_end_ns - now_ns;
+	}
+}
+
+/**
+ * @fn static void model_advance(output_Model* model, uint64_t until_ns)
+ * @brief Complete the transfers ending up to until_ns.
+ */
+static void model_advance(output_Model* model, uint64_t until_ns) {
+	while (model->link != LINK_IDLE && model->link_end_ns <= until_ns) {
+		if (model->link == LINK_FRAMES) {
+			model->tail_offset += model->sending_memory;
+			if (model->tail_offset == model->capacity) model->tail_offset = 0;
+			model->first = (model->first + model->sending_frames) % MODEL_QUEUE;
+			model->count -= model->sending_frames;
+			model->sending_frames = 0;
+			model->sending_memory = 0;
+		}
+		/* Text: an empty buffer ends the output loop, a notice waits for the next frame */
+		if (!model->batch && model->count == 0) {
+			model->link = LINK_IDLE;
+			continue;
+		}
+		model_send(model, model->link_end_ns);
+	}
+}
+
+/**
+ * @fn static void model_frame(output_Model* model, uint32_t memory, uint32_t bytes, uint64_t arrival_ns)
+ * @brief A frame reaches the output path at arrival_ns.
+ */
+static void model_frame(output_Model* model, uint32_t memory, uint32_t bytes, uint64_t arrival_ns) {
+	model_advance(model, arrival_ns);
+	model->frames++;
+	model->frame_bytes += bytes;
+	if (bytes < model->min_bytes) model->min_bytes = bytes;
+	if (bytes > model->max_bytes) model->max_bytes = bytes;
+
+	int32_t offset = (model->count < MODEL_QUEUE) ? model_reserve(model, memory) : -1;
+	if (offset < 0) {
+		model->dropped++;
+		if (!model->batch) model->notice_pending = true;
+		if (model->first_drop_ns == UINT64_MAX) model->first_drop_ns = arrival_ns;
+	} else {
+		uint32_t index = (model->first + model->count++) % MODEL_QUEUE;
+		model->offset[index] = (uint16_t)offset;
+		model->memory[index] = (uint16_t)memory;
+		model->bytes[index] = (uint16_t)bytes;
+		model->head_offset = offset + memory;
+		if (model->head_offset == model->capacity) model->head_offset = 0;
+		if (model_used(model) > model->max_used) model->max_used = model_used(model);
+	}
+	if (model->link == LINK_IDLE) {
+		/* Text: the output loop was left on an empty buffer, the flag is checked on entry */
+		if (model->notice_pending) {
+			model->notice_pending = false;
+			model->notice_queued = true;
+		}
+		model_send(model, arrival_ns);
+	}
+	if (model_backlog(model) > model->max_backlog) model->max_backlog = model_backlog(model);
+}
+
+/**
+ * @fn static void write_samples(uint64_t until_ns)
+ * @brief Write the backlog samples up to until_ns to the trajectory file.
+ */
+static void write_samples(uint64_t until_ns) {
+	while (trajectory_file && next_sample_ns <= until_ns) {
+		for (int i = 0; i < 2; i++) model_advance(&models[i], next_sample_ns);
+		fprintf(trajectory_file, "%.3f,%lu,%lu,%llu,%lu,%lu,%llu\n", next_sample_ns * 1e-9,
+				(unsigned long)model_backlog(&models[0]), (unsigned long)model_used(&models[0]), (unsigned long long)models[0].dropped,
+				(unsigned long)model_backlog(&models[1]), (unsigned long)model_used(&models[1]), (unsigned long long)models[1].dropped);
+		next_sample_ns += trajectory_interval_ns;
+	}
+}
+
+/**
+ * @fn static void add_frame(const my_CAN_Frame* frame, uint64_t start_ns)
+ * @brief Put a frame on the bus at start_ns (or when the bus is free) and
+ * 		  pass it to both models at its end.
+ */
+static void add_frame(const my_CAN_Frame* frame, uint64_t start_ns) {
+	if (start_ns < bus_free_ns) {
+		if (speed > 0) bus_delayed_frames++;
+		start_ns = bus_free_ns;
+	}
+	uint64_t duration = (uint64_t)frame_bits(frame->Identifier, frame->DataLength) * 1000000000ULL / bitrate;
+	bus_free_ns = start_ns + duration;
+	bus_busy_ns += duration;
+	bus_frames++;
+	write_samples(bus_free_ns);
+	if (frame->Identifier > 0x7FF || ((frame->Identifier ^ filter_id) & mask_id) != 0) {
+		filtered_frames++;
+		return;
+	}
+
+	uint8_t record[CAN_WIRE_MAX_SIZE];
+	char line[CAN_TEXT_MAX_SIZE];
+	uint32_t wire_size = my_CAN_wire_encode(frame, 0, record);
+	uint32_t text_size = my_CAN_text_format(frame->Identifier, frame->DataLength, frame->Data, line);
+	model_frame(&models[0], wire_size, wire_size, bus_free_ns);
+	model_frame(&models[1], CAN_RECORD_SIZE(frame->DataLength), text_size, bus_free_ns);
+}
+
+/**
+ * @fn static void on_frame(const my_CAN_Frame* frame, uint64_t time_us, void* context)
+ * @brief Capture frame at its scaled time (can_Capture_Callback).
+ */
+static void on_frame(const my_CAN_Frame* frame, uint64_t time_us, void* context) {
+	(void)context;
+	add_frame(frame, (speed > 0) ? (uint64_t)(time_us * 1000.0 / speed) : 0);
+}
+
+/**
+ * @fn static uint32_t parse_mix(const char* text, mix_Entry* mix)
+ * @brief Parse "ID:DLC:HZ[,ID:DLC:HZ ...]".
+ *
+ * @retval Number of entries, 0 if the text is invalid.
+ */
+static uint32_t parse_mix(const char* text, mix_Entry* mix) {
+	uint32_t count = 0;
+	while (*text != '\0' && count < MAX_MIX) {
+		unsigned long identifier;
+		unsigned dlc;
+		double hz;
+		int length = 0;
+		if (sscanf(text, "%li:%u:%lf%n", (long*)&identifier, &dlc, &hz, &length) != 3 || dlc > 8 || hz <= 0) return 0;
+		mix[count].identifier = (uint32_t)identifier;
+		mix[count].data_length = (uint8_t)dlc;
+		mix[count].period_ns = 1e9 / hz;
+		count++;
+		text += length;
+		if (*text == ',') text++;
+		else if (*text != '\0') return 0;
+	}
+	/* Spread the phases so that the IDs do not all start together */
+	for (uint32_t i = 0; i < count; i++) mix[i].next_ns = mix[i].period_ns * i / count;
+	return count;
+}
+
+/**
+ * @fn static void generate_mix(mix_Entry* mix, uint32_t count, double duration_s)
+ * @brief Put the periodic frames of a mix on the bus in time order.
+ */
+static void generate_mix(mix_Entry* mix, uint32_t count, double duration_s) {
+	const double end_ns = duration_s * 1e9;
+	for (;;) {
+		uint32_t next = 0;
+		for (uint32_t i = 1; i < count; i++) {
+			if (mix[i].next_ns < mix[next].next_ns) next = i;
+		}
+		if (mix[next].next_ns >= end_ns) break;
+
+		my_CAN_Frame frame = {0};
+		frame.Identifier = mix[next].identifier;
+		frame.DataLength = mix[next].data_length;
+		memset(frame.Data, 0x55, frame.DataLength);
+		add_frame(&frame, (uint64_t)mix[next].next_ns);
+		mix[next].next_ns += mix[next].period_ns;
+	}
+}
+
+/**
+ * @fn static void print_model(const output_Model* model, double duration_s, double frames_per_s, uint32_t baud)
+ * @brief Print the capacity and the prediction of one format.
+ */
+static void print_model(const output_Model* model, double duration_s, double frames_per_s, uint32_t baud) {
+	double average = model->frames ? (double)model->frame_bytes / model->frames : 0;
+	double capacity = average > 0 ? baud / 10.0 / average : 0;
+
+	printf("%s output\n", model->name);
+	printf("  Bytes/frame: avg %.2f, min %lu, max %lu\n", average, (unsigned long)model->min_bytes, (unsigned long)model->max_bytes);
+	printf("  Max sustained: %.0f frames/s (%.2fx the offered rate)\n", capacity, frames_per_s > 0 ? capacity / frames_per_s : 0);
+	printf("  Link demand: %.1f%% of %lu baud\n", 100.0 * model->frame_bytes * byte_ns * 1e-9 / (duration_s > 0 ? duration_s : 1),
+		   (unsigned long)baud);
+	printf("  Buffer: %lu B, peak fill %lu B (%.0f%%), max backlog %lu frames\n", (unsigned long)model->capacity,
+		   (unsigned long)model->max_used, 100.0 * model->max_used / model->capacity, (unsigned long)model->max_backlog);
+	if (model->dropped) {
+		printf("  Predicted drops: %llu frames (%.3f%%), first after %.3f s, %llu overflow notices\n",
+			   (unsigned long long)model->dropped, 100.0 * model->dropped / model->frames, model->first_drop_ns * 1e-9,
+			   (unsigned long long)model->notices);
+	} else {
+		printf("  Predicted drops: none\n");
+	}
+	/* Busy share up to the end of the output, which may come after the end of the bus traffic */
+	double end_ns = (model->link_end_ns > duration_s * 1e9) ? model->link_end_ns : duration_s * 1e9;
+	printf("  Output: %llu bytes, UART busy %.1f%%\n\n", (unsigned long long)model->output_bytes,
+		   100.0 * model->busy_ns / (end_ns > 0 ? end_ns : 1));
+}
+
+int main(int argc, char** argv) {
+	uint32_t baud = 921600;
+	const char* mix_text = NULL;
+	const char* trajectory_path = NULL;
+	double duration_s = 10;
+	int arg = 1;
+
+	for (; arg < argc && argv[arg][0] == '-'; arg++) {
+		if (strcmp(argv[arg], "--baud") == 0 && arg + 1 < argc) {
+			baud = (uint32_t)strtoul(argv[++arg], NULL, 0);
+		} else if (strcmp(argv[arg], "--bitrate") == 0 && arg + 1 < argc) {
+			bitrate = (uint32_t)strtoul(argv[++arg], NULL, 0);
+		} else if (strcmp(argv[arg], "--filter") == 0 && arg + 2 < argc) {
+			filter_id = (uint32_t)strtoul(argv[++arg], NULL, 0) & 0x7FF;
+			mask_id = (uint32_t)strtoul(argv[++arg], NULL, 0) & 0x7FF;
+		} else if (strcmp(argv[arg], "--speed") == 0 && arg + 1 < argc) {
+			arg++;
+			speed = (strcmp(argv[arg], "max") == 0) ? 0 : atof(argv[arg]);
+		} else if (strcmp(argv[arg], "--mix") == 0 && arg + 1 < argc) {
+			mix_text = argv[++arg];
+		} else if (strcmp(argv[arg], "--duration") == 0 && arg + 1 < argc) {
+			duration_s = atof(argv[++arg]);
+		} else if (strcmp(argv[arg], "--trajectory") == 0 && arg + 1 < argc) {
+			trajectory_path = argv[++arg];
+		} else if (strcmp(argv[arg], "--interval") == 0 && arg + 1 < argc) {
+			trajectory_interval_ns = (uint64_t)(atof(argv[++arg]) * 1e6);
+		} else {
+			break;
+		}
+	}
+	if ((mix_text == NULL) == (arg == argc) || baud == 0 || bitrate == 0 || speed < 0 || trajectory_interval_ns == 0) {
+		printf("Usage: can_capacity [--baud B] [--bitrate B] [--filter ID MASK] [--speed N|max] [--trajectory backlog.csv [--interval MS]] capture ...\n"
+			   "       can_capacity [--baud B] [--bitrate B] --mix ID:DLC:HZ[,ID:DLC:HZ ...] [--duration S] [...]\n");
+		return 1;
+	}
+	if (trajectory_path) {
+		if ((trajectory_file = fopen(trajectory_path, "w")) == NULL) {
+			printf("Cannot write %s\n", trajectory_path);
+			return 1;
+		}
+		fprintf(trajectory_file, "time_s,binary_backlog_frames,binary_fill_bytes,binary_dropped_frames,"
+				"text_backlog_frames,text_fill_bytes,text_dropped_frames\n");
+	}
+
+	byte_ns = 10 * 1e9 / baud;
+	model_init(&models[0], "Binary", true, UART_TX_ARENA_SIZE);
+	model_init(&models[1], "Text", false, SOFTWARE_CAN_BUFFER_SIZE);
+
+	if (mix_text) {
+		static mix_Entry mix[MAX_MIX];
+		uint32_t count = parse_mix(mix_text, mix);
+		if (count == 0) {
+			printf("Invalid mix: %s\n", mix_text);
+			return 1;
+		}
+		speed = 1;
+		generate_mix(mix, count, duration_s);
+		printf("Profile: %lu IDs, %llu frames over %.1f s\n", (unsigned long)count, (unsigned long long)bus_frames, duration_s);
+	} else {
+		can_Capture capture;
+		can_capture_init(&capture, on_frame, NULL);
+		for (int i = arg; i < argc; i++) {
+			if (!can_capture_read(&capture, argv[i])) {
+				printf("Cannot read the capture %s\n", argv[i]);
+				return 1;
+			}
+		}
+		printf("Profile: %s, %llu frames over %.1f s of capture, ", argv[arg], (unsigned long long)bus_frames, capture.last_us / 1e6);
+		if (speed > 0) {
+			printf("%gx\n", speed);
+		} else {
+			printf("back to back\n");
+		}
+	}
+	if (bus_frames == filtered_frames) {
+		printf("No frames received\n");
+		return 1;
+	}
+
+	/* Run the output models until the buffers are empty */
+	for (;;) {
+		uint64_t next_ns = UINT64_MAX;
+		for (int i = 0; i < 2; i++) {
+			if (models[i].link != LINK_IDLE && models[i].link_end_ns < next_ns) next_ns = models[i].link_end_ns;
+		}
+		if (next_ns == UINT64_MAX) break;
+		write_samples(next_ns);
+		for (int i = 0; i < 2; i++) model_advance(&models[i], next_ns);
+	}
+	if (trajectory_file) fclose(trajectory_file);
+
+	double duration = bus_free_ns * 1e-9;
+	double frames_per_s = (bus_frames - filtered_frames) / (duration > 0 ? duration : 1);
+	double bus_frame_ns = (double)bus_busy_ns / bus_frames;
+	printf("Bus: load %.1f%% at %lu bit/s (max %.0f frames/s for this mix), %llu frames delayed by the bus\n",
+		   100.0 * bus_busy_ns / (bus_free_ns ? bus_free_ns : 1), (unsigned long)bitrate, 1e9 / bus_frame_ns,
+		   (unsigned long long)bus_delayed_frames);
+	printf("Received: %.0f frames/s, %llu frames filtered out\n\n", frames_per_s, (unsigned long long)filtered_frames);
+	for (int i = 0; i < 2; i++) print_model(&models[i], duration, frames_per_s, baud);
+	return 0;
+}
@@ -0,0 +1,342 @@
+/**
+ * @file can_capture.c
+ * @brief Capture file reader shared by the C host tools.
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "can_capture.h"
+#include "can_logger.h"
+
+/**
+ * @def PCAP_MAGIC_US
+ * @brief pcap file magic number, microsecond timestamps.
+ */
+#define PCAP_MAGIC_US 0xA1B2C3D4UL
+
+/**
+ * @def PCAP_MAGIC_NS
+ * @brief pcap file magic number, nanosecond timestamps.
+ */
+#define PCAP_MAGIC_NS 0xA1B23C4DUL
+
+/**
+ * @def PCAP_LINKTYPE_CAN_SOCKETCAN
+ * @brief pcap link type of SocketCAN captures.
+ */
+#define PCAP_LINKTYPE_CAN_SOCKETCAN 227
+
+/**
+ * @def PCAP_HEADER_SIZE
+ * @brief Size of the pcap file header.
+ */
+#define PCAP_HEADER_SIZE 24
+
+/**
+ * @def PCAP_RECORD_SIZE
+ * @brief Size of the pcap packet record header.
+ */
+#define PCAP_RECORD_SIZE 16
+
+/**
+ * @def CAN_EFF_FLAG
+ * @brief SocketCAN can_id flag: extended ID.
+ */
+#define CAN_EFF_FLAG 0x80000000UL
+
+/**
+ * @def CAN_RTR_FLAG
+ * @brief SocketCAN can_id flag: remote frame.
+ */
+#define CAN_RTR_FLAG 0x40000000UL
+
+/**
+ * @def CAN_ERR_FLAG
+ * @brief SocketCAN can_id flag: error frame.
+ */
+#define CAN_ERR_FLAG 0x20000000UL
+
+/**
+ * @fn void can_capture_init(can_Capture* capture, can_Capture_Callback callback, void* context)
+ * @brief Start a new time line.
+ *
+ * @param capture Reader state.
+ * @param callback Function called for every frame.
+ * @param context Passed to callback.
+ * @retval None
+ */
+void can_capture_init(can_Capture* capture, can_Capture_Callback callback, void* context) {
+	memset(capture, 0, sizeof(*capture));
+	capture->callback = callback;
+	capture->context = context;
+}
+
+/**
+ * @fn static void add_frame(can_Capture* capture, const my_CAN_Frame* frame)
+ * @brief Unwrap the timestamp and pass the frame on.
+ */
+static void add_frame(can_Capture* capture, const my_CAN_Frame* frame) {
+	if (capture->started && frame->Timestamp < capture->last_timestamp &&
+			capture->last_timestamp - frame->Timestamp > 0x80000000UL) {
+		capture->wraps += 1ULL << 32;
+	}
+	uint64_t us = capture->wraps + frame->Timestamp;
+	if (!capture->started) {
+		capture->started = true;
+		capture->first_us = us;
+	}
+	capture->last_timestamp = frame->Timestamp;
+	capture->last_us = us - capture->first_us;
+	capture->frames++;
+	capture->callback(frame, capture->last_us, capture->context);
+}
+
+/**
+ * @fn static uint32_t add_records(can_Capture* capture, const uint8_t* data, uint32_t length, bool complete)
+ * @brief Decode the wire records of a byte stream, skipping invalid bytes.
+ *
+ * @details
+ * Unless complete, stops before a record that may be cut by the end of data.
+ * Returns the number of bytes consumed.
+ */
+static uint32_t add_records(can_Capture* capture, const uint8_t* data, uint32_t length, bool complete) {
+	uint32_t offset = 0;
+	while (offset < length) {
+		my_CAN_Frame frame;
+		if (!complete && data[offset] == CAN_WIRE_SYNC && length - offset < CAN_WIRE_MAX_SIZE) {
+			if (length - offset < 2 || data[offset + 1] > length - offset) break;
+		}
+		uint32_t size = my_CAN_wire_decode(&data[offset], length - offset, &frame, NULL);
+		if (size == 0) {
+			capture->skipped_bytes++;
+			offset++;
+			continue;
+		}
+		add_frame(capture, &frame);
+		offset += size;
+	}
+	return offset;
+}
+
+/**
+ * @fn static void read_log(can_Capture* capture, FILE* file, uint8_t* buffer)
+ * @brief Read the blocks of an SD card log file.
+ */
+static void read_log(can_Capture* capture, FILE* file, uint8_t* buffer) {
+	uint32_t file_id = 0;
+	for (uint32_t index = 0; fread(buffer, CAN_LOGGER_BLOCK_SIZE, 1, file) == 1; index++) {
+		const can_Logger_Block_Header* header = (const can_Logger_Block_Header*)buffer;
+		if (index == 0) file_id = header->file_id;
+		if (!can_logger_check_block(buffer, file_id, index)) break;
+		add_records(capture, buffer + sizeof(can_Logger_Block_Header), header->payload_bytes, true);
+	}
+}
+
+/**
+ * @fn static void read_stream(can_Capture* capture, FILE* file, uint8_t* buffer)
+ * @brief Read a binary wire record stream.
+ */
+static void read_stream(can_Capture* capture, FILE* file, uint8_t* buffer) {
+	size_t kept = 0;
+	size_t got;
+	while ((got = fread(buffer + kept, 1, CAN_CAPTURE_READ_CHUNK, file)) > 0) {
+		uint32_t used = add_records(capture, buffer, (uint32_t)(kept + got), false);
+		kept = kept + got - used;
+		memmove(buffer, buffer + used, kept);
+	}
+	add_records(capture, buffer, (uint32_t)kept, true);
+}
+
+/**
+ * @fn uint32_t can_capture_feed(can_Capture* capture, const uint8_t* data, uint32_t length, bool complete)
+ * @brief Read the binary wire records of a byte stream received in pieces
+ * (e.g. from the capture daemon socket).
+ *
+ * @param capture Reader state.
+ * @param data Received bytes.
+ * @param length Number of bytes.
+ * @param complete If false, stops before a record that may be cut by the end
+ * 		  of data; pass the rest again with the next bytes.
+ * @retval Number of bytes consumed.
+ */
+uint32_t can_capture_feed(can_Capture* capture, const uint8_t* data, uint32_t length, bool complete) {
+	return add_records(capture, data, length, complete);
+}
+
+/**
+ * @fn static uint32_t pcap_u32(const uint8_t* data, bool swapped)
+ * @brief 32-bit field of a pcap header, in the byte order of the file.
+ */
+static uint32_t pcap_u32(const uint8_t* data, bool swapped) {
+	uint32_t value;
+	memcpy(&value, data, 4);
+	return swapped ? __builtin_bswap32(value) : value;
+}
+
+/**
+ * @fn static void read_pcap(can_Capture* capture, FILE* file, uint8_t* buffer)
+ * @brief Read the frames of a LINKTYPE_CAN_SOCKETCAN pcap file.
+ *
+ * @details
+ * Each packet is a struct can_frame: CAN ID and flags (big-endian), payload
+ * length, 3 reserved bytes, payload.
+ */
+static void read_pcap(can_Capture* capture, FILE* file, uint8_t* buffer) {
+	uint8_t header[PCAP_HEADER_SIZE];
+	if (fread(header, sizeof(header), 1, file) != 1) return;
+	uint32_t magic;
+	memcpy(&magic, header, 4);
+	const bool swapped = (magic == __builtin_bswap32(PCAP_MAGIC_US) || magic == __builtin_bswap32(PCAP_MAGIC_NS));
+	const bool nanoseconds = (magic == PCAP_MAGIC_NS || magic == __builtin_bswap32(PCAP_MAGIC_NS));
+	if (pcap_u32(&header[20], swapped) != PCAP_LINKTYPE_CAN_SOCKETCAN) {
+		fprintf(stderr, "pcap link type %lu is not SocketCAN\n", (unsigned long)pcap_u32(&header[20], swapped));
+		return;
+	}
+
+	uint8_t record[PCAP_RECORD_SIZE];
+	while (fread(record, sizeof(record), 1, file) == 1) {
+		uint32_t length = pcap_u32(&record[8], swapped);
+		if (length > CAN_CAPTURE_READ_CHUNK || fread(buffer, 1, length, file) != length) break;
+		uint32_t can_id = ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) | ((uint32_t)buffer[2] << 8) | buffer[3];
+		if (length < 8 || buffer[4] > 8 || length < 8U + buffer[4] || (can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG))) {
+			capture->skipped_frames++;
+			continue;
+		}
+		uint64_t us = (uint64_t)pcap_u32(&record[0], swapped) * 1000000 +
+					  pcap_u32(&record[4], swapped) / (nanoseconds ? 1000 : 1);
+		my_CAN_Frame frame = {0};
+		frame.Timestamp = (uint32_t)us;
+		frame.Identifier = can_id & ((can_id & CAN_EFF_FLAG) ? 0x1FFFFFFFUL : 0x7FFUL);
+		frame.DataLength = buffer[4];
+		memcpy(frame.Data, &buffer[8], frame.DataLength);
+		add_frame(capture, &frame);
+	}
+}
+
+/**
+ * @fn static int parse_hex_bytes(const char* text, uint8_t* data, bool spaced)
+ * @brief Parse up to 8 hex bytes ("DEADBEEF", or "DE AD BE EF" if spaced).
+ *
+ * @retval Number of bytes, -1 if more than 8 or malformed.
+ */
+static int parse_hex_bytes(const char* text, uint8_t* data, bool spaced) {
+	int count = 0;
+	while (*text) {
+		if (spaced && *text == ' ') {
+			text++;
+			continue;
+		}
+		unsigned value;
+		if (!isxdigit((unsigned char)text[0]) || !isxdigit((unsigned char)text[1]) || sscanf(text, "%2x", &value) != 1) break;
+		if (count == 8) return -1;
+		data[count++] = (uint8_t)value;
+		text += 2;
+	}
+	return (*text == '\0' || *text == '\r' || *text == '\n') ? count : -1;
+}
+
+/**
+ * @fn static int find_channel(can_Capture* capture, const char* interface)
+ * @brief Channel of a candump interface, assigned on first use (-1 if none is left).
+ */
+static int find_channel(can_Capture* capture, const char* interface) {
+	for (int i = 0; i < capture->channel_count; i++) {
+		if (strncmp(capture->channel_names[i], interface, CAN_CAPTURE_NAME_SIZE - 1) == 0) return i;
+	}
+	if (capture->channel_count == CAN_CAPTURE_MAX_CHANNELS) return -1;
+	snprintf(capture->channel_names[capture->channel_count], CAN_CAPTURE_NAME_SIZE, "%.*s", CAN_CAPTURE_NAME_SIZE - 1, interface);
+	return capture->channel_count++;
+}
+
+/**
+ * @fn static void read_text(can_Capture* capture, FILE* file)
+ * @brief Read candump log lines and sniffer text output lines.
+ */
+static void read_text(can_Capture* capture, FILE* file) {
+	char line[512];
+	while (fgets(line, sizeof(line), file) != NULL) {
+		my_CAN_Frame frame = {0};
+		unsigned long seconds, fraction;
+		char interface[32], id_text[16];
+		int data_offset = 0;
+		int length = -1;
+		int channel = 0;
+		unsigned identifier, dlc;
+
+		if (sscanf(line, " (%lu.%lu) %31s %15[0-9A-Fa-f]#%n", &seconds, &fraction, interface, id_text, &data_offset) == 4 &&
+				data_offset > 0) {
+			/* candump: 3 hex digits = standard ID, 8 = extended, R = remote frame, ## = CAN FD */
+			if (line[data_offset] != 'R' && line[data_offset] != '#') {
+				length = parse_hex_bytes(&line[data_offset], frame.Data, false);
+			}
+			channel = find_channel(capture, interface);
+			if (length < 0 || channel < 0) {
+				capture->skipped_frames++;
+				continue;
+			}
+			frame.Timestamp = (uint32_t)((uint64_t)seconds * 1000000 + fraction);
+			frame.Identifier = (uint32_t)strtoul(id_text, NULL, 16);
+		} else if (sscanf(line, " ID: 0x%x, DLC: %u, Data:%n", &identifier, &dlc, &data_offset) == 2 && data_offset > 0) {
+			length = parse_hex_bytes(&line[data_offset], frame.Data, true);
+			if (length < 0 || (unsigned)length != dlc) {
+				capture->skipped_bytes += strlen(line);
+				continue;
+			}
+			frame.Identifier = identifier;
+		} else {
+			capture->skipped_bytes += strlen(line);
+			continue;
+		}
+		frame.DataLength = (uint8_t)length;
+		capture->channel = (uint8_t)channel;
+		add_frame(capture, &frame);
+	}
+	capture->channel = 0;
+}
+
+/**
+ * @fn bool can_capture_read(can_Capture* capture, const char* path)
+ * @brief Read a capture file of any supported format.
+ *
+ * @param capture Reader state.
+ * @param path File to read.
+ * @retval false If the file cannot be opened.
+ *
+ * @details
+ * The format is recognised from the start of the file: a valid first log
+ * block, a pcap magic number, or only printable characters (text).
+ */
+bool can_capture_read(can_Capture* capture, const char* path) {
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) return false;
+	uint8_t* buffer = malloc(CAN_CAPTURE_READ_CHUNK + CAN_LOGGER_BLOCK_SIZE);
+	if (buffer == NULL) {
+		fclose(file);
+		return false;
+	}
+
+	size_t length = fread(buffer, 1, CAN_LOGGER_BLOCK_SIZE, file);
+	uint32_t magic = 0;
+	if (length >= 4) memcpy(&magic, buffer, 4);
+	bool text = (length > 0);
+	for (size_t i = 0; i < length; i++) {
+		if (!isprint(buffer[i]) && buffer[i] != '\r' && buffer[i] != '\n' && buffer[i] != '\t') text = false;
+	}
+	rewind(file);
+
+	if (length == CAN_LOGGER_BLOCK_SIZE &&
+			can_logger_check_block(buffer, ((const can_Logger_Block_Header*)buffer)->file_id, 0)) {
+		read_log(capture, file, buffer);
+	} else if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS ||
+			   magic == __builtin_bswap32(PCAP_MAGIC_US) || magic == __builtin_bswap32(PCAP_MAGIC_NS)) {
+		read_pcap(capture, file, buffer);
+	} else if (text) {
+		read_text(capture, file);
+	} else {
+		read_stream(capture, file, buffer);
+	}
+	free(buffer);
+	fclose(file);
+	return true;
+}
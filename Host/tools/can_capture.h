@@ -0,0 +1,118 @@
+/**
+ * @file can_capture.h
+ * @brief Capture file reader shared by the C host tools.
+ *
+ * @details
+ * Reads, recognised by their content:
+ *   - SD card CAN<nnnnn>.LOG files (checked with can_logger_check_block(),
+ *     up to the first invalid block)
+ *   - pcap files of a SocketCAN interface (link type LINKTYPE_CAN_SOCKETCAN,
+ *     e.g. from tcpdump -i can0 or Wireshark). Remote, error and CAN FD
+ *     frames are skipped.
+ *   - text: candump log lines "(1436509052.249713) can0 123#DEADBEEF" and
+ *     the sniffer's text output lines "ID: 0x123, DLC: 8, Data: ..." (which
+ *     carry no time: all such frames get time 0)
+ *   - binary wire record streams (my_can_wire.h), e.g. the binary UART
+ *     output or the capture daemon stream saved to a file. Bytes that are
+ *     not a valid record are skipped.
+ *
+ * Frames are passed to a callback with their time in microseconds since the
+ * first frame, the 32-bit device timestamp being unwrapped. Several files
+ * read with the same can_Capture continue one time line.
+ *
+ * A candump log may hold several buses (e.g. candump -l any): each
+ * interface name gets a channel number in order of appearance, and
+ * can_Capture.channel is the channel of the frame passed to the callback.
+ * Frames of the other formats are on channel 0.
+ */
+
+#ifndef CAN_CAPTURE_H
+#define CAN_CAPTURE_H
+
+#include "my_can_wire.h"
+
+/**
+ * @def CAN_CAPTURE_READ_CHUNK
+ * @brief Bytes read from a stream file at once.
+ */
+#define CAN_CAPTURE_READ_CHUNK (1UL << 20)
+
+/**
+ * @def CAN_CAPTURE_MAX_CHANNELS
+ * @brief Number of candump interfaces told apart; frames of further ones are skipped.
+ */
+#define CAN_CAPTURE_MAX_CHANNELS 16
+
+/**
+ * @def CAN_CAPTURE_NAME_SIZE
+ * @brief Size of an interface name, terminator included.
+ */
+#define CAN_CAPTURE_NAME_SIZE 16
+
+/**
+ * @typedef can_Capture_Callback
+ * @brief Called for every frame read, time_us = time since the first frame.
+ */
+typedef void (*can_Capture_Callback)(const my_CAN_Frame* frame, uint64_t time_us, void* context);
+
+/**
+ * @struct can_Capture
+ * @brief Reader state.
+ *
+ * @details
+ * skipped_bytes counts invalid bytes of wire streams and unrecognised text
+ * lines, skipped_frames the pcap/candump frames that are not classic data
+ * frames. channel_names holds the candump interface of each channel.
+ */
+typedef struct {
+	can_Capture_Callback callback;
+	void* context;
+	bool started;
+	uint32_t last_timestamp;
+	uint64_t wraps;
+	uint64_t first_us;
+	uint64_t last_us;
+	uint64_t frames;
+	uint64_t skipped_bytes;
+	uint64_t skipped_frames;
+	uint8_t channel;
+	uint8_t channel_count;
+	char channel_names[CAN_CAPTURE_MAX_CHANNELS][CAN_CAPTURE_NAME_SIZE];
+} can_Capture;
+
+/**
+ * @fn void can_capture_init(can_Capture* capture, can_Capture_Callback callback, void* context)
+ * @brief Start a new time line.
+ *
+ * @param capture Reader state.
+ * @param callback Function called for every frame.
+ * @param context Passed to callback.
+ * @retval None
+ */
+void can_capture_init(can_Capture* capture, can_Capture_Callback callback, void* context);
+
+/**
+ * @fn bool can_capture_read(can_Capture* capture, const char* path)
+ * @brief Read a capture file of any supported format.
+ *
+ * @param capture Reader state.
+ * @param path File to read.
+ * @retval false If the file cannot be opened.
+ */
+bool can_capture_read(can_Capture* capture, const char* path);
+
+/**
+ * @fn uint32_t can_capture_feed(can_Capture* capture, const uint8_t* data, uint32_t length, bool complete)
+ * @brief Read the binary wire records of a byte stream received in pieces
+ * (e.g. from the capture daemon socket).
+ *
+ * @param capture Reader state.
+ * @param data Received bytes.
+ * @param length Number of bytes.
+ * @param complete If false, stops before a record that may be cut by the end
+ * 		  of data; pass the rest again with the next bytes.
+ * @retval Number of bytes consumed.
+ */
+uint32_t can_capture_feed(can_Capture* capture, const uint8_t* data, uint32_t length, bool complete);
+
+#endif /* CAN_CAPTURE_H */
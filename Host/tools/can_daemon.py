@@ -0,0 +1,262 @@
+"""Host capture daemon: reads the sniffer once and serves the frames to many clients.
+
+The source is the sniffer's serial port (text or binary output, see
+can_stream.StreamDecoder), a recorded capture, an SD card log file or a
+capture store directory.
+Clients (can_monitor.py, ...) connect to a Unix domain socket and receive
+every frame as a binary wire record (my_can_wire.h). A client that cannot
+keep up loses frames instead of slowing the daemon down; the gaps are
+visible in the record sequence numbers. Text lines from the sniffer (debug
+messages, command replies) are printed. With --store, every frame is also
+written to a size-bounded rotating capture store (see can_store.py).
+A second socket serves snapshots of the live tables (last frame and rate of
+every ID, last value of the --signals, loss counters) and ID- or
+signal-filtered subscriptions, see can_api.py.
+
+    python can_daemon.py --serial /dev/ttyACM0
+    python can_daemon.py --file capture.bin --realtime
+    python can_daemon.py --file CAN00003.LOG --realtime
+    python can_daemon.py --serial /dev/ttyACM0 --store /var/log/can --store-budget 4096
+    python can_daemon.py --serial /dev/ttyACM0 --signals dashboard.toml
+"""
+
+import argparse
+import os
+import selectors
+import socket
+import sys
+import time
+
+import can_api
+import can_log
+import can_store
+from can_signals import load_signals
+from can_stream import DAEMON_SOCKET, Frame, StreamDecoder, encode_wire, open_serial
+
+CLIENT_BACKLOG = 1 << 20   # bytes queued per client before its frames are dropped
+STATS_PERIOD = 5.0         # seconds between statistics lines
+
+
+class Daemon:
+    def __init__(self, socket_path, api_socket_path, signals=(), store=None):
+        self.selector = selectors.DefaultSelector()
+        self.store = store
+        self.clients = {}  # socket -> bytearray of pending output
+        self.frames = 0
+        self.dropped = 0
+        self.sequence = 0
+        self.decoder = None  # StreamDecoder of the serial port
+
+        if os.path.exists(socket_path):
+            os.unlink(socket_path)
+        self.server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.server.bind(socket_path)
+        self.server.listen()
+        self.server.setblocking(False)
+        self.selector.register(self.server, selectors.EVENT_READ, self.accept)
+        self.tables = can_api.LiveTables(signals)
+        self.api = can_api.ApiServer(self, api_socket_path, self.tables, CLIENT_BACKLOG)
+
+    def bad_records(self):
+        return self.decoder.bad_records if self.decoder else 0
+
+    def accept(self, server, mask):
+        client, _ = server.accept()
+        client.setblocking(False)
+        self.clients[client] = bytearray()
+        self.selector.register(client, selectors.EVENT_READ, self.client_event)
+
+    def close_client(self, client):
+        self.selector.unregister(client)
+        del self.clients[client]
+        client.close()
+
+    def client_event(self, client, mask):
+        if mask & selectors.EVENT_READ:
+            try:
+                if not client.recv(4096):
+                    self.close_client(client)
+                    return
+            except OSError:
+                self.close_client(client)
+                return
+        if mask & selectors.EVENT_WRITE:
+            self.flush(client)
+
+    def flush(self, client):
+        pending = self.clients[client]
+        try:
+            sent = client.send(pending)
+        except BlockingIOError:
+            sent = 0
+        except OSError:
+            self.close_client(client)
+            return
+        del pending[:sent]
+        events = selectors.EVENT_READ | (selectors.EVENT_WRITE if pending else 0)
+        self.selector.modify(client, events, self.client_event)
+
+    def publish(self, frames):
+        if not frames:
+            return
+        samples = self.tables.update(frames)
+        encoded = []
+        for frame in frames:
+            sequence = frame.sequence if frame.sequence is not None else self.sequence
+            self.sequence = sequence + 1
+            record = encode_wire(frame, sequence)
+            encoded.append(record)
+            if self.store:
+                self.store.append(record, frame.timestamp)
+        self.frames += len(frames)
+        self.api.publish(frames, encoded, samples)
+        records = b"".join(encoded)
+        for client, pending in list(self.clients.items()):
+            if len(pending) > CLIENT_BACKLOG:
+                self.dropped += len(frames)
+                continue
+            was_empty = not pending
+            pending += records
+            if was_empty:
+                self.flush(client)
+
+    def poll(self, timeout):
+        for key, mask in self.selector.select(timeout):
+            key.data(key.fileobj, mask)
+        self.tables.tick(time.monotonic())
+        if self.store:
+            self.store.poll()
+
+
+def serial_source(daemon, port):
+    """Read the serial port forever."""
+    device = open_serial(port)
+    fd = device if isinstance(device, int) else device.fileno()
+    decoder = daemon.decoder = StreamDecoder()
+
+    def readable(fileobj, mask):
+        try:
+            data = os.read(fd, 65536)
+        except BlockingIOError:
+            return
+        frames, lines = decoder.feed(data)
+        daemon.publish(frames)
+        for line in lines:
+            print(line, flush=True)
+
+    daemon.selector.register(fd, selectors.EVENT_READ, readable)
+    run(daemon, lambda: True)
+
+
+def file_frames(path):
+    """Frames of a recorded capture, of an SD card log file or of a capture store."""
+    if os.path.isdir(path):
+        yield from can_store.read_store(path)
+        return
+    if path.upper().endswith(".LOG"):
+        for _, payload in can_log.read_blocks(path):
+            for sequence, timestamp, identifier, data in can_log.read_frames(payload):
+                yield Frame(timestamp, identifier, bytes(data), sequence)
+        return
+    decoder = StreamDecoder()
+    with (sys.stdin.buffer if path == "-" else open(path, "rb")) as f:
+        while True:
+            data = f.read(65536)
+            if not data:
+                return
+            frames, _ = decoder.feed(data)
+            yield from frames
+
+
+def file_source(daemon, path, realtime, loop):
+    """Serve a file, optionally paced by the frame timestamps."""
+    print("[daemon] waiting for a client on %s or %s" % (daemon.server.getsockname(), daemon.api.server.getsockname()),
+          file=sys.stderr)
+    while not daemon.clients and not daemon.api.sessions:
+        daemon.poll(0.5)
+    while True:
+        start_wall = None
+        batch = []
+        for frame in file_frames(path):
+            if realtime:
+                if start_wall is None:
+                    start_wall, last_ts, elapsed_us = time.monotonic(), frame.timestamp, 0
+                # 32-bit device timestamps wrap every 71.6 min: accumulate the deltas,
+                # ignoring frames slightly out of order
+                delta = (frame.timestamp - last_ts) & 0xFFFFFFFF
+                if delta < 0x80000000:
+                    elapsed_us += delta
+                    last_ts = frame.timestamp
+                due = start_wall + elapsed_us / 1e6
+                while time.monotonic() < due:
+                    daemon.publish(batch)
+                    batch = []
+                    daemon.poll(min(0.005, max(0.0, due - time.monotonic())))
+            batch.append(frame)
+            if len(batch) >= 256:
+                daemon.publish(batch)
+                batch = []
+                daemon.poll(0)
+        daemon.publish(batch)
+        if not loop:
+            break
+    # keep serving until the clients have received everything
+    run(daemon, lambda: any(daemon.clients.values()) or any(session.pending for session in daemon.api.sessions.values()))
+
+
+def run(daemon, keep_running):
+    last_stats, last_frames = time.monotonic(), 0
+    while keep_running():
+        daemon.poll(0.5)
+        now = time.monotonic()
+        if now - last_stats >= STATS_PERIOD:
+            print("[daemon] %.0f frames/s, %d clients, %d API sessions, %d client frames dropped%s" % (
+                (daemon.frames - last_frames) / (now - last_stats), len(daemon.clients), len(daemon.api.sessions),
+                daemon.dropped + daemon.api.dropped,
+                ", store: " + daemon.store.usage() if daemon.store else ""), file=sys.stderr)
+            last_stats, last_frames = now, daemon.frames
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--serial", help="sniffer serial port, e.g. /dev/ttyACM0")
+    source.add_argument("--file", help="capture file (text/binary output, SD card .LOG, - for stdin)")
+    parser.add_argument("--realtime", action="store_true", help="pace a file by its timestamps")
+    parser.add_argument("--loop", action="store_true", help="repeat a file forever")
+    parser.add_argument("--socket", default=DAEMON_SOCKET, help="Unix socket path (default %(default)s)")
+    parser.add_argument("--api-socket", default=can_api.DAEMON_API_SOCKET,
+                        help="query/subscription API socket path (default %(default)s)")
+    parser.add_argument("--signals", help="signal definitions (TOML, as dashboard.toml) for the API")
+    parser.add_argument("--store", help="also write the frames to a rotating capture store in this directory")
+    parser.add_argument("--segment-size", type=int, default=can_store.SEGMENT_SIZE >> 20,
+                        help="store segment file size in MiB (default %(default)s)")
+    parser.add_argument("--store-budget", type=int, default=1024, help="store size in MiB (default %(default)s)")
+    parser.add_argument("--max-age", type=float, default=0,
+                        help="delete store segments older than this many hours (default: size only)")
+    parser.add_argument("--direct", action="store_true", help="write the store with O_DIRECT (Linux)")
+    args = parser.parse_args()
+
+    store = None
+    if args.store:
+        store = can_store.SegmentStore(args.store, args.segment_size << 20, args.store_budget << 20,
+                                       args.max_age * 3600, args.direct)
+        print("[daemon] store %s: %s" % (args.store, store.recovery), file=sys.stderr)
+    daemon = Daemon(args.socket, args.api_socket, load_signals(args.signals) if args.signals else (), store)
+    try:
+        if args.serial:
+            serial_source(daemon, args.serial)
+        else:
+            file_source(daemon, args.file, args.realtime, args.loop)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        os.unlink(args.socket)
+        os.unlink(args.api_socket)
+        if store:
+            store.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,324 @@
+"""Configurable live dashboard of decoded CAN signals.
+
+The signals and the layout of the widgets are read from a TOML config file
+(see dashboard.toml). Frames come from the capture daemon (can_daemon.py),
+the configured signals are decoded with can_signals.py.
+
+Widgets:
+    gauge    analog gauge of one signal (min..max, optional redline)
+    digital  numeric display of one signal
+    plot     time plot of one or more signals over the last `span` seconds
+
+The widgets are refreshed refresh_hz times per second, but a widget is only
+repainted when what it shows changed: the needle moved by at least a step,
+the displayed digits changed, or a plot scrolled by a pixel or got new
+samples. Plots are decimated to one point per pixel column with LTTB, so
+dozens of signals cost little CPU.
+
+    python can_dashboard.py dashboard.toml [--socket PATH]
+
+Requires PyQt6.
+"""
+
+import argparse
+import math
+import sys
+import tomllib
+
+from PyQt6.QtCore import QPointF, QSocketNotifier, Qt, QTimer
+from PyQt6.QtGui import QColor, QFont, QPainter, QPen, QPolygonF
+from PyQt6.QtWidgets import QApplication, QGridLayout, QLabel, QLCDNumber, QVBoxLayout, QWidget
+
+from can_signals import Signal, SignalDecoder, SignalHistory, lttb
+from can_stream import DAEMON_SOCKET, StreamDecoder, connect_daemon
+
+REFRESH_HZ = 30             # default widget refresh rate
+GAUGE_STEPS = 540           # needle positions over the 270 degree scale
+READ_LIMIT = 1 << 18        # bytes read per socket notification at most
+PLOT_COLORS = ("#e04040", "#40c040", "#4080ff", "#e0c040", "#c040c0", "#40c0c0")
+
+
+class Dashboard:
+    """Latest values and histories of the configured signals."""
+
+    def __init__(self, signals):
+        self.signals = {signal.name: signal for signal in signals}
+        self.values = {}
+        self.histories = {}
+        self.now = 0.0  # time of the latest decoded sample
+        self.decoder = SignalDecoder(signals)
+
+    def history(self, name, span):
+        history = self.histories.get(name)
+        if history is None:
+            history = self.histories[name] = SignalHistory(span)
+        history.span = max(history.span, span)
+        return history
+
+    def ingest(self, frames):
+        values, histories = self.values, self.histories
+        for signal, t, value in self.decoder.decode(frames):
+            values[signal.name] = value
+            history = histories.get(signal.name)
+            if history is not None:
+                history.append(t, value)
+            self.now = t
+
+
+class DashWidget(QWidget):
+    """Base of the widgets: repaints only when state_key() changes."""
+
+    def __init__(self, dashboard, config):
+        super().__init__()
+        self.dashboard = dashboard
+        self.config = config
+        self._shown = None
+
+    def signal(self, name=None):
+        name = name or self.config["signal"]
+        if name not in self.dashboard.signals:
+            raise ValueError("widget uses unknown signal %r" % name)
+        return self.dashboard.signals[name]
+
+    def state_key(self):
+        raise NotImplementedError
+
+    def refresh(self):
+        key = self.state_key()
+        if key != self._shown:
+            self._shown = key
+            self.repaint_changed()
+
+    def repaint_changed(self):
+        self.update()
+
+
+class Gauge(DashWidget):
+    def __init__(self, dashboard, config):
+        super().__init__(dashboard, config)
+        self.source = self.signal()
+        self.minimum = config.get("min", self.source.minimum or 0)
+        self.maximum = config.get("max", self.source.maximum or 100)
+        self.redline = config.get("redline")
+        self.setMinimumSize(250, 250)
+
+    def fraction(self):
+        value = self.dashboard.values.get(self.source.name, self.minimum)
+        return max(0.0, min(1.0, (value - self.minimum) / ((self.maximum - self.minimum) or 1)))
+
+    def state_key(self):
+        return round(self.fraction() * GAUGE_STEPS)
+
+    def paintEvent(self, event):
+        p = QPainter(self)
+        p.setRenderHint(QPainter.RenderHint.Antialiasing)
+        p.fillRect(self.rect(), QColor(0, 0, 0))
+
+        cx, cy = self.width() / 2, self.height() / 2
+        r = min(cx, cy) * 0.8
+
+        p.setBrush(QColor(30, 30, 30))
+        p.setPen(Qt.PenStyle.NoPen)
+        p.drawEllipse(int(cx - r), int(cy - r), int(2 * r), int(2 * r))
+
+        # Tick marks and labels
+        p.setFont(QFont("Arial", 10))
+        for i in range(0, 9):
+            angle = math.radians(225 - i * 270 / 8)
+            x1, y1 = cx + (r - 15) * math.cos(angle), cy - (r - 15) * math.sin(angle)
+            x2, y2 = cx + r * math.cos(angle), cy - r * math.sin(angle)
+            p.setPen(QPen(Qt.GlobalColor.white, 2))
+            p.drawLine(int(x1), int(y1), int(x2), int(y2))
+            lx = cx + (r - 35) * math.cos(angle) - 10
+            ly = cy - (r - 35) * math.sin(angle) + 5
+            p.drawText(int(lx), int(ly), "%g" % round(self.minimum + (self.maximum - self.minimum) * i / 8, 1))
+
+        # Redline / warning zone
+        if self.redline is not None and self.redline < self.maximum:
+            red = (self.redline - self.minimum) / (self.maximum - self.minimum)
+            p.setPen(QPen(QColor(200, 0, 0), 6))
+            p.drawArc(int(cx - r), int(cy - r), int(2 * r), int(2 * r),
+                      int((225 - red * 270) * 16), int(-(270 - red * 270) * 16))
+
+        # Name and unit
+        p.setPen(QPen(Qt.GlobalColor.lightGray))
+        p.drawText(int(cx - r), int(cy + r * 0.45), int(2 * r), 20, Qt.AlignmentFlag.AlignCenter,
+                   "%s %s" % (self.source.name, self.source.unit))
+
+        # Needle
+        angle = math.radians(225 - self.state_key() / GAUGE_STEPS * 270)
+        nx, ny = cx + (r - 40) * math.cos(angle), cy - (r - 40) * math.sin(angle)
+        p.setPen(QPen(QColor(200, 0, 0), 4))
+        p.drawLine(int(cx), int(cy), int(nx), int(ny))
+
+        # Center cap
+        p.setBrush(QColor(255, 255, 255))
+        p.setPen(Qt.PenStyle.NoPen)
+        p.drawEllipse(int(cx - 5), int(cy - 5), 10, 10)
+
+
+class Digital(DashWidget):
+    def __init__(self, dashboard, config):
+        super().__init__(dashboard, config)
+        self.source = self.signal()
+        self.format = "%%.%df" % config.get("decimals", 0)
+        layout = QVBoxLayout(self)
+        label = QLabel("%s (%s):" % (self.source.name, self.source.unit) if self.source.unit else self.source.name)
+        label.setAlignment(Qt.AlignmentFlag.AlignCenter)
+        layout.addWidget(label)
+        self.lcd = QLCDNumber(self)
+        self.lcd.setDigitCount(config.get("digits", 6))
+        self.lcd.display("-")
+        layout.addWidget(self.lcd)
+
+    def state_key(self):
+        value = self.dashboard.values.get(self.source.name)
+        return None if value is None else self.format % value
+
+    def repaint_changed(self):
+        # QLCDNumber repaints itself
+        self.lcd.display(self._shown)
+
+
+class Plot(DashWidget):
+    MARGIN_LEFT, MARGIN_RIGHT, MARGIN_TOP, MARGIN_BOTTOM = 55, 10, 22, 20
+
+    def __init__(self, dashboard, config):
+        super().__init__(dashboard, config)
+        self.sources = [self.signal(name) for name in config["signals"]]
+        self.span = config.get("span", 30)
+        self.minimum = config.get("min")
+        self.maximum = config.get("max")
+        self.histories = [dashboard.history(source.name, self.span) for source in self.sources]
+        self.setMinimumSize(300, 150)
+
+    def plot_width(self):
+        return max(1, self.width() - self.MARGIN_LEFT - self.MARGIN_RIGHT)
+
+    def state_key(self):
+        # scrolled by a pixel or got new samples
+        pixel = self.span / self.plot_width()
+        return int(self.dashboard.now / pixel), tuple(h.last() for h in self.histories)
+
+    def paintEvent(self, event):
+        p = QPainter(self)
+        p.setRenderHint(QPainter.RenderHint.Antialiasing)
+        p.fillRect(self.rect(), QColor(0, 0, 0))
+        width = self.plot_width()
+        height = max(1, self.height() - self.MARGIN_TOP - self.MARGIN_BOTTOM)
+        left, top = self.MARGIN_LEFT, self.MARGIN_TOP
+
+        end = self.dashboard.now
+        begin = end - self.span
+        series = [lttb(*history.window(begin), width) for history in self.histories]
+
+        lo, hi = self.minimum, self.maximum
+        if lo is None or hi is None:
+            data = [v for _, values in series for v in values]
+            limits = [s.minimum for s in self.sources if s.minimum is not None], \
+                     [s.maximum for s in self.sources if s.maximum is not None]
+            if lo is None:
+                lo = min(limits[0]) if limits[0] else min(data, default=0.0)
+            if hi is None:
+                hi = max(limits[1]) if limits[1] else max(data, default=1.0)
+        if hi <= lo:
+            hi = lo + 1.0
+
+        p.setPen(QPen(QColor(90, 90, 90), 1))
+        p.drawRect(left, top, width, height)
+        p.setPen(QPen(Qt.GlobalColor.lightGray))
+        p.setFont(QFont("Arial", 8))
+        p.drawText(2, top + 8, "%.5g" % hi)
+        p.drawText(2, top + height, "%.5g" % lo)
+        p.drawText(left, top + height + 15, "-%g s" % self.span)
+        p.drawText(left + width - 10, top + height + 15, "0")
+
+        x_scale = width / self.span
+        y_scale = height / (hi - lo)
+        x_name = left
+        for index, (source, (times, values)) in enumerate(zip(self.sources, series)):
+            color = QColor(PLOT_COLORS[index % len(PLOT_COLORS)])
+            p.setPen(QPen(color))
+            name = "%s %s" % (source.name, source.unit)
+            p.drawText(x_name, top - 6, name)
+            x_name += p.fontMetrics().horizontalAdvance(name) + 15
+            if len(times) < 2:
+                continue
+            p.setPen(QPen(color, 1.5))
+            p.drawPolyline(QPolygonF([
+                QPointF(left + (t - begin) * x_scale,
+                        top + height - (min(max(v, lo), hi) - lo) * y_scale) for t, v in zip(times, values)]))
+
+
+WIDGET_TYPES = {"gauge": Gauge, "digital": Digital, "plot": Plot}
+
+
+class DashboardWindow(QWidget):
+    def __init__(self, config, sock):
+        super().__init__()
+        self.setWindowTitle(config.get("title", "CAN Dashboard"))
+        self.setStyleSheet("background-color: black; color: lightgray;")
+        signals = [Signal.from_config(name, entry) for name, entry in config.get("signals", {}).items()]
+        self.dashboard = Dashboard(signals)
+
+        grid = QGridLayout(self)
+        self.widgets = []
+        for index, entry in enumerate(config.get("widget", [])):
+            if entry.get("type") not in WIDGET_TYPES:
+                raise ValueError("widget %d: unknown type %r" % (index, entry.get("type")))
+            widget = WIDGET_TYPES[entry["type"]](self.dashboard, entry)
+            grid.addWidget(widget, entry.get("row", index), entry.get("column", 0),
+                           entry.get("row_span", 1), entry.get("column_span", 1))
+            self.widgets.append(widget)
+
+        self.sock = sock
+        self.stream = StreamDecoder()
+        sock.setblocking(False)
+        self.notifier = QSocketNotifier(sock.fileno(), QSocketNotifier.Type.Read, self)
+        self.notifier.activated.connect(self.read_daemon)
+
+        self.timer = QTimer(self, timeout=self.refresh)
+        self.timer.start(int(1000 / config.get("refresh_hz", REFRESH_HZ)))
+
+    def read_daemon(self):
+        received = 0
+        while received < READ_LIMIT:
+            try:
+                data = self.sock.recv(65536)
+            except BlockingIOError:
+                return
+            if not data:
+                self.notifier.setEnabled(False)
+                self.setWindowTitle(self.windowTitle() + " (capture daemon closed the connection)")
+                return
+            received += len(data)
+            frames, _ = self.stream.feed(data)
+            self.dashboard.ingest(frames)
+
+    def refresh(self):
+        for widget in self.widgets:
+            widget.refresh()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("config", help="dashboard config file (TOML)")
+    parser.add_argument("--socket", default=DAEMON_SOCKET, help="capture daemon socket (default %(default)s)")
+    args = parser.parse_args()
+
+    with open(args.config, "rb") as f:
+        config = tomllib.load(f)
+    try:
+        sock = connect_daemon(args.socket)
+    except OSError as error:
+        print("Cannot connect to the capture daemon at %s: %s" % (args.socket, error), file=sys.stderr)
+        return 1
+
+    app = QApplication(sys.argv)
+    window = DashboardWindow(config, sock)
+    window.show()
+    return app.exec()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
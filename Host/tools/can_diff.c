@@ -0,0 +1,460 @@
+/**
+ * @file can_diff.c
+ * @brief Host tool: find the payload bits that tell two or more recorded scenarios apart.
+ *
+ * @details
+ * Record the same bus in each state of what you are looking for ("door
+ * closed" / "door open", "lights off" / "lights on", ...), one capture per
+ * scenario, and let the tool rank every bit of every CAN ID by how well it
+ * separates the scenarios.
+ *
+ * Each scenario is read by its own thread in a single streaming pass, which
+ * keeps per ID the frame count and, per bit, the frames with the bit set and
+ * the bit flips between consecutive frames. A bit then has a share of 1s in
+ * each scenario, and its score is the share of its variance explained by the
+ * scenario (eta squared, every scenario weighted equally whatever its
+ * length): 1 for a bit that is constant within each scenario and differs
+ * between them, 0 for a bit that does not depend on the scenario, and low
+ * for a counter, checksum or fast signal bit that toggles within every
+ * scenario.
+ *
+ * Bits scoring at least --min-score are grouped into fields of adjacent
+ * bits (DBC little-endian numbering: bit b is bit b % 8 of byte b / 8), which
+ * are ranked by their best bit. For every scenario the field is shown MSB
+ * first, a bit being 0 or 1 when it has that value in at least
+ * 1 - STABLE_SHARE of the frames, ~ otherwise, with the flips per frame of
+ * the field. IDs that appear in some scenarios only, or whose frame rate
+ * changes by RATE_RATIO or more, are listed as well (frames sent on an
+ * event, or a gateway waking up).
+ *
+ * A scenario is one or more capture files (any format read by
+ * can_capture.c) read in order, optionally named: [name=]file[,file...].
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -IHost/stubs -IMy_Modules/Drivers/can -IMy_Modules/Drivers/debug
+ *       -IMy_Modules/Drivers/stdio -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp
+ *       -IMy_Modules/Features/logger Host/tools/can_diff.c Host/tools/can_capture.c
+ *       My_Modules/Drivers/can/my_can_wire.c My_Modules/Features/logger/can_logger.c
+ *       My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/stdio/my_stdio.c
+ *       My_Modules/Drivers/uart/my_uart.c -lpthread -o can_diff
+ *   ./can_diff closed=door_closed.bin open=door_open.bin
+ *   ./can_diff --top 10 --min-score 0.8 off=CAN00001.LOG low=CAN00002.LOG high=CAN00003.LOG,CAN00004.LOG
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "can_capture.h"
+
+/**
+ * @def MAX_IDS
+ * @brief Number of distinct CAN IDs a scenario may contain.
+ */
+#define MAX_IDS 4096
+
+/**
+ * @def MAX_SCENARIOS
+ * @brief Number of scenarios compared at most.
+ */
+#define MAX_SCENARIOS 16
+
+/**
+ * @def MIN_FRAMES
+ * @brief Frames of an ID needed in every scenario before its bits are scored.
+ */
+#define MIN_FRAMES 10
+
+/**
+ * @def STABLE_SHARE
+ * @brief Share of frames with the other value below which a bit is shown as constant.
+ */
+#define STABLE_SHARE 0.05
+
+/**
+ * @def RATE_RATIO
+ * @brief Frame rate ratio between two scenarios from which an ID is listed.
+ */
+#define RATE_RATIO 1.5
+
+/**
+ * @def DEFAULT_TOP
+ * @brief Fields printed by default.
+ */
+#define DEFAULT_TOP 20
+
+/**
+ * @def DEFAULT_MIN_SCORE
+ * @brief Default score from which a bit is part of a candidate field.
+ */
+#define DEFAULT_MIN_SCORE 0.5
+
+/**
+ * @struct id_Stats
+ * @brief Streaming statistics of one CAN ID in one scenario.
+ *
+ * @details
+ * transitions counts the frames that follow a frame of the same ID, over
+ * which flips are counted.
+ */
+typedef struct {
+	uint32_t identifier;
+	uint8_t max_bytes;
+	bool started;
+	uint64_t frames;
+	uint64_t transitions;
+	uint64_t last_data;
+	uint64_t ones[64];
+	uint64_t flips[64];
+} id_Stats;
+
+/**
+ * @struct scenario_State
+ * @brief Files and statistics of one scenario, filled by its reader thread.
+ */
+typedef struct {
+	char name[32];
+	char* files;
+	bool failed;
+	can_Capture capture;
+	id_Stats* stats;
+	uint32_t stats_count;
+	uint32_t dropped_ids;
+	uint32_t id_table[2 * MAX_IDS];
+} scenario_State;
+
+/**
+ * @struct diff_Field
+ * @brief Adjacent scoring bits of one ID.
+ */
+typedef struct {
+	uint32_t identifier;
+	uint8_t start;
+	uint8_t length;
+	double score;
+} diff_Field;
+
+/**
+ * @var scenarios
+ * @brief State of every scenario.
+ */
+static scenario_State scenarios[MAX_SCENARIOS];
+
+/**
+ * @var scenario_count
+ * @brief Number of scenarios.
+ */
+static int scenario_count = 0;
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+
+/**
+ * @fn static id_Stats* find_stats(scenario_State* scenario, uint32_t identifier, bool create)
+ * @brief Statistics of a CAN ID in a scenario, created on first use if create
+ * 		  (NULL if absent or MAX_IDS is exceeded).
+ */
+static id_Stats* find_stats(scenario_State* scenario, uint32_t identifier, bool create) {
+	uint32_t slot = (identifier * 2654435761UL) % (2 * MAX_IDS);
+	while (scenario->id_table[slot] != 0) {
+		id_Stats* s = &scenario->stats[scenario->id_table[slot] - 1];
+		if (s->identifier == identifier) return s;
+		slot = (slot + 1) % (2 * MAX_IDS);
+	}
+	if (!create) return NULL;
+	if (scenario->stats_count == MAX_IDS) {
+		scenario->dropped_ids++;
+		return NULL;
+	}
+	id_Stats* s = &scenario->stats[scenario->stats_count++];
+	scenario->id_table[slot] = scenario->stats_count;
+	s->identifier = identifier;
+	return s;
+}
+
+/**
+ * @fn static void add_frame(const my_CAN_Frame* frame, uint64_t time_us, void* context)
+ * @brief Update the statistics of the frame's ID in its scenario (can_Capture_Callback).
+ */
+static void add_frame(const my_CAN_Frame* frame, uint64_t time_us, void* context) {
+	(void)time_us;
+	scenario_State* scenario = context;
+	id_Stats* s = find_stats(scenario, frame->Identifier, true);
+	if (s == NULL) return;
+	const uint8_t length = (frame->DataLength > 8) ? 8 : frame->DataLength;
+	uint64_t data = 0;
+	memcpy(&data, frame->Data, length);
+
+	s->frames++;
+	if (length > s->max_bytes) s->max_bytes = length;
+	for (uint64_t bits = data; bits != 0; bits &= bits - 1) {
+		s->ones[__builtin_ctzll(bits)]++;
+	}
+	if (s->started) {
+		s->transitions++;
+		for (uint64_t bits = data ^ s->last_data; bits != 0; bits &= bits - 1) {
+			s->flips[__builtin_ctzll(bits)]++;
+		}
+	}
+	s->started = true;
+	s->last_data = data;
+}
+
+/**
+ * @fn static void* read_scenario(void* argument)
+ * @brief Thread: read the files of a scenario.
+ */
+static void* read_scenario(void* argument) {
+	scenario_State* scenario = argument;
+	can_capture_init(&scenario->capture, add_frame, scenario);
+	char* rest = scenario->files;
+	while (rest != NULL && !scenario->failed) {
+		char* file = rest;
+		rest = strchr(rest, ',');
+		if (rest != NULL) *rest++ = '\0';
+		if (!can_capture_read(&scenario->capture, file)) {
+			fprintf(stderr, "Cannot read the capture %s\n", file);
+			scenario->failed = true;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @fn static double share_of_ones(const id_Stats* s, int bit)
+ * @brief Share of the frames of an ID with a bit set.
+ */
+static double share_of_ones(const id_Stats* s, int bit) {
+	return (double)s->ones[bit] / (double)s->frames;
+}
+
+/**
+ * @fn static double bit_score(id_Stats* const* per_scenario, int bit)
+ * @brief Share of the variance of a bit explained by the scenario (eta squared),
+ * 		  every scenario weighted equally.
+ */
+static double bit_score(id_Stats* const* per_scenario, int bit) {
+	double mean = 0.0;
+	double within = 0.0;
+	for (int i = 0; i < scenario_count; i++) {
+		double p = share_of_ones(per_scenario[i], bit);
+		mean += p;
+		within += p * (1.0 - p);
+	}
+	mean /= scenario_count;
+	within /= scenario_count;
+	double between = 0.0;
+	for (int i = 0; i < scenario_count; i++) {
+		double d = share_of_ones(per_scenario[i], bit) - mean;
+		between += d * d;
+	}
+	between /= scenario_count;
+	return (between + within > 0.0) ? between / (between + within) : 0.0;
+}
+
+/**
+ * @fn static double frame_rate(const scenario_State* scenario, const id_Stats* s)
+ * @brief Frames per second of an ID over its scenario.
+ */
+static double frame_rate(const scenario_State* scenario, const id_Stats* s) {
+	double seconds = scenario->capture.last_us / 1e6;
+	return (s != NULL && seconds > 0.0) ? s->frames / seconds : 0.0;
+}
+
+/**
+ * @fn static int compare_fields(const void* a, const void* b)
+ * @brief Order by decreasing score, then by CAN ID and start bit.
+ */
+static int compare_fields(const void* a, const void* b) {
+	const diff_Field* x = a;
+	const diff_Field* y = b;
+	if (x->score != y->score) return (x->score < y->score) - (x->score > y->score);
+	if (x->identifier != y->identifier) return (x->identifier > y->identifier) - (x->identifier < y->identifier);
+	return x->start - y->start;
+}
+
+/**
+ * @fn static void print_pattern(const id_Stats* s, const diff_Field* field)
+ * @brief Bits of a field in one scenario, MSB first, and its flips per frame.
+ */
+static void print_pattern(const id_Stats* s, const diff_Field* field) {
+	char pattern[65];
+	uint64_t flips = 0;
+	for (int i = 0; i < field->length; i++) {
+		int bit = field->start + field->length - 1 - i;
+		double p = share_of_ones(s, bit);
+		pattern[i] = (p <= STABLE_SHARE) ? '0' : (p >= 1.0 - STABLE_SHARE) ? '1' : '~';
+		flips += s->flips[bit];
+	}
+	pattern[field->length] = '\0';
+	printf("  %*s %5.2f", field->length < 12 ? 12 : field->length, pattern,
+		   s->transitions ? (double)flips / s->transitions : 0.0);
+}
+
+/**
+ * @fn static void print_rates(void)
+ * @brief IDs missing from a scenario or whose frame rate changes between scenarios.
+ */
+static void print_rates(void) {
+	bool header = false;
+	for (int i = 0; i < scenario_count; i++) {
+		for (uint32_t k = 0; k < scenarios[i].stats_count; k++) {
+			uint32_t identifier = scenarios[i].stats[k].identifier;
+			/* list each ID once, from the first scenario that has it */
+			bool seen_before = false;
+			for (int j = 0; j < i; j++) {
+				if (find_stats(&scenarios[j], identifier, false) != NULL) seen_before = true;
+			}
+			if (seen_before) continue;
+
+			double low = -1.0, high = 0.0;
+			for (int j = 0; j < scenario_count; j++) {
+				double rate = frame_rate(&scenarios[j], find_stats(&scenarios[j], identifier, false));
+				if (low < 0.0 || rate < low) low = rate;
+				if (rate > high) high = rate;
+			}
+			if (high < low * RATE_RATIO) continue;
+			if (!header) {
+				printf("\nIDs whose frame rate (frames/s) depends on the scenario:\n%-10s", "ID");
+				for (int j = 0; j < scenario_count; j++) printf(" %12s", scenarios[j].name);
+				printf("\n");
+				header = true;
+			}
+			printf("0x%-8lX", (unsigned long)identifier);
+			for (int j = 0; j < scenario_count; j++) {
+				printf(" %12.2f", frame_rate(&scenarios[j], find_stats(&scenarios[j], identifier, false)));
+			}
+			printf("\n");
+		}
+	}
+}
+
+/**
+ * @fn static void usage(void)
+ * @brief Print the command line help.
+ */
+static void usage(void) {
+	printf("Usage: can_diff [--top N] [--min-score S] [name=]capture[,capture...] [name=]capture[,capture...] ...\n");
+}
+
+int main(int argc, char** argv) {
+	int top = DEFAULT_TOP;
+	double min_score = DEFAULT_MIN_SCORE;
+
+	for (int arg = 1; arg < argc; arg++) {
+		if (strcmp(argv[arg], "--top") == 0 && arg + 1 < argc) {
+			top = atoi(argv[++arg]);
+		} else if (strcmp(argv[arg], "--min-score") == 0 && arg + 1 < argc) {
+			min_score = atof(argv[++arg]);
+		} else if (argv[arg][0] == '-') {
+			usage();
+			return 1;
+		} else if (scenario_count == MAX_SCENARIOS) {
+			fprintf(stderr, "At most %d scenarios\n", MAX_SCENARIOS);
+			return 1;
+		} else {
+			scenario_State* scenario = &scenarios[scenario_count];
+			char* equals = strchr(argv[arg], '=');
+			if (equals != NULL) {
+				*equals = '\0';
+				snprintf(scenario->name, sizeof(scenario->name), "%s", argv[arg]);
+				scenario->files = equals + 1;
+			} else {
+				snprintf(scenario->name, sizeof(scenario->name), "%c", 'A' + scenario_count);
+				scenario->files = argv[arg];
+			}
+			scenario->stats = calloc(MAX_IDS, sizeof(id_Stats));
+			if (scenario->stats == NULL) {
+				fprintf(stderr, "Out of memory\n");
+				return 1;
+			}
+			scenario_count++;
+		}
+	}
+	if (scenario_count < 2) {
+		usage();
+		return 1;
+	}
+
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	pthread_t threads[MAX_SCENARIOS];
+	for (int i = 0; i < scenario_count; i++) {
+		if (pthread_create(&threads[i], NULL, read_scenario, &scenarios[i]) != 0) {
+			fprintf(stderr, "Cannot start a reader thread\n");
+			return 1;
+		}
+	}
+	uint64_t total_frames = 0;
+	bool failed = false;
+	for (int i = 0; i < scenario_count; i++) {
+		pthread_join(threads[i], NULL);
+		failed |= scenarios[i].failed;
+		total_frames += scenarios[i].capture.frames;
+	}
+	if (failed) return 1;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9;
+	for (int i = 0; i < scenario_count; i++) {
+		fprintf(stderr, "%s: %llu frames, %lu IDs over %.1f s%s\n", scenarios[i].name,
+				(unsigned long long)scenarios[i].capture.frames, (unsigned long)scenarios[i].stats_count,
+				scenarios[i].capture.last_us / 1e6, scenarios[i].dropped_ids ? " (MAX_IDS exceeded)" : "");
+	}
+	fprintf(stderr, "Read in %.2f s (%.0f frames/s)\n", elapsed, total_frames / (elapsed > 0 ? elapsed : 1));
+
+	/* Score the bits of the IDs present in every scenario, group them into fields */
+	diff_Field* fields = malloc(MAX_IDS * 32 * sizeof(diff_Field));
+	if (fields == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	uint32_t field_count = 0;
+	for (uint32_t k = 0; k < scenarios[0].stats_count; k++) {
+		id_Stats* per_scenario[MAX_SCENARIOS];
+		uint32_t identifier = scenarios[0].stats[k].identifier;
+		int bits = 64;
+		bool usable = true;
+		for (int i = 0; i < scenario_count && usable; i++) {
+			per_scenario[i] = find_stats(&scenarios[i], identifier, false);
+			usable = (per_scenario[i] != NULL && per_scenario[i]->frames >= MIN_FRAMES);
+			if (usable && per_scenario[i]->max_bytes * 8 < bits) bits = per_scenario[i]->max_bytes * 8;
+		}
+		if (!usable) continue;
+
+		diff_Field* field = NULL;
+		for (int bit = 0; bit < bits; bit++) {
+			double score = bit_score(per_scenario, bit);
+			if (score < min_score) {
+				field = NULL;
+				continue;
+			}
+			if (field == NULL) {
+				field = &fields[field_count++];
+				*field = (diff_Field){.identifier = identifier, .start = (uint8_t)bit, .length = 0, .score = 0.0};
+			}
+			field->length++;
+			if (score > field->score) field->score = score;
+		}
+	}
+	qsort(fields, field_count, sizeof(diff_Field), compare_fields);
+
+	printf("%-4s %-10s %-9s %-6s", "Rank", "ID", "Start/len", "Score");
+	for (int i = 0; i < scenario_count; i++) printf("  %12s %5s", scenarios[i].name, "flips");
+	printf("\n");
+	for (uint32_t f = 0; f < field_count && (int)f < top; f++) {
+		const diff_Field* field = &fields[f];
+		char position[16];
+		snprintf(position, sizeof(position), "%u/%u", field->start, field->length);
+		printf("%-4lu 0x%-8lX %-9s %6.3f", (unsigned long)f + 1, (unsigned long)field->identifier, position, field->score);
+		for (int i = 0; i < scenario_count; i++) {
+			print_pattern(find_stats(&scenarios[i], field->identifier, false), field);
+		}
+		printf("\n");
+	}
+	if (field_count == 0) printf("No bit scores %.2f or more\n", min_score);
+	print_rates();
+
+	free(fields);
+	for (int i = 0; i < scenario_count; i++) free(scenarios[i].stats);
+	return 0;
+}
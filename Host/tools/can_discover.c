@@ -0,0 +1,725 @@
+/**
+ * @file can_discover.c
+ * @brief Host tool: find the payload bit field that carries a known signal.
+ *
+ * @details
+ * Takes a capture and a reference time series of the wanted signal (GPS
+ * speed, RPM logged by a scan tool, ...) and ranks every candidate bit field
+ * of every CAN ID by its correlation with the reference:
+ *   - start bit 0..63 x length 1..MAX_FIELD_LENGTH
+ *   - little-endian (Intel) and big-endian (Motorola, DBC start bit = MSB)
+ *   - unsigned and two's complement signed
+ *
+ * The reference and the payloads of each ID (sample and hold) are resampled
+ * on a common time grid (--rate). The correlation of a field follows from
+ * the means and covariances of its bits, so each ID needs one pass over the
+ * grid per bit (SIMD reductions and popcounts over bit planes), after which
+ * every field costs O(length). The IDs are shared out between worker
+ * threads. A field whose first or last bit never changes is skipped, since a
+ * shorter field gives the same correlation, and so is a field spanning a
+ * run of constant bits (MAX_CONSTANT_RUN). The best fields are then refined over
+ * time lags of up to --max-lag seconds, to absorb a clock offset between the
+ * reference and the capture. The scale and offset of a least-squares fit
+ * make the result directly usable as a dashboard.toml signal.
+ *
+ * Reference: CSV with a time (s) and a value column (other lines, e.g. a
+ * header, are skipped); its first sample is at capture time --offset (s
+ * after the first frame). With --events, one time (s) per line, taken as a
+ * state that is 0 at time 0 (= capture time --offset) and toggles at each
+ * event (e.g. pedal pressed/released).
+ *
+ * Capture: one or more files read in order by can_capture.c (binary wire
+ * record streams or SD card CAN<nnnnn>.LOG files).
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O3 -march=native -fopenmp-simd -IHost/stubs -IMy_Modules/Drivers/can
+ *       -IMy_Modules/Drivers/debug -IMy_Modules/Drivers/stdio -IMy_Modules/Drivers/uart
+ *       -IMy_Modules/Drivers/timestamp -IMy_Modules/Features/logger Host/tools/can_discover.c
+ *       Host/tools/can_capture.c My_Modules/Drivers/can/my_can_wire.c My_Modules/Features/logger/can_logger.c
+ *       My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/stdio/my_stdio.c
+ *       My_Modules/Drivers/uart/my_uart.c -lpthread -lm -o can_discover
+ *   ./can_discover [options] speed.csv capture.bin
+ *   ./can_discover --events --offset 12.5 brake_events.txt CAN00003.LOG CAN00004.LOG
+ */
+
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "can_capture.h"
+
+/**
+ * @def MAX_IDS
+ * @brief Number of distinct CAN IDs a capture may contain.
+ */
+#define MAX_IDS 4096
+
+/**
+ * @def MAX_FIELD_LENGTH
+ * @brief Longest candidate field in bits.
+ */
+#define MAX_FIELD_LENGTH 32
+
+/**
+ * @def MAX_CONSTANT_RUN
+ * @brief Longest run of never changing bits a candidate field may contain.
+ *
+ * @details
+ * A signal whose MSB changes also changes its lower bits, while a longer
+ * constant run is the gap between two fields (e.g. a signal and a counter
+ * bits below it, which would barely lower the correlation).
+ */
+#define MAX_CONSTANT_RUN 4
+
+/**
+ * @struct id_Series
+ * @brief Payloads of one CAN ID resampled on the time grid.
+ *
+ * @details
+ * points[k] is the payload (little-endian, zero padded) of the last frame at
+ * or before grid point k. Points first_point .. next_point-1 are valid.
+ */
+typedef struct {
+	uint32_t identifier;
+	uint32_t frames;
+	uint8_t max_bytes;
+	bool seen;
+	uint64_t last_data;
+	uint32_t first_point;
+	uint32_t next_point;
+	uint64_t* points;
+} id_Series;
+
+/**
+ * @struct field_Result
+ * @brief Correlation of one candidate field with the reference.
+ *
+ * @details
+ * start is the DBC start bit (the LSB for little-endian, the MSB for
+ * big-endian). bits is the mask of the field in the little-endian payload.
+ */
+typedef struct {
+	uint32_t series;
+	uint8_t start;
+	uint8_t length;
+	bool big_endian;
+	bool is_signed;
+	double r;
+	double scale;
+	double offset;
+	uint64_t bits;
+	int lag;
+	double lag_r;
+} field_Result;
+
+/**
+ * @struct result_List
+ * @brief Growable array of results (one per worker thread).
+ */
+typedef struct {
+	field_Result* items;
+	size_t count;
+	size_t capacity;
+	uint64_t evaluated;
+} result_List;
+
+/**
+ * @struct bit_Statistics
+ * @brief Statistics of the payload bits of one ID over the grid.
+ *
+ * @details
+ * planes holds 64 bit planes (bit b of every grid point) used to compute
+ * them. covariance and reference_covariance are divided by the number of
+ * points. Constant bits have covariance 0 and are left out of planes.
+ */
+typedef struct {
+	uint64_t* planes;
+	double mean[64];
+	double covariance[64][64];
+	double reference_covariance[64];
+} bit_Statistics;
+
+/**
+ * @var series
+ * @brief Resampled payloads of every CAN ID of the capture.
+ */
+static id_Series series[MAX_IDS];
+
+/**
+ * @var series_count
+ * @brief Number of used entries of series.
+ */
+static uint32_t series_count = 0;
+
+/**
+ * @var id_table
+ * @brief Open addressing hash table: CAN ID -> series index + 1 (0 = free).
+ */
+static uint32_t id_table[2 * MAX_IDS];
+
+/**
+ * @var reference
+ * @brief Reference value at each grid point.
+ */
+static double* reference = NULL;
+
+/**
+ * @var reference_sum
+ * @brief Prefix sums of reference (index k = sum of points 0..k-1).
+ */
+static double* reference_sum = NULL;
+
+/**
+ * @var reference_square_sum
+ * @brief Prefix sums of the square of reference.
+ */
+static double* reference_square_sum = NULL;
+
+/**
+ * @var grid_points
+ * @brief Number of grid points (covering the reference).
+ */
+static uint32_t grid_points = 0;
+
+/**
+ * @var grid_rate
+ * @brief Grid points per second.
+ */
+static double grid_rate = 10.0;
+
+/**
+ * @var grid_start
+ * @brief Capture time (s after the first frame) of grid point 0.
+ */
+static double grid_start = 0.0;
+
+/**
+ * @var next_series
+ * @brief Next series to be taken by a worker thread.
+ */
+static uint32_t next_series = 0;
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+
+/**
+ * @fn static double now_s(void)
+ * @brief Monotonic time in seconds.
+ */
+static double now_s(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @fn static void* checked_calloc(size_t count, size_t size)
+ * @brief calloc() that exits when out of memory.
+ */
+static void* checked_calloc(size_t count, size_t size) {
+	void* memory = calloc(count, size);
+	if (memory == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	return memory;
+}
+
+/**
+ * @fn static double* load_reference(const char* path, bool events, int column, uint32_t* count)
+ * @brief Read the reference as (time, value) pairs.
+ *
+ * @details
+ * CSV times are made relative to the first sample. Event times are kept, so
+ * time 0 is the start of the grid and the state is 0 until the first event.
+ */
+static double* load_reference(const char* path, bool events, int column, uint32_t* count) {
+	FILE* file = fopen(path, "r");
+	if (file == NULL) return NULL;
+
+	size_t capacity = 1024;
+	double* pairs = checked_calloc(2 * capacity, sizeof(double));
+	char line[512];
+	uint32_t n = 0;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		double fields[16];
+		int found = 0;
+		char* cursor = line;
+		while (found < 16) {
+			char* end;
+			double value = strtod(cursor, &end);
+			if (end == cursor) break;
+			fields[found++] = value;
+			cursor = end + strspn(end, ",; \t");
+		}
+		double t, value;
+		if (events) {
+			if (found < 1) continue;
+			t = fields[0];
+			value = (double)((n + 1) % 2);
+		} else {
+			if (found <= column) continue;
+			t = fields[0];
+			value = fields[column];
+		}
+		if (n == capacity) {
+			capacity *= 2;
+			pairs = realloc(pairs, 2 * capacity * sizeof(double));
+			if (pairs == NULL) exit(1);
+		}
+		pairs[2 * n] = t;
+		pairs[2 * n + 1] = value;
+		n++;
+	}
+	fclose(file);
+
+	for (uint32_t i = 1; i < n && !events; i++) {
+		pairs[2 * i] -= pairs[0];
+	}
+	if (n > 0 && !events) pairs[0] = 0.0;
+	*count = n;
+	return pairs;
+}
+
+/**
+ * @fn static void build_grid(const double* pairs, uint32_t count, bool events)
+ * @brief Resample the reference on the grid (linear, or held for events).
+ */
+static void build_grid(const double* pairs, uint32_t count, bool events) {
+	grid_points = (uint32_t)(pairs[2 * (count - 1)] * grid_rate) + 1;
+	reference = checked_calloc(grid_points, sizeof(double));
+	reference_sum = checked_calloc(grid_points + 1, sizeof(double));
+	reference_square_sum = checked_calloc(grid_points + 1, sizeof(double));
+
+	uint32_t i = 0;
+	for (uint32_t k = 0; k < grid_points; k++) {
+		double t = k / grid_rate;
+		while (i + 1 < count && pairs[2 * (i + 1)] <= t) i++;
+		if (events || i + 1 == count) {
+			reference[k] = pairs[2 * i + 1];
+		} else {
+			double t0 = pairs[2 * i], t1 = pairs[2 * (i + 1)];
+			double w = (t1 > t0) ? (t - t0) / (t1 - t0) : 0.0;
+			reference[k] = pairs[2 * i + 1] + w * (pairs[2 * (i + 1) + 1] - pairs[2 * i + 1]);
+		}
+		if (events && t < pairs[0]) reference[k] = 0.0;
+		reference_sum[k + 1] = reference_sum[k] + reference[k];
+		reference_square_sum[k + 1] = reference_square_sum[k] + reference[k] * reference[k];
+	}
+}
+
+/**
+ * @fn static id_Series* find_series(uint32_t identifier)
+ * @brief Series of a CAN ID, created on first use (NULL if MAX_IDS is exceeded).
+ */
+static id_Series* find_series(uint32_t identifier) {
+	uint32_t slot = (identifier * 2654435761UL) % (2 * MAX_IDS);
+	while (id_table[slot] != 0) {
+		id_Series* s = &series[id_table[slot] - 1];
+		if (s->identifier == identifier) return s;
+		slot = (slot + 1) % (2 * MAX_IDS);
+	}
+	if (series_count == MAX_IDS) return NULL;
+	id_Series* s = &series[series_count++];
+	id_table[slot] = series_count;
+	s->identifier = identifier;
+	s->points = checked_calloc(grid_points, sizeof(uint64_t));
+	return s;
+}
+
+/**
+ * @fn static void hold_until(id_Series* s, double t)
+ * @brief Fill the grid points before capture time t with the last payload.
+ */
+static void hold_until(id_Series* s, double t) {
+	while (s->next_point < grid_points && grid_start + s->next_point / grid_rate < t) {
+		s->points[s->next_point++] = s->last_data;
+	}
+}
+
+/**
+ * @fn static void add_frame(const my_CAN_Frame* frame, uint64_t time_us, void* context)
+ * @brief Resample one captured frame onto its ID's grid (can_Capture_Callback).
+ */
+static void add_frame(const my_CAN_Frame* frame, uint64_t time_us, void* context) {
+	(void)context;
+	double t = time_us / 1e6;
+	id_Series* s = find_series(frame->Identifier);
+	if (s == NULL) return;
+	uint64_t data = 0;
+	uint8_t length = (frame->DataLength > 8) ? 8 : frame->DataLength;
+	for (int i = 0; i < length; i++) {
+		data |= (uint64_t)frame->Data[i] << (8 * i);
+	}
+	if (!s->seen) {
+		double first = ceil((t - grid_start) * grid_rate);
+		s->first_point = s->next_point = (first < 0) ? 0 : (first > grid_points ? grid_points : (uint32_t)first);
+		s->seen = true;
+	} else {
+		hold_until(s, t);
+	}
+	s->last_data = data;
+	if (length > s->max_bytes) s->max_bytes = length;
+	s->frames++;
+}
+
+/**
+ * @fn static void add_result(result_List* list, const field_Result* result)
+ * @brief Append to a worker's result list.
+ */
+static void add_result(result_List* list, const field_Result* result) {
+	if (list->count == list->capacity) {
+		list->capacity = list->capacity ? 2 * list->capacity : 4096;
+		list->items = realloc(list->items, list->capacity * sizeof(field_Result));
+		if (list->items == NULL) exit(1);
+	}
+	list->items[list->count++] = *result;
+}
+
+/**
+ * @fn static void bit_statistics(const id_Series* s, uint64_t varying, bit_Statistics* stats)
+ * @brief Bit means, bit covariances and bit-reference covariances of one ID.
+ *
+ * @details
+ * The payload bits are transposed into bit planes (one bit per grid point),
+ * so the co-occurrence of two bits is a popcount of the AND of their planes.
+ */
+static void bit_statistics(const id_Series* s, uint64_t varying, bit_Statistics* stats) {
+	const uint32_t first = s->first_point;
+	const uint32_t n = s->next_point - first;
+	const uint32_t words = (n + 63) / 64;
+	const double* y = &reference[first];
+	const double mean_y = (reference_sum[first + n] - reference_sum[first]) / n;
+
+	memset(stats->planes, 0, 64 * words * sizeof(uint64_t));
+	for (uint32_t k = 0; k < n; k++) {
+		uint64_t bits = s->points[first + k] & varying;
+		while (bits != 0) {
+			int bit = __builtin_ctzll(bits);
+			stats->planes[bit * words + k / 64] |= 1ULL << (k % 64);
+			bits &= bits - 1;
+		}
+	}
+
+	memset(stats->covariance, 0, sizeof(stats->covariance));
+	for (int b = 0; b < 64; b++) {
+		stats->reference_covariance[b] = 0.0;
+		if (!((varying >> b) & 1)) {
+			stats->mean[b] = (double)((s->points[first] >> b) & 1);
+			continue;
+		}
+		const uint64_t* plane = &stats->planes[b * words];
+		uint64_t count = 0;
+		for (uint32_t w = 0; w < words; w++) count += __builtin_popcountll(plane[w]);
+		stats->mean[b] = (double)count / n;
+
+		double sum = 0.0;
+		const uint64_t* points = &s->points[first];
+		#pragma omp simd reduction(+:sum)
+		for (uint32_t k = 0; k < n; k++) {
+			sum += (double)((points[k] >> b) & 1) * y[k];
+		}
+		stats->reference_covariance[b] = sum / n - stats->mean[b] * mean_y;
+	}
+	for (int b = 0; b < 64; b++) {
+		if (!((varying >> b) & 1)) continue;
+		const uint64_t* plane_b = &stats->planes[b * words];
+		for (int c = b; c < 64; c++) {
+			if (!((varying >> c) & 1)) continue;
+			const uint64_t* plane_c = &stats->planes[c * words];
+			uint64_t both = 0;
+			#pragma omp simd reduction(+:both)
+			for (uint32_t w = 0; w < words; w++) {
+				both += __builtin_popcountll(plane_b[w] & plane_c[w]);
+			}
+			double covariance = (double)both / n - stats->mean[b] * stats->mean[c];
+			stats->covariance[b][c] = stats->covariance[c][b] = covariance;
+		}
+	}
+}
+
+/**
+ * @fn static void evaluate_series(uint32_t index, bit_Statistics* stats, result_List* list)
+ * @brief Correlate every candidate field of one ID with the reference.
+ *
+ * @details
+ * A field is x = sum of w_j * bit_j with w_j = 2^j (and -2^(length-1) for the
+ * MSB when signed), so its mean, variance and covariance with the reference
+ * are linear and quadratic forms of the bit statistics. Fields are grown one
+ * bit at a time from each LSB towards the MSB (increasing bit index for
+ * little-endian, decreasing transmission order for big-endian), which
+ * updates the variance in O(length).
+ */
+static void evaluate_series(uint32_t index, bit_Statistics* stats, result_List* list) {
+	const id_Series* s = &series[index];
+	const uint32_t first = s->first_point;
+	const uint32_t end = s->next_point;
+	const double n = end - first;
+	if (end < first + 3) return;
+
+	const double sy = reference_sum[end] - reference_sum[first];
+	const double mean_y = sy / n;
+	const double var_y = (reference_square_sum[end] - reference_square_sum[first]) / n - mean_y * mean_y;
+	if (var_y <= 0.0) return;
+
+	uint64_t varying = 0;
+	for (uint32_t k = first; k < end; k++) {
+		varying |= s->points[k] ^ s->points[first];
+	}
+	if (varying == 0) return;
+	bit_statistics(s, varying, stats);
+	const int bits = s->max_bytes * 8;
+
+	for (int big_endian = 0; big_endian <= 1; big_endian++) {
+		for (int lsb = 0; lsb < bits; lsb++) {
+			uint8_t members[MAX_FIELD_LENGTH];
+			double mean_x = 0.0, var_x = 0.0, cov_xy = 0.0;
+			uint64_t mask = 0;
+			int constant_run = 0;
+
+			for (int length = 1; length <= MAX_FIELD_LENGTH; length++) {
+				/* New MSB: little-endian bit index, big-endian transmission order */
+				int position = big_endian ? lsb - (length - 1) : lsb + (length - 1);
+				if (position < 0 || position >= bits) break;
+				int m = big_endian ? (position / 8) * 8 + 7 - position % 8 : position;
+				if (length == 1 && !((varying >> m) & 1)) break;
+
+				const double weight = ldexp(1.0, length - 1);
+				double shared = 0.0;
+				for (int j = 0; j < length - 1; j++) {
+					shared += ldexp(stats->covariance[members[j]][m], j);
+				}
+				var_x += 2.0 * weight * shared + weight * weight * stats->covariance[m][m];
+				cov_xy += weight * stats->reference_covariance[m];
+				mean_x += weight * stats->mean[m];
+				members[length - 1] = (uint8_t)m;
+				mask |= 1ULL << m;
+				if (!((varying >> m) & 1)) {
+					if (++constant_run > MAX_CONSTANT_RUN) break;
+					continue;
+				}
+				constant_run = 0;
+
+				for (int is_signed = 0; is_signed <= (length > 1); is_signed++) {
+					double var = var_x, cov = cov_xy, mean = mean_x;
+					if (is_signed) {
+						/* x_signed = x - 2^length * MSB */
+						const double wrap = 2.0 * weight;
+						var -= 2.0 * wrap * (shared + weight * stats->covariance[m][m]) - wrap * wrap * stats->covariance[m][m];
+						cov -= wrap * stats->reference_covariance[m];
+						mean -= wrap * stats->mean[m];
+					}
+					list->evaluated++;
+					if (var <= 0.0) continue;
+					field_Result result = {index, (uint8_t)(big_endian ? m : lsb), (uint8_t)length, big_endian,
+										   is_signed, 0, 0, 0, mask, 0, 0};
+					result.r = cov / sqrt(var * var_y);
+					result.scale = cov / var;
+					result.offset = mean_y - result.scale * mean;
+					add_result(list, &result);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @fn static void* worker(void* argument)
+ * @brief Worker thread: evaluates IDs until none is left.
+ */
+static void* worker(void* argument) {
+	result_List* list = argument;
+	bit_Statistics* stats = checked_calloc(1, sizeof(bit_Statistics));
+	stats->planes = checked_calloc(64 * ((grid_points + 63) / 64), sizeof(uint64_t));
+	uint32_t index;
+	while ((index = __atomic_fetch_add(&next_series, 1, __ATOMIC_RELAXED)) < series_count) {
+		evaluate_series(index, stats, list);
+	}
+	free(stats->planes);
+	free(stats);
+	return NULL;
+}
+
+/**
+ * @fn static double field_value(const field_Result* f, uint64_t payload)
+ * @brief Raw value of a field in a little-endian payload.
+ */
+static double field_value(const field_Result* f, uint64_t payload) {
+	uint32_t position = f->big_endian ? (f->start / 8) * 8 + 7 - f->start % 8 : f->start;
+	uint64_t word = f->big_endian ? __builtin_bswap64(payload) : payload;
+	uint32_t shift = f->big_endian ? 64 - position - f->length : position;
+	uint32_t w = (uint32_t)(word >> shift);
+	uint32_t sign_shift = 32 - f->length;
+	if (f->is_signed) return (double)((int32_t)(w << sign_shift) >> sign_shift);
+	return (double)(f->length == 32 ? w : (w & ((1UL << f->length) - 1)));
+}
+
+/**
+ * @fn static void refine_lag(field_Result* f, int max_lag)
+ * @brief Find the lag (grid points, reference later > 0) of the best correlation.
+ */
+static void refine_lag(field_Result* f, int max_lag) {
+	const id_Series* s = &series[f->series];
+	f->lag = 0;
+	f->lag_r = f->r;
+	for (int lag = -max_lag; lag <= max_lag; lag++) {
+		int64_t first = s->first_point, end = s->next_point;
+		if (first + lag < 0) first = -lag;
+		if (end + lag > (int64_t)grid_points) end = (int64_t)grid_points - lag;
+		if (end - first < 3) continue;
+		double n = (double)(end - first), sx = 0, sxx = 0, sxy = 0;
+		double x0 = field_value(f, s->points[first]);
+		for (int64_t k = first; k < end; k++) {
+			double x = field_value(f, s->points[k]) - x0;
+			sx += x;
+			sxx += x * x;
+			sxy += x * reference[k + lag];
+		}
+		double sy = reference_sum[end + lag] - reference_sum[first + lag];
+		double syy = reference_square_sum[end + lag] - reference_square_sum[first + lag];
+		double var_x = sxx - sx * sx / n, var_y = syy - sy * sy / n;
+		if (var_x <= 0.0 || var_y <= 0.0) continue;
+		double r = (sxy - sx * sy / n) / sqrt(var_x * var_y);
+		if (fabs(r) > fabs(f->lag_r)) {
+			f->lag_r = r;
+			f->lag = lag;
+		}
+	}
+}
+
+/**
+ * @fn static int compare_results(const void* a, const void* b)
+ * @brief Order by decreasing |r|, shorter fields first on a tie.
+ */
+static int compare_results(const void* a, const void* b) {
+	const field_Result* x = a;
+	const field_Result* y = b;
+	double dx = fabs(x->r), dy = fabs(y->r);
+	if (dx != dy) return (dx < dy) ? 1 : -1;
+	return (int)x->length - (int)y->length;
+}
+
+/**
+ * @fn static void usage(void)
+ * @brief Print the command line help.
+ */
+static void usage(void) {
+	printf("Usage: can_discover [options] reference capture [capture ...]\n"
+		   "  --events         reference is a list of event times (toggling state)\n"
+		   "  --column N       value column of the reference CSV (default 1)\n"
+		   "  --offset S       capture time of the first reference sample (default 0)\n"
+		   "  --rate HZ        resampling rate (default 10)\n"
+		   "  --max-lag S      refine the best fields over +-S seconds (default 2)\n"
+		   "  --top N          number of fields reported (default 20)\n"
+		   "  --threads N      worker threads (default: all CPUs)\n");
+}
+
+int main(int argc, char** argv) {
+	static const struct option options[] = {
+		{"events", no_argument, NULL, 'e'}, {"column", required_argument, NULL, 'c'},
+		{"offset", required_argument, NULL, 'o'}, {"rate", required_argument, NULL, 'r'},
+		{"max-lag", required_argument, NULL, 'l'}, {"top", required_argument, NULL, 't'},
+		{"threads", required_argument, NULL, 'j'}, {"help", no_argument, NULL, 'h'}, {NULL, 0, NULL, 0}
+	};
+	bool events = false;
+	int column = 1;
+	double max_lag_s = 2.0;
+	int top = 20;
+	int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int option;
+
+	while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+		switch (option) {
+			case 'e': events = true; break;
+			case 'c': column = atoi(optarg); break;
+			case 'o': grid_start = atof(optarg); break;
+			case 'r': grid_rate = atof(optarg); break;
+			case 'l': max_lag_s = atof(optarg); break;
+			case 't': top = atoi(optarg); break;
+			case 'j': threads = atoi(optarg); break;
+			default: usage(); return 1;
+		}
+	}
+	if (argc - optind < 2 || column < 1 || column >= 16 || grid_rate <= 0 || top < 1 || threads < 1) {
+		usage();
+		return 1;
+	}
+
+	uint32_t count = 0;
+	double* pairs = load_reference(argv[optind], events, column, &count);
+	if (pairs == NULL || count < 2) {
+		fprintf(stderr, "Cannot read the reference %s (at least 2 samples needed)\n", argv[optind]);
+		return 1;
+	}
+	build_grid(pairs, count, events);
+	printf("Reference: %s, %lu samples over %.1f s, %lu grid points at %g Hz\n", argv[optind],
+			(unsigned long)count, pairs[2 * (count - 1)], (unsigned long)grid_points, grid_rate);
+	free(pairs);
+
+	double start = now_s();
+	can_Capture capture;
+	can_capture_init(&capture, add_frame, NULL);
+	for (int i = optind + 1; i < argc; i++) {
+		if (!can_capture_read(&capture, argv[i])) {
+			fprintf(stderr, "Cannot read the capture %s\n", argv[i]);
+			return 1;
+		}
+	}
+	for (uint32_t i = 0; i < series_count; i++) {
+		hold_until(&series[i], capture.last_us / 1e6 + 1e-9);
+	}
+	printf("Capture: %llu frames, %lu IDs over %.1f s, read in %.2f s\n",
+			(unsigned long long)capture.frames, (unsigned long)series_count, capture.last_us / 1e6, now_s() - start);
+
+	/* Correlate every candidate field of every ID */
+	start = now_s();
+	pthread_t* thread = checked_calloc(threads, sizeof(pthread_t));
+	result_List* lists = checked_calloc(threads, sizeof(result_List));
+	for (int i = 0; i < threads; i++) {
+		pthread_create(&thread[i], NULL, worker, &lists[i]);
+	}
+	result_List all = {0};
+	for (int i = 0; i < threads; i++) {
+		pthread_join(thread[i], NULL);
+		for (size_t j = 0; j < lists[i].count; j++) add_result(&all, &lists[i].items[j]);
+		all.evaluated += lists[i].evaluated;
+		free(lists[i].items);
+	}
+	printf("Candidates: %llu fields correlated in %.2f s (%d threads)\n\n",
+			(unsigned long long)all.evaluated, now_s() - start, threads);
+
+	/* Best fields, skipping those overlapping a better one of the same ID */
+	qsort(all.items, all.count, sizeof(field_Result), compare_results);
+	field_Result* best = checked_calloc(top, sizeof(field_Result));
+	int found = 0;
+	for (size_t i = 0; i < all.count; i++) {
+		const field_Result* candidate = &all.items[i];
+		bool overlaps = false;
+		for (int j = 0; j < found; j++) {
+			if (best[j].series != candidate->series || (best[j].bits & candidate->bits) == 0) continue;
+			overlaps = true;
+			break;
+		}
+		if (!overlaps && found < top) best[found++] = *candidate;
+	}
+
+	printf("Rank  ID          Order   Start  Length  Signed      r   Lag (s)  r (lag)         Scale        Offset\n");
+	for (int i = 0; i < found; i++) {
+		refine_lag(&best[i], (int)(max_lag_s * grid_rate));
+		printf("%4d  0x%-8lX  %-6s  %5u  %6u  %-6s  %6.3f  %7.2f  %7.3f  %12.6g  %12.6g\n", i + 1,
+				(unsigned long)series[best[i].series].identifier, best[i].big_endian ? "big" : "little",
+				best[i].start, best[i].length, best[i].is_signed ? "yes" : "no", best[i].r,
+				best[i].lag / grid_rate, best[i].lag_r, best[i].scale, best[i].offset);
+	}
+	if (found > 0) {
+		printf("\ndashboard.toml:\n[signals.discovered]\nid = \"0x%lX\"\nstart = %u\nlength = %u\n"
+			   "byte_order = \"%s\"\nsigned = %s\nscale = %.6g\noffset = %.6g\n",
+			   (unsigned long)series[best[0].series].identifier, best[0].start, best[0].length,
+			   best[0].big_endian ? "big" : "little", best[0].is_signed ? "true" : "false",
+			   best[0].scale, best[0].offset);
+	}
+	return 0;
+}
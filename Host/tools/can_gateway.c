@@ -0,0 +1,606 @@
+/**
+ * @file can_gateway.c
+ * @brief Host tool: link frames copied between buses by a gateway and report the routing latency.
+ *
+ * @details
+ * Reads a merged multi-bus capture (a candump log of several interfaces,
+ * e.g. candump -l any, each interface being a channel, see can_capture.h)
+ * in one streaming pass. A frame is a copy when the same ID and payload was
+ * seen on another channel less than --window before. It is linked to the
+ * first appearance of that frame (its origin), at most once per channel,
+ * and the time between them is a sample of the gateway latency of its route
+ * (ID, origin channel -> copy channel). A frame forwarded to several buses,
+ * or along a chain of gateways, has all its copies linked to the origin.
+ * Repeats of a static payload on the same bus are never linked, and a
+ * repeat on the origin bus starts a new origin once the previous one was
+ * copied.
+ *
+ * The frames of the window are kept in a ring of --capacity entries, in
+ * arrival order, chained per hash bucket of (ID, DLC, payload). A lookup
+ * walks its bucket from the newest entry and stops at the first entry older
+ * than the window, so a frame costs O(1) and memory is fixed whatever the
+ * capture length or the number of buses. Frames pushed out of the ring
+ * while still within the window (ring too small for the bus load) are
+ * counted and reported.
+ *
+ * Per route, latencies go to a log-linear histogram (HISTOGRAM_SUB_BUCKETS
+ * buckets per power of two, i.e. 12.5% resolution), from which the
+ * percentiles are reported. The report also gives the frames, unique frames
+ * and copies of each channel, so the double counting of a merged capture is
+ * visible. Gateways that rewrite the payload (counter, checksum) are not
+ * detected.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -IHost/stubs -IMy_Modules/Drivers/can -IMy_Modules/Drivers/debug
+ *       -IMy_Modules/Drivers/stdio -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp
+ *       -IMy_Modules/Features/logger Host/tools/can_gateway.c Host/tools/can_capture.c
+ *       My_Modules/Drivers/can/my_can_wire.c My_Modules/Features/logger/can_logger.c
+ *       My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/stdio/my_stdio.c
+ *       My_Modules/Drivers/uart/my_uart.c -o can_gateway
+ *   ./can_gateway [--window MS] [--links links.csv] candump-2024-05-01.log
+ */
+
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "can_capture.h"
+
+/**
+ * @def WINDOW_US
+ * @brief Default time (us) within which a frame on another bus is taken as its origin.
+ */
+#define WINDOW_US 20000
+
+/**
+ * @def RING_CAPACITY
+ * @brief Default number of recent frames kept (power of two).
+ */
+#define RING_CAPACITY (1UL << 16)
+
+/**
+ * @def MAX_ROUTES
+ * @brief Number of distinct (ID, origin channel, copy channel) routes.
+ */
+#define MAX_ROUTES 8192
+
+/**
+ * @def MAX_IDS
+ * @brief Number of distinct CAN IDs counted per channel.
+ */
+#define MAX_IDS 8192
+
+/**
+ * @def HISTOGRAM_SUB_BUCKETS
+ * @brief Latency histogram buckets per power of two (power of two).
+ */
+#define HISTOGRAM_SUB_BUCKETS 8
+
+/**
+ * @def HISTOGRAM_SUB_BITS
+ * @brief log2(HISTOGRAM_SUB_BUCKETS).
+ */
+#define HISTOGRAM_SUB_BITS 3
+
+/**
+ * @def HISTOGRAM_BUCKETS
+ * @brief Latency histogram buckets (latencies up to 2^32 us).
+ */
+#define HISTOGRAM_BUCKETS (HISTOGRAM_SUB_BUCKETS * (32 - HISTOGRAM_SUB_BITS + 1))
+
+/**
+ * @struct recent_Frame
+ * @brief Ring entry: a frame of the window.
+ *
+ * @details
+ * older is the sequence number of the previous frame of the same hash
+ * bucket (0 = none), origin the sequence number of the frame a copy is
+ * linked to (its own for an origin). copied_to has bit c set once a copy on
+ * channel c was linked to this frame.
+ */
+typedef struct {
+	uint64_t time_us;
+	uint64_t key;
+	uint64_t older;
+	uint64_t origin;
+	uint32_t identifier;
+	uint16_t copied_to;
+	uint8_t channel;
+	uint8_t data_length;
+	uint8_t data[8];
+} recent_Frame;
+
+/**
+ * @struct route_Stats
+ * @brief Copies and latency histogram of one route.
+ */
+typedef struct {
+	uint32_t identifier;
+	uint8_t from;
+	uint8_t to;
+	uint64_t copies;
+	uint64_t latency_sum;
+	uint32_t latency_min;
+	uint32_t latency_max;
+	uint32_t histogram[HISTOGRAM_BUCKETS];
+} route_Stats;
+
+/**
+ * @struct id_Count
+ * @brief Frames of one CAN ID per channel.
+ */
+typedef struct {
+	uint32_t identifier;
+	uint64_t frames[CAN_CAPTURE_MAX_CHANNELS];
+} id_Count;
+
+/**
+ * @struct channel_Stats
+ * @brief Frames and copies of one channel.
+ */
+typedef struct {
+	uint64_t frames;
+	uint64_t copies_in;
+	uint64_t copies_out;
+} channel_Stats;
+
+/**
+ * @var ring
+ * @brief Recent frames, frame n (from 1) in ring[n & ring_mask].
+ */
+static recent_Frame* ring = NULL;
+
+/**
+ * @var ring_mask
+ * @brief Ring capacity - 1.
+ */
+static uint64_t ring_mask = RING_CAPACITY - 1;
+
+/**
+ * @var buckets
+ * @brief Sequence number of the newest frame of each hash bucket (0 = none).
+ */
+static uint64_t* buckets = NULL;
+
+/**
+ * @var bucket_mask
+ * @brief Number of hash buckets - 1.
+ */
+static uint64_t bucket_mask = 0;
+
+/**
+ * @var sequence
+ * @brief Sequence number of the last frame added to the ring.
+ */
+static uint64_t sequence = 0;
+
+/**
+ * @var window_us
+ * @brief Linking window.
+ */
+static uint64_t window_us = WINDOW_US;
+
+/**
+ * @var ring_overflows
+ * @brief Frames pushed out of the ring while still within the window.
+ */
+static uint64_t ring_overflows = 0;
+
+/**
+ * @var out_of_order
+ * @brief Frames timestamped before their origin (latency counted as 0).
+ */
+static uint64_t out_of_order = 0;
+
+/**
+ * @var routes
+ * @brief Per-route statistics.
+ */
+static route_Stats routes[MAX_ROUTES];
+
+/**
+ * @var route_count
+ * @brief Number of used entries of routes.
+ */
+static uint32_t route_count = 0;
+
+/**
+ * @var route_table
+ * @brief Open addressing hash table: route -> routes index + 1 (0 = free).
+ */
+static uint32_t route_table[2 * MAX_ROUTES];
+
+/**
+ * @var lost_routes
+ * @brief Copies not counted because MAX_ROUTES was exceeded.
+ */
+static uint64_t lost_routes = 0;
+
+/**
+ * @var ids
+ * @brief Per-ID frame counts.
+ */
+static id_Count ids[MAX_IDS];
+
+/**
+ * @var id_count
+ * @brief Number of used entries of ids.
+ */
+static uint32_t id_count = 0;
+
+/**
+ * @var id_table
+ * @brief Open addressing hash table: CAN ID -> ids index + 1 (0 = free).
+ */
+static uint32_t id_table[2 * MAX_IDS];
+
+/**
+ * @var channels
+ * @brief Per-channel statistics.
+ */
+static channel_Stats channels[CAN_CAPTURE_MAX_CHANNELS];
+
+/**
+ * @var links
+ * @brief CSV file of the linked copies, NULL if not requested.
+ */
+static FILE* links = NULL;
+
+/**
+ * @var capture
+ * @brief Reader state (its channel field tells the channel of the current frame).
+ */
+static can_Capture capture;
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+
+/**
+ * @fn static double now_s(void)
+ * @brief Monotonic time in seconds.
+ */
+static double now_s(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @fn static uint64_t frame_key(const my_CAN_Frame* frame)
+ * @brief 64-bit hash of ID, DLC and payload.
+ */
+static uint64_t frame_key(const my_CAN_Frame* frame) {
+	uint64_t data = 0;
+	memcpy(&data, frame->Data, frame->DataLength);
+	uint64_t key = ((uint64_t)frame->Identifier << 8 | frame->DataLength) * 0x9E3779B97F4A7C15ULL;
+	key ^= data + 0x632BE59BD9B4E019ULL + (key << 6) + (key >> 2);
+	key ^= key >> 31;
+	key *= 0xBF58476D1CE4E5B9ULL;
+	return key ^ (key >> 29);
+}
+
+/**
+ * @fn static uint32_t histogram_bucket(uint64_t value)
+ * @brief Log-linear histogram bucket of a latency.
+ */
+static uint32_t histogram_bucket(uint64_t value) {
+	if (value >= (1ULL << 32)) value = (1ULL << 32) - 1;
+	if (value < HISTOGRAM_SUB_BUCKETS) return (uint32_t)value;
+	uint32_t exponent = 63 - __builtin_clzll(value);
+	return (exponent - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS +
+		   (uint32_t)((value >> (exponent - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+/**
+ * @fn static double histogram_value(uint32_t bucket)
+ * @brief Middle of the latency range of a histogram bucket.
+ */
+static double histogram_value(uint32_t bucket) {
+	if (bucket < HISTOGRAM_SUB_BUCKETS) return bucket;
+	uint32_t exponent = bucket / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BITS - 1;
+	uint64_t low = (uint64_t)(HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) << (exponent - HISTOGRAM_SUB_BITS);
+	return low + ((1ULL << (exponent - HISTOGRAM_SUB_BITS)) - 1) / 2.0;
+}
+
+/**
+ * @fn static double percentile(const uint32_t* histogram, uint64_t count, double fraction, const route_Stats* exact)
+ * @brief Latency percentile from a histogram, clamped to the exact min and max.
+ */
+static double percentile(const uint32_t* histogram, uint64_t count, double fraction, const route_Stats* exact) {
+	uint64_t rank = (uint64_t)(fraction * (count - 1)) + 1;
+	uint64_t seen = 0;
+	for (uint32_t bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+		seen += histogram[bucket];
+		if (seen >= rank) {
+			double value = histogram_value(bucket);
+			if (value < exact->latency_min) value = exact->latency_min;
+			if (value > exact->latency_max) value = exact->latency_max;
+			return value;
+		}
+	}
+	return exact->latency_max;
+}
+
+/**
+ * @fn static id_Count* find_id(uint32_t identifier)
+ * @brief Counts of a CAN ID, created on first use (NULL if MAX_IDS is exceeded).
+ */
+static id_Count* find_id(uint32_t identifier) {
+	uint32_t slot = (identifier * 2654435761UL) % (2 * MAX_IDS);
+	while (id_table[slot] != 0) {
+		id_Count* entry = &ids[id_table[slot] - 1];
+		if (entry->identifier == identifier) return entry;
+		slot = (slot + 1) % (2 * MAX_IDS);
+	}
+	if (id_count == MAX_IDS) return NULL;
+	id_Count* entry = &ids[id_count++];
+	id_table[slot] = id_count;
+	entry->identifier = identifier;
+	return entry;
+}
+
+/**
+ * @fn static route_Stats* find_route(uint32_t identifier, uint8_t from, uint8_t to)
+ * @brief Statistics of a route, created on first use (NULL if MAX_ROUTES is exceeded).
+ */
+static route_Stats* find_route(uint32_t identifier, uint8_t from, uint8_t to) {
+	uint32_t slot = ((identifier * 31 + from) * 31 + to) * 2654435761UL % (2 * MAX_ROUTES);
+	while (route_table[slot] != 0) {
+		route_Stats* route = &routes[route_table[slot] - 1];
+		if (route->identifier == identifier && route->from == from && route->to == to) return route;
+		slot = (slot + 1) % (2 * MAX_ROUTES);
+	}
+	if (route_count == MAX_ROUTES) return NULL;
+	route_Stats* route = &routes[route_count++];
+	route_table[slot] = route_count;
+	route->identifier = identifier;
+	route->from = from;
+	route->to = to;
+	route->latency_min = UINT32_MAX;
+	return route;
+}
+
+/**
+ * @fn static void link_copy(const recent_Frame* origin, const recent_Frame* copy)
+ * @brief Count a copy and its latency.
+ */
+static void link_copy(const recent_Frame* origin, const recent_Frame* copy) {
+	uint64_t latency = 0;
+	if (copy->time_us >= origin->time_us) {
+		latency = copy->time_us - origin->time_us;
+	} else {
+		out_of_order++;
+	}
+	channels[origin->channel].copies_out++;
+	channels[copy->channel].copies_in++;
+	if (links != NULL) {
+		fprintf(links, "%.6f,%u,0x%03lX,%.6f,%u,%llu\n", copy->time_us / 1e6, copy->channel,
+				(unsigned long)copy->identifier, origin->time_us / 1e6, origin->channel, (unsigned long long)latency);
+	}
+
+	route_Stats* route = find_route(copy->identifier, origin->channel, copy->channel);
+	if (route == NULL) {
+		lost_routes++;
+		return;
+	}
+	uint32_t value = (latency > UINT32_MAX) ? UINT32_MAX : (uint32_t)latency;
+	route->copies++;
+	route->latency_sum += value;
+	if (value < route->latency_min) route->latency_min = value;
+	if (value > route->latency_max) route->latency_max = value;
+	route->histogram[histogram_bucket(value)]++;
+}
+
+/**
+ * @fn static void add_frame(const my_CAN_Frame* frame, uint64_t time_us, void* context)
+ * @brief Link a frame to its origin on another bus, then add it to the ring (can_Capture_Callback).
+ */
+static void add_frame(const my_CAN_Frame* frame, uint64_t time_us, void* context) {
+	(void)context;
+	const uint8_t channel = capture.channel;
+	const uint8_t length = (frame->DataLength > 8) ? 8 : frame->DataLength;
+	channels[channel].frames++;
+	id_Count* counts = find_id(frame->Identifier);
+	if (counts != NULL) counts->frames[channel]++;
+
+	my_CAN_Frame normalized = {0};
+	normalized.Identifier = frame->Identifier;
+	normalized.DataLength = length;
+	memcpy(normalized.Data, frame->Data, length);
+	const uint64_t key = frame_key(&normalized);
+	uint64_t* bucket = &buckets[key & bucket_mask];
+
+	/* Newest earlier frame with this ID and payload whose origin is on another channel and not yet copied here */
+	recent_Frame* origin = NULL;
+	uint64_t origin_sequence = 0;
+	for (uint64_t n = *bucket; n != 0 && n + ring_mask >= sequence; ) {
+		recent_Frame* candidate = &ring[n & ring_mask];
+		if (time_us > candidate->time_us + window_us) break;
+		if (candidate->key == key && candidate->identifier == frame->Identifier && candidate->data_length == length &&
+				memcmp(candidate->data, normalized.Data, sizeof(candidate->data)) == 0) {
+			uint64_t first = candidate->origin;
+			if (first + ring_mask < sequence || time_us > ring[first & ring_mask].time_us + window_us) first = n;
+			recent_Frame* source = &ring[first & ring_mask];
+			if (source->channel != channel && !(source->copied_to & (1U << channel))) {
+				origin = source;
+				origin_sequence = first;
+				break;
+			}
+		}
+		n = candidate->older;
+	}
+
+	sequence++;
+	recent_Frame* entry = &ring[sequence & ring_mask];
+	if (sequence > ring_mask + 1 && entry->time_us + window_us >= time_us) ring_overflows++;
+	entry->time_us = time_us;
+	entry->key = key;
+	entry->older = *bucket;
+	entry->origin = origin ? origin_sequence : sequence;
+	entry->identifier = frame->Identifier;
+	entry->copied_to = 0;
+	entry->channel = channel;
+	entry->data_length = length;
+	memcpy(entry->data, normalized.Data, sizeof(entry->data));
+	*bucket = sequence;
+
+	if (origin != NULL) {
+		origin->copied_to |= (uint16_t)(1U << channel);
+		link_copy(origin, entry);
+	}
+}
+
+/**
+ * @fn static int compare_routes(const void* a, const void* b)
+ * @brief Order by decreasing number of copies, then by ID.
+ */
+static int compare_routes(const void* a, const void* b) {
+	const route_Stats* x = a;
+	const route_Stats* y = b;
+	if (x->copies != y->copies) return (x->copies < y->copies) ? 1 : -1;
+	return (x->identifier > y->identifier) - (x->identifier < y->identifier);
+}
+
+/**
+ * @fn static void print_latency(const uint32_t* histogram, uint64_t copies, const route_Stats* exact)
+ * @brief Print min / mean / p50 / p90 / p99 / max latency in us.
+ */
+static void print_latency(const uint32_t* histogram, uint64_t copies, const route_Stats* exact) {
+	printf("%8lu %8.0f %8.0f %8.0f %8.0f %8lu\n", (unsigned long)exact->latency_min,
+		   (double)exact->latency_sum / copies, percentile(histogram, copies, 0.5, exact),
+		   percentile(histogram, copies, 0.9, exact), percentile(histogram, copies, 0.99, exact),
+		   (unsigned long)exact->latency_max);
+}
+
+/**
+ * @fn static void report(double elapsed, int top)
+ * @brief Print the channel, channel pair and route tables.
+ */
+static void report(double elapsed, int top) {
+	const int channel_count = capture.channel_count ? capture.channel_count : 1;
+	uint64_t copies = 0;
+	for (int c = 0; c < channel_count; c++) copies += channels[c].copies_in;
+	printf("Capture: %llu frames on %d channels over %.1f s, %llu copies, %llu unique frames (%.1f frames/s in %.2f s)\n",
+		   (unsigned long long)capture.frames, channel_count, capture.last_us / 1e6, (unsigned long long)copies,
+		   (unsigned long long)(capture.frames - copies), capture.frames / (elapsed > 0 ? elapsed : 1), elapsed);
+	printf("Window: %.1f ms, ring of %llu frames (%llu pushed out within the window), %llu copies before their origin\n\n",
+		   window_us / 1e3, (unsigned long long)(ring_mask + 1), (unsigned long long)ring_overflows,
+		   (unsigned long long)out_of_order);
+
+	printf("Channel  Name              Frames   Unique  Copies in  Copied out\n");
+	for (int c = 0; c < channel_count; c++) {
+		printf("%7d  %-12s %11llu %8llu %10llu %11llu\n", c, capture.channel_count ? capture.channel_names[c] : "-",
+			   (unsigned long long)channels[c].frames, (unsigned long long)(channels[c].frames - channels[c].copies_in),
+			   (unsigned long long)channels[c].copies_in, (unsigned long long)channels[c].copies_out);
+	}
+
+	/* Channel pairs: merged histograms of their routes */
+	printf("\nRoute      IDs   Copies  Latency (us): min     mean      p50      p90      p99      max\n");
+	for (int from = 0; from < channel_count; from++) {
+		for (int to = 0; to < channel_count; to++) {
+			static uint32_t histogram[HISTOGRAM_BUCKETS];
+			route_Stats pair = {.latency_min = UINT32_MAX};
+			uint32_t routed = 0;
+			memset(histogram, 0, sizeof(histogram));
+			for (uint32_t r = 0; r < route_count; r++) {
+				const route_Stats* route = &routes[r];
+				if (route->from != from || route->to != to) continue;
+				routed++;
+				pair.copies += route->copies;
+				pair.latency_sum += route->latency_sum;
+				if (route->latency_min < pair.latency_min) pair.latency_min = route->latency_min;
+				if (route->latency_max > pair.latency_max) pair.latency_max = route->latency_max;
+				for (uint32_t b = 0; b < HISTOGRAM_BUCKETS; b++) histogram[b] += route->histogram[b];
+			}
+			if (pair.copies == 0) continue;
+			printf("%2d -> %-2d %6lu %8llu %17s", from, to, (unsigned long)routed, (unsigned long long)pair.copies, "");
+			print_latency(histogram, pair.copies, &pair);
+		}
+	}
+
+	qsort(routes, route_count, sizeof(route_Stats), compare_routes);
+	printf("\nID           Route   Copies  Copied  Latency (us): min     mean      p50      p90      p99      max\n");
+	for (uint32_t r = 0; r < route_count && (int)r < top; r++) {
+		const route_Stats* route = &routes[r];
+		const id_Count* counts = find_id(route->identifier);
+		double share = (counts && counts->frames[route->from]) ? 100.0 * route->copies / counts->frames[route->from] : 0;
+		printf("0x%-8lX %2d -> %-2d %8llu %6.1f%% %14s", (unsigned long)route->identifier, route->from, route->to,
+			   (unsigned long long)route->copies, share, "");
+		print_latency(route->histogram, route->copies, route);
+	}
+	if (route_count > (uint32_t)top) printf("... %lu more routes (--top)\n", (unsigned long)(route_count - top));
+	if (lost_routes > 0) printf("%llu copies on routes beyond %d not listed\n", (unsigned long long)lost_routes, MAX_ROUTES);
+}
+
+/**
+ * @fn static void usage(void)
+ * @brief Print the command line help.
+ */
+static void usage(void) {
+	printf("Usage: can_gateway [options] capture [capture ...]\n"
+		   "  --window MS       link a frame to the same ID and payload on another bus within MS (default %g)\n"
+		   "  --capacity N      frames kept for the window, rounded up to a power of two (default %lu)\n"
+		   "  --links FILE      write every link as CSV (time, channel, id, origin time, origin channel, latency us)\n"
+		   "  --top N           routes listed (default 30)\n", WINDOW_US / 1e3, (unsigned long)RING_CAPACITY);
+}
+
+int main(int argc, char** argv) {
+	static const struct option options[] = {
+		{"window", required_argument, NULL, 'w'}, {"capacity", required_argument, NULL, 'c'},
+		{"links", required_argument, NULL, 'l'}, {"top", required_argument, NULL, 't'},
+		{"help", no_argument, NULL, 'h'}, {NULL, 0, NULL, 0}
+	};
+	double window_ms = WINDOW_US / 1e3;
+	unsigned long capacity = RING_CAPACITY;
+	const char* links_path = NULL;
+	int top = 30;
+	int option;
+
+	while ((option = getopt_long(argc, argv, "", options, NULL)) != -1) {
+		switch (option) {
+			case 'w': window_ms = atof(optarg); break;
+			case 'c': capacity = strtoul(optarg, NULL, 0); break;
+			case 'l': links_path = optarg; break;
+			case 't': top = atoi(optarg); break;
+			default: usage(); return 1;
+		}
+	}
+	if (optind >= argc || window_ms <= 0 || capacity < 2 || capacity > (1UL << 28) || top < 1) {
+		usage();
+		return 1;
+	}
+	window_us = (uint64_t)(window_ms * 1000);
+	uint64_t size = 2;
+	while (size < capacity) size *= 2;
+	ring_mask = size - 1;
+	bucket_mask = 2 * size - 1;
+	ring = calloc(size, sizeof(recent_Frame));
+	buckets = calloc(2 * size, sizeof(uint64_t));
+	if (ring == NULL || buckets == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	if (links_path != NULL) {
+		links = fopen(links_path, "w");
+		if (links == NULL) {
+			fprintf(stderr, "Cannot write %s\n", links_path);
+			return 1;
+		}
+		fprintf(links, "time_s,channel,id,origin_time_s,origin_channel,latency_us\n");
+	}
+
+	double start = now_s();
+	can_capture_init(&capture, add_frame, NULL);
+	for (int i = optind; i < argc; i++) {
+		if (!can_capture_read(&capture, argv[i])) {
+			fprintf(stderr, "Cannot read the capture %s\n", argv[i]);
+			return 1;
+		}
+	}
+	double elapsed = now_s() - start;
+	if (links != NULL) fclose(links);
+	report(elapsed, top);
+	free(ring);
+	free(buckets);
+	return 0;
+}
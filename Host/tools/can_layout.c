@@ -0,0 +1,666 @@
+/**
+ * @file can_layout.c
+ * @brief Host tool: infer the signal layout of every CAN ID and write it as a DBC file.
+ *
+ * @details
+ * Reads one or more captures in a single streaming pass and keeps a fixed
+ * set of counters per ID (a few KB, independent of the capture length):
+ *   - per bit: frames with the bit set and bit flips between consecutive
+ *     frames of the ID
+ *   - per pair of adjacent bits: simultaneous flips, from which the
+ *     conditional entropy of one bit's flips given its neighbour's follows
+ *   - rolling counter candidates: every bit field within a byte, counting
+ *     the frames in which it is the previous value + 1
+ *   - checksum candidates in the first and the last byte: XOR and SUM of
+ *     the other bytes, and CRC-8 (polynomials CRC_POLYNOMIALS). A CRC is
+ *     affine in the data, so crc(a) ^ crc(b) = crc0(a ^ b), with crc0 the
+ *     CRC with a zero init value: this test holds whatever the init value,
+ *     final XOR or (AUTOSAR E2E) data ID included in the CRC
+ *
+ * After the pass, counters and checksums are placed first. The remaining
+ * bits are split into signals along both byte orders (Intel: significance
+ * increases with the bit index, Motorola: with decreasing transmission
+ * order). Within a numeric signal the flip rate does not increase from the
+ * LSB to the MSB, and a bit's flips come with flips of the bits below it
+ * (carry). A boundary is placed where the flip rate magnitude (log10)
+ * increases, where flips of a bit tell nothing about flips of the bit below
+ * (low dependence), or at a constant bit. The byte order giving fewer signals is
+ * kept. A signal whose two top bits always flip together at the same rate is
+ * taken as signed (sign extension).
+ *
+ * The layout is written as a DBC file (factor 1, offset 0, raw range), with
+ * the evidence in comments. Use can_discover to find scale and offset.
+ *
+ * Build and run from the repository root:
+ *
+ *   gcc -O2 -IHost/stubs -IMy_Modules/Drivers/can -IMy_Modules/Drivers/debug
+ *       -IMy_Modules/Drivers/stdio -IMy_Modules/Drivers/uart -IMy_Modules/Drivers/timestamp
+ *       -IMy_Modules/Features/logger Host/tools/can_layout.c Host/tools/can_capture.c
+ *       My_Modules/Drivers/can/my_can_wire.c My_Modules/Features/logger/can_logger.c
+ *       My_Modules/Drivers/debug/my_debug.c My_Modules/Drivers/stdio/my_stdio.c
+ *       My_Modules/Drivers/uart/my_uart.c -lm -o can_layout
+ *   ./can_layout [--report] [-o layout.dbc] capture.bin [capture ...]
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "can_capture.h"
+
+/**
+ * @def MAX_IDS
+ * @brief Number of distinct CAN IDs a capture may contain.
+ */
+#define MAX_IDS 4096
+
+/**
+ * @def MIN_TRANSITIONS
+ * @brief Frame pairs an ID needs before a layout is inferred.
+ */
+#define MIN_TRANSITIONS 20
+
+/**
+ * @def MIN_FLIPS
+ * @brief Flips of a bit needed to use its dependence on the bit below.
+ */
+#define MIN_FLIPS 30
+
+/**
+ * @def MIN_SIGN_FLIPS
+ * @brief Flips of a signal's MSB (sign changes) needed to call it signed.
+ */
+#define MIN_SIGN_FLIPS 4
+
+/**
+ * @def NOISE_RATE
+ * @brief Flip rate from which a bit looks random. The dependence test only
+ * 		  splits below a slower bit: the sampled LSBs of a fast signal are
+ * 		  as independent of each other as unrelated bits.
+ */
+#define NOISE_RATE 0.25
+
+/**
+ * @def MIN_DEPENDENCE
+ * @brief Uncertainty coefficient (share of the entropy of the lower bit's
+ * 		  flips explained by the upper bit's flips) below which the two bits
+ * 		  belong to different signals.
+ */
+#define MIN_DEPENDENCE 0.1
+
+/**
+ * @def COUNTER_RATE
+ * @brief Share of frames in which a field must be the previous value + 1.
+ */
+#define COUNTER_RATE 0.9
+
+/**
+ * @def CHECKSUM_RATE
+ * @brief Share of frames in which a checksum test must hold.
+ */
+#define CHECKSUM_RATE 0.98
+
+/**
+ * @def CRC_POLYNOMIALS
+ * @brief CRC-8 polynomials tested: SAE J1850 / E2E profile 1, AUTOSAR
+ * 		  8H2F / E2E profile 2, CRC-8 (ATM).
+ */
+#define CRC_POLYNOMIALS {0x1D, 0x2F, 0x07}
+
+/**
+ * @def CRC_COUNT
+ * @brief Number of CRC_POLYNOMIALS.
+ */
+#define CRC_COUNT 3
+
+/**
+ * @def COUNTER_FIELDS
+ * @brief Bit fields of length 2..8 within one byte (counter candidates).
+ */
+#define COUNTER_FIELDS 28
+
+/**
+ * @enum checksum_Kind
+ * @brief Checksum tests, for the first (0) and the last (1) data byte.
+ */
+typedef enum {
+	CHECKSUM_XOR,
+	CHECKSUM_SUM,
+	CHECKSUM_CRC,
+	CHECKSUM_KINDS = CHECKSUM_CRC + CRC_COUNT
+} checksum_Kind;
+
+/**
+ * @struct id_Stats
+ * @brief Streaming statistics of one CAN ID.
+ *
+ * @details
+ * Bits are numbered as the DBC little-endian start bit: bit b is bit b % 8
+ * of byte b / 8. transitions counts the frames that follow a frame of the
+ * same ID and length, over which flips and tests are counted. joint_up[b]
+ * counts simultaneous flips of bits b and b + 1, joint_cross[k] of bits
+ * 8k and 8k + 15 (adjacent in Motorola order). checksum_value holds the
+ * first value of the XOR / SUM tests, which must stay constant.
+ */
+typedef struct {
+	uint32_t identifier;
+	uint8_t max_bytes;
+	uint8_t last_bytes;
+	uint64_t frames;
+	uint64_t transitions;
+	uint64_t first_data;
+	uint64_t last_data;
+	uint64_t varying;
+	uint64_t ones[64];
+	uint64_t flips[64];
+	uint64_t joint_up[63];
+	uint64_t joint_cross[7];
+	uint64_t increments[8][COUNTER_FIELDS];
+	uint64_t checksum_tests[2];
+	uint64_t checksum_matches[2][CHECKSUM_KINDS];
+	uint8_t checksum_value[2][2];
+} id_Stats;
+
+/**
+ * @struct signal_Field
+ * @brief One inferred field of an ID.
+ */
+typedef struct {
+	uint8_t start;
+	uint8_t length;
+	bool big_endian;
+	bool is_signed;
+	char name[32];
+	char comment[96];
+} signal_Field;
+
+/**
+ * @var stats
+ * @brief Statistics of every CAN ID of the capture.
+ */
+static id_Stats stats[MAX_IDS];
+
+/**
+ * @var stats_count
+ * @brief Number of used entries of stats.
+ */
+static uint32_t stats_count = 0;
+
+/**
+ * @var id_table
+ * @brief Open addressing hash table: CAN ID -> stats index + 1 (0 = free).
+ */
+static uint32_t id_table[2 * MAX_IDS];
+
+/**
+ * @var crc_tables
+ * @brief Table of each of CRC_POLYNOMIALS (zero init, no final XOR).
+ */
+static uint8_t crc_tables[CRC_COUNT][256];
+
+/**
+ * @var crc_polynomials
+ * @brief Polynomials of crc_tables.
+ */
+static const uint8_t crc_polynomials[CRC_COUNT] = CRC_POLYNOMIALS;
+
+/**
+ * @var counter_fields
+ * @brief (shift, length) of the COUNTER_FIELDS counter candidates in a byte.
+ */
+static uint8_t counter_fields[COUNTER_FIELDS][2];
+
+UART_HandleTypeDef huart3 = {.gState = HAL_UART_STATE_READY};
+
+/**
+ * @fn static void init_tables(void)
+ * @brief Build the CRC tables and the list of counter fields.
+ */
+static void init_tables(void) {
+	for (int p = 0; p < CRC_COUNT; p++) {
+		for (int value = 0; value < 256; value++) {
+			uint8_t crc = (uint8_t)value;
+			for (int bit = 0; bit < 8; bit++) {
+				crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ crc_polynomials[p]) : (uint8_t)(crc << 1);
+			}
+			crc_tables[p][value] = crc;
+		}
+	}
+	int field = 0;
+	for (int length = 2; length <= 8; length++) {
+		for (int shift = 0; shift + length <= 8; shift++) {
+			counter_fields[field][0] = (uint8_t)shift;
+			counter_fields[field][1] = (uint8_t)length;
+			field++;
+		}
+	}
+}
+
+/**
+ * @fn static id_Stats* find_stats(uint32_t identifier)
+ * @brief Statistics of a CAN ID, created on first use (NULL if MAX_IDS is exceeded).
+ */
+static id_Stats* find_stats(uint32_t identifier) {
+	uint32_t slot = (identifier * 2654435761UL) % (2 * MAX_IDS);
+	while (id_table[slot] != 0) {
+		id_Stats* s = &stats[id_table[slot] - 1];
+		if (s->identifier == identifier) return s;
+		slot = (slot + 1) % (2 * MAX_IDS);
+	}
+	if (stats_count == MAX_IDS) return NULL;
+	id_Stats* s = &stats[stats_count++];
+	id_table[slot] = stats_count;
+	s->identifier = identifier;
+	return s;
+}
+
+/**
+ * @fn static void checksum_frame(id_Stats* s, const uint8_t* bytes, const uint8_t* previous, uint8_t length)
+ * @brief Count the checksum tests of one frame against the previous one.
+ */
+static void checksum_frame(id_Stats* s, const uint8_t* bytes, const uint8_t* previous, uint8_t length) {
+	uint8_t all_xor = 0;
+	uint8_t all_sum = 0;
+	for (int i = 0; i < length; i++) {
+		all_xor ^= bytes[i];
+		all_sum += bytes[i];
+	}
+	for (int side = 0; side < 2; side++) {
+		const int position = side ? length - 1 : 0;
+		/* XOR of all bytes, SUM of the others minus the checksum: constant */
+		uint8_t values[2] = {all_xor, (uint8_t)(all_sum - 2 * bytes[position])};
+		if (s->transitions == 1) memcpy(s->checksum_value[side], values, 2);
+
+		/* CRC of the difference of the other bytes */
+		uint8_t crc[CRC_COUNT] = {0};
+		bool changed = false;
+		for (int i = 0; i < length; i++) {
+			if (i == position) continue;
+			uint8_t difference = bytes[i] ^ previous[i];
+			changed |= (difference != 0);
+			for (int p = 0; p < CRC_COUNT; p++) crc[p] = crc_tables[p][crc[p] ^ difference];
+		}
+		if (!changed) continue;
+		s->checksum_tests[side]++;
+		s->checksum_matches[side][CHECKSUM_XOR] += (values[0] == s->checksum_value[side][0]);
+		s->checksum_matches[side][CHECKSUM_SUM] += (values[1] == s->checksum_value[side][1]);
+		for (int p = 0; p < CRC_COUNT; p++) {
+			s->checksum_matches[side][CHECKSUM_CRC + p] += (crc[p] == (bytes[position] ^ previous[position]));
+		}
+	}
+}
+
+/**
+ * @fn static void add_frame(const my_CAN_Frame* frame, uint64_t time_us, void* context)
+ * @brief Update the statistics of the frame's ID (can_Capture_Callback).
+ */
+static void add_frame(const my_CAN_Frame* frame, uint64_t time_us, void* context) {
+	(void)time_us;
+	(void)context;
+	id_Stats* s = find_stats(frame->Identifier);
+	if (s == NULL) return;
+	const uint8_t length = (frame->DataLength > 8) ? 8 : frame->DataLength;
+	uint64_t data = 0;
+	for (int i = 0; i < length; i++) {
+		data |= (uint64_t)frame->Data[i] << (8 * i);
+	}
+
+	if (s->frames == 0) s->first_data = data;
+	s->frames++;
+	s->varying |= data ^ s->first_data;
+	if (length > s->max_bytes) s->max_bytes = length;
+	for (uint64_t bits = data; bits != 0; bits &= bits - 1) {
+		s->ones[__builtin_ctzll(bits)]++;
+	}
+
+	if (s->frames > 1 && length == s->last_bytes) {
+		const uint64_t previous = s->last_data;
+		const uint64_t flipped = data ^ previous;
+		s->transitions++;
+		for (uint64_t bits = flipped; bits != 0; bits &= bits - 1) {
+			s->flips[__builtin_ctzll(bits)]++;
+		}
+		for (uint64_t bits = flipped & (flipped >> 1) & ~(1ULL << 63); bits != 0; bits &= bits - 1) {
+			s->joint_up[__builtin_ctzll(bits)]++;
+		}
+		for (uint64_t bits = flipped & (flipped >> 15) & 0x0001010101010101ULL; bits != 0; bits &= bits - 1) {
+			s->joint_cross[__builtin_ctzll(bits) / 8]++;
+		}
+
+		/* Rolling counters: fields that are the previous value + 1 */
+		for (int i = 0; i < length; i++) {
+			uint8_t current = (uint8_t)(data >> (8 * i));
+			uint8_t last = (uint8_t)(previous >> (8 * i));
+			if (current == last) continue;
+			for (int f = 0; f < COUNTER_FIELDS; f++) {
+				uint8_t mask = (uint8_t)((1U << counter_fields[f][1]) - 1);
+				s->increments[i][f] += ((((current >> counter_fields[f][0]) - (last >> counter_fields[f][0])) & mask) == 1);
+			}
+		}
+
+		if (length >= 2) {
+			uint8_t bytes[8], last_bytes[8];
+			for (int i = 0; i < length; i++) {
+				bytes[i] = (uint8_t)(data >> (8 * i));
+				last_bytes[i] = (uint8_t)(previous >> (8 * i));
+			}
+			checksum_frame(s, bytes, last_bytes, length);
+		}
+	}
+	s->last_data = data;
+	s->last_bytes = length;
+}
+
+/**
+ * @fn static double entropy(double p)
+ * @brief Binary entropy in bits.
+ */
+static double entropy(double p) {
+	if (p <= 0.0 || p >= 1.0) return 0.0;
+	return -p * log2(p) - (1.0 - p) * log2(1.0 - p);
+}
+
+/**
+ * @fn static uint64_t joint_flips(const id_Stats* s, int lower, int upper)
+ * @brief Simultaneous flips of two adjacent bits.
+ */
+static uint64_t joint_flips(const id_Stats* s, int lower, int upper) {
+	if (upper == lower + 1) return s->joint_up[lower];
+	return s->joint_cross[upper / 8];
+}
+
+/**
+ * @fn static double dependence(const id_Stats* s, int lower, int upper)
+ * @brief Uncertainty coefficient of the flips of lower given those of upper.
+ *
+ * @details
+ * (H(lower) - H(lower | upper)) / H(lower) of the flip events: 1 if the
+ * upper bit's flips tell whether the lower bit flips, 0 if independent.
+ */
+static double dependence(const id_Stats* s, int lower, int upper) {
+	const double n = (double)s->transitions;
+	const double n_lower = (double)s->flips[lower];
+	const double n_upper = (double)s->flips[upper];
+	const double n_both = (double)joint_flips(s, lower, upper);
+	const double h_lower = entropy(n_lower / n);
+	if (h_lower == 0.0) return 1.0;
+	double h_conditional = (n_upper / n) * entropy(n_both / n_upper);
+	if (n > n_upper) h_conditional += ((n - n_upper) / n) * entropy((n_lower - n_both) / (n - n_upper));
+	return (h_lower - h_conditional) / h_lower;
+}
+
+/**
+ * @fn static int magnitude(const id_Stats* s, int bit)
+ * @brief Order of magnitude (ceil(log10)) of a bit's flip rate.
+ */
+static int magnitude(const id_Stats* s, int bit) {
+	return (int)ceil(log10((double)s->flips[bit] / s->transitions));
+}
+
+/**
+ * @fn static bool is_boundary(const id_Stats* s, int lower, int upper)
+ * @brief Whether two adjacent varying bits belong to different signals.
+ */
+static bool is_boundary(const id_Stats* s, int lower, int upper) {
+	if (s->flips[lower] == 0 || s->flips[upper] == 0) return true;
+	if (magnitude(s, upper) > magnitude(s, lower)) return true;
+	return s->flips[upper] >= MIN_FLIPS && (double)s->flips[upper] / s->transitions < NOISE_RATE &&
+		   dependence(s, lower, upper) < MIN_DEPENDENCE;
+}
+
+/**
+ * @fn static int bit_order(const id_Stats* s, bool big_endian, int* order)
+ * @brief Bits of the payload from the least to the most significant.
+ *
+ * @details
+ * Intel: bit 0 upwards. Motorola: the last byte first, each byte from bit 0
+ * to bit 7. Returns the number of bits.
+ */
+static int bit_order(const id_Stats* s, bool big_endian, int* order) {
+	int count = 0;
+	for (int i = 0; i < s->max_bytes; i++) {
+		int byte = big_endian ? s->max_bytes - 1 - i : i;
+		for (int bit = 0; bit < 8; bit++) order[count++] = byte * 8 + bit;
+	}
+	return count;
+}
+
+/**
+ * @fn static int split_signals(const id_Stats* s, uint64_t reserved, bool big_endian, signal_Field* fields, int count)
+ * @brief Split the varying, not reserved bits into signals along one byte order.
+ *
+ * @details
+ * Appends to fields from index count, returns the new count.
+ */
+static int split_signals(const id_Stats* s, uint64_t reserved, bool big_endian, signal_Field* fields, int count) {
+	int order[64];
+	const int bits = bit_order(s, big_endian, order);
+	const uint64_t usable = s->varying & ~reserved;
+
+	for (int i = 0; i < bits; i++) {
+		if (!((usable >> order[i]) & 1)) continue;
+		int top = i;
+		while (top + 1 < bits && ((usable >> order[top + 1]) & 1) && !is_boundary(s, order[top], order[top + 1])) {
+			top++;
+		}
+		signal_Field* f = &fields[count++];
+		memset(f, 0, sizeof(*f));
+		f->length = (uint8_t)(top - i + 1);
+		f->big_endian = big_endian && order[i] / 8 != order[top] / 8;
+		f->start = (uint8_t)(f->big_endian ? order[top] : order[i]);
+		if (f->length >= 3) {
+			int msb = order[top], below = order[top - 1];
+			f->is_signed = s->flips[msb] >= MIN_SIGN_FLIPS &&
+						   joint_flips(s, below, msb) >= 0.9 * s->flips[msb] &&
+						   s->flips[below] <= 1.1 * s->flips[msb];
+		}
+		snprintf(f->name, sizeof(f->name), "SIG_%lX_%u", (unsigned long)s->identifier, f->start);
+		snprintf(f->comment, sizeof(f->comment), "flip rate LSB %.3g, MSB %.3g",
+				 (double)s->flips[order[i]] / s->transitions, (double)s->flips[order[top]] / s->transitions);
+		i = top;
+	}
+	return count;
+}
+
+/**
+ * @fn static bool counter_carries(const id_Stats* s, int byte, int field)
+ * @brief Check that the top bit of a counter candidate flips as a counter's would.
+ *
+ * @details
+ * The top bit of an n-bit counter flips once every 2^(n-1) increments;
+ * at least half of that is required.
+ */
+static bool counter_carries(const id_Stats* s, int byte, int field) {
+	const int length = counter_fields[field][1];
+	const int top = 8 * byte + counter_fields[field][0] + length - 1;
+	return 2 * (s->flips[top] << (length - 1)) >= s->transitions;
+}
+
+/**
+ * @fn static int infer_layout(const id_Stats* s, signal_Field* fields, bool* big_endian)
+ * @brief Counters, checksums and signals of one ID. Returns the number of fields.
+ */
+static int infer_layout(const id_Stats* s, signal_Field* fields, bool* big_endian) {
+	uint64_t reserved = 0;
+	int count = 0;
+	*big_endian = false;
+	if (s->transitions < MIN_TRANSITIONS) return 0;
+
+	/* Checksum in the first or the last byte */
+	for (int side = 1; side >= 0 && s->max_bytes >= 2; side--) {
+		const int position = side ? s->max_bytes - 1 : 0;
+		const uint64_t byte_mask = 0xFFULL << (8 * position);
+		if (s->checksum_tests[side] < MIN_TRANSITIONS || (s->varying & byte_mask) == 0) continue;
+		if ((s->varying & ~byte_mask) == 0) continue;
+		int best = -1;
+		for (int kind = CHECKSUM_KINDS - 1; kind >= 0; kind--) {
+			if (s->checksum_matches[side][kind] >= CHECKSUM_RATE * s->checksum_tests[side]) best = kind;
+		}
+		if (best < 0) continue;
+		signal_Field* f = &fields[count++];
+		memset(f, 0, sizeof(*f));
+		f->start = (uint8_t)(8 * position);
+		f->length = 8;
+		snprintf(f->name, sizeof(f->name), "CHECKSUM_%lX", (unsigned long)s->identifier);
+		if (best == CHECKSUM_XOR) {
+			snprintf(f->comment, sizeof(f->comment), "XOR checksum: XOR of all bytes = 0x%02X", s->checksum_value[side][0]);
+		} else if (best == CHECKSUM_SUM) {
+			snprintf(f->comment, sizeof(f->comment), "SUM checksum: sum of the other bytes - checksum = 0x%02X",
+					 s->checksum_value[side][1]);
+		} else {
+			snprintf(f->comment, sizeof(f->comment), "CRC-8 poly 0x%02X over the other bytes (+ unknown init/data ID)",
+					 crc_polynomials[best - CHECKSUM_CRC]);
+		}
+		reserved |= byte_mask;
+		break;
+	}
+
+	/* Rolling counters: the best field per byte, the longest if tied (the
+	 * low bits of a counter are counters as well). A field only counts if
+	 * its top bit carries: a counter that wraps before the top of a longer
+	 * field (e.g. 0..14) increments it as often, but leaves its top bits
+	 * constant. */
+	for (int i = 0; i < s->max_bytes; i++) {
+		if ((reserved >> (8 * i)) & 1) continue;
+		int best = -1;
+		for (int f = 0; f < COUNTER_FIELDS; f++) {
+			if (!counter_carries(s, i, f)) continue;
+			if (best < 0 || s->increments[i][f] + s->transitions / 200 >= s->increments[i][best]) best = f;
+		}
+		if (best < 0 || s->increments[i][best] < COUNTER_RATE * s->transitions) continue;
+		signal_Field* f = &fields[count++];
+		memset(f, 0, sizeof(*f));
+		f->start = (uint8_t)(8 * i + counter_fields[best][0]);
+		f->length = counter_fields[best][1];
+		snprintf(f->name, sizeof(f->name), "COUNTER_%lX_%u", (unsigned long)s->identifier, f->start);
+		snprintf(f->comment, sizeof(f->comment), "%u-bit rolling counter: +1 in %.1f%% of the frames",
+				 f->length, 100.0 * s->increments[i][best] / s->transitions);
+		reserved |= ((1ULL << f->length) - 1) << f->start;
+	}
+
+	/* Signals along the byte order that needs fewer of them */
+	signal_Field intel[64], motorola[64];
+	int intel_count = split_signals(s, reserved, false, intel, 0);
+	int motorola_count = split_signals(s, reserved, true, motorola, 0);
+	*big_endian = motorola_count < intel_count;
+	const signal_Field* chosen = *big_endian ? motorola : intel;
+	for (int i = 0; i < (*big_endian ? motorola_count : intel_count); i++) {
+		fields[count++] = chosen[i];
+	}
+	return count;
+}
+
+/**
+ * @fn static void write_dbc(FILE* out, bool report)
+ * @brief Write the inferred layout of every ID as a DBC file.
+ */
+static void write_dbc(FILE* out, bool report) {
+	signal_Field fields[64];
+	bool big_endian;
+
+	fprintf(out, "VERSION \"\"\n\nNS_ :\n\nBS_:\n\nBU_:\n\n");
+	for (uint32_t i = 0; i < stats_count; i++) {
+		const id_Stats* s = &stats[i];
+		int count = infer_layout(s, fields, &big_endian);
+		uint32_t dbc_id = s->identifier | ((s->identifier > 0x7FF) ? 0x80000000UL : 0);
+		fprintf(out, "BO_ %lu MSG_%lX: %u Vector__XXX\n", (unsigned long)dbc_id, (unsigned long)s->identifier, s->max_bytes);
+		for (int j = 0; j < count; j++) {
+			const signal_Field* f = &fields[j];
+			uint64_t high = (f->length == 64) ? UINT64_MAX : (1ULL << f->length) - 1;
+			if (f->is_signed) {
+				fprintf(out, " SG_ %s : %u|%u@%c- (1,0) [-%llu|%llu] \"\" Vector__XXX\n", f->name, f->start, f->length,
+						f->big_endian ? '0' : '1', (unsigned long long)(high / 2 + 1), (unsigned long long)(high / 2));
+			} else {
+				fprintf(out, " SG_ %s : %u|%u@%c+ (1,0) [0|%llu] \"\" Vector__XXX\n", f->name, f->start, f->length,
+						f->big_endian ? '0' : '1', (unsigned long long)high);
+			}
+		}
+		fprintf(out, "\n");
+
+		if (report) {
+			fprintf(stderr, "0x%03lX  %8llu frames  %-8s ", (unsigned long)s->identifier,
+					(unsigned long long)s->frames, big_endian ? "Motorola" : "Intel");
+			/* Flip rate magnitude per bit, bytes in order, bit 7 first: '.' = constant */
+			for (int byte = 0; byte < s->max_bytes; byte++) {
+				fputc(' ', stderr);
+				for (int bit = 7; bit >= 0; bit--) {
+					int b = byte * 8 + bit;
+					fputc((s->flips[b] == 0) ? '.' : (char)('0' + (-magnitude(s, b) > 9 ? 9 : -magnitude(s, b))), stderr);
+				}
+			}
+			fprintf(stderr, "  %d fields\n", count);
+		}
+	}
+
+	/* Comments: the layout is inferred again, which is cheap */
+	for (uint32_t i = 0; i < stats_count; i++) {
+		const id_Stats* s = &stats[i];
+		int count = infer_layout(s, fields, &big_endian);
+		uint32_t dbc_id = s->identifier | ((s->identifier > 0x7FF) ? 0x80000000UL : 0);
+		fprintf(out, "CM_ BO_ %lu \"%llu frames, %s byte order%s\";\n", (unsigned long)dbc_id,
+				(unsigned long long)s->frames, big_endian ? "Motorola" : "Intel",
+				(s->transitions < MIN_TRANSITIONS) ? ", too few frames to infer a layout" : "");
+		for (int j = 0; j < count; j++) {
+			fprintf(out, "CM_ SG_ %lu %s \"%s\";\n", (unsigned long)dbc_id, fields[j].name, fields[j].comment);
+		}
+	}
+}
+
+/**
+ * @fn static int compare_stats(const void* a, const void* b)
+ * @brief Order by CAN ID.
+ */
+static int compare_stats(const void* a, const void* b) {
+	const id_Stats* x = a;
+	const id_Stats* y = b;
+	return (x->identifier > y->identifier) - (x->identifier < y->identifier);
+}
+
+int main(int argc, char** argv) {
+	const char* output = NULL;
+	bool report = false;
+	int first_capture = 1;
+
+	while (first_capture < argc && argv[first_capture][0] == '-' && argv[first_capture][1] != '\0') {
+		if (strcmp(argv[first_capture], "--report") == 0) {
+			report = true;
+			first_capture++;
+		} else if (strcmp(argv[first_capture], "-o") == 0 && first_capture + 1 < argc) {
+			output = argv[first_capture + 1];
+			first_capture += 2;
+		} else {
+			break;
+		}
+	}
+	if (first_capture >= argc) {
+		printf("Usage: can_layout [--report] [-o layout.dbc] capture [capture ...]\n");
+		return 1;
+	}
+	init_tables();
+
+	struct timespec begin, end;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	can_Capture capture;
+	can_capture_init(&capture, add_frame, NULL);
+	for (int i = first_capture; i < argc; i++) {
+		if (!can_capture_read(&capture, argv[i])) {
+			fprintf(stderr, "Cannot read the capture %s\n", argv[i]);
+			return 1;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) * 1e-9;
+	fprintf(stderr, "%llu frames, %lu IDs over %.1f s of capture, read in %.2f s (%.0f frames/s)\n",
+			(unsigned long long)capture.frames, (unsigned long)stats_count, capture.last_us / 1e6, elapsed,
+			capture.frames / (elapsed > 0 ? elapsed : 1));
+
+	qsort(stats, stats_count, sizeof(id_Stats), compare_stats);
+	FILE* out = output ? fopen(output, "w") : stdout;
+	if (out == NULL) {
+		fprintf(stderr, "Cannot write %s\n", output);
+		return 1;
+	}
+	write_dbc(out, report);
+	if (output) fclose(out);
+	return 0;
+}
@@ -0,0 +1,88 @@
+"""Read CAN<nnnnn>.LOG files written by the SD card logger (can_logger.c).
+
+Checks every block like can_logger_check_block() and stops at the first
+invalid one (the end of the file after a power loss). Prints the frames in
+the firmware text format, prefixed with the timestamp in seconds.
+
+    python can_log.py CAN00003.LOG [CAN00004.LOG ...]
+    python can_log.py --summary CAN00003.LOG
+"""
+
+import struct
+import sys
+import zlib
+
+BLOCK_SIZE = 8192                      # CAN_LOGGER_BLOCK_SIZE
+BLOCK_MAGIC = 0x474F4C43               # "CLOG"
+HEADER = struct.Struct("<6IHHII")      # can_Logger_Block_Header
+WIRE_SYNC = 0xA5
+WIRE_HEADER = struct.Struct("<BBHIIB")  # sync, size, sequence, timestamp, id, dlc
+
+
+def read_blocks(path):
+    """Yield (header fields, payload) of the valid blocks of a log file."""
+    file_id = None
+    with open(path, "rb") as f:
+        index = 0
+        while True:
+            block = f.read(BLOCK_SIZE)
+            if len(block) < BLOCK_SIZE:
+                return
+            (magic, file_number, block_file_id, block_index, first_ts, last_ts,
+             payload_bytes, records, dropped, crc) = HEADER.unpack_from(block)
+            if file_id is None:
+                file_id = block_file_id
+            if (magic != BLOCK_MAGIC or block_file_id != file_id or block_index != index
+                    or payload_bytes > BLOCK_SIZE - HEADER.size):
+                return
+            end = HEADER.size + payload_bytes
+            if zlib.crc32(block[:HEADER.size - 4] + bytes(4) + block[HEADER.size:end]) != crc:
+                return
+            yield {"file_number": file_number, "block_index": block_index, "records": records,
+                   "first_timestamp": first_ts, "last_timestamp": last_ts,
+                   "dropped_frames": dropped}, block[HEADER.size:end]
+            index += 1
+
+
+def read_frames(payload):
+    """Yield (sequence, timestamp, identifier, data) of the wire records of a payload."""
+    offset = 0
+    while offset + WIRE_HEADER.size < len(payload):
+        sync, size, sequence, timestamp, identifier, dlc = WIRE_HEADER.unpack_from(payload, offset)
+        record = payload[offset:offset + size]
+        checksum = 0
+        for b in record[1:-1]:
+            checksum ^= b
+        if sync != WIRE_SYNC or size != WIRE_HEADER.size + dlc + 1 or checksum != record[-1]:
+            raise ValueError("corrupt record at payload offset %d" % offset)
+        yield sequence, timestamp, identifier, record[WIRE_HEADER.size:-1]
+        offset += size
+
+
+def main(argv):
+    summary = "--summary" in argv
+    paths = [a for a in argv if a != "--summary"]
+    if not paths:
+        print(__doc__)
+        return 1
+
+    for path in paths:
+        blocks = frames = gaps = 0
+        next_sequence = None
+        for header, payload in read_blocks(path):
+            blocks += 1
+            for sequence, timestamp, identifier, data in read_frames(payload):
+                frames += 1
+                if next_sequence is not None and sequence != next_sequence:
+                    gaps += (sequence - next_sequence) & 0xFFFF
+                next_sequence = (sequence + 1) & 0xFFFF
+                if not summary:
+                    print("%.6f ID: 0x%03X, DLC: %d, Data: %s" % (
+                        timestamp / 1e6, identifier, len(data), " ".join("%02X" % b for b in data)))
+        print("%s: %d valid blocks, %d frames, %d frames missing" % (path, blocks, frames, gaps),
+              file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
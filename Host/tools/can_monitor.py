@@ -0,0 +1,283 @@
+"""Live terminal bus monitor (in the spirit of can-utils cansniffer).
+
+One row per CAN ID with its frame count, mean period and last payload. Bytes
+that changed are highlighted and fade out (red, then yellow, then normal),
+so the signals that react to an action on the vehicle stand out. Frames come
+from the capture daemon (can_daemon.py).
+
+The screen is redrawn at most REFRESH_HZ times per second and only the rows
+whose content or highlight changed are rewritten, so the monitor keeps up
+with a loaded bus (10k+ frames/s) over a slow terminal.
+
+    python can_monitor.py [--socket PATH]
+
+Keys:
+    s       cycle sort order (ID, count, period, last change)
+    f       filter, e.g. "100-1FF,7DF" (IDs/ranges) or "700/F00" (ID/mask)
+    h       hide IDs whose payload did not change for STATIC_S seconds
+    c       clear the table
+    space   pause the display (frames are still counted)
+    q       quit
+"""
+
+import argparse
+import curses
+import select
+import sys
+import time
+
+from can_stream import DAEMON_SOCKET, StreamDecoder, connect_daemon, parse_filter
+
+REFRESH_HZ = 30       # maximum screen updates per second
+HOT_S = 0.3           # changed bytes are red for this long...
+WARM_S = 1.5          # ...then yellow until this age
+STATIC_S = 5.0        # "static" IDs for the h key
+PERIOD_WEIGHT = 1 / 8  # EWMA weight of a new period sample
+READ_LIMIT = 1 << 18  # bytes read between two screen updates at most
+
+SORT_KEYS = ("id", "count", "period", "change")
+
+# highlight levels of a payload byte
+NORMAL, WARM, HOT = 0, 1, 2
+
+
+class IdState:
+    """Per-ID state of the table."""
+
+    __slots__ = ("identifier", "count", "period", "last_timestamp", "data", "changed_at", "last_change")
+
+    def __init__(self, identifier):
+        self.identifier = identifier
+        self.count = 0
+        self.period = None         # mean period in microseconds
+        self.last_timestamp = None
+        self.data = b""
+        self.changed_at = []       # host time of the last change of each byte
+        self.last_change = 0.0
+
+
+class BusModel:
+    """Frame table, independent of the display."""
+
+    def __init__(self):
+        self.ids = {}
+        self.frames = 0
+        self.missing = 0
+        self.next_sequence = None
+
+    def clear(self):
+        self.__init__()
+
+    def ingest(self, frames, now):
+        ids = self.ids
+        for frame in frames:
+            if frame.sequence is not None:
+                if self.next_sequence is not None and frame.sequence != self.next_sequence:
+                    self.missing += (frame.sequence - self.next_sequence) & 0xFFFF
+                self.next_sequence = (frame.sequence + 1) & 0xFFFF
+            state = ids.get(frame.identifier)
+            if state is None:
+                state = ids[frame.identifier] = IdState(frame.identifier)
+            if state.last_timestamp is not None:
+                delta = (frame.timestamp - state.last_timestamp) & 0xFFFFFFFF
+                if state.period is None:
+                    state.period = delta
+                else:
+                    state.period += (delta - state.period) * PERIOD_WEIGHT
+            state.last_timestamp = frame.timestamp
+            state.count += 1
+            data = frame.data
+            if data != state.data:
+                old = state.data
+                if len(data) != len(old):
+                    state.changed_at = [now] * len(data)
+                else:
+                    changed_at = state.changed_at
+                    for i in range(len(data)):
+                        if data[i] != old[i]:
+                            changed_at[i] = now
+                state.data = data
+                state.last_change = now
+        self.frames += len(frames)
+
+    def rows(self, sort_key, match, hide_static, now):
+        """IDs to display, filtered and sorted."""
+        rows = [s for s in self.ids.values() if match(s.identifier)]
+        if hide_static:
+            rows = [s for s in rows if now - s.last_change < STATIC_S]
+        if sort_key == "count":
+            rows.sort(key=lambda s: -s.count)
+        elif sort_key == "period":
+            rows.sort(key=lambda s: (s.period is None, s.period or 0))
+        elif sort_key == "change":
+            rows.sort(key=lambda s: -s.last_change)
+        else:
+            rows.sort(key=lambda s: s.identifier)
+        return rows
+
+
+def highlight(age):
+    return HOT if age < HOT_S else WARM if age < WARM_S else NORMAL
+
+
+def row_cells(state, now):
+    """(text, highlight) cells of a table row. Equal cells mean an equal row."""
+    if state.period is None:
+        period = "       -"
+    elif state.period >= 1e6:
+        period = "%6.2f s" % (state.period / 1e6)
+    else:
+        period = "%5.1f ms" % (state.period / 1e3)
+    cells = [("%8X  %9d  %s  " % (state.identifier, state.count, period), NORMAL)]
+    for value, changed_at in zip(state.data, state.changed_at):
+        cells.append(("%02X" % value, highlight(now - changed_at)))
+        cells.append((" ", NORMAL))
+    return tuple(cells)
+
+
+class Screen:
+    """curses view that rewrites only the rows that changed."""
+
+    HEADER = "      ID      Count    Period  Data"
+
+    def __init__(self, window):
+        self.window = window
+        self.lines = {}  # screen line -> cells shown
+        curses.curs_set(0)
+        window.nodelay(True)
+        curses.start_color()
+        curses.use_default_colors()
+        curses.init_pair(1, curses.COLOR_RED, -1)
+        curses.init_pair(2, curses.COLOR_YELLOW, -1)
+        self.attributes = {NORMAL: curses.A_NORMAL,
+                           WARM: curses.color_pair(2) | curses.A_BOLD,
+                           HOT: curses.color_pair(1) | curses.A_BOLD | curses.A_REVERSE}
+
+    def put(self, line, cells):
+        if self.lines.get(line) == cells:
+            return
+        self.lines[line] = cells
+        height, width = self.window.getmaxyx()
+        if line >= height:
+            return
+        self.window.move(line, 0)
+        self.window.clrtoeol()
+        column = 0
+        for text, level in cells:
+            text = text[:max(0, width - 1 - column)]
+            if text:
+                self.window.addstr(line, column, text, self.attributes[level])
+                column += len(text)
+
+    def draw(self, status, rows, now):
+        height, _ = self.window.getmaxyx()
+        self.put(0, ((status, NORMAL),))
+        self.put(1, ((self.HEADER, NORMAL),))
+        line = 2
+        for state in rows[:max(0, height - 2)]:
+            self.put(line, row_cells(state, now))
+            line += 1
+        for stale in [l for l in self.lines if l >= line]:
+            self.put(stale, ())
+            del self.lines[stale]
+        self.window.noutrefresh()
+        curses.doupdate()
+
+    def resized(self):
+        self.lines.clear()
+        self.window.erase()
+
+    def prompt(self, question):
+        height, _ = self.window.getmaxyx()
+        self.window.nodelay(False)
+        curses.echo()
+        curses.curs_set(1)
+        self.window.move(height - 1, 0)
+        self.window.clrtoeol()
+        self.window.addstr(height - 1, 0, question)
+        answer = self.window.getstr(height - 1, len(question), 40).decode(errors="replace")
+        curses.noecho()
+        curses.curs_set(0)
+        self.window.nodelay(True)
+        self.lines.pop(height - 1, None)
+        return answer
+
+
+def monitor(window, sock):
+    screen = Screen(window)
+    model = BusModel()
+    decoder = StreamDecoder()
+    sort_index = 0
+    filter_text = ""
+    match = parse_filter(filter_text)
+    hide_static = False
+    paused = False
+    next_draw = 0.0
+    rate_start, rate_frames, rate = time.monotonic(), 0, 0.0
+
+    while True:
+        now = time.monotonic()
+        received = 0
+        while received < READ_LIMIT and select.select([sock], [], [], max(0.0, next_draw - now))[0]:
+            data = sock.recv(65536)
+            if not data:
+                return "capture daemon closed the connection"
+            received += len(data)
+            frames, _ = decoder.feed(data)
+            now = time.monotonic()
+            model.ingest(frames, now)
+
+        key = window.getch()
+        if key in (ord("q"), ord("Q")):
+            return None
+        elif key == ord("s"):
+            sort_index = (sort_index + 1) % len(SORT_KEYS)
+        elif key == ord("f"):
+            text = screen.prompt("Filter (e.g. 100-1FF,7DF or 700/F00): ")
+            try:
+                match, filter_text = parse_filter(text), text.strip()
+            except ValueError:
+                pass
+        elif key == ord("h"):
+            hide_static = not hide_static
+        elif key == ord("c"):
+            model.clear()
+        elif key == ord(" "):
+            paused = not paused
+        elif key == curses.KEY_RESIZE:
+            screen.resized()
+
+        now = time.monotonic()
+        if now >= next_draw:
+            next_draw = now + 1 / REFRESH_HZ
+            if now - rate_start >= 1.0:
+                rate = (model.frames - rate_frames) / (now - rate_start)
+                rate_start, rate_frames = now, model.frames
+            if not paused or key != -1:
+                status = "%d IDs  %d frames  %.0f frames/s  %d missing  sort: %s%s%s%s" % (
+                    len(model.ids), model.frames, rate, model.missing, SORT_KEYS[sort_index],
+                    "  filter: " + filter_text if filter_text else "",
+                    "  changing only" if hide_static else "", "  PAUSED" if paused else "")
+                screen.draw(status, model.rows(SORT_KEYS[sort_index], match, hide_static, now), now)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--socket", default=DAEMON_SOCKET, help="capture daemon socket (default %(default)s)")
+    args = parser.parse_args()
+    try:
+        sock = connect_daemon(args.socket)
+    except OSError as error:
+        print("Cannot connect to the capture daemon at %s: %s" % (args.socket, error), file=sys.stderr)
+        return 1
+    try:
+        message = curses.wrapper(monitor, sock)
+    except KeyboardInterrupt:
+        message = None
+    if message:
+        print(message, file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
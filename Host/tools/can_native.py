@@ -0,0 +1,242 @@
+"""NumPy bindings of the native capture decoder (can_batch.c).
+
+Parsing a capture line by line in Python costs a few microseconds per frame.
+The native library decodes captures (any format of can_capture.c) and the
+capture daemon stream into columns, and this module exposes them as NumPy
+arrays over the library memory: no copy, no Python object per frame.
+
+    batch = Batch.read("capture.bin")
+    batch.identifier, batch.time_us, batch.data      # NumPy views
+    t, speed = batch.extract(signal)                  # can_signals.Signal
+    for batch in stream(connect_daemon()):            # live, one batch per read
+        ...
+
+The views are only valid until the batch is read into, fed, cleared or
+freed (the columns move when they grow): copy what must be kept. Times are
+in seconds since the first frame of the batch, not device time as in
+can_signals.SignalDecoder.
+
+Build the library first (see can_batch.c), to libcan_batch.so next to this
+file or to the path in CAN_NATIVE_LIBRARY. Compare with the Python decoder:
+
+    python can_native.py capture.bin dashboard.toml --compare
+"""
+
+import argparse
+import ctypes
+import os
+import sys
+import time
+
+import numpy as np
+
+from can_signals import SignalDecoder, load_signals
+from can_stream import StreamDecoder
+
+LIBRARY = os.environ.get("CAN_NATIVE_LIBRARY", os.path.join(os.path.dirname(os.path.abspath(__file__)), "libcan_batch.so"))
+READ_SIZE = 1 << 20  # bytes received from the daemon at most per batch
+
+
+class CBatch(ctypes.Structure):
+    """Leading fields of can_Batch (can_batch.h)."""
+    _fields_ = [("time_us", ctypes.POINTER(ctypes.c_uint64)),
+                ("identifier", ctypes.POINTER(ctypes.c_uint32)),
+                ("channel", ctypes.POINTER(ctypes.c_uint8)),
+                ("dlc", ctypes.POINTER(ctypes.c_uint8)),
+                ("data", ctypes.POINTER(ctypes.c_uint8)),
+                ("rows", ctypes.c_uint64),
+                ("capacity", ctypes.c_uint64),
+                ("failed", ctypes.c_bool)]
+
+
+def load_library(path=LIBRARY):
+    lib = ctypes.CDLL(path)
+    batch = ctypes.POINTER(CBatch)
+    lib.can_batch_new.restype = batch
+    lib.can_batch_new.argtypes = []
+    lib.can_batch_free.restype = None
+    lib.can_batch_free.argtypes = [batch]
+    lib.can_batch_clear.restype = None
+    lib.can_batch_clear.argtypes = [batch]
+    lib.can_batch_read.restype = ctypes.c_bool
+    lib.can_batch_read.argtypes = [batch, ctypes.c_char_p]
+    lib.can_batch_feed.restype = ctypes.c_uint32
+    lib.can_batch_feed.argtypes = [batch, ctypes.c_void_p, ctypes.c_uint32]
+    lib.can_batch_extract.restype = ctypes.c_uint64
+    lib.can_batch_extract.argtypes = [batch, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_bool,
+                                      ctypes.c_bool, ctypes.c_double, ctypes.c_double,
+                                      ctypes.c_void_p, ctypes.c_void_p]
+    return lib
+
+
+_lib = None
+
+
+def library():
+    global _lib
+    if _lib is None:
+        _lib = load_library()
+    return _lib
+
+
+def _column(pointer, rows, dtype, shape=()):
+    if rows == 0:
+        return np.empty((0,) + shape, dtype)
+    return np.ctypeslib.as_array(pointer, (rows,) + shape).view(dtype)
+
+
+class Batch:
+    """Frames as columns: time_us, identifier, channel, dlc (N) and data (N x 8)."""
+
+    def __init__(self):
+        self._lib = library()
+        self._batch = self._lib.can_batch_new()
+        if not self._batch:
+            raise MemoryError("can_batch_new")
+
+    @classmethod
+    def read(cls, *paths):
+        """Batch of the frames of capture files, on one time line."""
+        batch = cls()
+        for path in paths:
+            if not batch._lib.can_batch_read(batch._batch, os.fsencode(path)):
+                raise OSError("cannot read %s" % path)
+        return batch
+
+    def feed(self, buffer, length=None):
+        """Append the wire records of a received buffer (bytes, bytearray, memoryview).
+        Returns the number of bytes consumed: the rest must be fed again with the next bytes."""
+        view = memoryview(buffer)
+        length = len(view) if length is None else length
+        if length == 0:
+            return 0
+        if view.readonly:
+            pointer = buffer if isinstance(buffer, bytes) else bytes(view[:length])
+        else:
+            pointer = ctypes.addressof(ctypes.c_char.from_buffer(view))
+        used = self._lib.can_batch_feed(self._batch, pointer, length)
+        if self._batch.contents.failed:
+            raise MemoryError("can_batch_feed")
+        return used
+
+    def clear(self):
+        self._lib.can_batch_clear(self._batch)
+
+    def close(self):
+        if self._batch:
+            self._lib.can_batch_free(self._batch)
+            self._batch = None
+
+    def __del__(self):
+        self.close()
+
+    def __len__(self):
+        return self._batch.contents.rows
+
+    @property
+    def time_us(self):
+        batch = self._batch.contents
+        return _column(batch.time_us, batch.rows, np.uint64)
+
+    @property
+    def identifier(self):
+        batch = self._batch.contents
+        return _column(batch.identifier, batch.rows, np.uint32)
+
+    @property
+    def channel(self):
+        batch = self._batch.contents
+        return _column(batch.channel, batch.rows, np.uint8)
+
+    @property
+    def dlc(self):
+        batch = self._batch.contents
+        return _column(batch.dlc, batch.rows, np.uint8)
+
+    @property
+    def data(self):
+        batch = self._batch.contents
+        return _column(batch.data, batch.rows, np.uint8, (8,))
+
+    def extract(self, signal):
+        """(times, values) float64 arrays of a can_signals.Signal over the batch."""
+        rows = len(self)
+        times = np.empty(rows, np.float64)
+        values = np.empty(rows, np.float64)
+        count = self._lib.can_batch_extract(self._batch, signal.identifier, signal.start, signal.length,
+                                            signal.byte_order == "big", signal.signed, signal.scale, signal.offset,
+                                            times.ctypes.data, values.ctypes.data)
+        return times[:count], values[:count]
+
+
+def stream(sock, batch=None):
+    """Batches of the frames received from the capture daemon socket, one per read.
+    The same Batch is cleared and yielded again: use it before the next iteration."""
+    batch = batch or Batch()
+    buffer = bytearray(READ_SIZE + 64)
+    view = memoryview(buffer)
+    kept = 0
+    while True:
+        got = sock.recv_into(view[kept:kept + READ_SIZE])
+        if not got:
+            return
+        batch.clear()
+        used = batch.feed(buffer, kept + got)
+        kept = kept + got - used
+        buffer[:kept] = buffer[used:used + kept]
+        yield batch
+
+
+def python_decode(path, signals):
+    """The same samples with the Python decoder, for --compare."""
+    decoder = SignalDecoder(signals)
+    stream_decoder = StreamDecoder()
+    samples = {signal.name: [] for signal in signals}
+    with open(path, "rb") as f:
+        while True:
+            data = f.read(65536)
+            if not data:
+                break
+            frames, _ = stream_decoder.feed(data)
+            for signal, t, value in decoder.decode(frames):
+                samples[signal.name].append(value)
+    return samples
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", help="capture file (any format read by can_capture.c)")
+    parser.add_argument("config", help="signal definitions (TOML, as dashboard.toml)")
+    parser.add_argument("--compare", action="store_true",
+                        help="also decode a wire record capture with can_stream/can_signals and compare")
+    args = parser.parse_args()
+    signals = load_signals(args.config)
+
+    start = time.perf_counter()
+    batch = Batch.read(args.capture)
+    read_s = time.perf_counter() - start
+    start = time.perf_counter()
+    extracted = {signal.name: batch.extract(signal) for signal in signals}
+    extract_s = time.perf_counter() - start
+    print("%d frames, %d IDs: read %.1f ms (%.0f ns/frame), %d signals extracted in %.1f ms" % (
+        len(batch), len(np.unique(batch.identifier)), read_s * 1e3, read_s * 1e9 / max(1, len(batch)),
+        len(signals), extract_s * 1e3))
+    for name, (times, values) in extracted.items():
+        if len(values):
+            print("  %s: %d samples, min %g, max %g, mean %g" % (name, len(values), values.min(), values.max(), values.mean()))
+        else:
+            print("  %s: no samples" % name)
+
+    if args.compare:
+        start = time.perf_counter()
+        samples = python_decode(args.capture, signals)
+        python_s = time.perf_counter() - start
+        print("Python decoder: %.1f ms (%.1fx)" % (python_s * 1e3, python_s / (read_s + extract_s)))
+        for name, values in samples.items():
+            same = np.array_equal(np.array(values, np.float64), extracted[name][1])
+            print("  %s: %d samples, %s" % (name, len(values), "same values" if same else "DIFFERENT"))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,357 @@
+"""Multi-resolution min/max/mean pyramid store of decoded signals.
+
+Plotting a signal over a whole drive should not mean decoding the whole
+capture again. The store keeps, for every signal, its raw samples and a
+pyramid of min/max/mean summaries at power-of-two time resolutions, so any
+zoom level reads a bounded number of points.
+
+A store is a directory:
+
+    pyramid.json      base period, number of levels, signal definitions
+    <signal>/raw.bin  samples: time (s), value                   RAW
+    <signal>/L00.bin  one record per non-empty bucket of         LEVEL
+    ...               BASE_PERIOD * 2^level seconds: start time (s),
+    <signal>/L23.bin  sample count, min, max, mean
+
+Every file is a flat array of little-endian float64 records without header,
+appended in time order, so it can be memory-mapped as is (numpy.memmap with
+a structured dtype, or mmap + memoryview.cast("d") as query() does) and
+searched by start time.
+
+The pyramid is built incrementally as samples arrive: a bucket is written
+when the first sample of the next bucket arrives, then merged into the
+bucket of the next level. Files are written finest first every FLUSH_PERIOD,
+so after a crash a coarse level can only lag behind the finer ones; when a
+store is reopened, the open buckets of every level are rebuilt from the
+finer level (a partial record at the end of a file is cut). Samples not yet
+in a closed bucket are found by query() in the finer levels and in the raw
+samples. Time is the device time of can_signals.SignalDecoder; if it goes
+back (sniffer restarted), later samples are shifted to continue the store.
+
+    python can_pyramid.py record dashboard.toml /var/lib/can/pyramid
+    python can_pyramid.py record dashboard.toml pyramid --file capture.bin
+    python can_pyramid.py query pyramid speed 0 36000 --points 1000
+"""
+
+import argparse
+import bisect
+import json
+import mmap
+import os
+import struct
+import sys
+import time
+
+from can_signals import SignalDecoder, load_signals
+from can_stream import DAEMON_SOCKET, StreamDecoder, connect_daemon
+
+BASE_PERIOD = 0.01           # seconds per bucket of level 0 (new stores)
+LEVELS = 24                  # levels 0 .. 23: 10 ms .. 23 h buckets
+FLUSH_PERIOD = 1.0           # seconds between file writes at most
+DEFAULT_POINTS = 1000        # query resolution
+META_NAME = "pyramid.json"
+RAW = struct.Struct("<dd")       # time, value
+LEVEL = struct.Struct("<ddddd")  # start, count, min, max, mean
+RAW_NAME = "raw.bin"
+LEVEL_NAME = "L%02d.bin"
+
+
+class Records:
+    """Memory-mapped, read-only view of a record file, indexed by record start time."""
+
+    def __init__(self, path, record):
+        self.stride = record.size // 8
+        self.map = None
+        self.doubles = memoryview(b"").cast("d")
+        try:
+            with open(path, "rb") as f:
+                size = os.fstat(f.fileno()).st_size // record.size * record.size
+                if size:
+                    self.map = mmap.mmap(f.fileno(), size, access=mmap.ACCESS_READ)
+                    self.doubles = memoryview(self.map).cast("d")
+        except FileNotFoundError:
+            pass
+
+    def __len__(self):
+        return len(self.doubles) // self.stride
+
+    def __getitem__(self, i):
+        """Start time of record i (what bisect searches)."""
+        return self.doubles[i * self.stride]
+
+    def record(self, i):
+        return tuple(self.doubles[i * self.stride:(i + 1) * self.stride])
+
+    def close(self):
+        self.doubles.release()
+        if self.map is not None:
+            self.map.close()
+
+
+class SignalPyramid:
+    """Raw samples and pyramid files of one signal, opened for appending."""
+
+    def __init__(self, directory, base_period=BASE_PERIOD, levels=LEVELS):
+        os.makedirs(directory, exist_ok=True)
+        self.directory = directory
+        self.base_period = base_period
+        self.levels = levels
+        self.paths = [os.path.join(directory, RAW_NAME)] + [os.path.join(directory, LEVEL_NAME % level)
+                                                               for level in range(levels)]
+        self.pending = [bytearray() for _ in self.paths]
+        self.open = [None] * levels  # per level: [index, count, min, max, total]
+        self.last_time = None
+        self.shift = 0.0
+        self.samples = 0
+        self.recover()
+
+    def width(self, level):
+        return self.base_period * (1 << level)
+
+    def recover(self):
+        """Cut partial records and rebuild the open buckets from the finer levels."""
+        for number, path in enumerate(self.paths):
+            record = RAW if number == 0 else LEVEL
+            with open(path, "ab") as f:
+                size = f.tell()
+                if size % record.size:
+                    f.truncate(size - size % record.size)
+
+        raw = Records(self.paths[0], RAW)
+        try:
+            if len(raw):
+                self.last_time = raw.record(len(raw) - 1)[0]
+        finally:
+            raw.close()
+
+        for level in range(self.levels):
+            source = Records(self.paths[level], RAW if level == 0 else LEVEL)
+            closed = Records(self.paths[level + 1], LEVEL)
+            try:
+                # compare bucket indexes, not float start times
+                first = 0
+                last_index = round(closed[len(closed) - 1] / self.width(level)) if len(closed) else None
+                if last_index is not None:
+                    source_width = self.width(level - 1) if level else self.base_period
+                    first = bisect.bisect_left(source, (last_index + 1) * self.width(level) - source_width / 2)
+                for i in range(first, len(source)):
+                    if level == 0:
+                        t, value = source.record(i)
+                        index = int(t // self.base_period)
+                        if last_index is None or index > last_index:
+                            self.add(0, index, 1, value, value, value, False)
+                    else:
+                        start, count, minimum, maximum, mean = source.record(i)
+                        index = round(start / self.width(level - 1)) >> 1
+                        self.add(level, index, int(count), minimum, maximum, mean * count, False)
+            finally:
+                source.close()
+                closed.close()
+            self.write(level + 1)
+
+    def append(self, t, value):
+        t += self.shift
+        if self.last_time is not None and t < self.last_time:
+            self.shift += self.last_time - t
+            t = self.last_time
+        self.last_time = t
+        self.samples += 1
+        self.pending[0] += RAW.pack(t, value)
+        self.add(0, int(t // self.base_period), 1, value, value, value)
+
+    def add(self, level, index, count, minimum, maximum, total, cascade=True):
+        """Merge a sample or a closed bucket of the level below into the open bucket of level."""
+        bucket = self.open[level]
+        if bucket is not None and bucket[0] != index:
+            self.close_bucket(level, cascade)
+            bucket = None
+        if bucket is None:
+            self.open[level] = [index, count, minimum, maximum, total]
+            return
+        bucket[1] += count
+        if minimum < bucket[2]:
+            bucket[2] = minimum
+        if maximum > bucket[3]:
+            bucket[3] = maximum
+        bucket[4] += total
+
+    def close_bucket(self, level, cascade=True):
+        index, count, minimum, maximum, total = self.open[level]
+        self.open[level] = None
+        self.pending[level + 1] += LEVEL.pack(index * self.width(level), count, minimum, maximum, total / count)
+        if cascade and level + 1 < self.levels:
+            self.add(level + 1, index >> 1, count, minimum, maximum, total)
+
+    def write(self, number):
+        if self.pending[number]:
+            with open(self.paths[number], "ab") as f:
+                f.write(self.pending[number])
+            self.pending[number] = bytearray()
+
+    def flush(self):
+        """Write the pending records, finest first."""
+        for number in range(len(self.paths)):
+            self.write(number)
+
+
+class PyramidStore:
+    """Pyramid store directory of a set of signals, opened for appending."""
+
+    def __init__(self, directory, signals, base_period=BASE_PERIOD, levels=LEVELS):
+        os.makedirs(directory, exist_ok=True)
+        meta_path = os.path.join(directory, META_NAME)
+        meta = {"base_period": base_period, "levels": levels, "signals": {}}
+        if os.path.exists(meta_path):
+            with open(meta_path) as f:
+                meta = json.load(f)  # an existing store keeps its resolutions
+        for signal in signals:
+            meta["signals"][signal.name] = {
+                "id": signal.identifier, "start": signal.start, "length": signal.length,
+                "byte_order": signal.byte_order, "signed": signal.signed, "scale": signal.scale,
+                "offset": signal.offset, "unit": signal.unit}
+        with open(meta_path + ".tmp", "w") as f:
+            json.dump(meta, f, indent=1)
+        os.replace(meta_path + ".tmp", meta_path)
+
+        self.directory = directory
+        self.decoder = SignalDecoder(signals)
+        self.pyramids = {signal.name: SignalPyramid(os.path.join(directory, signal.name), meta["base_period"],
+                                                    meta["levels"]) for signal in signals}
+        self.last_flush = time.monotonic()
+
+    def ingest(self, frames):
+        pyramids = self.pyramids
+        for signal, t, value in self.decoder.decode(frames):
+            pyramids[signal.name].append(t, value)
+        if time.monotonic() - self.last_flush >= FLUSH_PERIOD:
+            self.flush()
+
+    def flush(self):
+        for pyramid in self.pyramids.values():
+            pyramid.flush()
+        self.last_flush = time.monotonic()
+
+    def close(self):
+        self.flush()
+
+
+def read_meta(directory):
+    with open(os.path.join(directory, META_NAME)) as f:
+        return json.load(f)
+
+
+def query(directory, name, begin, end, points=DEFAULT_POINTS, meta=None):
+    """(start, min, max, mean) of the finest level with at most points buckets over
+    [begin, end), followed by the finer levels and raw samples after its last closed
+    bucket (at most one record per level and the samples of one base period, unless
+    the store is not flushed). Raw samples (start = time, min = max = mean = value)
+    are returned instead when there are no more than points of them in the range."""
+    meta = meta or read_meta(directory)
+    base_period, levels = meta["base_period"], meta["levels"]
+    signal_directory = os.path.join(directory, name)
+    if not os.path.isdir(signal_directory):
+        raise KeyError("no signal %s in %s" % (name, directory))
+
+    raw = Records(os.path.join(signal_directory, RAW_NAME), RAW)
+    try:
+        first, last = bisect.bisect_left(raw, begin), bisect.bisect_left(raw, end)
+        if last - first <= points:
+            return [(t, value, value, value) for t, value in map(raw.record, range(first, last))]
+    finally:
+        raw.close()
+
+    level = 0
+    while level + 1 < levels and base_period * (1 << level) * points < end - begin:
+        level += 1
+
+    result = []
+    covered = begin
+    for current in range(level, -1, -1):
+        records = Records(os.path.join(signal_directory, LEVEL_NAME % current), LEVEL)
+        try:
+            width = base_period * (1 << current)
+            # the first bucket may start before begin
+            first = bisect.bisect_right(records, covered - width)
+            last = bisect.bisect_left(records, end)
+            appended = False
+            for i in range(first, last):
+                start, _, minimum, maximum, mean = records.record(i)
+                if start >= covered - width / 2 or not result:
+                    result.append((start, minimum, maximum, mean))
+                    appended = True
+            if appended:
+                covered = max(covered, result[-1][0] + width)
+        finally:
+            records.close()
+    raw = Records(os.path.join(signal_directory, RAW_NAME), RAW)
+    try:
+        for i in range(bisect.bisect_left(raw, covered), bisect.bisect_left(raw, end)):
+            t, value = raw.record(i)
+            result.append((t, value, value, value))
+    finally:
+        raw.close()
+    return result
+
+
+def record(args):
+    store = PyramidStore(args.store, load_signals(args.config), args.base_period)
+    stream = StreamDecoder()
+    try:
+        if args.file:
+            import can_daemon
+            batch = []
+            for frame in can_daemon.file_frames(args.file):
+                batch.append(frame)
+                if len(batch) >= 4096:
+                    store.ingest(batch)
+                    batch = []
+            store.ingest(batch)
+        else:
+            sock = connect_daemon(args.socket)
+            while True:
+                data = sock.recv(65536)
+                if not data:
+                    break
+                frames, _ = stream.feed(data)
+                store.ingest(frames)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        store.close()
+    for name, pyramid in store.pyramids.items():
+        print("%s: %d samples" % (name, pyramid.samples), file=sys.stderr)
+    return 0
+
+
+def print_query(args):
+    start = time.perf_counter()
+    rows = query(args.store, args.signal, args.begin, args.end, args.points)
+    print("time,min,max,mean")
+    for row in rows:
+        print("%.6f,%g,%g,%g" % row)
+    print("%d points in %.1f ms" % (len(rows), (time.perf_counter() - start) * 1e3), file=sys.stderr)
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+    recorder = commands.add_parser("record", help="decode frames into a pyramid store")
+    recorder.add_argument("config", help="signal definitions (TOML, as dashboard.toml)")
+    recorder.add_argument("store", help="pyramid store directory")
+    recorder.add_argument("--file", help="read a capture, log file or capture store instead of the daemon")
+    recorder.add_argument("--socket", default=DAEMON_SOCKET, help="capture daemon socket (default %(default)s)")
+    recorder.add_argument("--base-period", type=float, default=BASE_PERIOD,
+                          help="level 0 bucket (s) of a new store (default %(default)s)")
+    reader = commands.add_parser("query", help="print a time range of a signal as CSV")
+    reader.add_argument("store", help="pyramid store directory")
+    reader.add_argument("signal", help="signal name")
+    reader.add_argument("begin", type=float, help="start time (s)")
+    reader.add_argument("end", type=float, help="end time (s)")
+    reader.add_argument("--points", type=int, default=DEFAULT_POINTS, help="resolution (default %(default)s)")
+    args = parser.parse_args()
+    return record(args) if args.command == "record" else print_query(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,184 @@
+"""Signal decoding and history shared by the host tools.
+
+A Signal is a bit field of the payload of one CAN ID, scaled to a physical
+value, defined like a DBC signal: start bit and length, byte order
+("little" = Intel, "big" = Motorola with the DBC start bit of the MSB),
+signedness, scale and offset.
+
+SignalDecoder turns the frame stream of the capture daemon into
+(signal, time, value) samples, SignalHistory keeps the recent samples of a
+signal and lttb() decimates them for plotting.
+"""
+
+import bisect
+import tomllib
+
+TIMESTAMP_WRAP = 1 << 32  # device timestamps are 32-bit microseconds
+
+
+class Signal:
+    __slots__ = ("name", "identifier", "start", "length", "byte_order", "signed", "scale", "offset",
+                 "unit", "minimum", "maximum", "_mask", "_msb")
+
+    def __init__(self, name, identifier, start, length, byte_order="little", signed=False,
+                 scale=1.0, offset=0.0, unit="", minimum=None, maximum=None):
+        if byte_order not in ("little", "big"):
+            raise ValueError("%s: byte_order must be little or big" % name)
+        if not 1 <= length <= 64:
+            raise ValueError("%s: length must be 1..64" % name)
+        self.name = name
+        self.identifier = identifier
+        self.start = start
+        self.length = length
+        self.byte_order = byte_order
+        self.signed = signed
+        self.scale = scale
+        self.offset = offset
+        self.unit = unit
+        self.minimum = minimum
+        self.maximum = maximum
+        self._mask = (1 << length) - 1
+        # big-endian: position of the MSB counted from the first bit on the wire
+        self._msb = (start // 8) * 8 + 7 - start % 8
+
+    @classmethod
+    def from_config(cls, name, entry):
+        """Signal of a config table (keys as the constructor, id as int or "0x..")."""
+        identifier = entry["id"]
+        if isinstance(identifier, str):
+            identifier = int(identifier, 0)
+        return cls(name, identifier, entry["start"], entry["length"], entry.get("byte_order", "little"),
+                   entry.get("signed", False), entry.get("scale", 1.0), entry.get("offset", 0.0),
+                   entry.get("unit", ""), entry.get("min"), entry.get("max"))
+
+    def raw(self, data):
+        """Raw (unscaled) value, or None if the payload is too short."""
+        if self.byte_order == "little":
+            if self.start + self.length > len(data) * 8:
+                return None
+            value = (int.from_bytes(data, "little") >> self.start) & self._mask
+        else:
+            lsb = self._msb + self.length - 1
+            if lsb >= len(data) * 8:
+                return None
+            value = (int.from_bytes(data, "big") >> (len(data) * 8 - 1 - lsb)) & self._mask
+        if self.signed and value >> (self.length - 1):
+            value -= 1 << self.length
+        return value
+
+    def decode(self, data):
+        """Physical value, or None if the payload is too short."""
+        value = self.raw(data)
+        if value is None:
+            return None
+        return value * self.scale + self.offset
+
+
+def load_signals(config_path):
+    """Signals of the [signals.<name>] tables of a config file (see dashboard.toml)."""
+    with open(config_path, "rb") as f:
+        config = tomllib.load(f)
+    return [Signal.from_config(name, entry) for name, entry in config.get("signals", {}).items()]
+
+
+class SignalDecoder:
+    """Decodes the signals of a set of definitions from a frame stream."""
+
+    def __init__(self, signals):
+        self.by_id = {}
+        for signal in signals:
+            self.by_id.setdefault(signal.identifier, []).append(signal)
+        self._last_timestamp = None
+        self._epoch = 0
+
+    def time_of(self, frame):
+        """Frame time in seconds, with the 32-bit timestamp unwrapped."""
+        if self._last_timestamp is not None and frame.timestamp < self._last_timestamp - TIMESTAMP_WRAP // 2:
+            self._epoch += TIMESTAMP_WRAP
+        self._last_timestamp = frame.timestamp
+        return (self._epoch + frame.timestamp) / 1e6
+
+    def decode(self, frames):
+        """Yield (signal, time, value) of the frames carrying a known signal."""
+        by_id = self.by_id
+        for frame in frames:
+            signals = by_id.get(frame.identifier)
+            if signals is None:
+                continue
+            t = self.time_of(frame)
+            for signal in signals:
+                value = signal.decode(frame.data)
+                if value is not None:
+                    yield signal, t, value
+
+
+class SignalHistory:
+    """Samples of a signal over the last `span` seconds."""
+
+    def __init__(self, span):
+        self.span = span
+        self.times = []
+        self.values = []
+        self._start = 0  # index of the oldest kept sample
+
+    def append(self, t, value):
+        self.times.append(t)
+        self.values.append(value)
+        start = self._start
+        while self.times[start] < t - self.span:
+            start += 1
+        # drop the expired samples in bulk, not on every append
+        if start > 4096 and start > len(self.times) // 2:
+            del self.times[:start]
+            del self.values[:start]
+            start = 0
+        self._start = start
+
+    def __len__(self):
+        return len(self.times) - self._start
+
+    def last(self):
+        return (self.times[-1], self.values[-1]) if len(self) else None
+
+    def window(self, begin):
+        """(times, values) of the samples at or after time begin."""
+        first = max(self._start, bisect.bisect_left(self.times, begin, self._start))
+        return self.times[first:], self.values[first:]
+
+
+def lttb(times, values, threshold):
+    """Largest-Triangle-Three-Buckets decimation to at most threshold points.
+
+    Keeps the first and last point and, in each bucket in between, the point
+    forming the largest triangle with the previously kept point and the mean
+    of the next bucket, which preserves the visual shape (peaks) of the data.
+    """
+    count = len(times)
+    if threshold >= count or threshold < 3:
+        return times, values
+    out_t, out_v = [times[0]], [values[0]]
+    bucket = (count - 2) / (threshold - 2)
+    a = 0
+    for i in range(threshold - 2):
+        start = int(i * bucket) + 1
+        end = int((i + 1) * bucket) + 1
+        next_end = min(int((i + 2) * bucket) + 1, count)
+        n = next_end - end
+        if n > 0:
+            avg_t = sum(times[end:next_end]) / n
+            avg_v = sum(values[end:next_end]) / n
+        else:
+            avg_t, avg_v = times[-1], values[-1]
+        at, av = times[a], values[a]
+        dt, dv = avg_t - at, avg_v - av
+        best, best_area = start, -1.0
+        for j in range(start, end):
+            area = abs((times[j] - at) * dv - (values[j] - av) * dt)
+            if area > best_area:
+                best, best_area = j, area
+        out_t.append(times[best])
+        out_v.append(values[best])
+        a = best
+    out_t.append(times[-1])
+    out_v.append(values[-1])
+    return out_t, out_v
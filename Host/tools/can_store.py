@@ -0,0 +1,290 @@
+"""Size-bounded rotating capture store of the capture daemon.
+
+Frames are written to a directory as a ring of fixed-size segment files
+(SEG<nnnnnnnn>.LOG) in the SD card log format (can_logger.h): 8 KiB blocks
+with a header carrying a random per-segment file id, the block index and a
+CRC-32, so any segment can be read with can_log.py, can_capture.c or
+can_daemon.py --file. A partially filled block is sealed after FLUSH_PERIOD,
+like the firmware does.
+
+Sealed blocks are gathered in a page-aligned buffer and written WRITE_BLOCKS
+at a time with one pwrite() (optionally with O_DIRECT, bypassing the page
+cache), into segments pre-allocated when created. When the size budget is
+reached, the oldest segment file is recycled for the next segment; segments
+older than the age limit are deleted.
+
+The index (index.json) lists the segments with their file id, the number of
+blocks known to be on disk and their wall-clock time range. It is replaced
+atomically (write, fsync, rename) after the segment data is synced, at most
+every INDEX_PERIOD and at every rotation, so it never claims data that is
+not on disk. A segment is entered in the index before its file is created
+and left out of it before its file is recycled or deleted.
+
+Recovery after a crash only reads the index and the blocks of the last
+segment written after its last index update (at most INDEX_PERIOD of
+traffic), checking them like can_logger_check_block(). Writing resumes after
+the last valid block; segment files not in the index are removed.
+
+    python can_daemon.py --serial /dev/ttyACM0 --store /var/log/can --store-budget 4096
+    python can_daemon.py --file /var/log/can --realtime
+"""
+
+import json
+import mmap
+import os
+import re
+import time
+import zlib
+
+from can_log import BLOCK_MAGIC, BLOCK_SIZE, HEADER, read_blocks, read_frames
+from can_stream import Frame
+
+PAYLOAD_SIZE = BLOCK_SIZE - HEADER.size  # CAN_LOGGER_PAYLOAD_SIZE
+RECORD_PADDING = 0xFF                    # CAN_RECORD_PADDING
+SEGMENT_SIZE = 64 << 20                  # default segment file size (bytes)
+WRITE_BLOCKS = 128                       # blocks per write (1 MiB)
+FLUSH_PERIOD = 0.5                       # seconds before a partial block is sealed (CAN_LOGGER_FLUSH_MS)
+INDEX_PERIOD = 1.0                       # seconds between index updates at most
+INDEX_NAME = "index.json"
+SEGMENT_NAME = "SEG%08d.LOG"
+SEGMENT_PATTERN = re.compile(r"SEG(\d{8})\.LOG$")
+
+
+def segment_path(directory, number):
+    return os.path.join(directory, SEGMENT_NAME % number)
+
+
+def seal_block(block, offset, payload, file_number, file_id, block_index, first_ts, last_ts, records):
+    """Write a complete log block at block[offset:] (as the firmware seals one)."""
+    end = offset + HEADER.size + len(payload)
+    block[offset + HEADER.size:end] = payload
+    block[end:offset + BLOCK_SIZE] = bytes((RECORD_PADDING,)) * (offset + BLOCK_SIZE - end)
+    fields = (BLOCK_MAGIC, file_number, file_id, block_index, first_ts, last_ts, len(payload), records, 0)
+    HEADER.pack_into(block, offset, *fields, 0)
+    crc = zlib.crc32(block[offset + HEADER.size:end], zlib.crc32(block[offset:offset + HEADER.size]))
+    HEADER.pack_into(block, offset, *fields, crc)
+
+
+def valid_block(block, file_id, block_index):
+    """can_logger_check_block() for one block of a segment."""
+    if len(block) < BLOCK_SIZE:
+        return False
+    magic, _, block_file_id, index, _, _, payload_bytes, _, _, crc = HEADER.unpack_from(block)
+    if magic != BLOCK_MAGIC or block_file_id != file_id or index != block_index or payload_bytes > PAYLOAD_SIZE:
+        return False
+    end = HEADER.size + payload_bytes
+    return zlib.crc32(block[:HEADER.size - 4] + bytes(4) + block[HEADER.size:end]) == crc
+
+
+def read_index(directory):
+    try:
+        with open(os.path.join(directory, INDEX_NAME)) as f:
+            return json.load(f)
+    except FileNotFoundError:
+        return None
+
+
+def read_store(directory):
+    """Frames of every segment of a store, oldest first."""
+    index = read_index(directory)
+    if index is None:
+        raise FileNotFoundError("no %s in %s" % (INDEX_NAME, directory))
+    for segment in index["segments"]:
+        path = segment_path(directory, segment["number"])
+        if not os.path.exists(path):
+            continue
+        for _, payload in read_blocks(path):
+            for sequence, timestamp, identifier, data in read_frames(payload):
+                yield Frame(timestamp, identifier, bytes(data), sequence)
+
+
+class SegmentStore:
+    def __init__(self, directory, segment_size=SEGMENT_SIZE, budget=16 * SEGMENT_SIZE, max_age=0, direct=False):
+        if segment_size % (WRITE_BLOCKS * BLOCK_SIZE) != 0:
+            raise ValueError("segment size must be a multiple of %d bytes" % (WRITE_BLOCKS * BLOCK_SIZE))
+        self.directory = directory
+        self.segment_size = segment_size
+        self.segment_blocks = segment_size // BLOCK_SIZE
+        self.budget = budget
+        self.max_segments = max(2, budget // segment_size)
+        self.max_age = max_age
+        self.flags = os.O_WRONLY | (getattr(os, "O_DIRECT", 0) if direct else 0)
+        self.buffer = mmap.mmap(-1, WRITE_BLOCKS * BLOCK_SIZE)  # page aligned, as O_DIRECT needs
+        self.buffered = 0
+        self.payload = bytearray()
+        self.first_ts = self.last_ts = 0
+        self.records = 0
+        self.block_opened = 0.0
+        self.last_index = 0.0
+        self.segments = []
+        self.fd = None
+        self.bytes_written = 0
+        os.makedirs(directory, exist_ok=True)
+        self.recovery = self.recover()
+
+    # -- index ------------------------------------------------------------
+
+    def write_index(self):
+        path = os.path.join(self.directory, INDEX_NAME)
+        with open(path + ".tmp", "w") as f:
+            json.dump({"segment_size": self.segment_size, "segments": self.segments}, f, indent=1)
+            f.flush()
+            os.fsync(f.fileno())
+        os.replace(path + ".tmp", path)
+        directory = os.open(self.directory, os.O_RDONLY)
+        try:
+            os.fsync(directory)
+        finally:
+            os.close(directory)
+        self.last_index = time.monotonic()
+
+    def recover(self):
+        """Reopen the store after a clean stop or a crash. Returns a one-line report."""
+        start = time.monotonic()
+        index = read_index(self.directory)
+        names = [name for name in os.listdir(self.directory) if SEGMENT_PATTERN.match(name)]
+        if index is None and names:
+            raise FileExistsError("%s has segment files but no %s" % (self.directory, INDEX_NAME))
+        if index is not None:
+            # an existing store keeps its segment size
+            self.segment_size = index["segment_size"]
+            self.segment_blocks = self.segment_size // BLOCK_SIZE
+            self.max_segments = max(2, self.budget // self.segment_size)
+            self.segments = [s for s in index["segments"] if os.path.exists(segment_path(self.directory, s["number"]))]
+        indexed = {s["number"] for s in self.segments}
+        for name in names:
+            if int(SEGMENT_PATTERN.match(name).group(1)) not in indexed:
+                os.unlink(os.path.join(self.directory, name))
+        if not self.segments:
+            self.open_segment(None)
+            return "new store"
+
+        segment = self.segments[-1]
+        self.fd = os.open(segment_path(self.directory, segment["number"]), self.flags)
+        recovered = 0
+        with open(segment_path(self.directory, segment["number"]), "rb") as f:
+            f.seek(segment["blocks"] * BLOCK_SIZE)
+            while segment["blocks"] < self.segment_blocks:
+                block = f.read(BLOCK_SIZE)
+                if not valid_block(block, segment["file_id"], segment["blocks"]):
+                    break
+                segment["blocks"] += 1
+                segment["frames"] += HEADER.unpack_from(block)[7]
+                recovered += 1
+        self.write_index()
+        if segment["blocks"] == self.segment_blocks:
+            self.rotate()
+        return "%d segments, %d blocks recovered after the index in %.3f s" % (
+            len(self.segments), recovered, time.monotonic() - start)
+
+    # -- segments ---------------------------------------------------------
+
+    def open_segment(self, recycled):
+        """Start the next segment, in the recycled file if given."""
+        number = self.segments[-1]["number"] + 1 if self.segments else 0
+        now = time.time()
+        self.segments.append({"number": number, "file_id": int.from_bytes(os.urandom(4), "little"),
+                              "blocks": 0, "frames": 0, "first_time": now, "last_time": now})
+        self.write_index()
+        path = segment_path(self.directory, number)
+        if recycled is not None:
+            # stale blocks of the old segment must not be taken for the first block of the new one
+            fd = os.open(recycled, self.flags)
+            try:
+                self.buffer[:BLOCK_SIZE] = bytes(BLOCK_SIZE)
+                os.pwrite(fd, memoryview(self.buffer)[:BLOCK_SIZE], 0)
+                os.fdatasync(fd)
+            finally:
+                os.close(fd)
+            os.rename(recycled, path)
+        else:
+            fd = os.open(path, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o644)
+            try:
+                os.posix_fallocate(fd, 0, self.segment_size)
+            except (AttributeError, OSError):
+                os.ftruncate(fd, self.segment_size)
+            os.close(fd)
+        self.fd = os.open(path, self.flags)
+
+    def evict(self, keep):
+        """Leave the oldest segments out of the index while there are more than keep
+        or they are older than the age limit. Returns their files."""
+        now = time.time()
+        evicted = []
+        while len(self.segments) > 1 and (len(self.segments) > keep or (
+                self.max_age and now - self.segments[0]["last_time"] > self.max_age)):
+            evicted.append(segment_path(self.directory, self.segments.pop(0)["number"]))
+        if evicted:
+            self.write_index()
+        return evicted
+
+    def rotate(self):
+        os.fdatasync(self.fd)
+        os.close(self.fd)
+        self.fd = None
+        evicted = self.evict(self.max_segments - 1)
+        for path in evicted[:-1]:
+            os.unlink(path)
+        self.open_segment(evicted[-1] if evicted else None)
+
+    # -- writing ----------------------------------------------------------
+
+    def append(self, record, timestamp):
+        """Add one binary wire record (timestamp: its device time in us)."""
+        if len(self.payload) + len(record) > PAYLOAD_SIZE:
+            self.seal()
+        if not self.payload:
+            self.first_ts = timestamp
+            self.block_opened = time.monotonic()
+        self.payload += record
+        self.last_ts = timestamp
+        self.records += 1
+
+    def seal(self):
+        segment = self.segments[-1]
+        seal_block(self.buffer, self.buffered * BLOCK_SIZE, self.payload, segment["number"], segment["file_id"],
+                   segment["blocks"] + self.buffered, self.first_ts & 0xFFFFFFFF, self.last_ts & 0xFFFFFFFF,
+                   self.records)
+        segment["frames"] += self.records
+        segment["last_time"] = time.time()
+        self.payload = bytearray()
+        self.records = 0
+        self.buffered += 1
+        if self.buffered == WRITE_BLOCKS or segment["blocks"] + self.buffered == self.segment_blocks:
+            self.write_out()
+
+    def write_out(self):
+        if not self.buffered:
+            return
+        segment = self.segments[-1]
+        length = self.buffered * BLOCK_SIZE
+        os.pwrite(self.fd, memoryview(self.buffer)[:length], segment["blocks"] * BLOCK_SIZE)
+        segment["blocks"] += self.buffered
+        self.bytes_written += length
+        self.buffered = 0
+        if segment["blocks"] == self.segment_blocks:
+            self.rotate()
+
+    def poll(self):
+        """Seal a partial block after FLUSH_PERIOD, update the index after INDEX_PERIOD."""
+        now = time.monotonic()
+        if self.payload and now - self.block_opened >= FLUSH_PERIOD:
+            self.seal()
+            self.write_out()
+        if now - self.last_index >= INDEX_PERIOD:
+            self.write_out()
+            os.fdatasync(self.fd)
+            for path in self.evict(self.max_segments):
+                os.unlink(path)
+            self.write_index()
+
+    def close(self):
+        if self.payload:
+            self.seal()
+        self.write_out()
+        os.fdatasync(self.fd)
+        os.close(self.fd)
+        self.write_index()
+
+    def usage(self):
+        return "%d segments, %.0f MB written" % (len(self.segments), self.bytes_written / 1e6)
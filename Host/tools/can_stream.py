@@ -0,0 +1,163 @@
+"""Frame stream decoding shared by the host tools.
+
+The sniffer sends frames over USART3 either as text lines
+("ID: 0x123, DLC: 8, Data: 01 02 ...") or as binary wire records
+(my_can_wire.h). Debug messages and command replies are always text, so a
+StreamDecoder accepts any mix of both and returns the frames and the other
+text lines separately.
+
+The capture daemon (can_daemon.py) serves the frames to its clients as
+binary wire records over a Unix domain socket, see connect_daemon().
+"""
+
+import os
+import re
+import socket
+import struct
+import time
+
+BAUD_RATE = 921600
+DAEMON_SOCKET = os.environ.get("CAN_SNIFFER_SOCKET", "/tmp/can_sniffer.sock")
+
+WIRE_SYNC = 0xA5
+WIRE_HEADER = struct.Struct("<BBHIIB")  # sync, size, sequence, timestamp (us), id, dlc
+WIRE_MAX_SIZE = WIRE_HEADER.size + 8 + 1
+
+TEXT_FRAME = re.compile(rb"ID: 0x([0-9A-Fa-f]+), DLC: (\d), Data:((?: [0-9A-Fa-f]{2})*)")
+
+
+class Frame:
+    """One captured frame. timestamp is in microseconds (device or host clock)."""
+
+    __slots__ = ("timestamp", "identifier", "data", "sequence")
+
+    def __init__(self, timestamp, identifier, data, sequence=None):
+        self.timestamp = timestamp
+        self.identifier = identifier
+        self.data = data
+        self.sequence = sequence
+
+    def __repr__(self):
+        return "Frame(%d, 0x%03X, %s)" % (self.timestamp, self.identifier, self.data.hex(" "))
+
+
+def xor_checksum(data):
+    checksum = 0
+    for b in data:
+        checksum ^= b
+    return checksum
+
+
+def encode_wire(frame, sequence):
+    """Binary wire record of a frame (as my_CAN_wire_encode())."""
+    body = WIRE_HEADER.pack(WIRE_SYNC, WIRE_HEADER.size + len(frame.data) + 1, sequence & 0xFFFF,
+                            frame.timestamp & 0xFFFFFFFF, frame.identifier, len(frame.data)) + frame.data
+    return body + bytes((xor_checksum(body[1:]),))
+
+
+def host_time_us():
+    return int(time.monotonic() * 1e6) & 0xFFFFFFFF
+
+
+class StreamDecoder:
+    """Incremental decoder of a mixed text / binary wire byte stream."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.bad_records = 0
+
+    def feed(self, data):
+        """Add received bytes. Returns (frames, text_lines) completed by them."""
+        self.buffer += data
+        frames, lines = [], []
+        buf = self.buffer
+        pos = 0
+        end = len(buf)
+        while pos < end:
+            if buf[pos] == WIRE_SYNC:
+                if end - pos < 2:
+                    break
+                size = buf[pos + 1]
+                if WIRE_HEADER.size + 1 <= size <= WIRE_MAX_SIZE:
+                    if end - pos < size:
+                        break
+                    _, _, sequence, timestamp, identifier, dlc = WIRE_HEADER.unpack_from(buf, pos)
+                    if dlc == size - WIRE_HEADER.size - 1 and xor_checksum(buf[pos + 1:pos + size - 1]) == buf[pos + size - 1]:
+                        frames.append(Frame(timestamp, identifier, bytes(buf[pos + WIRE_HEADER.size:pos + size - 1]), sequence))
+                        pos += size
+                        continue
+                self.bad_records += 1
+                pos += 1
+                continue
+            newline = buf.find(b"\n", pos)
+            sync = buf.find(bytes((WIRE_SYNC,)), pos)
+            if newline < 0 or (0 <= sync < newline):
+                if sync < 0:
+                    if end - pos > 4096:  # no line end, drop garbage
+                        pos = end
+                    break
+                # text cut by a binary record: keep the text before it as a line
+                self._text_line(bytes(buf[pos:sync]).strip(), lines)
+                pos = sync
+                continue
+            line = bytes(buf[pos:newline]).strip()
+            pos = newline + 1
+            if not line:
+                continue
+            match = TEXT_FRAME.match(line)
+            if match and int(match.group(2)) == len(match.group(3)) // 3:
+                frames.append(Frame(host_time_us(), int(match.group(1), 16), bytes.fromhex(match.group(3).decode())))
+            else:
+                self._text_line(line, lines)
+        del buf[:pos]
+        return frames, lines
+
+    def _text_line(self, line, lines):
+        """Keep printable text, count the rest (binary data out of sync) as bad."""
+        if not line:
+            return
+        if all(32 <= b < 127 or b == 9 for b in line):
+            lines.append(line.decode())
+        else:
+            self.bad_records += 1
+
+
+def open_serial(port):
+    """Open the sniffer's virtual COM port. Returns a non-blocking file descriptor
+    (POSIX) or a pyserial object with read(n) when pyserial is installed."""
+    try:
+        import serial
+        return serial.Serial(port, BAUD_RATE, timeout=0)
+    except ImportError:
+        pass
+    import termios
+    import tty
+    fd = os.open(port, os.O_RDWR | os.O_NOCTTY | os.O_NONBLOCK)
+    tty.setraw(fd)
+    attrs = termios.tcgetattr(fd)
+    speed = getattr(termios, "B%d" % BAUD_RATE)
+    attrs[4] = attrs[5] = speed
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def connect_daemon(path=DAEMON_SOCKET):
+    """Connect to the capture daemon. Frames arrive as binary wire records."""
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(path)
+    return sock
+
+
+def parse_filter(text):
+    """Match function of an ID filter: "100-1FF,7DF" (IDs/ranges) or "700/F00" (ID/mask), hexadecimal."""
+    text = text.strip()
+    if not text:
+        return lambda identifier: True
+    if "/" in text:
+        value, mask = (int(part, 16) for part in text.split("/", 1))
+        return lambda identifier: (identifier & mask) == (value & mask)
+    ranges = []
+    for part in text.split(","):
+        low, _, high = part.partition("-")
+        ranges.append((int(low, 16), int(high or low, 16)))
+    return lambda identifier: any(low <= identifier <= high for low, high in ranges)
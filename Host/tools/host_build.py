@@ -0,0 +1,37 @@
+"""Build of the C host tools for the tests (test_*.py).
+
+The include paths and sources are those of the build commands in the file
+headers of the tools: every tool is built with the capture reader and the
+firmware modules it uses.
+"""
+
+import os
+import shutil
+import subprocess
+
+ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
+
+TOOL_INCLUDES = ["Host/stubs", "My_Modules/Drivers/can", "My_Modules/Drivers/debug", "My_Modules/Drivers/stdio",
+                 "My_Modules/Drivers/uart", "My_Modules/Drivers/timestamp", "My_Modules/Features/logger"]
+
+TOOL_SOURCES = ["Host/tools/can_capture.c", "My_Modules/Drivers/can/my_can_wire.c",
+                "My_Modules/Features/logger/can_logger.c", "My_Modules/Drivers/debug/my_debug.c",
+                "My_Modules/Drivers/stdio/my_stdio.c", "My_Modules/Drivers/uart/my_uart.c"]
+
+
+def compiler():
+    """C compiler of the host, None if there is none."""
+    return os.environ.get("CC") or shutil.which("gcc") or shutil.which("cc")
+
+
+def build(sources, output, includes=TOOL_INCLUDES, flags=(), libraries=()):
+    """Compile and link sources (relative to the repository root) into output."""
+    command = [compiler(), "-O2", *flags, *("-I" + path for path in includes), *sources, *libraries, "-o", output]
+    subprocess.run(command, cwd=ROOT, check=True, capture_output=True)
+    return output
+
+
+def build_tool(name, directory, flags=()):
+    """Build Host/tools/<name>.c into directory and return the path of the executable."""
+    return build(["Host/tools/%s.c" % name, *TOOL_SOURCES], os.path.join(directory, name),
+                 flags=flags, libraries=("-lpthread", "-lm"))
@@ -0,0 +1,96 @@
+"""Tests of the capture daemon API framing (can_api.py).
+
+    cd Host/tools && python -m unittest test_can_api
+"""
+
+import os
+import selectors
+import tempfile
+import threading
+import types
+import unittest
+
+from can_api import ApiClient, ApiDecoder, ApiServer, LiveTables, Session, parse_filter
+from can_stream import Frame, encode_wire
+
+IDS = 2000  # enough IDs for an "ids" reply of a few hundred KiB
+
+
+class FakeDaemon:
+    """What ApiServer uses of can_daemon.Daemon."""
+
+    def __init__(self):
+        self.selector = selectors.DefaultSelector()
+        self.dropped = 0
+        self.clients = {}
+
+    def bad_records(self):
+        return 0
+
+
+class ApiDecoderTest(unittest.TestCase):
+    def test_long_line_in_small_reads(self):
+        line = b'{"ok":true,"pad":"%s"}\n' % (b"x" * 20000)
+        record = encode_wire(Frame(1234, 0x1A0, bytes(range(8))), 7)
+        stream = record + line + record
+        decoder = ApiDecoder()
+        frames, lines = [], []
+        for start in range(0, len(stream), 100):
+            got_frames, got_lines = decoder.feed(stream[start:start + 100])
+            frames += got_frames
+            lines += got_lines
+        self.assertEqual(lines, [line.decode().strip()])
+        self.assertEqual([(f.timestamp, f.identifier, f.data, f.sequence) for f in frames],
+                         [(1234, 0x1A0, bytes(range(8)), 7)] * 2)
+        self.assertEqual(len(decoder.buffer), 0)
+
+
+class ApiServerTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.path = os.path.join(self.directory.name, "api")
+        self.daemon = FakeDaemon()
+        self.tables = LiveTables()
+        self.tables.update([Frame(i, 0x100 + i, bytes(8), i) for i in range(IDS)])
+        self.server = ApiServer(self.daemon, self.path, self.tables, 1 << 20)
+        self.running = True
+        self.thread = threading.Thread(target=self.serve)
+        self.thread.start()
+
+    def serve(self):
+        while self.running:
+            for key, mask in self.daemon.selector.select(0.05):
+                key.data(key.fileobj, mask)
+
+    def tearDown(self):
+        self.running = False
+        self.thread.join()
+        self.server.server.close()
+        self.directory.cleanup()
+
+    def test_reply_over_several_reads(self):
+        client = ApiClient(self.path)
+        client.sock.settimeout(10)  # a lost line start leaves request() waiting for ever
+        reply = client.request("ids")
+        self.assertTrue(reply["ok"])
+        self.assertEqual([state["id"] for state in reply["ids"]], [0x100 + i for i in range(IDS)])
+        self.assertEqual(client.request("stats")["ids"], IDS)
+        client.sock.close()
+
+    def test_backlogged_subscriber_counts_matching_data(self):
+        session = Session()
+        session.match = parse_filter("100-10F")
+        session.signals = {"speed"}
+        session.pending = bytearray(self.server.backlog + 1)
+        self.server.sessions[object()] = session  # backlogged: never flushed by publish()
+        frames = [Frame(i, 0x100 + i, bytes(8), i) for i in range(64)]
+        speed, rpm = types.SimpleNamespace(name="speed"), types.SimpleNamespace(name="rpm")
+        samples = [(speed, 0.5, 88.0), (rpm, 0.5, 3000.0), (speed, 1.0, 89.0)]
+        self.server.publish(frames, [encode_wire(frame, frame.sequence) for frame in frames], samples)
+        self.assertEqual(session.dropped, 16 + 2)
+        self.assertEqual(self.server.dropped, 16 + 2)
+        self.assertEqual(len(session.pending), self.server.backlog + 1)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,97 @@
+"""Tests of the Arrow IPC export (can_arrow.c).
+
+Exports a generated two-bus candump log in several record batches and reads
+the file back with pyarrow, row by row against the log. Without pyarrow,
+only the framing of the file (magic numbers, footer) is checked.
+
+    cd Host/tools && python -m unittest test_can_arrow
+"""
+
+import datetime
+import os
+import random
+import struct
+import subprocess
+import tempfile
+import unittest
+
+import host_build
+
+try:
+    import pyarrow
+    import pyarrow.ipc
+except ImportError:
+    pyarrow = None
+
+FRAMES = 5000
+BATCH_ROWS = 700  # several batches, the last one partial
+START_US = 1700000000250000
+MICROSECOND = datetime.timedelta(microseconds=1)
+
+
+def make_frames():
+    """(time in us since the first frame, interface, id, data) of the log."""
+    rng = random.Random(3)
+    identifiers = [0x100, 0x7FF, 0x0A5, 0x18DAF110, 0x1FFFFFFF, 0x321]
+    frames = []
+    for i in range(FRAMES):
+        identifier = rng.choice(identifiers)
+        frames.append((i * 731, "can%d" % (i % 3 == 0), identifier, rng.randbytes(rng.randrange(9))))
+    return frames
+
+
+def write_candump(path, frames):
+    with open(path, "w") as log:
+        for time_us, interface, identifier, data in frames:
+            id_text = ("%08X" if identifier > 0x7FF else "%03X") % identifier
+            seconds, micros = divmod(START_US + time_us, 1000000)
+            log.write("(%d.%06d) %s %s#%s\n" % (seconds, micros, interface, id_text, data.hex().upper()))
+
+
+class ArrowExportTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        if host_build.compiler() is None:
+            raise unittest.SkipTest("no C compiler to build can_arrow")
+        cls.directory = tempfile.TemporaryDirectory()
+        tool = host_build.build_tool("can_arrow", cls.directory.name)
+        cls.frames = make_frames()
+        log = os.path.join(cls.directory.name, "capture.log")
+        write_candump(log, cls.frames)
+        cls.path = os.path.join(cls.directory.name, "capture.arrow")
+        subprocess.run([tool, "--batch", str(BATCH_ROWS), "--threads", "3", "-o", cls.path, log],
+                       check=True, capture_output=True)
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.directory.cleanup()
+
+    def test_framing(self):
+        with open(self.path, "rb") as f:
+            content = f.read()
+        self.assertEqual(content[:8], b"ARROW1\0\0")
+        self.assertEqual(content[-6:], b"ARROW1")
+        footer_length = struct.unpack_from("<i", content, len(content) - 10)[0]
+        self.assertTrue(0 < footer_length < len(content) - 18)
+
+    @unittest.skipIf(pyarrow is None, "pyarrow is not installed")
+    def test_rows(self):
+        reader = pyarrow.ipc.open_file(pyarrow.memory_map(self.path))
+        self.assertEqual(reader.num_record_batches, -(-FRAMES // BATCH_ROWS))
+        table = reader.read_all()
+        self.assertEqual(table.column_names, ["timestamp", "channel", "id", "flags", "dlc", "payload"])
+        self.assertEqual(str(table.schema.field("timestamp").type), "duration[us]")
+        self.assertEqual(table.num_rows, FRAMES)
+
+        columns = table.to_pydict()
+        interfaces = list(dict.fromkeys(interface for _, interface, _, _ in self.frames))  # channels by appearance
+        for row, (time_us, interface, identifier, data) in enumerate(self.frames):
+            got = (columns["timestamp"][row] // MICROSECOND, columns["channel"][row], columns["id"][row],
+                   columns["flags"][row], columns["dlc"][row], columns["payload"][row])
+            expected = (time_us, interfaces.index(interface), identifier, int(identifier > 0x7FF), len(data),
+                        data + bytes(8 - len(data)))
+            self.assertEqual(got, expected, "row %d" % row)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,101 @@
+"""Check of the link capacity model (can_capacity.c) against the simulated firmware (replay_bench.c).
+
+Builds both tools, replays the same generated capture at several speeds and
+fails when the drops predicted by the model and the drops measured on the
+firmware differ by more than TOLERANCE, in binary and in text output mode.
+
+    cd Host/tools && python -m unittest test_can_capacity
+"""
+
+import os
+import re
+import subprocess
+import tempfile
+import unittest
+
+import host_build
+
+FIRMWARE_INCLUDES = ["Host/stubs", "Host/tools", "My_Modules/Drivers/can", "My_Modules/Drivers/debug",
+            "My_Modules/Drivers/mempool", "My_Modules/Drivers/payload", "My_Modules/Drivers/stdio",
+            "My_Modules/Drivers/uart", "My_Modules/Drivers/timestamp", "My_Modules/Features/command",
+            "My_Modules/Features/e2e", "My_Modules/Features/history", "My_Modules/Features/ids",
+            "My_Modules/Features/logger", "My_Modules/Features/power"]
+
+REPLAY_SOURCES = ["Host/bench/replay_bench.c", "Host/stubs/host_sim.c", "Host/tools/can_capture.c",
+                  "My_Modules/Drivers/can/my_can.c", "My_Modules/Drivers/can/my_can_wire.c",
+                  "My_Modules/Drivers/debug/my_debug.c", "My_Modules/Drivers/mempool/my_mempool.c",
+                  "My_Modules/Drivers/payload/my_payload.c", "My_Modules/Drivers/stdio/my_stdio.c",
+                  "My_Modules/Drivers/uart/my_uart.c", "My_Modules/Features/command/command_channel.c",
+                  "My_Modules/Features/e2e/can_e2e.c", "My_Modules/Features/history/can_history.c",
+                  "My_Modules/Features/ids/can_ids.c", "My_Modules/Features/logger/can_logger.c",
+                  "My_Modules/Features/power/can_power.c"]
+
+FRAMES = 20000
+PERIOD_S = 0.0005  # 2000 frames/s at --speed 1, within the bus and both UART formats
+SPEEDS = (2, 4)  # 2: text mode overflows only, 4: both modes overflow
+TOLERANCE = 0.02  # of the measured drops
+MIN_TOLERANCE = 10  # frames
+
+
+def write_capture(path):
+    """candump log of FRAMES frames of 64 IDs with every DLC."""
+    with open(path, "w") as capture:
+        for i in range(FRAMES):
+            identifier = 0x100 + (i * 7) % 64
+            data = bytes((i + j) & 0xFF for j in range((i * 5) % 9))
+            capture.write("(%.6f) can0 %03X#%s\n" % (1700000000 + i * PERIOD_S, identifier, data.hex().upper()))
+
+
+def run(*command):
+    return subprocess.run(command, check=True, capture_output=True, text=True).stdout
+
+
+class CapacityModelTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        if host_build.compiler() is None:
+            raise unittest.SkipTest("no C compiler to build can_capacity and replay_bench")
+        cls.directory = tempfile.TemporaryDirectory()
+        cls.capacity = host_build.build_tool("can_capacity", cls.directory.name)
+        cls.replay = host_build.build(REPLAY_SOURCES, os.path.join(cls.directory.name, "replay_bench"),
+                                      FIRMWARE_INCLUDES, ["-DHOST_SIMULATION"])
+        cls.capture = os.path.join(cls.directory.name, "capture.log")
+        write_capture(cls.capture)
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.directory.cleanup()
+
+    def predicted(self, speed):
+        """Predicted drops of the binary and text models."""
+        output = run(self.capacity, "--speed", str(speed), self.capture)
+        drops = re.findall(r"Predicted drops: (none|\d+)", output)
+        self.assertEqual(len(drops), 2, output)
+        return [0 if value == "none" else int(value) for value in drops]
+
+    def measured(self, speed, text):
+        output = run(self.replay, "--speed", str(speed), *(["--text"] if text else []), self.capture)
+        match = re.search(r"^Firmware: (\d+) dropped", output, re.MULTILINE)
+        self.assertIsNotNone(match, output)
+        return int(match.group(1))
+
+    def check(self, text):
+        overflowed = False
+        for speed in SPEEDS:
+            predicted = self.predicted(speed)[1 if text else 0]
+            measured = self.measured(speed, text)
+            overflowed |= measured > 0
+            with self.subTest(speed=speed):
+                self.assertLessEqual(abs(predicted - measured), max(MIN_TOLERANCE, TOLERANCE * measured),
+                                     "predicted %d drops, measured %d" % (predicted, measured))
+        self.assertTrue(overflowed, "the profile does not overflow the output buffer")
+
+    def test_binary(self):
+        self.check(text=False)
+
+    def test_text(self):
+        self.check(text=True)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,108 @@
+"""Tests of the scenario comparison (can_diff.c).
+
+Generates a "closed" and an "open" candump capture of the same bus that
+differ in one payload bit, in the share of 1s of another bit, in an ID sent
+in one scenario only and in the frame rate of another, among counters and
+random payload bits. Checks the ranking, the bit patterns and the frame rate
+table of the report.
+
+    cd Host/tools && python -m unittest test_can_diff
+"""
+
+import os
+import random
+import re
+import subprocess
+import tempfile
+import unittest
+
+import host_build
+
+DURATION_US = 10000000
+START_US = 1714550400000000
+DOOR_ID, DOOR_BIT = 0x3A0, 21  # bit 5 of byte 2: 0 closed, 1 open
+LIGHT_ID, LIGHT_BIT = 0x100, 3  # 1 in 30% of the frames closed, 70% open
+EVENT_ID = 0x5E0  # sent when open only
+RATE_ID = 0x4C0  # 50 frames/s closed, 100 open
+
+
+def make_scenario(is_open, seed):
+    """Frames (time us, id, data) of one scenario."""
+    rng = random.Random(seed)
+    frames = []
+    for n, t in enumerate(range(0, DURATION_US, 20000)):
+        door = bytearray([n & 0xFF, rng.randrange(256), rng.randrange(256) & ~0x20, 0x11])
+        if is_open:
+            door[2] |= 0x20
+        frames.append((t, DOOR_ID, bytes(door)))
+        light = rng.randrange(256) & ~0x08
+        if rng.random() < (0.7 if is_open else 0.3):
+            light |= 0x08
+        frames.append((t + 3000, LIGHT_ID, bytes([light, 0x40])))
+        frames.append((t + 5000, RATE_ID, bytes([0x01, 0x02])))
+        if is_open:
+            frames.append((t + 15000, RATE_ID, bytes([0x01, 0x02])))
+            if n % 5 == 0:
+                frames.append((t + 17000, EVENT_ID, bytes([0xAA])))
+    return sorted(frames)
+
+
+def write_candump(path, frames):
+    with open(path, "w") as log:
+        for time_us, identifier, data in frames:
+            seconds, micros = divmod(START_US + time_us, 1000000)
+            log.write("(%d.%06d) can0 %03X#%s\n" % (seconds, micros, identifier, data.hex().upper()))
+
+
+class DiffTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        if host_build.compiler() is None:
+            raise unittest.SkipTest("no C compiler to build can_diff")
+        cls.directory = tempfile.TemporaryDirectory()
+        tool = host_build.build_tool("can_diff", cls.directory.name)
+        paths = {}
+        for name, is_open, seed in (("closed", False, 1), ("open", True, 2)):
+            paths[name] = os.path.join(cls.directory.name, name + ".log")
+            write_candump(paths[name], make_scenario(is_open, seed))
+        cls.report = subprocess.run([tool, "--min-score", "0.1", "closed=" + paths["closed"], "open=" + paths["open"]],
+                                    check=True, capture_output=True, text=True).stdout
+        cls.fields = re.findall(r"^(\d+)\s+0x(\w+)\s+(\d+)/(\d+)\s+([\d.]+)\s+(\S+)\s+([\d.]+)\s+(\S+)\s+([\d.]+)$",
+                                cls.report, re.MULTILINE)
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.directory.cleanup()
+
+    def test_differing_bit_first(self):
+        self.assertTrue(self.fields, self.report)
+        rank, identifier, start, length, score, closed, closed_flips, opened, open_flips = self.fields[0]
+        self.assertEqual((int(identifier, 16), int(start), int(length)), (DOOR_ID, DOOR_BIT, 1))
+        self.assertEqual(float(score), 1.0)
+        self.assertEqual((closed, opened), ("0", "1"))
+        self.assertEqual((float(closed_flips), float(open_flips)), (0.0, 0.0))
+
+    def test_partial_bit_second(self):
+        _, identifier, start, length, score, closed, _, opened, _ = self.fields[1]
+        self.assertEqual((int(identifier, 16), int(start), int(length)), (LIGHT_ID, LIGHT_BIT, 1))
+        self.assertGreater(float(score), 0.1)
+        self.assertLess(float(score), 0.5)
+        self.assertEqual((closed, opened), ("~", "~"))
+
+    def test_noise_not_ranked(self):
+        # counters, random bytes and constant bytes do not depend on the scenario
+        ranked = [(int(identifier, 16), int(start)) for _, identifier, start, *_ in self.fields]
+        self.assertEqual(ranked, [(DOOR_ID, DOOR_BIT), (LIGHT_ID, LIGHT_BIT)], self.report)
+
+    def test_frame_rates(self):
+        rates = {int(identifier, 16): (float(closed), float(opened)) for identifier, closed, opened in
+                 re.findall(r"^0x(\w+)\s+([\d.]+)\s+([\d.]+)$", self.report, re.MULTILINE)}
+        self.assertEqual(sorted(rates), [RATE_ID, EVENT_ID], self.report)
+        self.assertEqual(rates[EVENT_ID][0], 0.0)
+        self.assertAlmostEqual(rates[EVENT_ID][1], 10.0, delta=0.2)
+        self.assertAlmostEqual(rates[RATE_ID][0], 50.0, delta=1.0)
+        self.assertAlmostEqual(rates[RATE_ID][1], 100.0, delta=2.0)
+
+
+if __name__ == "__main__":
+    unittest.main()
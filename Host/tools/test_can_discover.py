@@ -0,0 +1,122 @@
+"""Tests of the signal discovery tool (can_discover.c).
+
+Generates a capture in which one bit field of one ID carries a known
+signal, among counters, noise and a decoy signal, and checks that
+can_discover ranks that field first, with its byte order, signedness and
+scale, from a reference time series of the signal.
+
+    cd Host/tools && python -m unittest test_can_discover
+"""
+
+import math
+import os
+import random
+import re
+import subprocess
+import tempfile
+import unittest
+
+import host_build
+from can_stream import Frame, encode_wire
+
+DURATION_S = 120
+PERIOD_S = 0.02  # of every ID
+SPEED_ID = 0x1A0  # speed * 100, Intel, bits 16..31
+RPM_ID = 0x2C0  # RPM deviation, Motorola signed 12 bits, DBC start bit 11
+DECOY_ID = 0x1B0  # another signal, partly correlated with the speed
+
+
+def speed(t):
+    return 60 + 40 * math.sin(t / 9) + 10 * math.sin(t / 2.3)
+
+
+def speed_max():
+    return max(speed(n * PERIOD_S) for n in range(int(DURATION_S / PERIOD_S)))
+
+
+def rpm(t):
+    return 1500 * math.sin(t / 6) * math.cos(t / 17)
+
+
+def field(value, start, length, big_endian=False):
+    """Payload bits of a field value, as an 8-byte integer."""
+    value &= (1 << length) - 1
+    if not big_endian:
+        return value << start
+    msb = (start // 8) * 8 + 7 - start % 8  # position of the MSB from the first bit on the wire
+    return value << (64 - msb - length)
+
+
+def write_capture(path):
+    rng = random.Random(7)
+    frames = []
+    for n in range(int(DURATION_S / PERIOD_S)):
+        t = n * PERIOD_S
+        counter = n & 0xFF
+        payloads = {
+            SPEED_ID: field(counter, 0, 8) | field(round(speed(t) * 100), 16, 16) | field(rng.getrandbits(8), 40, 8),
+            DECOY_ID: field(round(50 + 30 * math.sin(t / 9) + 20 * math.sin(t / 29)), 0, 8) | field(counter, 56, 8),
+            0x300: rng.getrandbits(64),
+        }
+        payloads = {identifier: value.to_bytes(8, "little") for identifier, value in payloads.items()}
+        payloads[RPM_ID] = field(round(rpm(t)), 11, 12, big_endian=True).to_bytes(8, "big")
+        for k, (identifier, data) in enumerate(sorted(payloads.items())):
+            frames.append(Frame(round((t + k * 0.001) * 1e6), identifier, data))
+    with open(path, "wb") as capture:
+        capture.write(b"".join(encode_wire(frame, i & 0xFFFF) for i, frame in enumerate(frames)))
+
+
+def write_reference(path, signal, rate):
+    """CSV with a header, sampled slower than the capture, as a GPS or a scan tool would."""
+    with open(path, "w") as reference:
+        reference.write("time,value\n")
+        for n in range(int(DURATION_S * rate)):
+            reference.write("%.3f,%.3f\n" % (n / rate, signal(n / rate)))
+
+
+class DiscoverTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        if host_build.compiler() is None:
+            raise unittest.SkipTest("no C compiler to build can_discover")
+        cls.directory = tempfile.TemporaryDirectory()
+        cls.tool = host_build.build_tool("can_discover", cls.directory.name, ["-fopenmp-simd"])
+        cls.capture = os.path.join(cls.directory.name, "capture.bin")
+        write_capture(cls.capture)
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.directory.cleanup()
+
+    def best(self, name, signal, rate):
+        """First row of the ranking of can_discover on the reference of signal."""
+        reference = os.path.join(self.directory.name, name + ".csv")
+        write_reference(reference, signal, rate)
+        output = subprocess.run([self.tool, "--top", "5", reference, self.capture],
+                                check=True, capture_output=True, text=True).stdout
+        rows = re.findall(r"^\s*1\s+0x([0-9A-F]+)\s+(\w+)\s+(\d+)\s+(\d+)\s+(\w+)\s+(\S+)\s+\S+\s+\S+\s+(\S+)\s+(\S+)$",
+                          output, re.MULTILINE)
+        self.assertEqual(len(rows), 1, output)
+        identifier, order, start, length, signed, r, scale, offset = rows[0]
+        return (int(identifier, 16), order, int(start), int(length), signed, float(r), float(scale),
+                float(offset)), output
+
+    def test_intel_unsigned(self):
+        (identifier, order, start, length, signed, r, scale, offset), output = self.best("speed", speed, 1)
+        self.assertEqual((identifier, order, signed), (SPEED_ID, "little", "no"), output)
+        # the constant top bits are left out, and the LSB may be too (below the reference resolution)
+        self.assertEqual(start + length - 1, 16 + round(speed_max() * 100).bit_length() - 1, output)
+        self.assertLessEqual(16, start, output)
+        self.assertGreater(r, 0.99, output)
+        self.assertAlmostEqual(scale / (1 << (start - 16)), 0.01, delta=0.0002)
+        self.assertAlmostEqual(offset, 0, delta=1)
+
+    def test_motorola_signed(self):
+        (identifier, order, start, length, signed, r, scale, offset), output = self.best("rpm", rpm, 5)
+        self.assertEqual((identifier, order, start, length, signed), (RPM_ID, "big", 11, 12, "yes"), output)
+        self.assertGreater(r, 0.99, output)
+        self.assertAlmostEqual(scale, 1, delta=0.05)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,116 @@
+"""Tests of the gateway copy linking (can_gateway.c).
+
+Generates a three-bus candump log in which a gateway forwards some IDs from
+can0 to can1, and one of them further to can2, with known latencies, among
+traffic of every bus that is not forwarded and a static payload repeated on
+one bus. Checks every link of --links and the channel and route tables of
+the report.
+
+    cd Host/tools && python -m unittest test_can_gateway
+"""
+
+import csv
+import os
+import random
+import re
+import subprocess
+import tempfile
+import unittest
+
+import host_build
+
+DURATION_US = 20000000
+PERIOD_US = 10000
+START_US = 1714550400000000
+FORWARDED_IDS = range(0x100, 0x110)  # can0 -> can1
+CHAINED_ID = 0x200  # can0 -> can1 -> can2
+STATIC_ID = 0x300  # same payload every period on can0, never forwarded
+LOCAL_IDS = {0: 0x400, 1: 0x500, 2: 0x600}  # not forwarded
+
+
+def make_traffic():
+    """Frames (time us, channel, id, data) sorted by time, and the expected links
+    (time us, channel, id, origin time us, origin channel, latency us)."""
+    rng = random.Random(11)
+    frames, links = [], []
+    for n, t in enumerate(range(0, DURATION_US, PERIOD_US)):
+        for k, identifier in enumerate([*FORWARDED_IDS, CHAINED_ID]):
+            origin = t + 20 * k + rng.randrange(10)
+            data = bytes([n & 0xFF, k]) + rng.randbytes(6)
+            frames.append((origin, 0, identifier, data))
+            latency = rng.randrange(150, 900)
+            frames.append((origin + latency, 1, identifier, data))
+            links.append((origin + latency, 1, identifier, origin, 0, latency))
+            if identifier == CHAINED_ID:
+                latency += rng.randrange(300, 2000)
+                frames.append((origin + latency, 2, identifier, data))
+                links.append((origin + latency, 2, identifier, origin, 0, latency))
+        frames.append((t + 5000, 0, STATIC_ID, bytes([0xAA, 0x55])))
+        for channel, identifier in LOCAL_IDS.items():
+            frames.append((t + 6000 + channel, channel, identifier, rng.randbytes(8)))
+    frames.sort()
+    return frames, sorted(links)
+
+
+def write_candump(path, frames):
+    with open(path, "w") as log:
+        for time_us, channel, identifier, data in frames:
+            seconds, micros = divmod(START_US + time_us, 1000000)
+            log.write("(%d.%06d) can%d %03X#%s\n" % (seconds, micros, channel, identifier, data.hex().upper()))
+
+
+class GatewayTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        if host_build.compiler() is None:
+            raise unittest.SkipTest("no C compiler to build can_gateway")
+        cls.directory = tempfile.TemporaryDirectory()
+        tool = host_build.build_tool("can_gateway", cls.directory.name)
+        cls.frames, cls.links = make_traffic()
+        log = os.path.join(cls.directory.name, "candump.log")
+        write_candump(log, cls.frames)
+        cls.links_path = os.path.join(cls.directory.name, "links.csv")
+        cls.report = subprocess.run([tool, "--links", cls.links_path, log],
+                                    check=True, capture_output=True, text=True).stdout
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.directory.cleanup()
+
+    def test_links(self):
+        with open(self.links_path) as f:
+            rows = list(csv.DictReader(f))
+        first = self.frames[0][0]
+        got = sorted((round(float(row["time_s"]) * 1e6) + first, int(row["channel"]), int(row["id"], 16),
+                      round(float(row["origin_time_s"]) * 1e6) + first, int(row["origin_channel"]),
+                      int(row["latency_us"])) for row in rows)
+        self.assertEqual(len(got), len(self.links))
+        self.assertEqual(got, self.links)
+
+    def test_channels(self):
+        copies_in = {channel: sum(1 for link in self.links if link[1] == channel) for channel in range(3)}
+        copies_out = {0: len(self.links), 1: 0, 2: 0}
+        for channel in range(3):
+            frames = sum(1 for frame in self.frames if frame[1] == channel)
+            row = re.search(r"^\s+%d\s+can%d\s+(\d+)\s+(\d+)\s+(\d+)\s+(\d+)$" % (channel, channel),
+                            self.report, re.MULTILINE)
+            self.assertIsNotNone(row, self.report)
+            self.assertEqual([int(value) for value in row.groups()],
+                             [frames, frames - copies_in[channel], copies_in[channel], copies_out[channel]])
+
+    def test_routes(self):
+        for to in (1, 2):
+            latencies = [link[5] for link in self.links if link[1] == to]
+            row = re.search(r"^ 0 -> %d\s+(\d+)\s+(\d+)\s+(\d+)\s+\S+\s+\S+\s+\S+\s+\S+\s+(\d+)$" % to,
+                            self.report, re.MULTILINE)
+            self.assertIsNotNone(row, self.report)
+            ids, copies, latency_min, latency_max = (int(value) for value in row.groups())
+            self.assertEqual((ids, copies, latency_min, latency_max),
+                             (len(FORWARDED_IDS) + 1 if to == 1 else 1, len(latencies), min(latencies),
+                              max(latencies)))
+        self.assertNotIn("1 -> 2", self.report)  # the chained copies are linked to their origin
+        self.assertIn("0 pushed out within the window", self.report)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,104 @@
+"""Tests of the SD card log file reader (can_log.py) against the firmware block check.
+
+Writes CAN<nnnnn>.LOG files block by block as can_logger.c does, with the
+endings a power loss leaves (a stale block of an older file, a torn block),
+and checks that can_log.py and can_logger_check_block() (through the C
+capture reader of can_capacity) recover the same frames.
+
+    cd Host/tools && python -m unittest test_can_log
+"""
+
+import os
+import re
+import struct
+import subprocess
+import tempfile
+import unittest
+import zlib
+
+import host_build
+from can_log import BLOCK_MAGIC, BLOCK_SIZE, HEADER, read_blocks, read_frames
+from can_stream import Frame, encode_wire
+
+FRAMES_PER_BLOCK = 300
+
+
+def make_frames(first, count):
+    return [Frame(1000 * n, (n * 37) % 0x800, bytes((n + i) & 0xFF for i in range(n % 9)), n)
+            for n in range(first, first + count)]
+
+
+def make_block(file_number, file_id, index, frames, dropped=0):
+    """A sealed block of the firmware: header, wire records, zero fill, CRC-32."""
+    payload = b"".join(encode_wire(frame, frame.sequence) for frame in frames)
+    fields = [BLOCK_MAGIC, file_number, file_id, index, frames[0].timestamp, frames[-1].timestamp,
+              len(payload), len(frames), dropped]
+    crc = zlib.crc32(HEADER.pack(*fields, 0)[:-4] + bytes(4) + payload)
+    block = HEADER.pack(*fields, crc) + payload
+    return block + bytes(BLOCK_SIZE - len(block))
+
+
+class LogFileTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        cls.directory = tempfile.TemporaryDirectory()
+        cls.reader = None
+        if host_build.compiler() is not None:
+            cls.reader = host_build.build_tool("can_capacity", cls.directory.name)
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.directory.cleanup()
+
+    def write_log(self, name, blocks, tail=b""):
+        path = os.path.join(self.directory.name, name)
+        with open(path, "wb") as f:
+            f.write(b"".join(blocks) + tail)
+        return path
+
+    def check(self, path, frames):
+        """Both readers must recover exactly frames."""
+        got = [(sequence, timestamp, identifier, data)
+               for _, payload in read_blocks(path) for sequence, timestamp, identifier, data in read_frames(payload)]
+        self.assertEqual(got, [(f.sequence, f.timestamp, f.identifier, f.data) for f in frames])
+        if self.reader is None:
+            self.skipTest("no C compiler to build the capture reader")
+        output = subprocess.run([self.reader, "--speed", "max", path], capture_output=True, text=True).stdout
+        match = re.search(r"Profile: .*?, (\d+) frames", output)
+        count = int(match.group(1)) if match else 0
+        self.assertEqual(count, len(frames), output)
+
+    def test_complete_file(self):
+        frames = make_frames(0, 3 * FRAMES_PER_BLOCK)
+        blocks = [make_block(7, 0x1234, i, frames[i * FRAMES_PER_BLOCK:(i + 1) * FRAMES_PER_BLOCK]) for i in range(3)]
+        self.check(self.write_log("CAN00007.LOG", blocks), frames)
+
+    def test_power_loss_after_reused_clusters(self):
+        """Blocks of an older file left in the pre-allocated space are not frames of this one."""
+        frames = make_frames(0, 2 * FRAMES_PER_BLOCK)
+        blocks = [make_block(8, 0x5678, i, frames[i * FRAMES_PER_BLOCK:(i + 1) * FRAMES_PER_BLOCK]) for i in range(2)]
+        stale = make_block(3, 0x1234, 2, make_frames(5000, FRAMES_PER_BLOCK))
+        self.check(self.write_log("CAN00008.LOG", blocks + [stale]), frames)
+
+    def test_power_loss_in_a_block(self):
+        """A block torn by the cut (old content after the first sectors) fails its CRC."""
+        frames = make_frames(0, 2 * FRAMES_PER_BLOCK)
+        blocks = [make_block(9, 0x9ABC, i, frames[i * FRAMES_PER_BLOCK:(i + 1) * FRAMES_PER_BLOCK]) for i in range(2)]
+        torn = make_block(9, 0x9ABC, 2, make_frames(2 * FRAMES_PER_BLOCK, FRAMES_PER_BLOCK))
+        torn = torn[:1024] + bytes(BLOCK_SIZE - 1024)
+        self.check(self.write_log("CAN00009.LOG", blocks + [torn], tail=b"\xFF" * 100), frames)
+
+    def test_corrupt_record(self):
+        payload = next(read_blocks(self.write_log("CAN00001.LOG", [make_block(1, 1, 0, make_frames(0, 2))])))[1]
+        damaged = bytearray(payload)
+        damaged[-1] ^= 0xFF  # checksum of the last record
+        with self.assertRaises(ValueError):
+            list(read_frames(bytes(damaged)))
+
+    def test_header_layout(self):
+        self.assertEqual(HEADER.size, 36)  # sizeof(can_Logger_Block_Header)
+        self.assertEqual(struct.unpack_from("<I", make_block(1, 2, 0, make_frames(0, 1)))[0], 0x474F4C43)
+
+
+if __name__ == "__main__":
+    unittest.main()
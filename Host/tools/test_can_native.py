@@ -0,0 +1,152 @@
+"""Tests of the NumPy bindings of the native capture decoder (can_native.py, can_batch.c).
+
+Builds libcan_batch.so and compares the columns and the extracted signals
+of a generated wire record capture, with a timestamp wrap and short frames,
+with the Python decoders (can_stream, can_signals), read from the file and
+fed through stream() in chunks that cut records.
+
+    cd Host/tools && python -m unittest test_can_native
+"""
+
+import os
+import random
+import tempfile
+import unittest
+
+import host_build
+
+try:
+    import numpy as np
+    import can_native
+except ImportError:
+    np = None
+
+from can_signals import Signal, SignalDecoder
+from can_stream import Frame, StreamDecoder, encode_wire
+
+FRAMES = 20000
+FIRST_TIMESTAMP = 0xFFFFFFFF - 3000000  # the device timestamp wraps after 3 s
+SIGNALS = [Signal("speed", 0x100, 16, 16, scale=0.01),
+           Signal("rpm", 0x200, 11, 12, byte_order="big", signed=True, scale=0.5, offset=-10),
+           Signal("flag", 0x100, 63, 1),
+           Signal("counter", 0x300, 0, 64)]
+
+
+def make_frames():
+    rng = random.Random(17)
+    frames, timestamp = [], FIRST_TIMESTAMP
+    for n in range(FRAMES):
+        timestamp = (timestamp + rng.randrange(50, 700)) & 0xFFFFFFFF
+        identifier = rng.choice([0x100, 0x200, 0x300, 0x7FF, 0x18DAF110])
+        size = 8 if n % 50 else rng.randrange(0, 8)  # some frames too short for their signals
+        frames.append(Frame(timestamp, identifier, rng.randbytes(size), n & 0xFFFF))
+    return frames
+
+
+class RecvSocket:
+    """Socket stand-in returning the capture in chunks of random sizes."""
+
+    def __init__(self, data, seed=1):
+        self.data = memoryview(data)
+        self.rng = random.Random(seed)
+
+    def recv_into(self, view):
+        size = min(len(view), len(self.data), self.rng.randrange(1, 5000))
+        view[:size] = self.data[:size]
+        self.data = self.data[size:]
+        return size
+
+
+@unittest.skipIf(np is None, "no numpy")
+class NativeTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        if host_build.compiler() is None:
+            raise unittest.SkipTest("no C compiler to build libcan_batch.so")
+        cls.directory = tempfile.TemporaryDirectory()
+        library = host_build.build(["Host/tools/can_batch.c", *host_build.TOOL_SOURCES],
+                                   os.path.join(cls.directory.name, "libcan_batch.so"), flags=("-shared", "-fPIC"))
+        can_native._lib = can_native.load_library(library)
+        cls.frames = make_frames()
+        cls.capture = b"".join(encode_wire(frame, frame.sequence) for frame in cls.frames)
+        cls.path = os.path.join(cls.directory.name, "capture.bin")
+        with open(cls.path, "wb") as f:
+            f.write(cls.capture)
+
+    @classmethod
+    def tearDownClass(cls):
+        can_native._lib = None
+        cls.directory.cleanup()
+
+    def assertColumns(self, batch, frames):
+        self.assertEqual(len(batch), len(frames))
+        self.assertEqual(batch.identifier.tolist(), [frame.identifier for frame in frames])
+        self.assertEqual(batch.dlc.tolist(), [len(frame.data) for frame in frames])
+        self.assertEqual([bytes(row) for row in batch.data], [frame.data.ljust(8, b"\0") for frame in frames])
+        unwrapped = SignalDecoder([])
+        times = [round(unwrapped.time_of(frame) * 1e6) for frame in frames]
+        self.assertEqual(batch.time_us.tolist(), [t - times[0] for t in times])
+
+    def assertSignals(self, batch, frames):
+        decoder = SignalDecoder(SIGNALS)
+        samples = {signal.name: ([], []) for signal in SIGNALS}
+        for signal, t, value in decoder.decode(frames):
+            samples[signal.name][0].append(t)
+            samples[signal.name][1].append(value)
+        first = SignalDecoder([]).time_of(frames[0])
+        for signal in SIGNALS:
+            times, values = batch.extract(signal)
+            expected_times, expected_values = samples[signal.name]
+            self.assertGreater(len(expected_values), 100, signal.name)
+            self.assertEqual(values.tolist(), expected_values, signal.name)
+            np.testing.assert_allclose(times, np.array(expected_times) - first, atol=1e-9, err_msg=signal.name)
+
+    def test_read(self):
+        batch = can_native.Batch.read(self.path)
+        self.assertColumns(batch, self.frames)
+        self.assertSignals(batch, self.frames)
+        # views over the library memory, not copies
+        for column in (batch.time_us, batch.identifier, batch.channel, batch.dlc, batch.data):
+            self.assertFalse(column.flags.owndata)
+        batch.close()
+
+    def test_python_decoder(self):
+        frames, _ = StreamDecoder().feed(self.capture)
+        self.assertEqual(len(frames), FRAMES)
+        batch = can_native.Batch.read(self.path)
+        self.assertColumns(batch, frames)
+        batch.close()
+
+    def test_stream_chunks(self):
+        got = {"identifier": [], "dlc": [], "data": [], "time_us": []}
+        for batch in can_native.stream(RecvSocket(self.capture)):
+            got["identifier"] += batch.identifier.tolist()
+            got["dlc"] += batch.dlc.tolist()
+            got["data"] += [bytes(row) for row in batch.data]
+            got["time_us"] += batch.time_us.tolist()
+        reference = can_native.Batch.read(self.path)
+        self.assertEqual(got["identifier"], reference.identifier.tolist())
+        self.assertEqual(got["dlc"], reference.dlc.tolist())
+        self.assertEqual(got["data"], [bytes(row) for row in reference.data])
+        self.assertEqual(got["time_us"], reference.time_us.tolist())  # one time line across the batches
+        reference.close()
+
+    def test_feed_cut_record(self):
+        batch = can_native.Batch()
+        record = encode_wire(self.frames[0], 0)
+        self.assertEqual(batch.feed(record[:-3]), 0)
+        self.assertEqual(len(batch), 0)
+        self.assertEqual(batch.feed(bytearray(record + record[:5])), len(record))
+        self.assertEqual(len(batch), 1)
+        batch.clear()
+        self.assertEqual(len(batch), 0)
+        self.assertEqual(batch.extract(SIGNALS[0])[1].size, 0)
+        batch.close()
+
+    def test_missing_file(self):
+        with self.assertRaises(OSError):
+            can_native.Batch.read(os.path.join(self.directory.name, "missing.bin"))
+
+
+if __name__ == "__main__":
+    unittest.main()
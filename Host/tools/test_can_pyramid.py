@@ -0,0 +1,179 @@
+"""Tests of the min/max/mean pyramid store (can_pyramid.py).
+
+Compares every level file with buckets computed from the samples, including
+a store reopened after a crash that tore a level file and lost the last
+writes of the coarser ones, and checks the queries.
+
+    cd Host/tools && python -m unittest test_can_pyramid
+"""
+
+import os
+import random
+import tempfile
+import unittest
+
+from can_pyramid import LEVEL, LEVEL_NAME, RAW, RAW_NAME, PyramidStore, SignalPyramid, query, read_meta
+from can_signals import Signal
+
+BASE_PERIOD = 0.01
+LEVELS = 8  # 10 ms .. 1.28 s buckets
+SAMPLES = 20000  # about 60 s
+
+
+def make_samples(seed=3):
+    """(time s, value) at irregular intervals, with a few gaps longer than a top level bucket."""
+    rng = random.Random(seed)
+    t, samples = 5.0, []
+    for n in range(SAMPLES):
+        t += rng.uniform(0.0005, 0.0055) if n % 5000 else 3.0
+        samples.append((t, rng.uniform(-100.0, 100.0)))
+    return samples
+
+
+def expected_levels(samples):
+    """Closed buckets (start, count, min, max, mean) of every level: all but the last bucket of the
+    samples that reached the level (those of the closed buckets of the level below)."""
+    levels = []
+    for level in range(LEVELS):
+        buckets = {}
+        for t, value in samples:
+            buckets.setdefault(int(t // BASE_PERIOD) >> level, []).append((t, value))
+        width = BASE_PERIOD * (1 << level)
+        closed = sorted(buckets.items())[:-1]
+        levels.append([(index * width, len(bucket), min(value for _, value in bucket),
+                        max(value for _, value in bucket), sum(value for _, value in bucket) / len(bucket))
+                       for index, bucket in closed])
+        samples = [sample for _, bucket in closed for sample in bucket]
+    return levels
+
+
+def read_records(path, record):
+    with open(path, "rb") as f:
+        return list(record.iter_unpack(f.read()))
+
+
+class SignalPyramidTest(unittest.TestCase):
+    def setUp(self):
+        self.temporary = tempfile.TemporaryDirectory()
+        self.directory = os.path.join(self.temporary.name, "speed")
+        self.samples = make_samples()
+
+    def tearDown(self):
+        self.temporary.cleanup()
+
+    def path(self, level):
+        return os.path.join(self.directory, LEVEL_NAME % level)
+
+    def assertLevels(self, samples):
+        self.assertEqual(read_records(os.path.join(self.directory, RAW_NAME), RAW), samples)
+        for level, expected in enumerate(expected_levels(samples)):
+            got = read_records(self.path(level), LEVEL)
+            self.assertEqual(len(got), len(expected), "level %d" % level)
+            for record, reference in zip(got, expected):
+                self.assertAlmostEqual(record[0], reference[0], places=9)
+                self.assertEqual(record[1:4], reference[1:4])
+                self.assertAlmostEqual(record[4], reference[4], places=9)
+
+    def test_incremental_build(self):
+        pyramid = SignalPyramid(self.directory, BASE_PERIOD, LEVELS)
+        for n, (t, value) in enumerate(self.samples):
+            pyramid.append(t, value)
+            if n % 997 == 0:
+                pyramid.flush()
+        pyramid.flush()
+        self.assertLevels(self.samples)
+
+    def test_reopen_after_crash(self):
+        half = SAMPLES // 2
+        pyramid = SignalPyramid(self.directory, BASE_PERIOD, LEVELS)
+        for t, value in self.samples[:half - 3000]:
+            pyramid.append(t, value)
+        pyramid.flush()
+        sizes = [os.path.getsize(self.path(level)) for level in range(LEVELS)]
+        for t, value in self.samples[half - 3000:half]:
+            pyramid.append(t, value)
+        pyramid.flush()
+
+        # crash in the last flush: level 2 torn within a record, the coarser levels not written,
+        # and the open buckets of every level lost with the process
+        with open(self.path(2), "r+b") as f:
+            f.truncate(sizes[2] + LEVEL.size + LEVEL.size // 2)
+        for level in range(3, LEVELS):
+            with open(self.path(level), "r+b") as f:
+                f.truncate(sizes[level])
+        del pyramid
+
+        pyramid = SignalPyramid(self.directory, BASE_PERIOD, LEVELS)
+        self.assertEqual(os.path.getsize(self.path(2)) % LEVEL.size, 0)
+        self.assertEqual(pyramid.last_time, self.samples[half - 1][0])
+        for t, value in self.samples[half:]:
+            pyramid.append(t, value)
+        pyramid.flush()
+        self.assertLevels(self.samples)
+
+    def test_time_going_back(self):
+        pyramid = SignalPyramid(self.directory, BASE_PERIOD, LEVELS)
+        for t, value in self.samples[:100]:
+            pyramid.append(t, value)
+        restart = self.samples[99][0] - self.samples[0][0]
+        for t, value in self.samples[:100]:  # sniffer restarted: device time starts again
+            pyramid.append(t, value)
+        pyramid.flush()
+        times = [t for t, _ in read_records(os.path.join(self.directory, RAW_NAME), RAW)]
+        self.assertEqual(times, sorted(times))
+        self.assertAlmostEqual(times[-1] - times[0], 2 * restart, places=9)
+
+
+class QueryTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        cls.temporary = tempfile.TemporaryDirectory()
+        cls.directory = cls.temporary.name
+        cls.samples = make_samples(5)
+        store = PyramidStore(cls.directory, [Signal("speed", 0x100, 0, 16)], BASE_PERIOD, LEVELS)
+        pyramid = store.pyramids["speed"]
+        for t, value in cls.samples:
+            pyramid.append(t, value)
+        store.close()
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.temporary.cleanup()
+
+    def test_bounded_points(self):
+        begin, end = self.samples[0][0], self.samples[-1][0] + 1
+        rows = query(self.directory, "speed", begin, end, points=200)
+        self.assertLessEqual(len(rows), 200 + LEVELS + 1 + int(BASE_PERIOD / 0.0005))
+        self.assertEqual([row[0] for row in rows], sorted(row[0] for row in rows))
+        values = [value for _, value in self.samples]
+        self.assertEqual(min(row[1] for row in rows), min(values))
+        self.assertEqual(max(row[2] for row in rows), max(values))
+        # consistent summaries, no bucket returned twice
+        covered = set()
+        for start, minimum, maximum, mean in rows:
+            self.assertLessEqual(minimum, mean)
+            self.assertLessEqual(mean, maximum)
+            self.assertNotIn(start, covered)
+            covered.add(start)
+
+    def test_raw_samples_of_a_short_range(self):
+        begin, end = self.samples[1000][0], self.samples[1100][0]
+        rows = query(self.directory, "speed", begin, end, points=200)
+        self.assertEqual(rows, [(t, value, value, value) for t, value in self.samples[1000:1100]])
+
+    def test_unknown_signal(self):
+        with self.assertRaises(KeyError):
+            query(self.directory, "rpm", 0, 1)
+
+    def test_reopen_keeps_resolutions(self):
+        store = PyramidStore(self.directory, [Signal("speed", 0x100, 0, 16)])
+        self.assertEqual(store.pyramids["speed"].base_period, BASE_PERIOD)
+        self.assertEqual(store.pyramids["speed"].levels, LEVELS)
+        store.close()
+        meta = read_meta(self.directory)
+        self.assertEqual((meta["base_period"], meta["levels"]), (BASE_PERIOD, LEVELS))
+        self.assertIn("speed", meta["signals"])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,77 @@
+"""Tests of the signal decoding, history and plot decimation (can_signals.py).
+
+    cd Host/tools && python -m unittest test_can_signals
+"""
+
+import math
+import unittest
+
+from can_signals import Signal, SignalDecoder, SignalHistory, lttb
+from can_stream import Frame
+
+
+class SignalTest(unittest.TestCase):
+    def test_little_endian(self):
+        signal = Signal("s", 0x100, 12, 8, scale=0.5, offset=-10)
+        self.assertEqual(signal.raw(bytes([0x00, 0xA0, 0x0B])), 0xBA)
+        self.assertEqual(signal.decode(bytes([0x00, 0xA0, 0x0B])), 0xBA * 0.5 - 10)
+        self.assertIsNone(signal.decode(bytes([0x00, 0xA0])))
+
+    def test_big_endian(self):
+        """DBC Motorola: the start bit is the MSB, the field runs on into the next bytes."""
+        self.assertEqual(Signal("s", 0x100, 7, 16, "big").raw(bytes([0x12, 0x34])), 0x1234)
+        self.assertEqual(Signal("s", 0x100, 3, 12, "big").raw(bytes([0xF5, 0x67])), 0x567)
+        self.assertIsNone(Signal("s", 0x100, 3, 12, "big").raw(bytes([0xF5])))
+
+    def test_signed(self):
+        signal = Signal("s", 0x100, 0, 12, signed=True)
+        self.assertEqual(signal.raw(bytes([0xFF, 0x0F])), -1)
+        self.assertEqual(signal.raw(bytes([0x00, 0x08])), -2048)
+        self.assertEqual(signal.raw(bytes([0xFF, 0x07])), 2047)
+
+    def test_from_config(self):
+        signal = Signal.from_config("speed", {"id": "0x1A0", "start": 8, "length": 16, "scale": 0.01})
+        self.assertEqual(signal.identifier, 0x1A0)
+        self.assertAlmostEqual(signal.decode(bytes([0, 0x10, 0x27])), 100.0)
+
+    def test_decoder_unwraps_timestamps(self):
+        speed = Signal("speed", 0x1A0, 0, 8)
+        decoder = SignalDecoder([speed, Signal("rpm", 0x2B0, 0, 16)])
+        frames = [Frame(0xFFFFFF00, 0x1A0, bytes([1])), Frame(0xFFFFFF80, 0x300, bytes([2])),
+                  Frame(0x00000100, 0x1A0, bytes([3])), Frame(0x00000200, 0x2B0, bytes([4]))]
+        samples = [(signal.name, t, value) for signal, t, value in decoder.decode(frames)]
+        self.assertEqual([(name, value) for name, _, value in samples], [("speed", 1), ("speed", 3)])
+        self.assertAlmostEqual(samples[1][1] - samples[0][1], 0x200 / 1e6)
+
+
+class HistoryTest(unittest.TestCase):
+    def test_span(self):
+        history = SignalHistory(1.0)
+        for i in range(20000):
+            history.append(i * 0.001, i)
+        self.assertEqual(len(history), 1001)
+        self.assertEqual(history.last(), (19.999, 19999))
+        times, values = history.window(19.5)
+        self.assertEqual(values, list(range(19500, 20000)))
+        self.assertLess(len(history.times), 20000)  # expired samples were freed
+
+
+class LttbTest(unittest.TestCase):
+    def test_keeps_peaks(self):
+        times = [i * 0.01 for i in range(10000)]
+        values = [math.sin(t) for t in times]
+        values[4321] = 50.0
+        values[7000] = -50.0
+        out_t, out_v = lttb(times, values, 200)
+        self.assertEqual(len(out_t), 200)
+        self.assertEqual((out_t[0], out_t[-1]), (times[0], times[-1]))
+        self.assertEqual(out_t, sorted(out_t))
+        self.assertIn(50.0, out_v)
+        self.assertIn(-50.0, out_v)
+
+    def test_short_series(self):
+        self.assertEqual(lttb([0, 1, 2], [5, 6, 7], 10), ([0, 1, 2], [5, 6, 7]))
+
+
+if __name__ == "__main__":
+    unittest.main()
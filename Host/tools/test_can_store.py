@@ -0,0 +1,111 @@
+"""Tests of the rotating capture store (can_store.py).
+
+    cd Host/tools && python -m unittest test_can_store
+"""
+
+import os
+import tempfile
+import unittest
+
+from can_log import BLOCK_SIZE, HEADER
+from can_store import (INDEX_NAME, SEGMENT_PATTERN, WRITE_BLOCKS, SegmentStore, read_store, seal_block,
+                       segment_path)
+from can_stream import Frame, encode_wire
+
+SEGMENT_SIZE = WRITE_BLOCKS * BLOCK_SIZE  # smallest segment (1 MiB)
+RECORD_SIZE = 21  # wire record of an 8-byte payload
+
+
+def records(first, count):
+    """(frame, wire record) of count frames numbered from first."""
+    for n in range(first, first + count):
+        frame = Frame(n * 100 & 0xFFFFFFFF, 0x100 + n % 0x700, n.to_bytes(8, "little"), n & 0xFFFF)
+        yield frame, encode_wire(frame, frame.sequence)
+
+
+def write(store, first, count):
+    for frame, record in records(first, count):
+        store.append(record, frame.timestamp)
+
+
+def stored(directory):
+    """Frame numbers of the store (from the payload)."""
+    return [int.from_bytes(frame.data, "little") for frame in read_store(directory)]
+
+
+class SegmentStoreTest(unittest.TestCase):
+    def setUp(self):
+        self.temporary = tempfile.TemporaryDirectory()
+        self.directory = self.temporary.name
+
+    def tearDown(self):
+        self.temporary.cleanup()
+
+    def segment_files(self):
+        return sorted(name for name in os.listdir(self.directory) if SEGMENT_PATTERN.match(name))
+
+    def test_rotation_within_budget(self):
+        store = SegmentStore(self.directory, SEGMENT_SIZE, budget=3 * SEGMENT_SIZE)
+        count = 5 * SEGMENT_SIZE // RECORD_SIZE  # five segments of traffic
+        write(store, 0, count)
+        store.close()
+
+        files = self.segment_files()
+        self.assertLessEqual(len(files), 3)
+        self.assertLessEqual(sum(os.path.getsize(os.path.join(self.directory, name)) for name in files),
+                             3 * SEGMENT_SIZE)
+        numbers = [segment["number"] for segment in store.segments]
+        self.assertEqual(files, [os.path.basename(segment_path(self.directory, n)) for n in numbers])
+        self.assertEqual(numbers, list(range(numbers[0], numbers[0] + len(numbers))))
+        self.assertGreaterEqual(numbers[0], 2)  # the oldest segments were evicted
+
+        # the newest frames, without a gap, and none of a recycled segment
+        frames = stored(self.directory)
+        self.assertEqual(frames, list(range(count - len(frames), count)))
+        self.assertGreater(len(frames), 2 * SEGMENT_SIZE // RECORD_SIZE)
+        self.assertEqual(sum(segment["frames"] for segment in store.segments), len(frames))
+
+    def test_recovery_after_crash(self):
+        store = SegmentStore(self.directory, SEGMENT_SIZE, budget=4 * SEGMENT_SIZE)
+        write(store, 0, 100000)
+        store.write_out()
+        store.write_index()
+        indexed_blocks = store.segments[-1]["blocks"]
+        write(store, 100000, 20000)
+        store.seal()
+        store.write_out()  # on disk, not yet in the index
+        written = 120000
+        write(store, 120000, 300)  # in the open block: lost in the crash
+        os.close(store.fd)  # crash: no close(), no index update
+
+        # a torn block after the last one written and a segment file that never made it to the index
+        segment = store.segments[-1]
+        blocks = segment["blocks"]
+        torn = bytearray(BLOCK_SIZE)
+        seal_block(torn, 0, next(records(written, 1))[1], segment["number"], segment["file_id"], blocks, 0, 0, 1)
+        with open(segment_path(self.directory, segment["number"]), "r+b") as f:
+            f.seek(blocks * BLOCK_SIZE)
+            f.write(torn[:HEADER.size])  # the header sector reached the disk, not the payload
+        stray = segment_path(self.directory, segment["number"] + 1)
+        open(stray, "wb").close()
+
+        store = SegmentStore(self.directory, SEGMENT_SIZE, budget=4 * SEGMENT_SIZE)
+        self.assertIn("%d blocks recovered" % (blocks - indexed_blocks), store.recovery)
+        self.assertEqual(store.segments[-1]["blocks"], blocks)
+        self.assertFalse(os.path.exists(stray))
+        self.assertEqual(stored(self.directory), list(range(written)))
+
+        # writing resumes after the last valid block
+        write(store, written, 5000)
+        store.close()
+        self.assertEqual(stored(self.directory), list(range(written + 5000)))
+
+    def test_existing_files_without_index(self):
+        open(segment_path(self.directory, 0), "wb").close()
+        with self.assertRaises(FileExistsError):
+            SegmentStore(self.directory, SEGMENT_SIZE)
+        self.assertFalse(os.path.exists(os.path.join(self.directory, INDEX_NAME)))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -4,22 +4,82 @@
  *
  * @details
  * Provides:
- *  - Automatic and manual CAN baudrate configuration
- *  - Software ring buffer for received frames
+ *  - Automatic and manual CAN baudrate configuration (CAN FD data-phase
+ *    rate included in the automatic one)
+ *  - Software ring buffer (variable-length record arena) for received frames
  *  - Filter/mask configuration
  *  - FDCAN1 start/stop control
- *  - UART forwarding of captured frames
+ *  - UART forwarding of captured frames (text, or binary records encoded
+ *    by the RX interrupt directly into the UART DMA transmit arena)
  *
  * This module is designed to pair with an interrupt-driven FDCAN RX FIFO0
  * callback. Frames are moved into a software ring buffer to avoid losing
- * data when hardware FIFO fills up.
+ * data when hardware FIFO fills up. The stages the callback runs for each
+ * frame are chosen at build time (see my_can_pipeline.h).
+ *
+ * The ring buffer is a byte arena of my_CAN_Record entries. The RX interrupt
+ * is its only producer and the main loop its only consumer, so reservation
+ * needs no lock: the producer only writes `head`, the consumer only writes
+ * `tail`. Records are formatted in place by the consumer (zero-copy).
  */
 
 #include "my_can.h"
+#include "my_can_wire.h"
+#include "can_ids.h"
+#include "can_e2e.h"
+#include "can_history.h"
+#include "can_logger.h"
 
 /* Forward declarations for internal helpers */
 static bool check_Fifo(void);
-static bool read_frame_from_software_CAN_buffer(my_CAN_Frame* frame);
+static bool check_Fd_Fifo(uint32_t* brs_frames, uint32_t* data_errors);
+static const my_CAN_Record* peek_record_from_software_CAN_buffer(void);
+static void release_record_from_software_CAN_buffer(const my_CAN_Record* record);
+static void on_span_complete(void);
+
+/**
+ * @def PIPELINE_STAGES
+ * @brief Mask of the stages built into the RX handler.
+ */
+#define PIPELINE_STAGES CAN_PIPELINE_MASK(CAN_PIPELINE_STAGES)
+
+/**
+ * @def BINARY_ONLY(stages)
+ * @brief Whether a stage mask outputs binary records without a format choice.
+ */
+#define BINARY_ONLY(stages) (((stages) & CAN_PIPELINE_STAGE_BIT_binary) && !((stages) & CAN_PIPELINE_STAGE_BIT_output))
+
+/**
+ * @struct rx_Context
+ * @brief Per-interrupt values shared by the RX stages.
+ *
+ * @details
+ * losses_before/losses are the sniffer loss counts (RX FIFO0 overflows and
+ * wakes from Stop) before and after the overflow check of the interrupt.
+ */
+typedef struct {
+	uint32_t losses_before;
+	uint32_t losses;
+} rx_Context;
+
+/**
+ * @def SPAN_RECORDS
+ * @brief Most binary records in one UART DMA transfer (all of them the smallest).
+ */
+#define SPAN_RECORDS (UART_TX_ARENA_SIZE / CAN_WIRE_SIZE(0) + 1)
+
+/**
+ * @struct span_Record
+ * @brief Latency bookkeeping of a binary record in the DMA transfer in progress.
+ *
+ * @details
+ * end is the offset of the byte after the record in the transfer.
+ */
+typedef struct {
+	uint32_t Timestamp;
+	uint16_t end;
+	uint8_t latency_class;
+} span_Record;
 
 
 /**
@@ -61,6 +121,33 @@ const my_CAN_BitTiming can_timings[] = {
 
 const uint8_t baudrates_nbr = sizeof(can_timings) / sizeof(can_timings[0]);
 
+/**
+ * @var can_data_timings[]
+ * @brief Table of CAN FD data-phase bit timings, in auto-detection order.
+ *
+ * @details
+ * Same 40 MHz FDCAN peripheral clock as can_timings[]. The most common data
+ * rates come first with a sample point of 75-80%, then second tries of the
+ * same rates with an earlier sample point, for buses with long ringing after
+ * the edges. Timing segments are within the DataTimeSeg1 <= 32 and
+ * DataTimeSeg2 <= 16 limits of FDCAN; the data SJW is set to DataTimeSeg2.
+ *
+ * Transceiver delay compensation is not used: FDCAN1 runs in bus monitoring
+ * mode and never transmits, and the delay it compensates is the one between
+ * a node's own TX and RX pins.
+ */
+const my_CAN_BitTiming can_data_timings[] = {
+		{2000000, 1, 15, 4}, // 20 TQ, sample point 80%
+		{5000000, 1, 5, 2},  // 8 TQ, sample point 75%
+		{4000000, 1, 7, 2},  // 10 TQ, sample point 80%
+		{1000000, 1, 31, 8}, // 40 TQ, sample point 80%
+		{8000000, 1, 3, 1},  // 5 TQ, sample point 80%
+		{2000000, 1, 13, 6}, // Sample point 70%
+		{5000000, 1, 4, 3},  // Sample point 62.5%
+};
+
+const uint8_t data_baudrates_nbr = sizeof(can_data_timings) / sizeof(can_data_timings[0]);
+
 /**
  * @var software_CAN_buffer_overflow
  * @brief Flag indicating a software CAN buffer overflow.
@@ -75,27 +162,107 @@ static volatile bool hardware_CAN_buffer_overflow = false;
 
 /**
  * @var head
- * @brief Software CAN ring buffer head index.
+ * @brief Software CAN ring buffer head (write) byte offset.
  */
-static volatile uint16_t head = 0;
+static volatile uint32_t head = 0;
 
 /**
  * @var tail
- * @brief Software CAN ring buffer tail index.
+ * @brief Software CAN ring buffer tail (read) byte offset.
  */
-static volatile uint16_t tail = 0;
+static volatile uint32_t tail = 0;
 
 /**
  * @var CAN_ring_buffer[SOFTWARE_CAN_BUFFER_SIZE]
- * @brief Software CAN ring buffer.
+ * @brief Software CAN ring buffer (record arena).
+ */
+static uint8_t CAN_ring_buffer[SOFTWARE_CAN_BUFFER_SIZE] __ALIGNED(4);
+
+/**
+ * @var released_records
+ * @brief Number of records consumed from the ring buffer.
  */
-static my_CAN_Frame CAN_ring_buffer[SOFTWARE_CAN_BUFFER_SIZE];
+static volatile uint32_t released_records = 0;
+
+/**
+ * @var buffer_stats
+ * @brief Software CAN ring buffer usage counters.
+ */
+static my_CAN_Buffer_Stats buffer_stats = {0, 0, 0, 0, 0, 0, 0, 0};
+
+/**
+ * @var wire_sequence
+ * @brief Sequence number of the next binary wire record.
+ */
+static uint16_t wire_sequence = 0;
+
+/**
+ * @var cycle_stats
+ * @brief Capture path cycle counters.
+ */
+static my_CAN_Cycle_Stats cycle_stats = {0, 0, 0, 0, 0};
+
+/**
+ * @var latency_stats
+ * @brief Output latency histograms.
+ */
+static my_CAN_Latency_Stats latency_stats;
+
+/**
+ * @var span_records[SPAN_RECORDS]
+ * @brief Records of the last binary DMA transfer whose end-to-end latency is pending.
+ */
+static span_Record span_records[SPAN_RECORDS];
+
+/**
+ * @var span_record_count
+ * @brief Number of entries in span_records[], 0 if none pending.
+ */
+static uint32_t span_record_count = 0;
+
+/**
+ * @var span_size
+ * @brief Size (in bytes) of the last binary DMA transfer.
+ */
+static uint32_t span_size = 0;
+
+/**
+ * @var span_start_us
+ * @brief Start time of the last binary DMA transfer.
+ */
+static uint32_t span_start_us = 0;
+
+/**
+ * @var span_starts
+ * @brief Number of binary DMA transfers started.
+ */
+static uint32_t span_starts = 0;
+
+/**
+ * @var span_completions
+ * @brief Number of binary DMA transfers completed (UART interrupt).
+ */
+static volatile uint32_t span_completions = 0;
+
+/**
+ * @var span_complete_us
+ * @brief Completion time of the last binary DMA transfer (UART interrupt).
+ */
+static volatile uint32_t span_complete_us = 0;
 
 /**
  * @var can_status
  * @brief Current CAN status instance.
  */
-static my_CAN_Status can_status = {false, 0, 0, 0};
+static my_CAN_Status can_status = {.output_mode = BINARY_ONLY(PIPELINE_STAGES) ? CAN_OUTPUT_BINARY : CAN_OUTPUT_TEXT};
+
+#if CAN_PIPELINE_PROFILE == CAN_PIPELINE_DYNAMIC
+/**
+ * @var rx_stage_mask
+ * @brief Stages run by the dynamic handler.
+ */
+static uint32_t rx_stage_mask = CAN_PIPELINE_MASK(CAN_PIPELINE_FULL_STAGES);
+#endif
 
 /**
  * @var sFilterConfig
@@ -103,6 +270,62 @@ static my_CAN_Status can_status = {false, 0, 0, 0};
  */
 static FDCAN_FilterTypeDef sFilterConfig;
 
+/**
+ * @fn static my_CAN_Status set_configuration(bool is_set, uint32_t baudrate, uint32_t data_baudrate)
+ * @brief Record the outcome of a bit rate configuration, keeping the filter and output settings.
+ */
+static my_CAN_Status set_configuration(bool is_set, uint32_t baudrate, uint32_t data_baudrate) {
+	can_status.is_set = is_set;
+	can_status.baudrate = baudrate;
+	can_status.data_baudrate = data_baudrate;
+	return can_status;
+}
+
+/**
+ * @fn static void set_frame_format(uint32_t frame_format)
+ * @brief Select classic or CAN FD frames, with RX FIFO0 elements to match.
+ *
+ * @details
+ * HAL_FDCAN_GetRxMessage() copies the whole payload given by the DLC, up to
+ * 64 bytes for CAN FD, so FIFO0 elements are sized for it. The capture path
+ * keeps the first 8 bytes (see HAL_FDCAN_RxFifo0Callback()).
+ */
+static void set_frame_format(uint32_t frame_format) {
+	hfdcan1.Init.FrameFormat = frame_format;
+	hfdcan1.Init.RxFifo0ElmtSize = (frame_format == FDCAN_FRAME_CLASSIC) ? FDCAN_DATA_BYTES_8 : FDCAN_DATA_BYTES_64;
+}
+
+/**
+ * @fn static void set_data_timing(const my_CAN_BitTiming* timing)
+ * @brief Apply a data-phase bit timing.
+ */
+static void set_data_timing(const my_CAN_BitTiming* timing) {
+	hfdcan1.Init.DataPrescaler = timing->prescaler;
+	hfdcan1.Init.DataTimeSeg1 = timing->timeSeg1;
+	hfdcan1.Init.DataTimeSeg2 = timing->timeSeg2;
+	hfdcan1.Init.DataSyncJumpWidth = timing->timeSeg2;
+}
+
+/**
+ * @fn static bool is_data_phase_error(const FDCAN_ProtocolStatusTypeDef* protocol_status)
+ * @brief Whether an error was detected in the data phase of a CAN FD frame
+ * 		  since the previous read of the protocol status.
+ */
+static bool is_data_phase_error(const FDCAN_ProtocolStatusTypeDef* protocol_status) {
+	return protocol_status->DataLastErrorCode != FDCAN_PROTOCOL_ERROR_NONE &&
+		   protocol_status->DataLastErrorCode != FDCAN_PROTOCOL_ERROR_NO_CHANGE;
+}
+
+/**
+ * @fn static bool is_nominal_phase_clean(const FDCAN_ProtocolStatusTypeDef* protocol_status)
+ * @brief Whether no error was detected in the arbitration (nominal) phase
+ * 		  since the previous read of the protocol status.
+ */
+static bool is_nominal_phase_clean(const FDCAN_ProtocolStatusTypeDef* protocol_status) {
+	return protocol_status->LastErrorCode == FDCAN_PROTOCOL_ERROR_NONE ||
+		   protocol_status->LastErrorCode == FDCAN_PROTOCOL_ERROR_NO_CHANGE;
+}
+
 /**
  * @fn my_CAN_Status my_CAN_manual_configuration(uint32_t baudrate)
  * @brief Configure CAN manually using a requested baudrate.
@@ -111,7 +334,8 @@ static FDCAN_FilterTypeDef sFilterConfig;
  * @retval Current CAN status instance
  *
  * @details
- * Scans the bit timing table and applies the matching configuration.
+ * Scans the bit timing table and applies the matching configuration. Selects classic
+ * CAN frames (no data-phase rate).
  */
 my_CAN_Status my_CAN_manual_configuration(uint32_t baudrate) {
 	for (int i = 0; i < baudrates_nbr; i++) {
@@ -121,25 +345,44 @@ my_CAN_Status my_CAN_manual_configuration(uint32_t baudrate) {
 		hfdcan1.Init.NominalPrescaler = can_timings[i].prescaler;
 		hfdcan1.Init.NominalTimeSeg1 = can_timings[i].timeSeg1;
 		hfdcan1.Init.NominalTimeSeg2 = can_timings[i].timeSeg2;
-		return can_status = (my_CAN_Status){true, baudrate, can_status.filter_id, can_status.mask_id};
+		set_frame_format(FDCAN_FRAME_CLASSIC);
+		return set_configuration(true, baudrate, 0);
 	}
-	return can_status = (my_CAN_Status){false, 0, can_status.filter_id, can_status.mask_id};
+	return set_configuration(false, 0, 0);
 }
 
 /**
  * @fn my_CAN_Status my_CAN_auto_configuration(bool to_print)
- * @brief Try all supported baud rates until bus activity is detected.
+ * @brief Try all supported baud rates until bus activity is detected, then
+ * the CAN FD data-phase bit timings.
  *
  * @param to_print If true, "Trying Baud Rate:<baudrate>" messages are printed.
  * 				   If false, the process is silent.
  * @retval Current CAN status instance
  *
  * @detail
- * Applies each bit timing configuration and calls check_FIFO() to check if any traffic is detected.
+ * Applies each bit timing configuration and calls check_Fifo() to check if any traffic is detected.
  * The process is not affected by set filters. It uses global 0x000 filter and mask to capture
  * all possible traffic on the bus.
+ *
+ * The nominal sweep accepts CAN FD frames, so a bus carrying only CAN FD
+ * frames is found too: frames without bit rate switch are received, and a
+ * frame with bit rate switch passes the arbitration phase and fails (or
+ * succeeds) in the data phase. Once the nominal rate is found, bit rate
+ * switching is enabled (FDCAN_FRAME_FD_BRS, the capture configuration) and
+ * each entry of can_data_timings[] is tried with check_Fd_Fifo(), which
+ * returns as soon as CAN_FD_LOCK_FRAMES frames with bit rate switch arrive
+ * without a data-phase error. If the first timing sees neither such a frame nor a data-phase
+ * error, the bus has no bit rate switch and the sweep stops there. Without
+ * a clean lock, the timing that received the most frames without any
+ * data-phase error is kept. If there is none, data_baudrate is 0: no data
+ * rate was detected, the frame format goes back to FDCAN_FRAME_FD_NO_BRS and
+ * frames with bit rate switch are not received.
  */
 my_CAN_Status my_CAN_auto_configuration(bool to_print) {
+	set_frame_format(FDCAN_FRAME_FD_NO_BRS);
+	set_data_timing(&can_data_timings[0]);
+	uint32_t baudrate = 0;
 	for (int i = 0; i < baudrates_nbr; i++) {
 		if (to_print) my_printf("Trying Baud Rate: %d\r\n", can_timings[i].baudrate);
 		hfdcan1.Init.NominalPrescaler = can_timings[i].prescaler;
@@ -149,10 +392,41 @@ my_CAN_Status my_CAN_auto_configuration(bool to_print) {
 		HAL_FDCAN_ConfigGlobalFilter(&hfdcan1, FDCAN_ACCEPT_IN_RX_FIFO0, FDCAN_REJECT, FDCAN_REJECT_REMOTE, FDCAN_REJECT_REMOTE);
 
 		if (check_Fifo()) {
-			return can_status = (my_CAN_Status){true, can_timings[i].baudrate, can_status.filter_id, can_status.mask_id};
+			baudrate = can_timings[i].baudrate;
+			break;
 		}
 	}
-	return can_status = (my_CAN_Status){false, 0, can_status.filter_id, can_status.mask_id};
+	if (baudrate == 0) {
+		set_frame_format(FDCAN_FRAME_CLASSIC);
+		return set_configuration(false, 0, 0);
+	}
+
+	int best = -1;
+	uint32_t best_frames = 0;
+	set_frame_format(FDCAN_FRAME_FD_BRS);
+	for (int i = 0; i < data_baudrates_nbr; i++) {
+		if (to_print) my_printf("Trying Data Baud Rate: %d\r\n", can_data_timings[i].baudrate);
+		set_data_timing(&can_data_timings[i]);
+		uint32_t brs_frames = 0;
+		uint32_t data_errors = 0;
+		if (check_Fd_Fifo(&brs_frames, &data_errors)) {
+			best = i;
+			break;
+		}
+		if (data_errors == 0 && brs_frames > best_frames) {
+			best = i;
+			best_frames = brs_frames;
+		}
+		if (i == 0 && brs_frames == 0 && data_errors == 0) break;
+	}
+	if (best >= 0) {
+		set_data_timing(&can_data_timings[best]);
+	} else {
+		set_data_timing(&can_data_timings[0]);
+		set_frame_format(FDCAN_FRAME_FD_NO_BRS);
+	}
+	uint32_t data_baudrate = (best >= 0) ? can_data_timings[best].baudrate : 0;
+	return set_configuration(true, baudrate, data_baudrate);
 }
 
 /**
@@ -160,22 +434,29 @@ my_CAN_Status my_CAN_auto_configuration(bool to_print) {
  * @brief Checks for incoming frames to determine if the configured baudrate is valid.
  *
  * @param None
- * @retval true If any CAN frame is detected, else false.
+ * @retval true If any CAN frame (or data phase of a CAN FD frame) is detected, else false.
  *
  * @detail
  * Initializes and starts the CAN Sniffer. Waits WAIT_FOR_TRAFFIC time and then checks if
- * any CAN frame is captured.
+ * any CAN frame is captured. A data-phase error also means that the arbitration
+ * phase of a CAN FD frame was received at this rate, but only if the
+ * arbitration phase itself had no error: at a wrong nominal rate, the bits
+ * sampled after a misread BRS bit give data-phase errors as well.
  *
  * @note
  * For the function to actually detect the CAN baudrate, there should be traffic
  * on the bus. If the traffic is sparse, try increase WAIT_FOR_TRAFFIC delay.
  */
 static bool check_Fifo(void) {
+	FDCAN_ProtocolStatusTypeDef protocol_status;
 	HAL_FDCAN_Init(&hfdcan1);
 
 	HAL_FDCAN_Start(&hfdcan1);
+	HAL_FDCAN_GetProtocolStatus(&hfdcan1, &protocol_status); // clears the error codes
 	HAL_Delay(WAIT_FOR_TRAFFIC);
-	if (HAL_FDCAN_GetRxFifoFillLevel(&hfdcan1, FDCAN_RX_FIFO0) > 0) {
+	HAL_FDCAN_GetProtocolStatus(&hfdcan1, &protocol_status);
+	if (HAL_FDCAN_GetRxFifoFillLevel(&hfdcan1, FDCAN_RX_FIFO0) > 0 ||
+		(is_data_phase_error(&protocol_status) && is_nominal_phase_clean(&protocol_status))) {
 		HAL_FDCAN_Stop(&hfdcan1);
 		return true;
 	}
@@ -183,6 +464,43 @@ static bool check_Fifo(void) {
 	return false;
 }
 
+/**
+ * @fn static bool check_Fd_Fifo(uint32_t* brs_frames, uint32_t* data_errors)
+ * @brief Checks whether the configured data-phase bit timing receives CAN FD
+ * frames with bit rate switch.
+ *
+ * @param brs_frames Frames with bit rate switch received (output).
+ * @param data_errors Protocol status reads that found a data-phase error (output).
+ * @retval true If CAN_FD_LOCK_FRAMES such frames arrived without a data-phase error.
+ *
+ * @detail
+ * Empties the FIFO and reads the protocol status in a loop, for up to
+ * WAIT_FOR_FD_TRAFFIC, and returns as soon as the timing locks or fails.
+ */
+static bool check_Fd_Fifo(uint32_t* brs_frames, uint32_t* data_errors) {
+	FDCAN_ProtocolStatusTypeDef protocol_status;
+	FDCAN_RxHeaderTypeDef rxHeader;
+	uint8_t rxData[64];
+	*brs_frames = 0;
+	*data_errors = 0;
+
+	HAL_FDCAN_Init(&hfdcan1);
+	HAL_FDCAN_ConfigGlobalFilter(&hfdcan1, FDCAN_ACCEPT_IN_RX_FIFO0, FDCAN_REJECT, FDCAN_REJECT_REMOTE, FDCAN_REJECT_REMOTE);
+	HAL_FDCAN_Start(&hfdcan1);
+	HAL_FDCAN_GetProtocolStatus(&hfdcan1, &protocol_status); // clears the error codes
+	uint32_t start = HAL_GetTick();
+	while (HAL_GetTick() - start < WAIT_FOR_FD_TRAFFIC && *data_errors == 0 && *brs_frames < CAN_FD_LOCK_FRAMES) {
+		HAL_FDCAN_GetProtocolStatus(&hfdcan1, &protocol_status);
+		if (is_data_phase_error(&protocol_status)) (*data_errors)++;
+		while (HAL_FDCAN_GetRxFifoFillLevel(&hfdcan1, FDCAN_RX_FIFO0) > 0 &&
+			   HAL_FDCAN_GetRxMessage(&hfdcan1, FDCAN_RX_FIFO0, &rxHeader, rxData) == HAL_OK) {
+			if (rxHeader.FDFormat == FDCAN_FD_CAN && rxHeader.BitRateSwitch == FDCAN_BRS_ON) (*brs_frames)++;
+		}
+	}
+	HAL_FDCAN_Stop(&hfdcan1);
+	return *data_errors == 0 && *brs_frames >= CAN_FD_LOCK_FRAMES;
+}
+
 /**
  * @fn my_CAN_Status my_CAN_set_filter_mask(uint32_t filter_id, uint32_t mask_id)
  * @brief Assign filter and mask values on the structure of current CAN status instance.
@@ -194,7 +512,28 @@ static bool check_Fifo(void) {
 my_CAN_Status my_CAN_set_filter_mask(uint32_t filter_id, uint32_t mask_id) {
 	sFilterConfig.FilterID1 = (filter_id &= 0x7FF);
 	sFilterConfig.FilterID2 = (mask_id &= 0x7FF);
-	return can_status = (my_CAN_Status){can_status.is_set, can_status.baudrate, filter_id, mask_id};
+	can_status.filter_id = filter_id;
+	can_status.mask_id = mask_id;
+	return can_status;
+}
+
+/**
+ * @fn my_CAN_Status my_CAN_set_output_mode(my_CAN_Output_Mode output_mode)
+ * @brief Select the UART output format of captured frames.
+ *
+ * @param output_mode The desired output format.
+ * @retval Current CAN status instance
+ */
+my_CAN_Status my_CAN_set_output_mode(my_CAN_Output_Mode output_mode) {
+#if CAN_PIPELINE_PROFILE == CAN_PIPELINE_DYNAMIC
+	if (BINARY_ONLY(rx_stage_mask)) output_mode = CAN_OUTPUT_BINARY;
+#else
+	if (BINARY_ONLY(PIPELINE_STAGES)) output_mode = CAN_OUTPUT_BINARY;
+#endif
+	wire_sequence = 0;
+	cycle_stats = (my_CAN_Cycle_Stats){0};
+	can_status.output_mode = output_mode;
+	return can_status;
 }
 
 /**
@@ -210,6 +549,8 @@ my_CAN_Status get_my_CAN_status(bool to_print) {
 		if (can_status.is_set) {
 			my_printf("CAN configured.\r\n");
 			my_printf("Baud Rate: %d\r\n", can_status.baudrate);
+			if (can_status.data_baudrate) my_printf("Data Baud Rate: %d\r\n", can_status.data_baudrate);
+			else my_printf("Data Baud Rate: not detected\r\n");
 			my_printf("Filter ID: 0x%03x\r\n", can_status.filter_id);
 			my_printf("Mask ID: 0x%03x\r\n", can_status.mask_id);
 		} else {
@@ -218,6 +559,7 @@ my_CAN_Status get_my_CAN_status(bool to_print) {
 			my_printf("Filter ID: 0x%03x\r\n", can_status.filter_id);
 			my_printf("Mask ID: 0x%03x\r\n", can_status.mask_id);
 		}
+		my_printf("Output: %s\r\n", (can_status.output_mode == CAN_OUTPUT_BINARY) ? "Binary" : "Text");
 	}
 	return can_status;
 }
@@ -247,8 +589,9 @@ bool my_CAN_start(void) {
 		sFilterConfig.FilterID2 = can_status.mask_id;
 		HAL_FDCAN_ConfigFilter(&hfdcan1, &sFilterConfig);
 
+		my_uart_set_tx_complete_callback(on_span_complete);
 		HAL_FDCAN_Start(&hfdcan1);
-		HAL_FDCAN_ActivateNotification(&hfdcan1, FDCAN_IT_RX_FIFO0_NEW_MESSAGE, 0);
+		HAL_FDCAN_ActivateNotification(&hfdcan1, FDCAN_IT_RX_FIFO0_NEW_MESSAGE | FDCAN_IT_RX_FIFO0_MESSAGE_LOST, 0);
 		return true;
 	}
 	return false;
@@ -263,10 +606,269 @@ bool my_CAN_start(void) {
  */
 void my_CAN_stop(void) {
 	HAL_FDCAN_Stop(&hfdcan1);
-	HAL_FDCAN_DeactivateNotification(&hfdcan1, FDCAN_IT_RX_FIFO0_NEW_MESSAGE);
+	HAL_FDCAN_DeactivateNotification(&hfdcan1, FDCAN_IT_RX_FIFO0_NEW_MESSAGE | FDCAN_IT_RX_FIFO0_MESSAGE_LOST);
 	head = tail = 0;
+	released_records = buffer_stats.records;
+	my_uart_tx_arena_reset();
+	span_record_count = 0;
+	span_starts = span_completions;
+}
+
+/**
+ * @fn void my_CAN_suspend(void)
+ * @brief Stop FDCAN before a low-power Stop, keeping its configuration.
+ *
+ * @param None
+ * @retval None
+ */
+void my_CAN_suspend(void) {
+	HAL_FDCAN_Stop(&hfdcan1);
+}
+
+/**
+ * @fn void my_CAN_resume(void)
+ * @brief Restart FDCAN after a low-power Stop.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * The restart is counted before FDCAN is started, so the first frame of an
+ * ID checked by can_e2e_process_frame() after the wake sees the loss window.
+ */
+void my_CAN_resume(void) {
+	buffer_stats.wakes++;
+	HAL_FDCAN_Start(&hfdcan1);
+}
+
+/**
+ * @fn bool my_CAN_output_idle(void)
+ * @brief Check that every captured frame has been sent over UART.
+ *
+ * @param None
+ * @retval true If the software buffer and the UART DMA arena are empty and
+ * 		   no transmission is in progress, else false.
+ */
+bool my_CAN_output_idle(void) {
+	return (head == tail) && my_uart_tx_idle();
+}
+
+/**
+ * @fn static void encode_frame_to_UART_arena(const my_CAN_Frame* frame)
+ * @brief Write a frame in binary wire format directly into the UART DMA arena.
+ *
+ * @param frame Pointer to the received frame.
+ * @retval None
+ *
+ * @details
+ * Called from the RX interrupt. This is the only encoding step of the
+ * binary output path: the record is transmitted from where it is written.
+ * The sequence number advances even if the arena is full, so the receiver
+ * can count the dropped frames.
+ */
+static void encode_frame_to_UART_arena(const my_CAN_Frame* frame) {
+	uint32_t size = CAN_WIRE_SIZE(frame->DataLength);
+	uint16_t sequence = wire_sequence++;
+	uint8_t* record = my_uart_tx_arena_reserve(size);
+	if (record == NULL) {
+		software_CAN_buffer_overflow = true;
+		buffer_stats.dropped_frames++;
+		return;
+	}
+
+	my_uart_tx_arena_commit(record, my_CAN_wire_encode(frame, sequence, record));
+
+	uint32_t fill_bytes = my_uart_tx_arena_fill();
+	if (fill_bytes > buffer_stats.max_fill_bytes) buffer_stats.max_fill_bytes = fill_bytes;
+}
+
+/**
+ * @fn static my_CAN_Record* reserve_record_in_software_CAN_buffer(uint32_t size)
+ * @brief Reserve contiguous space for a record of size bytes.
+ *
+ * @param size Record size in bytes (CAN_RECORD_SIZE()).
+ * @retval Pointer to the reserved record, or NULL if the ring buffer is full.
+ *
+ * @details
+ * Producer side, called only from the RX interrupt. If the record does not
+ * fit before the end of the arena, a padding record is left there and the
+ * record is reserved at the start. head never catches up with tail, so
+ * head == tail always means empty. The record becomes visible to the
+ * consumer only after commit_record_to_software_CAN_buffer().
+ */
+static my_CAN_Record* reserve_record_in_software_CAN_buffer(uint32_t size) {
+	uint32_t h = head;
+	uint32_t t = tail;
+
+	if (h < t) {
+		return (size < (t - h)) ? (my_CAN_Record*)&CAN_ring_buffer[h] : NULL;
+	}
+
+	uint32_t space_to_end = SOFTWARE_CAN_BUFFER_SIZE - h;
+	if (size < space_to_end || (size == space_to_end && t != 0)) {
+		return (my_CAN_Record*)&CAN_ring_buffer[h];
+	}
+	if (size >= t) return NULL;
+
+	/* Too little room left at the end for any record is skipped implicitly by the consumer */
+	if (space_to_end >= CAN_RECORD_MIN_SIZE) {
+		((my_CAN_Record*)&CAN_ring_buffer[h])->DataLength = CAN_RECORD_PADDING;
+	}
+	buffer_stats.padding_bytes += space_to_end;
+	return (my_CAN_Record*)&CAN_ring_buffer[0];
+}
+
+/**
+ * @fn static void commit_record_to_software_CAN_buffer(my_CAN_Record* record, uint32_t size)
+ * @brief Publish a filled record to the consumer and update the usage counters.
+ */
+static void commit_record_to_software_CAN_buffer(my_CAN_Record* record, uint32_t size) {
+	uint32_t next_head = ((uint8_t*)record - CAN_ring_buffer) + size;
+	if (next_head == SOFTWARE_CAN_BUFFER_SIZE) next_head = 0;
+
+	__DMB(); // Record contents must be visible before the new head
+	head = next_head;
+
+	buffer_stats.records++;
+	buffer_stats.record_bytes += size;
+
+	uint32_t fill_bytes = (next_head + SOFTWARE_CAN_BUFFER_SIZE - tail) % SOFTWARE_CAN_BUFFER_SIZE;
+	uint32_t fill_records = buffer_stats.records - released_records;
+	if (fill_bytes > buffer_stats.max_fill_bytes) buffer_stats.max_fill_bytes = fill_bytes;
+	if (fill_records > buffer_stats.max_fill_records) buffer_stats.max_fill_records = fill_records;
+}
+
+/**
+ * @fn static inline void stage_ids(const my_CAN_Frame* frame, const rx_Context* context)
+ * @brief RX stage: intrusion detection.
+ */
+static inline void stage_ids(const my_CAN_Frame* frame, const rx_Context* context) {
+	(void)context;
+	can_ids_process_frame(frame);
+}
+
+/**
+ * @fn static inline void stage_e2e(const my_CAN_Frame* frame, const rx_Context* context)
+ * @brief RX stage: rolling counter and CRC checks.
+ */
+static inline void stage_e2e(const my_CAN_Frame* frame, const rx_Context* context) {
+	can_e2e_process_frame(frame, context->losses_before, context->losses);
+}
+
+/**
+ * @fn static inline void stage_history(const my_CAN_Frame* frame, const rx_Context* context)
+ * @brief RX stage: per-ID history.
+ */
+static inline void stage_history(const my_CAN_Frame* frame, const rx_Context* context) {
+	(void)context;
+	can_history_record_frame(frame);
+}
+
+/**
+ * @fn static inline void stage_logger(const my_CAN_Frame* frame, const rx_Context* context)
+ * @brief RX stage: SD card log.
+ */
+static inline void stage_logger(const my_CAN_Frame* frame, const rx_Context* context) {
+	(void)context;
+	can_logger_record_frame(frame);
+}
+
+/**
+ * @fn static inline void stage_binary(const my_CAN_Frame* frame, const rx_Context* context)
+ * @brief RX stage: binary record in the UART DMA transmit arena.
+ */
+static inline void stage_binary(const my_CAN_Frame* frame, const rx_Context* context) {
+	(void)context;
+	encode_frame_to_UART_arena(frame);
+}
+
+/**
+ * @fn static inline void stage_output(const my_CAN_Frame* frame, const rx_Context* context)
+ * @brief RX stage: output in the format selected at run time.
+ *
+ * @details
+ * Binary output: encodes the frame directly into the UART DMA transmit arena.
+ * Text output: writes a my_CAN_Record with only DataLength payload bytes at
+ * `head` of the software ring buffer. If no room is left for it, sets
+ * `software_CAN_buffer_overflow` and the frame is dropped.
+ */
+static inline void stage_output(const my_CAN_Frame* frame, const rx_Context* context) {
+	if (can_status.output_mode == CAN_OUTPUT_BINARY) {
+		stage_binary(frame, context);
+		return;
+	}
+
+	uint32_t size = CAN_RECORD_SIZE(frame->DataLength);
+	my_CAN_Record* record = reserve_record_in_software_CAN_buffer(size);
+	if (record == NULL) {
+		software_CAN_buffer_overflow = true;
+		buffer_stats.dropped_frames++;
+		return;
+	}
+	record->Timestamp = frame->Timestamp;
+	record->Identifier = frame->Identifier;
+	record->DataLength = frame->DataLength;
+	record->Flags = 0;
+	memcpy(record->Data, frame->Data, frame->DataLength);
+	commit_record_to_software_CAN_buffer(record, size);
 }
 
+#if CAN_PIPELINE_PROFILE == CAN_PIPELINE_DYNAMIC
+/**
+ * @typedef rx_Stage
+ * @brief RX stage called through the dynamic function table.
+ */
+typedef void (*rx_Stage)(const my_CAN_Frame* frame, const rx_Context* context);
+
+/**
+ * @def STAGE_ENTRY(name)
+ * @brief Function table entry of a stage.
+ */
+#define STAGE_ENTRY(name) stage_##name,
+
+/**
+ * @var rx_stages[]
+ * @brief All stages, in CAN_PIPELINE_ALL_STAGES (bit) order.
+ */
+static const rx_Stage rx_stages[] = {CAN_PIPELINE_ALL_STAGES(STAGE_ENTRY)};
+
+/**
+ * @fn void my_CAN_set_rx_stages(uint32_t stages)
+ * @brief Select the RX handler stages of the dynamic pipeline.
+ *
+ * @param stages Mask of CAN_PIPELINE_STAGE_BIT_<stage> bits.
+ * @retval None
+ */
+void my_CAN_set_rx_stages(uint32_t stages) {
+	rx_stage_mask = stages;
+	if (BINARY_ONLY(stages)) can_status.output_mode = CAN_OUTPUT_BINARY;
+}
+
+/**
+ * @fn static inline void run_stages(const my_CAN_Frame* frame, const rx_Context* context)
+ * @brief Run the enabled stages through the function table.
+ */
+static inline void run_stages(const my_CAN_Frame* frame, const rx_Context* context) {
+	for (uint32_t i = 0; i < sizeof(rx_stages) / sizeof(rx_stages[0]); i++) {
+		if (rx_stage_mask & (1U << i)) rx_stages[i](frame, context);
+	}
+}
+#else
+/**
+ * @def STAGE_CALL(name)
+ * @brief Call of a stage in the straight-line handler.
+ */
+#define STAGE_CALL(name) stage_##name(frame, context);
+
+/**
+ * @fn static inline void run_stages(const my_CAN_Frame* frame, const rx_Context* context)
+ * @brief Run the stages of CAN_PIPELINE_STAGES, expanded and inlined at build time.
+ */
+static inline void run_stages(const my_CAN_Frame* frame, const rx_Context* context) {
+	CAN_PIPELINE_STAGES(STAGE_CALL)
+}
+#endif
+
 /**
  * @fn void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo0ITs)
  * @brief ISR callback for FDCAN RX FIFO0 events.
@@ -283,65 +885,319 @@ void my_CAN_stop(void) {
  *         to true and clears the corresponding hardware flag.
  *
  *    - 2. Reads up to 32 frames from FIFO0: Retrieves the message header and data using
- *         `HAL_FDCAN_GetRxMessage` and converts it into a software CAN frame (`my_CAN_Frame`).
+ *         `HAL_FDCAN_GetRxMessage` and converts it into a software CAN frame (`my_CAN_Frame`)
+ *         stamped with the current microsecond timestamp.
+ *
+ *    - 3. Runs the stages of the pipeline on the frame (my_can_pipeline.h). By default
+ *         (CAN_PIPELINE_FULL): intrusion detection (`can_ids_process_frame`), rolling
+ *         counter/CRC check (`can_e2e_process_frame`), per-ID history
+ *         (`can_history_record_frame`), SD card log (`can_logger_record_frame`), then the
+ *         text ring buffer or the binary UART arena (`stage_output`).
  *
- *    - 3. Inserts the frame into the software ring buffer: If the ring buffer is full sets
- *         `software_CAN_buffer_overflow` and the frame is dropped. Otherwise, stores the frame
- *         at the current `head` position and updates `head`.
+ * The DWT cycle cost of each frame is accumulated in the cycle counters.
  */
 void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef *hfdcan, uint32_t RxFifo0ITs) {
+	rx_Context context = {buffer_stats.fifo_overflows + buffer_stats.wakes, 0};
 	if (RxFifo0ITs & FDCAN_IT_RX_FIFO0_MESSAGE_LOST) {
 		hardware_CAN_buffer_overflow = true;
+		buffer_stats.fifo_overflows++;
 		__HAL_FDCAN_CLEAR_FLAG(hfdcan, FDCAN_FLAG_RX_FIFO0_MESSAGE_LOST);
 	}
+	context.losses = buffer_stats.fifo_overflows + buffer_stats.wakes;
 
 	for (int i = 0; i < 32; i++) {
 		FDCAN_RxHeaderTypeDef rxHeader;
-		uint8_t rxData[8] = {0};
+		uint8_t rxData[64] = {0};
 		my_CAN_Frame frame = {0};
 
 		if (HAL_FDCAN_GetRxMessage(hfdcan, FDCAN_RX_FIFO0, &rxHeader, rxData) != HAL_OK) break;
+		uint32_t start_cycles = my_DWT_GetCycles_end();
+		frame.Timestamp = my_timestamp_get();
 		frame.Identifier = rxHeader.Identifier;
-		frame.DataLength = rxHeader.DataLength;
-		memcpy(frame.Data, rxData, rxHeader.DataLength);
+		/* CAN FD payloads are cut to the 8 bytes of my_CAN_Frame (DLC codes above 8 are FD lengths) */
+		frame.DataLength = (rxHeader.DataLength > 8) ? 8 : rxHeader.DataLength;
+		memcpy(frame.Data, rxData, frame.DataLength);
 
-		uint16_t next_head = (head + 1) & (SOFTWARE_CAN_BUFFER_SIZE - 1);
-		if (next_head == tail) {
-			software_CAN_buffer_overflow = true;
-		} else {
-			CAN_ring_buffer[head] = frame;
-			head = next_head;
+		run_stages(&frame, &context);
+
+		uint32_t cycles = my_DWT_GetCycles_end() - start_cycles;
+		cycle_stats.rx_frames++;
+		cycle_stats.rx_cycles += cycles;
+		if (cycles > cycle_stats.rx_max_cycles) cycle_stats.rx_max_cycles = cycles;
+	}
+}
+
+/**
+ * @fn static const my_CAN_Record* peek_record_from_software_CAN_buffer(void)
+ * @brief Get the next record of the software buffer without copying it.
+ *
+ * @param None
+ * @retval Pointer to the record in place, or NULL if the ring buffer is empty.
+ *
+ * @details
+ * Skips the padding at the end of the arena. The record stays valid until
+ * release_record_from_software_CAN_buffer() is called.
+ */
+static const my_CAN_Record* peek_record_from_software_CAN_buffer(void) {
+	while (head != tail) {
+		const my_CAN_Record* record = (const my_CAN_Record*)&CAN_ring_buffer[tail];
+		if ((SOFTWARE_CAN_BUFFER_SIZE - tail) < CAN_RECORD_MIN_SIZE || record->DataLength == CAN_RECORD_PADDING) {
+			tail = 0;
+			continue;
 		}
+		return record;
 	}
+	return NULL;
 }
 
 /**
- * @fn static bool read_frame_from_software_CAN_buffer(my_CAN_Frame* frame)
- * @brief Pop the next frame from the software buffer.
+ * @fn static void release_record_from_software_CAN_buffer(const my_CAN_Record* record)
+ * @brief Give the space of the peeked record back to the producer.
  *
- * @param frame Pointer to a frame structure where the popped frame will be stored.
- * @retval true If a framed is stored, else false if the ring buffer is empty.
+ * @param record Pointer returned by peek_record_from_software_CAN_buffer().
+ * @retval None
  */
-static bool read_frame_from_software_CAN_buffer(my_CAN_Frame* frame) {
-    if (head == tail) return false;
+static void release_record_from_software_CAN_buffer(const my_CAN_Record* record) {
+	uint32_t next_tail = tail + CAN_RECORD_SIZE(record->DataLength);
+	if (next_tail == SOFTWARE_CAN_BUFFER_SIZE) next_tail = 0;
 
-    *frame = CAN_ring_buffer[tail];
-    tail = (tail + 1) & (SOFTWARE_CAN_BUFFER_SIZE - 1);
+	__DMB(); // Record must be fully read before its space is given back
+	tail = next_tail;
+	released_records++;
+}
+
+/**
+ * @fn static void add_latency(my_CAN_Latency_Histogram* histogram, uint32_t latency_us)
+ * @brief Count a latency in its log2 bucket.
+ */
+static void add_latency(my_CAN_Latency_Histogram* histogram, uint32_t latency_us) {
+	uint32_t bucket = 32U - __CLZ(latency_us);
+	if (bucket >= CAN_LATENCY_BUCKETS) bucket = CAN_LATENCY_BUCKETS - 1;
+
+	histogram->frames++;
+	histogram->total_us += latency_us;
+	if (latency_us > histogram->max_us) histogram->max_us = latency_us;
+	histogram->buckets[bucket]++;
+}
+
+/**
+ * @fn static void on_span_complete(void)
+ * @brief UART interrupt: stamp the end of a binary DMA transfer.
+ */
+static void on_span_complete(void) {
+	span_complete_us = my_timestamp_get();
+	span_completions++;
+}
+
+/**
+ * @fn static void complete_latency_span(void)
+ * @brief Count the end-to-end latency of the records of the last DMA transfer, once it has completed.
+ *
+ * @details
+ * The UART sends the transfer at a constant byte rate, so a record has left
+ * at the fraction end / span_size of the transfer time.
+ */
+static void complete_latency_span(void) {
+	if (span_record_count == 0 || span_completions != span_starts) return;
+
+	uint32_t duration = span_complete_us - span_start_us;
+	for (uint32_t i = 0; i < span_record_count; i++) {
+		const span_Record* record = &span_records[i];
+		uint32_t sent = span_start_us + (uint32_t)(((uint64_t)duration * record->end) / span_size);
+		add_latency(&latency_stats.end_to_end[record->latency_class], sent - record->Timestamp);
+	}
+	span_record_count = 0;
+}
+
+/**
+ * @fn static void start_latency_span(const uint8_t* span, uint32_t size, uint32_t now)
+ * @brief Count the ring residence of the records of a DMA transfer that just started.
+ *
+ * @param span First byte of the transfer.
+ * @param size Size of the transfer in bytes.
+ * @param now Time the transfer was started.
+ * @retval None
+ *
+ * @details
+ * Reads the timestamp and the ID of each binary record (little-endian, as
+ * the CPU) in place. The records stay valid until the transfer completes,
+ * which takes far longer than this loop (one UART byte time per few
+ * records).
+ */
+static void start_latency_span(const uint8_t* span, uint32_t size, uint32_t now) {
+	complete_latency_span();
+
+	uint32_t count = 0;
+	uint32_t offset = 0;
+	while (offset < size && span[offset + 1] != 0 && count < SPAN_RECORDS) {
+		uint32_t timestamp;
+		uint32_t identifier;
+		memcpy(&timestamp, &span[offset + 4], sizeof(timestamp));
+		memcpy(&identifier, &span[offset + 8], sizeof(identifier));
+		uint8_t latency_class = CAN_LATENCY_CLASS(identifier);
+
+		add_latency(&latency_stats.residence[latency_class], now - timestamp);
+		offset += span[offset + 1];
+		span_records[count++] = (span_Record){timestamp, (uint16_t)offset, latency_class};
+	}
+	span_record_count = count;
+	span_size = size;
+	span_start_us = now;
+	span_starts++;
+}
+
+/**
+ * @fn my_CAN_Buffer_Stats get_my_CAN_buffer_stats(bool to_print)
+ * @brief Get the software CAN arena usage counters.
+ *
+ * @param to_print If true, the counters and the capacity gain over fixed
+ * 				   my_CAN_Frame slots are printed.
+ * 				   If false, nothing is printed.
+ * @retval Current arena counters
+ *
+ * @details
+ * Capacity is the number of frames the arena holds at the observed average
+ * record size, compared with SOFTWARE_CAN_BUFFER_SIZE / sizeof(my_CAN_Frame)
+ * fixed slots.
+ */
+my_CAN_Buffer_Stats get_my_CAN_buffer_stats(bool to_print) {
+	my_CAN_Buffer_Stats stats = buffer_stats;
+
+	if (to_print) {
+		uint32_t slot_capacity = SOFTWARE_CAN_BUFFER_SIZE / sizeof(my_CAN_Frame);
+		my_printf("Arena: %d B, records %lu, padding %lu B\r\n", SOFTWARE_CAN_BUFFER_SIZE, stats.records, stats.padding_bytes);
+		my_printf("High-water: %lu B, %lu records\r\n", stats.max_fill_bytes, stats.max_fill_records);
+		my_printf("Dropped: %lu frames, hardware FIFO overflows: %lu, wakes from Stop: %lu\r\n",
+				  stats.dropped_frames, stats.fifo_overflows, stats.wakes);
+		if (stats.records) {
+			uint32_t record_capacity = (uint32_t)(((uint64_t)SOFTWARE_CAN_BUFFER_SIZE * stats.records) / stats.record_bytes);
+			uint32_t average_x100 = (uint32_t)(((uint64_t)stats.record_bytes * 100) / stats.records);
+			uint32_t gain = (record_capacity > slot_capacity) ? ((record_capacity - slot_capacity) * 100) / slot_capacity : 0;
+			my_printf("Average record: %lu.%02lu B, capacity %lu frames (fixed slots: %lu frames, +%lu%%)\r\n",
+					  average_x100 / 100, average_x100 % 100, record_capacity, slot_capacity, gain);
+		}
+	}
+	return stats;
+}
+
+/**
+ * @fn my_CAN_Cycle_Stats get_my_CAN_cycle_stats(bool to_print)
+ * @brief Get the per-frame cycle cost of the capture path.
+ *
+ * @param to_print If true, average and maximum cycles per frame are printed.
+ * 				   If false, nothing is printed.
+ * @retval Current cycle counters
+ *
+ * @details
+ * In binary mode the output cost is averaged over all received frames,
+ * since DMA transfers carry several frames.
+ */
+my_CAN_Cycle_Stats get_my_CAN_cycle_stats(bool to_print) {
+	my_CAN_Cycle_Stats stats = cycle_stats;
+
+	if (to_print) {
+		uint32_t output_frames = (can_status.output_mode == CAN_OUTPUT_BINARY) ? stats.rx_frames : stats.output_frames;
+		uint32_t rx_average = stats.rx_frames ? (uint32_t)(stats.rx_cycles / stats.rx_frames) : 0;
+		uint32_t output_average = output_frames ? (uint32_t)(stats.output_cycles / output_frames) : 0;
+
+		my_printf("RX pipeline: %s, Output: %s, Frames: %lu\r\n", CAN_PIPELINE_NAME,
+				  (can_status.output_mode == CAN_OUTPUT_BINARY) ? "Binary" : "Text", stats.rx_frames);
+		my_printf("RX cycles/frame: avg %lu, max %lu\r\n", rx_average, stats.rx_max_cycles);
+		my_printf("Output cycles/frame: avg %lu\r\n", output_average);
+	}
+	return stats;
+}
+
+/**
+ * @fn static uint32_t latency_percentile(const my_CAN_Latency_Histogram* histogram, uint32_t percent)
+ * @brief Upper bound (us) of the bucket holding a percentile, or the maximum if smaller.
+ */
+static uint32_t latency_percentile(const my_CAN_Latency_Histogram* histogram, uint32_t percent) {
+	uint32_t rank = (uint32_t)(((uint64_t)histogram->frames * percent + 99) / 100);
+	uint32_t count = 0;
+	for (uint32_t bucket = 0; bucket < CAN_LATENCY_BUCKETS; bucket++) {
+		count += histogram->buckets[bucket];
+		if (count >= rank) {
+			uint32_t bound = (1UL << bucket) - 1;
+			return (bucket == CAN_LATENCY_BUCKETS - 1 || bound > histogram->max_us) ? histogram->max_us : bound;
+		}
+	}
+	return histogram->max_us;
+}
+
+/**
+ * @fn static void print_latency_histogram(const char* name, uint32_t latency_class, const my_CAN_Latency_Histogram* histogram)
+ * @brief Print the summary and the non-empty buckets of a latency histogram.
+ */
+static void print_latency_histogram(const char* name, uint32_t latency_class, const my_CAN_Latency_Histogram* histogram) {
+	if (histogram->frames == 0) return;
+
+	my_printf("Class %lu %s: %lu frames, mean %lu, p50 <= %lu, p99 <= %lu, max %lu us\r\n", latency_class, name,
+			  histogram->frames, (uint32_t)(histogram->total_us / histogram->frames),
+			  latency_percentile(histogram, 50), latency_percentile(histogram, 99), histogram->max_us);
+	for (uint32_t bucket = 0; bucket < CAN_LATENCY_BUCKETS; bucket++) {
+		if (histogram->buckets[bucket] == 0) continue;
+		if (bucket == CAN_LATENCY_BUCKETS - 1) {
+			my_printf("  >= %lu us: %lu\r\n", 1UL << (bucket - 1), histogram->buckets[bucket]);
+		} else {
+			my_printf("  < %lu us: %lu\r\n", 1UL << bucket, histogram->buckets[bucket]);
+		}
+	}
+}
 
-    return true;
+/**
+ * @fn const my_CAN_Latency_Stats* get_my_CAN_latency_stats(bool to_print)
+ * @brief Get the output latency histograms.
+ *
+ * @param to_print If true, frames, mean, p50, p99 and maximum latency and the
+ * 				   histogram of each class with frames are printed.
+ * 				   If false, nothing is printed.
+ * @retval Current histograms (updated by send_frame_over_UART())
+ *
+ * @details
+ * Percentiles are the upper bounds of their buckets.
+ */
+const my_CAN_Latency_Stats* get_my_CAN_latency_stats(bool to_print) {
+	if (to_print) {
+		my_printf("Output latency (%s), classes by CAN_LATENCY_CLASS():\r\n",
+				  (can_status.output_mode == CAN_OUTPUT_BINARY) ? "Binary" : "Text");
+		for (uint32_t latency_class = 0; latency_class < CAN_LATENCY_CLASSES; latency_class++) {
+			print_latency_histogram("ring residence", latency_class, &latency_stats.residence[latency_class]);
+			print_latency_histogram("end to end", latency_class, &latency_stats.end_to_end[latency_class]);
+		}
+	}
+	return &latency_stats;
 }
 
 /**
  * @fn void send_frame_over_UART(void)
- * @brief Print all buffered CAN frames over UART.
+ * @brief Send captured frames over UART in the selected output format.
  *
  * @param None
  * @retval None
  *
  * @details
- * Also prints debug warnings if hardware or software overflow has occurred.
+ * Also prints debug warnings if hardware or software overflow has occurred,
+ * and counts the output latency of the frames (my_CAN_Latency_Stats).
+ * In binary output mode the warnings are held until text output is selected,
+ * so that the stream only carries wire records; the overflows are counted in
+ * my_CAN_Buffer_Stats meanwhile.
  */
 void send_frame_over_UART(void) {
+	if (can_status.output_mode == CAN_OUTPUT_BINARY) {
+		uint32_t start_cycles = my_DWT_GetCycles_end();
+		const uint8_t* span;
+		uint32_t now = my_timestamp_get();
+		uint32_t size = my_uart_tx_arena_flush(&span);
+		if (size != 0) {
+			start_latency_span(span, size, now);
+			cycle_stats.output_cycles += my_DWT_GetCycles_end() - start_cycles;
+		} else {
+			complete_latency_span();
+		}
+		return;
+	}
+
 	if (hardware_CAN_buffer_overflow) {
 		hardware_CAN_buffer_overflow = false;
 		DEBUG_printf("Hardware CAN FIFO overflow!\r\n");
@@ -352,10 +1208,19 @@ void send_frame_over_UART(void) {
 		DEBUG_printf("Software CAN buffer overflow!\r\n");
 	}
 
-	my_CAN_Frame frame;
-	while (read_frame_from_software_CAN_buffer(&frame)) {
-		my_printf("ID: 0x%03X, DLC: %d, Data:", frame.Identifier, frame.DataLength);
-		for (int i = 0; i < frame.DataLength; i++) my_printf(" %02X", frame.Data[i]);
-		my_printf("\r\n\n");
+	const my_CAN_Record* record;
+	while ((record = peek_record_from_software_CAN_buffer()) != NULL) {
+		uint32_t start_cycles = my_DWT_GetCycles_end();
+		uint32_t dequeued = my_timestamp_get();
+		char line[CAN_TEXT_MAX_SIZE];
+		my_CAN_text_format(record->Identifier, record->DataLength, record->Data, line);
+		my_uart_transmit_buffer(line);
+		uint32_t sent = my_timestamp_get();
+		uint8_t latency_class = CAN_LATENCY_CLASS(record->Identifier);
+		add_latency(&latency_stats.residence[latency_class], dequeued - record->Timestamp);
+		add_latency(&latency_stats.end_to_end[latency_class], sent - record->Timestamp);
+		release_record_from_software_CAN_buffer(record);
+		cycle_stats.output_cycles += my_DWT_GetCycles_end() - start_cycles;
+		cycle_stats.output_frames++;
 	}
 }
@@ -13,7 +13,10 @@
 #define MY_CAN_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "my_debug.h"
+#include "my_timestamp.h"
+#include "my_can_pipeline.h"
 
 /**
  * @def WAIT_FOR_TRAFFIC
@@ -21,13 +24,82 @@
  */
 #define WAIT_FOR_TRAFFIC 1500
 
+/**
+ * @def WAIT_FOR_FD_TRAFFIC
+ * @brief Longest time (in ms) spent on each data-phase bit timing during CAN FD auto-detection.
+ */
+#define WAIT_FOR_FD_TRAFFIC 500
+
+/**
+ * @def CAN_FD_LOCK_FRAMES
+ * @brief CAN FD frames with bit rate switch, received without a data-phase
+ * 		  error, that lock a data-phase bit timing.
+ */
+#define CAN_FD_LOCK_FRAMES 4
+
 /**
  * @def SOFTWARE_CAN_BUFFER_SIZE
- * @brief Size of the software CAN ring buffer.
+ * @brief Size (in bytes) of the software CAN record arena.
+ *
+ * @details
+ * Same memory as 256 fixed my_CAN_Frame slots. Frames are stored as
+ * variable-length my_CAN_Record entries, so more frames fit when payloads
+ * are short.
+ *
+ * @note Must be a multiple of 4.
+ */
+#define SOFTWARE_CAN_BUFFER_SIZE 5120
+
+/**
+ * @def CAN_RECORD_PADDING
+ * @brief my_CAN_Record DataLength value marking a wrap-around padding record.
+ */
+#define CAN_RECORD_PADDING 0xFF
+
+/**
+ * @def CAN_RECORD_SIZE(data_length)
+ * @brief Arena bytes used by a record with data_length payload bytes.
+ *
+ * @details
+ * Header plus payload, rounded up to 4 bytes to keep every header aligned.
+ */
+#define CAN_RECORD_SIZE(data_length) ((offsetof(my_CAN_Record, Data) + (data_length) + 3) & ~3U)
+
+/**
+ * @def CAN_RECORD_MIN_SIZE
+ * @brief Size of the smallest record (no payload).
+ */
+#define CAN_RECORD_MIN_SIZE CAN_RECORD_SIZE(0)
+
+/**
+ * @def CAN_LATENCY_CLASSES
+ * @brief Number of priority classes of the output latency histograms.
+ */
+#define CAN_LATENCY_CLASSES 4
+
+/**
+ * @def CAN_LATENCY_CLASS(identifier)
+ * @brief Priority class (0 to CAN_LATENCY_CLASSES - 1) of a frame.
+ *
+ * @details
+ * By default the 2 most significant bits of the 11-bit ID: class 0
+ * (0x000-0x1FF) wins arbitration over all the others, class 3 (0x600-0x7FF)
+ * holds the diagnostic IDs.
+ */
+#ifndef CAN_LATENCY_CLASS
+#define CAN_LATENCY_CLASS(identifier) (((identifier) >> 9) & 3U)
+#endif
+
+/**
+ * @def CAN_LATENCY_BUCKETS
+ * @brief Number of log2 buckets of a latency histogram.
  *
- * @note Must be a power of two for modulo masking to work correctly.
+ * @details
+ * Bucket 0 counts 0 us, bucket b (1 to CAN_LATENCY_BUCKETS - 2) the latencies
+ * from 2^(b-1) to 2^b - 1 us, the last bucket 2^(CAN_LATENCY_BUCKETS - 2) us
+ * (about 4 s) and more.
  */
-#define SOFTWARE_CAN_BUFFER_SIZE 256
+#define CAN_LATENCY_BUCKETS 24
 
 /**
  * @var hfdcan1
@@ -51,31 +123,154 @@ typedef struct {
 	uint8_t timeSeg2;
 } my_CAN_BitTiming;
 
+/**
+ * @enum my_CAN_Output_Mode
+ * @brief Format in which captured frames are sent over UART.
+ *
+ * @details
+ * CAN_OUTPUT_TEXT:
+ *     Human-readable lines ("ID: 0x123, DLC: 8, Data: ..."), formatted by the
+ *     main loop from the software CAN buffer.
+ *
+ * CAN_OUTPUT_BINARY:
+ *     The RX interrupt encodes each frame directly in its final binary wire
+ *     format (see my_can_wire.h) into the UART DMA transmit arena. The main
+ *     loop only starts DMA transfers.
+ */
+typedef enum {
+	CAN_OUTPUT_TEXT,
+	CAN_OUTPUT_BINARY
+} my_CAN_Output_Mode;
+
 /**
  * @struct my_CAN_Status
  * @brief Tracks current CAN configuration state.
  *
  * @details
- * Used to report whether CAN is configured and what baudrate/filter settings
- * are active.
+ * Used to report whether CAN is configured and what baudrate/filter/output
+ * settings are active. data_baudrate is the CAN FD data-phase bit rate found
+ * by my_CAN_auto_configuration(), 0 if none was detected (classic CAN, CAN
+ * FD at the nominal rate only, or no data-phase timing without errors).
  */
 typedef struct {
 	bool is_set;
 	uint32_t baudrate;
+	uint32_t data_baudrate;
 	uint32_t filter_id;
 	uint32_t mask_id;
+	my_CAN_Output_Mode output_mode;
 } my_CAN_Status;
 
 /**
  * @struct my_CAN_Frame
  * @brief Simple software-level CAN frame representation.
+ *
+ * @details
+ * Timestamp is the reception time in microseconds (see my_timestamp.h).
  */
 typedef struct {
+	uint32_t Timestamp;
 	uint32_t Identifier;
 	uint8_t DataLength;
 	uint8_t Data[8];
 } my_CAN_Frame;
 
+/**
+ * @struct my_CAN_Record
+ * @brief Variable-length frame record stored in the software CAN arena.
+ *
+ * @details
+ * Only DataLength payload bytes follow the header. Flags is reserved for
+ * frame metadata. A record with DataLength equal to CAN_RECORD_PADDING fills
+ * the end of the arena when the next record does not fit before wrapping.
+ */
+typedef struct {
+	uint32_t Timestamp;
+	uint32_t Identifier;
+	uint8_t DataLength;
+	uint8_t Flags;
+	uint8_t Data[];
+} my_CAN_Record;
+
+/**
+ * @struct my_CAN_Buffer_Stats
+ * @brief Software CAN arena usage counters.
+ *
+ * @details
+ * record_bytes excludes padding, so record_bytes / records is the average
+ * arena cost of a frame on the observed traffic, to be compared with
+ * sizeof(my_CAN_Frame) for fixed slots. These record counters and
+ * max_fill_records are kept in text output only. max_fill_bytes is the
+ * high-water of the software buffer (text output) or of the UART DMA arena
+ * (binary output), end skipped by a wrap included.
+ *
+ * dropped_frames counts the frames lost because the software buffer (text
+ * output) or the UART DMA arena (binary output) was full, fifo_overflows the
+ * RX interrupts that found the hardware FIFO message lost flag set (the
+ * number of frames lost there is unknown). wakes counts the restarts of
+ * FDCAN by my_CAN_resume() after a low-power Stop, each losing at least the
+ * frame that woke the sniffer.
+ */
+typedef struct {
+	uint32_t records;
+	uint32_t record_bytes;
+	uint32_t padding_bytes;
+	uint32_t max_fill_bytes;
+	uint32_t max_fill_records;
+	uint32_t dropped_frames;
+	uint32_t fifo_overflows;
+	uint32_t wakes;
+} my_CAN_Buffer_Stats;
+
+
+/**
+ * @struct my_CAN_Cycle_Stats
+ * @brief DWT cycle cost of the capture path.
+ *
+ * @details
+ * rx_cycles covers the per-frame work of the RX interrupt after the frame is
+ * read from the hardware FIFO (including analysis stages). output_cycles
+ * covers the main loop output work; in text mode it includes the blocking
+ * UART transmission, in binary mode only the DMA hand-offs.
+ */
+typedef struct {
+	uint32_t rx_frames;
+	uint32_t rx_max_cycles;
+	uint64_t rx_cycles;
+	uint32_t output_frames;
+	uint64_t output_cycles;
+} my_CAN_Cycle_Stats;
+
+/**
+ * @struct my_CAN_Latency_Histogram
+ * @brief Log-scale histogram of a latency (us).
+ */
+typedef struct {
+	uint32_t frames;
+	uint32_t max_us;
+	uint64_t total_us;
+	uint32_t buckets[CAN_LATENCY_BUCKETS];
+} my_CAN_Latency_Histogram;
+
+/**
+ * @struct my_CAN_Latency_Stats
+ * @brief Output latency histograms of each priority class.
+ *
+ * @details
+ * Both latencies start at the frame timestamp (RX interrupt).
+ * residence ends when the output picks the frame up: in text mode when the
+ * main loop takes its record out of the software buffer, in binary mode when
+ * the UART DMA transfer that carries it starts.
+ * end_to_end ends when the last byte of the frame has left USART3: in text
+ * mode when the blocking transmission of its line returns, in binary mode
+ * interpolated over the DMA transfer between its start and its completion
+ * interrupt, from the position of the record in the transfer.
+ * Dropped frames are not counted.
+ */
+typedef struct {
+	my_CAN_Latency_Histogram residence[CAN_LATENCY_CLASSES];
+	my_CAN_Latency_Histogram end_to_end[CAN_LATENCY_CLASSES];
+} my_CAN_Latency_Stats;
 
 /**
  * @var can_timings[]
@@ -89,6 +284,18 @@ extern const my_CAN_BitTiming can_timings[];
  */
 extern const uint8_t baudrates_nbr;
 
+/**
+ * @var can_data_timings[]
+ * @brief Table of CAN FD data-phase bit timings, in auto-detection order.
+ */
+extern const my_CAN_BitTiming can_data_timings[];
+
+/**
+ * @var data_baudrates_nbr
+ * @brief Number of entries in can_data_timings[].
+ */
+extern const uint8_t data_baudrates_nbr;
+
 /**
  * @fn my_CAN_Status my_CAN_manual_configuration(uint32_t baudrate)
  * @brief Configure CAN manually using a requested baud rate.
@@ -98,13 +305,14 @@ extern const uint8_t baudrates_nbr;
  *
  * @detail
  * If baudrate is not one of the supported bauderates,
- * CAN will not be set.
+ * CAN will not be set. Selects classic CAN frames (no data-phase rate).
  */
 my_CAN_Status my_CAN_manual_configuration(uint32_t baudrate);
 
 /**
  * @fn my_CAN_Status my_CAN_auto_configuration(bool to_print)
- * @brief Try all supported baud rates until bus activity is detected.
+ * @brief Try all supported baud rates until bus activity is detected, then
+ * the CAN FD data-phase bit timings.
  *
  * @param to_print If true, "Trying Baud Rate:<baudrate>" messages are printed.
  * 				   If false, the process is silent.
@@ -113,6 +321,7 @@ my_CAN_Status my_CAN_manual_configuration(uint32_t baudrate);
  * @note
  * For the function to actually detect the CAN baudrate, there should be traffic
  * on the bus. If the traffic is sparse, try increase WAIT_FOR_TRAFFIC delay.
+ * The data-phase rate is only found from CAN FD frames with bit rate switch.
  */
 my_CAN_Status my_CAN_auto_configuration(bool to_print);
 
@@ -134,6 +343,34 @@ my_CAN_Status my_CAN_auto_configuration(bool to_print);
  */
 my_CAN_Status my_CAN_set_filter_mask(uint32_t filter_id, uint32_t mask_id);
 
+/**
+ * @fn my_CAN_Status my_CAN_set_output_mode(my_CAN_Output_Mode output_mode)
+ * @brief Select the UART output format of captured frames.
+ *
+ * @param output_mode The desired output format.
+ * @retval Current CAN status instance
+ *
+ * @details
+ * Also restarts the binary sequence numbering and the cycle counters.
+ * A pipeline with the binary stage but not the output stage (e.g.
+ * CAN_PIPELINE_RAW) always uses CAN_OUTPUT_BINARY.
+ */
+my_CAN_Status my_CAN_set_output_mode(my_CAN_Output_Mode output_mode);
+
+#if CAN_PIPELINE_PROFILE == CAN_PIPELINE_DYNAMIC
+/**
+ * @fn void my_CAN_set_rx_stages(uint32_t stages)
+ * @brief Select the RX handler stages of the dynamic pipeline.
+ *
+ * @param stages Mask of CAN_PIPELINE_STAGE_BIT_<stage> bits, e.g.
+ * 				 CAN_PIPELINE_MASK(CAN_PIPELINE_RAW_STAGES).
+ * @retval None
+ *
+ * @note Only with CAN_PIPELINE_DYNAMIC. Must be called while CAN is stopped.
+ */
+void my_CAN_set_rx_stages(uint32_t stages);
+#endif
+
 /**
  * @fn my_CAN_Status get_my_CAN_status(bool to_print)
  * @brief Get the current CAN configuration status.
@@ -167,16 +404,89 @@ bool my_CAN_start(void);
  */
 void my_CAN_stop(void);
 
+/**
+ * @fn void my_CAN_suspend(void)
+ * @brief Stop FDCAN before a low-power Stop, keeping its configuration.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * Unlike my_CAN_stop(), filters and interrupts stay configured and the
+ * software buffers are kept, so my_CAN_resume() only has to restart the
+ * peripheral.
+ */
+void my_CAN_suspend(void);
+
+/**
+ * @fn void my_CAN_resume(void)
+ * @brief Restart FDCAN after a low-power Stop.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * The FDCAN kernel clock must be running again. Counts the restart in
+ * my_CAN_Buffer_Stats.wakes. Reception starts once FDCAN has seen 11
+ * recessive bits on the bus.
+ */
+void my_CAN_resume(void);
+
+/**
+ * @fn bool my_CAN_output_idle(void)
+ * @brief Check that every captured frame has been sent over UART.
+ *
+ * @param None
+ * @retval true If the software buffer and the UART DMA arena are empty and
+ * 		   no transmission is in progress, else false.
+ */
+bool my_CAN_output_idle(void);
+
+/**
+ * @fn my_CAN_Buffer_Stats get_my_CAN_buffer_stats(bool to_print)
+ * @brief Get the software CAN arena usage counters.
+ *
+ * @param to_print If true, the counters and the capacity gain over fixed
+ * 				   my_CAN_Frame slots are printed.
+ * 				   If false, nothing is printed.
+ * @retval Current arena counters
+ */
+my_CAN_Buffer_Stats get_my_CAN_buffer_stats(bool to_print);
+
+/**
+ * @fn my_CAN_Cycle_Stats get_my_CAN_cycle_stats(bool to_print)
+ * @brief Get the per-frame cycle cost of the capture path.
+ *
+ * @param to_print If true, average and maximum cycles per frame are printed.
+ * 				   If false, nothing is printed.
+ * @retval Current cycle counters
+ */
+my_CAN_Cycle_Stats get_my_CAN_cycle_stats(bool to_print);
+
+/**
+ * @fn const my_CAN_Latency_Stats* get_my_CAN_latency_stats(bool to_print)
+ * @brief Get the output latency histograms.
+ *
+ * @param to_print If true, frames, mean, p50, p99 and maximum latency and the
+ * 				   histogram of each class with frames are printed.
+ * 				   If false, nothing is printed.
+ * @retval Current histograms (updated by send_frame_over_UART())
+ */
+const my_CAN_Latency_Stats* get_my_CAN_latency_stats(bool to_print);
+
 /**
  * @fn void send_frame_over_UART(void)
- * @brief Read frames from the software buffer and print them over UART.
+ * @brief Send captured frames over UART in the selected output format.
  *
  * @param None
  * @retval None
  *
  * @detail
+ * In text mode, reads frames from the software buffer and prints them.
+ * In binary mode, hands the encoded records to the UART DMA.
  * If either software or hardware buffer overflow is detected,
- * Debug Message is printed.
+ * Debug Message is printed, in text mode only: binary mode holds it so that
+ * the stream only carries wire records.
  */
 void send_frame_over_UART(void);
 
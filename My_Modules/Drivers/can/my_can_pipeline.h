@@ -0,0 +1,148 @@
+/**
+ * @file my_can_pipeline.h
+ * @brief Build-time stage list of the FDCAN RX handler.
+ *
+ * @details
+ * Every received frame goes through the stages of CAN_PIPELINE_STAGES, in
+ * order, inside HAL_FDCAN_RxFifo0Callback(). The list is an X-macro: my_can.c
+ * expands it into one call per stage to static inline functions, so the
+ * handler is a single straight-line function without a per-frame check for
+ * the stages that are not built in. The stages are:
+ *   - ids: timing-based intrusion detection (can_ids)
+ *   - e2e: rolling counter and CRC checks (can_e2e)
+ *   - history: per-ID frame history (can_history)
+ *   - logger: SD card log (can_logger)
+ *   - output: UART output in the format selected at run time
+ *   - binary: UART output in the binary format only
+ *
+ * Stages still check their own run-time settings (e.g. history off), as set
+ * from the settings menu. A stage left out of the list is never called, and
+ * its settings have no effect.
+ *
+ * Select a profile with CAN_PIPELINE_PROFILE (compiler option
+ * -DCAN_PIPELINE_PROFILE=CAN_PIPELINE_RAW), or define CAN_PIPELINE_STAGES
+ * to any list of stages:
+ *
+ *   #define CAN_PIPELINE_STAGES(STAGE) STAGE(ids) STAGE(binary)
+ *
+ * CAN_PIPELINE_DYNAMIC builds all the stages and calls them through a
+ * function table with a run-time enable mask (my_CAN_set_rx_stages()), the
+ * way a run-time configurable handler would. It is the baseline to measure
+ * the profiles against (RX cycles/frame of get_my_CAN_cycle_stats(), or
+ * Host/bench/pipeline_bench.c).
+ */
+
+#ifndef MY_CAN_PIPELINE_H
+#define MY_CAN_PIPELINE_H
+
+/**
+ * @def CAN_PIPELINE_FULL
+ * @brief Profile: every analysis stage, then the output selected at run time.
+ */
+#define CAN_PIPELINE_FULL 0
+
+/**
+ * @def CAN_PIPELINE_RAW
+ * @brief Profile: raw stream, binary records only.
+ */
+#define CAN_PIPELINE_RAW 1
+
+/**
+ * @def CAN_PIPELINE_CENSUS
+ * @brief Profile: per-ID analysis (timing, E2E, history), no frame output.
+ */
+#define CAN_PIPELINE_CENSUS 2
+
+/**
+ * @def CAN_PIPELINE_LOGGER
+ * @brief Profile: standalone SD card logging, no frame output.
+ */
+#define CAN_PIPELINE_LOGGER 3
+
+/**
+ * @def CAN_PIPELINE_DYNAMIC
+ * @brief Profile: all stages behind a function table and a run-time mask.
+ */
+#define CAN_PIPELINE_DYNAMIC 4
+
+#ifndef CAN_PIPELINE_PROFILE
+#define CAN_PIPELINE_PROFILE CAN_PIPELINE_FULL
+#endif
+
+/**
+ * @def CAN_PIPELINE_ALL_STAGES
+ * @brief Every stage, in handler order (the dynamic function table).
+ */
+#define CAN_PIPELINE_ALL_STAGES(STAGE) STAGE(ids) STAGE(e2e) STAGE(history) STAGE(logger) STAGE(output) STAGE(binary)
+
+/**
+ * @def CAN_PIPELINE_FULL_STAGES
+ * @brief Stages of CAN_PIPELINE_FULL.
+ */
+#define CAN_PIPELINE_FULL_STAGES(STAGE) STAGE(ids) STAGE(e2e) STAGE(history) STAGE(logger) STAGE(output)
+
+/**
+ * @def CAN_PIPELINE_RAW_STAGES
+ * @brief Stages of CAN_PIPELINE_RAW.
+ */
+#define CAN_PIPELINE_RAW_STAGES(STAGE) STAGE(binary)
+
+/**
+ * @def CAN_PIPELINE_CENSUS_STAGES
+ * @brief Stages of CAN_PIPELINE_CENSUS.
+ */
+#define CAN_PIPELINE_CENSUS_STAGES(STAGE) STAGE(ids) STAGE(e2e) STAGE(history)
+
+/**
+ * @def CAN_PIPELINE_LOGGER_STAGES
+ * @brief Stages of CAN_PIPELINE_LOGGER.
+ */
+#define CAN_PIPELINE_LOGGER_STAGES(STAGE) STAGE(logger)
+
+/**
+ * @def CAN_PIPELINE_STAGE_BIT_<stage>
+ * @brief Bit of each stage in the masks of my_CAN_set_rx_stages(), in
+ * CAN_PIPELINE_ALL_STAGES order.
+ */
+#define CAN_PIPELINE_STAGE_BIT_ids (1U << 0)
+#define CAN_PIPELINE_STAGE_BIT_e2e (1U << 1)
+#define CAN_PIPELINE_STAGE_BIT_history (1U << 2)
+#define CAN_PIPELINE_STAGE_BIT_logger (1U << 3)
+#define CAN_PIPELINE_STAGE_BIT_output (1U << 4)
+#define CAN_PIPELINE_STAGE_BIT_binary (1U << 5)
+
+/**
+ * @def CAN_PIPELINE_MASK
+ * @brief Mask of the stages of a stage list, e.g. CAN_PIPELINE_MASK(CAN_PIPELINE_RAW_STAGES).
+ */
+#define CAN_PIPELINE_MASK_BIT(name) | CAN_PIPELINE_STAGE_BIT_##name
+#define CAN_PIPELINE_MASK(STAGES) (0U STAGES(CAN_PIPELINE_MASK_BIT))
+
+#ifndef CAN_PIPELINE_STAGES
+#if CAN_PIPELINE_PROFILE == CAN_PIPELINE_RAW
+#define CAN_PIPELINE_STAGES CAN_PIPELINE_RAW_STAGES
+#define CAN_PIPELINE_NAME "raw"
+#elif CAN_PIPELINE_PROFILE == CAN_PIPELINE_CENSUS
+#define CAN_PIPELINE_STAGES CAN_PIPELINE_CENSUS_STAGES
+#define CAN_PIPELINE_NAME "census"
+#elif CAN_PIPELINE_PROFILE == CAN_PIPELINE_LOGGER
+#define CAN_PIPELINE_STAGES CAN_PIPELINE_LOGGER_STAGES
+#define CAN_PIPELINE_NAME "logger"
+#elif CAN_PIPELINE_PROFILE == CAN_PIPELINE_DYNAMIC
+#define CAN_PIPELINE_STAGES CAN_PIPELINE_ALL_STAGES
+#define CAN_PIPELINE_NAME "dynamic"
+#else
+#define CAN_PIPELINE_STAGES CAN_PIPELINE_FULL_STAGES
+#define CAN_PIPELINE_NAME "full"
+#endif
+#endif
+
+/**
+ * @def CAN_PIPELINE_NAME
+ * @brief Pipeline name printed with the cycle counters.
+ */
+#ifndef CAN_PIPELINE_NAME
+#define CAN_PIPELINE_NAME "custom"
+#endif
+
+#endif /* MY_CAN_PIPELINE_H */
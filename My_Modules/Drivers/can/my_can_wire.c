@@ -0,0 +1,92 @@
+/**
+ * @file my_can_wire.c
+ * @brief Binary wire record encoding and decoding, text line formatting.
+ */
+
+#include <stdio.h>
+#include "my_can_wire.h"
+
+/**
+ * @fn uint32_t my_CAN_wire_encode(const my_CAN_Frame* frame, uint16_t sequence, uint8_t* record)
+ * @brief Encode a frame as a binary wire record.
+ *
+ * @param frame Pointer to the frame to encode.
+ * @param sequence Sequence number of the record.
+ * @param record Destination, at least CAN_WIRE_SIZE(frame->DataLength) bytes.
+ * @retval Size of the written record in bytes.
+ */
+uint32_t my_CAN_wire_encode(const my_CAN_Frame* frame, uint16_t sequence, uint8_t* record) {
+	uint32_t size = CAN_WIRE_SIZE(frame->DataLength);
+
+	record[0] = CAN_WIRE_SYNC;
+	record[1] = (uint8_t)size;
+	memcpy(&record[2], &sequence, sizeof(sequence));
+	memcpy(&record[4], &frame->Timestamp, sizeof(frame->Timestamp));
+	memcpy(&record[8], &frame->Identifier, sizeof(frame->Identifier));
+	record[12] = frame->DataLength;
+	memcpy(&record[CAN_WIRE_HEADER_SIZE], frame->Data, frame->DataLength);
+
+	uint8_t checksum = 0;
+	for (uint32_t i = 1; i < size - 1; i++) checksum ^= record[i];
+	record[size - 1] = checksum;
+
+	return size;
+}
+
+/**
+ * @fn uint32_t my_CAN_wire_decode(const uint8_t* data, uint32_t length, my_CAN_Frame* frame, uint16_t* sequence)
+ * @brief Decode the binary wire record at the start of a byte stream.
+ *
+ * @param data Bytes starting with a record.
+ * @param length Number of available bytes.
+ * @param frame Decoded frame (output).
+ * @param sequence Decoded sequence number (output), may be NULL.
+ * @retval Size of the record in bytes, or 0 if data does not start with a
+ * 		   complete and valid record.
+ */
+uint32_t my_CAN_wire_decode(const uint8_t* data, uint32_t length, my_CAN_Frame* frame, uint16_t* sequence) {
+	if (length < CAN_WIRE_SIZE(0) || data[0] != CAN_WIRE_SYNC) return 0;
+
+	uint32_t size = data[1];
+	if (size < CAN_WIRE_SIZE(0) || size > CAN_WIRE_MAX_SIZE || size > length) return 0;
+	if (data[12] != size - CAN_WIRE_SIZE(0)) return 0;
+
+	uint8_t checksum = 0;
+	for (uint32_t i = 1; i < size - 1; i++) checksum ^= data[i];
+	if (checksum != data[size - 1]) return 0;
+
+	if (sequence != NULL) memcpy(sequence, &data[2], sizeof(*sequence));
+	memcpy(&frame->Timestamp, &data[4], sizeof(frame->Timestamp));
+	memcpy(&frame->Identifier, &data[8], sizeof(frame->Identifier));
+	frame->DataLength = data[12];
+	memcpy(frame->Data, &data[CAN_WIRE_HEADER_SIZE], frame->DataLength);
+
+	return size;
+}
+
+/**
+ * @fn uint32_t my_CAN_text_format(uint32_t identifier, uint8_t data_length, const uint8_t* data, char* line)
+ * @brief Format a frame as a text output line.
+ *
+ * @param identifier CAN ID.
+ * @param data_length Payload bytes (at most 8).
+ * @param data Payload.
+ * @param line Destination, at least CAN_TEXT_MAX_SIZE bytes. Null-terminated.
+ * @retval Length of the line, terminator excluded.
+ */
+uint32_t my_CAN_text_format(uint32_t identifier, uint8_t data_length, const uint8_t* data, char* line) {
+	static const char hex[] = "0123456789ABCDEF";
+	uint32_t length = (uint32_t)snprintf(line, CAN_TEXT_MAX_SIZE, "ID: 0x%03lX, DLC: %d, Data:", (unsigned long)identifier, data_length);
+
+	for (uint8_t i = 0; i < data_length; i++) {
+		line[length++] = ' ';
+		line[length++] = hex[data[i] >> 4];
+		line[length++] = hex[data[i] & 0x0F];
+	}
+	line[length++] = '\r';
+	line[length++] = '\n';
+	line[length++] = '\n';
+	line[length] = '\0';
+
+	return length;
+}
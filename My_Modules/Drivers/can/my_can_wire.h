@@ -0,0 +1,109 @@
+/**
+ * @file my_can_wire.h
+ * @brief Binary wire record format of captured CAN frames.
+ *
+ * @details
+ * Compact, self-delimiting record used for binary UART output and for the
+ * SD card log. Layout (multi-byte fields little-endian):
+ *
+ *     | Offset | Size | Field                                          |
+ *     |--------|------|------------------------------------------------|
+ *     | 0      | 1    | CAN_WIRE_SYNC (0xA5)                           |
+ *     | 1      | 1    | Record size in bytes (CAN_WIRE_SIZE(DLC))       |
+ *     | 2      | 2    | Sequence number (counts dropped frames too)     |
+ *     | 4      | 4    | Timestamp (us)                                 |
+ *     | 8      | 4    | Identifier                                     |
+ *     | 12     | 1    | DLC                                            |
+ *     | 13     | DLC  | Data                                           |
+ *     | 13+DLC | 1    | XOR of bytes 1 .. 12+DLC                       |
+ *
+ * The text output line ("ID: 0x123, DLC: 8, Data: 01 02 ...") is formatted
+ * here too.
+ *
+ * The functions have no hardware dependency, so host tools can use them too.
+ */
+
+#ifndef MY_CAN_WIRE_H
+#define MY_CAN_WIRE_H
+
+#include "my_can.h"
+
+/**
+ * @def CAN_WIRE_SYNC
+ * @brief First byte of every binary wire record.
+ */
+#define CAN_WIRE_SYNC 0xA5
+
+/**
+ * @def CAN_WIRE_HEADER_SIZE
+ * @brief Bytes of a binary wire record before the payload.
+ */
+#define CAN_WIRE_HEADER_SIZE 13
+
+/**
+ * @def CAN_WIRE_SIZE(data_length)
+ * @brief Total size of a binary wire record with data_length payload bytes.
+ */
+#define CAN_WIRE_SIZE(data_length) (CAN_WIRE_HEADER_SIZE + (data_length) + 1)
+
+/**
+ * @def CAN_WIRE_MAX_SIZE
+ * @brief Size of the largest binary wire record (8 payload bytes).
+ */
+#define CAN_WIRE_MAX_SIZE CAN_WIRE_SIZE(8)
+
+/**
+ * @def CAN_TEXT_SIZE(data_length)
+ * @brief Length of a text output line of a standard ID frame with data_length payload bytes.
+ *
+ * @details
+ * "ID: 0x123, DLC: 8, Data:", " XX" per byte, then "\r\n\n". Extended IDs
+ * take up to 5 more characters.
+ */
+#define CAN_TEXT_SIZE(data_length) (27 + 3 * (data_length))
+
+/**
+ * @def CAN_TEXT_MAX_SIZE
+ * @brief Buffer size for any text output line, terminator included.
+ */
+#define CAN_TEXT_MAX_SIZE (CAN_TEXT_SIZE(8) + 5 + 1)
+
+/**
+ * @fn uint32_t my_CAN_wire_encode(const my_CAN_Frame* frame, uint16_t sequence, uint8_t* record)
+ * @brief Encode a frame as a binary wire record.
+ *
+ * @param frame Pointer to the frame to encode.
+ * @param sequence Sequence number of the record.
+ * @param record Destination, at least CAN_WIRE_SIZE(frame->DataLength) bytes.
+ * @retval Size of the written record in bytes.
+ *
+ * @note Safe to call from interrupt context.
+ */
+uint32_t my_CAN_wire_encode(const my_CAN_Frame* frame, uint16_t sequence, uint8_t* record);
+
+/**
+ * @fn uint32_t my_CAN_wire_decode(const uint8_t* data, uint32_t length, my_CAN_Frame* frame, uint16_t* sequence)
+ * @brief Decode the binary wire record at the start of a byte stream.
+ *
+ * @param data Bytes starting with a record.
+ * @param length Number of available bytes.
+ * @param frame Decoded frame (output).
+ * @param sequence Decoded sequence number (output), may be NULL.
+ * @retval Size of the record in bytes, or 0 if data does not start with a
+ * 		   complete and valid record.
+ */
+uint32_t my_CAN_wire_decode(const uint8_t* data, uint32_t length, my_CAN_Frame* frame, uint16_t* sequence);
+
+/**
+ * @fn uint32_t my_CAN_text_format(uint32_t identifier, uint8_t data_length, const uint8_t* data, char* line)
+ * @brief Format a frame as a text output line.
+ *
+ * @param identifier CAN ID.
+ * @param data_length Payload bytes (at most 8).
+ * @param data Payload.
+ * @param line Destination, at least CAN_TEXT_MAX_SIZE bytes. Null-terminated.
+ * @retval Length of the line, terminator excluded.
+ */
+uint32_t my_CAN_text_format(uint32_t identifier, uint8_t data_length, const uint8_t* data, char* line);
+
+#endif /* MY_CAN_WIRE_H */
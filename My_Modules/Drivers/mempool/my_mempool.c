@@ -0,0 +1,184 @@
+/**
+ * @file my_mempool.c
+ * @brief Fixed-block, multi-size-class memory pool implementation.
+ *
+ * @details
+ * The region is split into one contiguous area per class. A free block stores
+ * the pointer to the next free block of its class in its first bytes, so no
+ * extra bookkeeping memory is needed. The class of a freed block is found by
+ * comparing its address against the class areas (at most MEMPOOL_MAX_CLASSES
+ * comparisons).
+ *
+ * Free list updates run with interrupts masked (PRIMASK) for a few
+ * instructions, which makes the pool safe from both ISR and thread context.
+ */
+
+#include "my_mempool.h"
+
+/**
+ * @var mempool_classes[]
+ * @brief Table of size classes.
+ *
+ * @details
+ * Sizes are chosen for the current users of the pool:
+ *  - 32/64/128 bytes: per-ID records and small state
+ *  - 288 bytes: per-ID history slabs (can_History_Slab)
+ *  - 1024 bytes: the payload set of my_payload_benchmark() (16 CAN FD payloads),
+ *    so that the benchmark does not need 1 KiB of stack
+ *
+ * The total (block_size * block_count) must not exceed MEMPOOL_REGION_SIZE.
+ */
+const my_Mempool_Class mempool_classes[] = {
+		{32, 128},
+		{64, 64},
+		{128, 32},
+		{288, 32},
+		{1024, 8},
+};
+
+const uint8_t mempool_classes_nbr = sizeof(mempool_classes) / sizeof(mempool_classes[0]);
+
+/**
+ * @var mempool_region[MEMPOOL_REGION_SIZE]
+ * @brief SRAM region managed by the pool.
+ */
+static uint8_t mempool_region[MEMPOOL_REGION_SIZE] MEMPOOL_REGION_ATTRIBUTE;
+
+/**
+ * @var free_lists[MEMPOOL_MAX_CLASSES]
+ * @brief Head of the free list of each class.
+ */
+static void* free_lists[MEMPOOL_MAX_CLASSES];
+
+/**
+ * @var class_start[MEMPOOL_MAX_CLASSES]
+ * @brief First byte of the area of each class.
+ */
+static uint8_t* class_start[MEMPOOL_MAX_CLASSES];
+
+/**
+ * @var class_end[MEMPOOL_MAX_CLASSES]
+ * @brief First byte after the area of each class.
+ */
+static uint8_t* class_end[MEMPOOL_MAX_CLASSES];
+
+/**
+ * @var mempool_stats[MEMPOOL_MAX_CLASSES]
+ * @brief Usage counters of each class.
+ */
+static my_Mempool_Stats mempool_stats[MEMPOOL_MAX_CLASSES];
+
+/**
+ * @var classes_nbr
+ * @brief Number of classes carved by my_mempool_init(), at most MEMPOOL_MAX_CLASSES.
+ */
+static uint8_t classes_nbr = 0;
+
+/**
+ * @fn bool my_mempool_init(void)
+ * @brief Carve the pool region into the configured size classes.
+ *
+ * @param None
+ * @retval true If all classes fit in MEMPOOL_REGION_SIZE, else false.
+ *
+ * @details
+ * Classes that do not fit (completely) are left with the blocks that fit.
+ * Classes beyond MEMPOOL_MAX_CLASSES are ignored.
+ */
+bool my_mempool_init(void) {
+	uint8_t* next = mempool_region;
+	uint8_t* end = mempool_region + MEMPOOL_REGION_SIZE;
+	bool fits = (mempool_classes_nbr <= MEMPOOL_MAX_CLASSES);
+
+	classes_nbr = fits ? mempool_classes_nbr : MEMPOOL_MAX_CLASSES;
+	for (int i = 0; i < classes_nbr; i++) {
+		uint16_t block_size = mempool_classes[i].block_size;
+		uint16_t count = 0;
+
+		free_lists[i] = NULL;
+		class_start[i] = next;
+		while (count < mempool_classes[i].block_count && (size_t)(end - next) >= block_size) {
+			*(void**)next = free_lists[i];
+			free_lists[i] = next;
+			next += block_size;
+			count++;
+		}
+		class_end[i] = next;
+		if (count != mempool_classes[i].block_count) fits = false;
+
+		mempool_stats[i] = (my_Mempool_Stats){.block_size = block_size, .block_count = count};
+	}
+	return fits;
+}
+
+/**
+ * @fn void* my_mempool_alloc(size_t size)
+ * @brief Allocate a block of at least size bytes.
+ *
+ * @param size Requested size in bytes.
+ * @retval Pointer to an 8-byte aligned block, or NULL if no class can serve it.
+ */
+void* my_mempool_alloc(size_t size) {
+	int i = 0;
+	while (i < classes_nbr && mempool_stats[i].block_size < size) i++;
+
+	for (bool best_fit = true; i < classes_nbr; i++, best_fit = false) {
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		void* block = free_lists[i];
+		if (block != NULL) {
+			free_lists[i] = *(void**)block;
+			my_Mempool_Stats* stats = &mempool_stats[i];
+			stats->allocations++;
+			if (++stats->used > stats->high_water) stats->high_water = stats->used;
+			__set_PRIMASK(primask);
+			return block;
+		}
+		if (best_fit) mempool_stats[i].exhausted++;
+		__set_PRIMASK(primask);
+	}
+	return NULL;
+}
+
+/**
+ * @fn void my_mempool_free(void* block)
+ * @brief Return a block to its class.
+ *
+ * @param block Pointer returned by my_mempool_alloc(), or NULL.
+ * @retval None
+ */
+void my_mempool_free(void* block) {
+	if (block == NULL) return;
+
+	for (int i = 0; i < classes_nbr; i++) {
+		if ((uint8_t*)block < class_start[i] || (uint8_t*)block >= class_end[i]) continue;
+
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		*(void**)block = free_lists[i];
+		free_lists[i] = block;
+		mempool_stats[i].used--;
+		__set_PRIMASK(primask);
+		return;
+	}
+}
+
+/**
+ * @fn const my_Mempool_Stats* get_my_mempool_stats(bool to_print)
+ * @brief Get the usage counters of all size classes.
+ *
+ * @param to_print If true, the counters are printed.
+ * 				   If false, nothing is printed.
+ * @retval Pointer to an array of counters, one per class carved by my_mempool_init().
+ */
+const my_Mempool_Stats* get_my_mempool_stats(bool to_print) {
+	if (to_print) {
+		for (int i = 0; i < classes_nbr; i++) {
+			my_Mempool_Stats* stats = &mempool_stats[i];
+			my_printf("Pool %4d B: used %d/%d, high-water %d, allocs %lu, exhausted %lu\r\n",
+					  stats->block_size, stats->used, stats->block_count, stats->high_water,
+					  stats->allocations, stats->exhausted);
+		}
+	}
+	return mempool_stats;
+}
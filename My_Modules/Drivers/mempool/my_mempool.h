@@ -0,0 +1,131 @@
+/**
+ * @file my_mempool.h
+ * @brief Fixed-block, multi-size-class memory pool API.
+ *
+ * @details
+ * Provides deterministic dynamic memory for analysis modules (per-ID
+ * statistics, histories, reassembly buffers) without malloc. A static SRAM
+ * region is carved at init into size classes of fixed-size blocks, as listed
+ * in mempool_classes[]. Each class keeps an intrusive free list, so
+ * allocation and release are O(1) and never fragment.
+ *
+ * All functions may be called from both interrupt and thread context.
+ */
+
+#ifndef MY_MEMPOOL_H
+#define MY_MEMPOOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "my_stdio.h"
+
+/**
+ * @def MEMPOOL_REGION_SIZE
+ * @brief Size (in bytes) of the SRAM region managed by the pool.
+ */
+#define MEMPOOL_REGION_SIZE (32 * 1024)
+
+/**
+ * @def MEMPOOL_REGION_ATTRIBUTE
+ * @brief Placement/alignment attribute of the pool region.
+ *
+ * @details
+ * Can be overridden at compile time to place the region into a specific
+ * SRAM bank, e.g. __attribute__((section(".RAM_D2"))) __ALIGNED(8).
+ */
+#ifndef MEMPOOL_REGION_ATTRIBUTE
+#define MEMPOOL_REGION_ATTRIBUTE __ALIGNED(8)
+#endif
+
+/**
+ * @def MEMPOOL_MAX_CLASSES
+ * @brief Maximum number of size classes.
+ */
+#define MEMPOOL_MAX_CLASSES 8
+
+/**
+ * @struct my_Mempool_Class
+ * @brief Size class configuration entry.
+ *
+ * @note block_size must be a multiple of 8.
+ */
+typedef struct {
+	uint16_t block_size;
+	uint16_t block_count;
+} my_Mempool_Class;
+
+/**
+ * @struct my_Mempool_Stats
+ * @brief Usage counters of one size class.
+ *
+ * @details
+ * high_water is the maximum number of blocks in use at the same time.
+ * exhausted counts the requests that found this class (their best fit)
+ * empty, whether or not a larger class could serve them.
+ */
+typedef struct {
+	uint16_t block_size;
+	uint16_t block_count;
+	uint16_t used;
+	uint16_t high_water;
+	uint32_t allocations;
+	uint32_t exhausted;
+} my_Mempool_Stats;
+
+/**
+ * @var mempool_classes[]
+ * @brief Table of size classes, sorted by increasing block size.
+ */
+extern const my_Mempool_Class mempool_classes[];
+
+/**
+ * @var mempool_classes_nbr
+ * @brief Number of entries in mempool_classes[].
+ */
+extern const uint8_t mempool_classes_nbr;
+
+/**
+ * @fn bool my_mempool_init(void)
+ * @brief Carve the pool region into the configured size classes.
+ *
+ * @param None
+ * @retval true If all classes fit in MEMPOOL_REGION_SIZE, else false.
+ *
+ * @details
+ * Must be called once before any allocation. Resets all statistics.
+ */
+bool my_mempool_init(void);
+
+/**
+ * @fn void* my_mempool_alloc(size_t size)
+ * @brief Allocate a block of at least size bytes.
+ *
+ * @param size Requested size in bytes.
+ * @retval Pointer to an 8-byte aligned block, or NULL if no class can serve it.
+ *
+ * @details
+ * Takes a block from the smallest fitting class. If that class is empty,
+ * the next larger classes are tried.
+ */
+void* my_mempool_alloc(size_t size);
+
+/**
+ * @fn void my_mempool_free(void* block)
+ * @brief Return a block to its class.
+ *
+ * @param block Pointer returned by my_mempool_alloc(), or NULL.
+ * @retval None
+ */
+void my_mempool_free(void* block);
+
+/**
+ * @fn const my_Mempool_Stats* get_my_mempool_stats(bool to_print)
+ * @brief Get the usage counters of all size classes.
+ *
+ * @param to_print If true, the counters are printed.
+ * 				   If false, nothing is printed.
+ * @retval Pointer to an array of counters, one per class carved by my_mempool_init().
+ */
+const my_Mempool_Stats* get_my_mempool_stats(bool to_print);
+
+#endif /* MY_MEMPOOL_H */
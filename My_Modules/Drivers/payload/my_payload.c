@@ -0,0 +1,583 @@
+/**
+ * @file my_payload.c
+ * @brief Word-wide payload kernels implementation.
+ *
+ * @details
+ * Every kernel is written once over 32-bit words on top of a few lane
+ * helpers (4 byte lanes per word). Only the lane helpers differ between the
+ * SIMD and the portable build. Match and popcount need no SIMD instruction:
+ * they are plain word operations in both builds. The popcount adds the
+ * per-byte bit counts of all words (at most 128 per byte for 64 bytes) and
+ * sums the four bytes once at the end.
+ */
+
+#include <string.h>
+#include "my_payload.h"
+#include "my_mempool.h"
+
+/**
+ * @def BENCH_PAYLOADS
+ * @brief Distinct payloads cycled through by the benchmark (one 1024-byte pool block).
+ */
+#define BENCH_PAYLOADS 16
+
+/**
+ * @def BENCH_WORK_SIZE
+ * @brief Kernel arguments of a benchmark step (value/mask, low/high or min/max, then output).
+ */
+#define BENCH_WORK_SIZE (3 * PAYLOAD_FD_SIZE)
+
+/**
+ * @typedef bench_Kernel
+ * @brief Common signature of the benchmarked kernels.
+ */
+typedef uint32_t (*bench_Kernel)(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size);
+
+/**
+ * @struct bench_Entry
+ * @brief A kernel and its byte-by-byte version.
+ */
+typedef struct {
+	const char* name;
+	bench_Kernel kernel;
+	bench_Kernel scalar;
+} bench_Entry;
+
+/**
+ * @fn static inline uint32_t load(const uint8_t* p)
+ * @brief Read 4 payload bytes as a little-endian word (any alignment).
+ */
+static inline uint32_t load(const uint8_t* p) {
+	uint32_t word;
+	memcpy(&word, p, sizeof(word));
+	return word;
+}
+
+/**
+ * @fn static inline void store(uint8_t* p, uint32_t word)
+ * @brief Write a word as 4 payload bytes (any alignment).
+ */
+static inline void store(uint8_t* p, uint32_t word) {
+	memcpy(p, &word, sizeof(word));
+}
+
+#if defined(__ARM_FEATURE_SIMD32)
+
+/**
+ * @fn static inline uint32_t lanes_differ(uint32_t a, uint32_t b)
+ * @brief 0xFF in the byte lanes where a and b differ.
+ *
+ * @details
+ * 0 - (a ^ b) does not borrow (GE set) only in the lanes where a ^ b is 0.
+ */
+static inline uint32_t lanes_differ(uint32_t a, uint32_t b) {
+	(void)__USUB8(0, a ^ b);
+	return __SEL(0, 0xFFFFFFFFU);
+}
+
+/**
+ * @fn static inline uint32_t lanes_max(uint32_t a, uint32_t b)
+ * @brief Unsigned maximum of each byte lane.
+ */
+static inline uint32_t lanes_max(uint32_t a, uint32_t b) {
+	(void)__USUB8(a, b);
+	return __SEL(a, b);
+}
+
+/**
+ * @fn static inline uint32_t lanes_min(uint32_t a, uint32_t b)
+ * @brief Unsigned minimum of each byte lane.
+ */
+static inline uint32_t lanes_min(uint32_t a, uint32_t b) {
+	(void)__USUB8(a, b);
+	return __SEL(b, a);
+}
+
+/**
+ * @fn static inline uint32_t lanes_outside(uint32_t x, uint32_t low, uint32_t high)
+ * @brief 0xFF in the byte lanes where x is below low or above high.
+ */
+static inline uint32_t lanes_outside(uint32_t x, uint32_t low, uint32_t high) {
+	(void)__USUB8(x, low);
+	uint32_t inside = __SEL(0xFFFFFFFFU, 0);
+	(void)__USUB8(high, x);
+	return ~__SEL(inside, 0);
+}
+
+#else
+
+/**
+ * @fn static inline uint32_t lanes_ge(uint32_t a, uint32_t b)
+ * @brief 0xFF in the byte lanes where a >= b (unsigned), as the GE flags of USUB8.
+ */
+static inline uint32_t lanes_ge(uint32_t a, uint32_t b) {
+	uint32_t ge = 0;
+	for (uint32_t shift = 0; shift < 32; shift += 8) {
+		if (((a >> shift) & 0xFF) >= ((b >> shift) & 0xFF)) ge |= 0xFFU << shift;
+	}
+	return ge;
+}
+
+/**
+ * @fn static inline uint32_t lanes_differ(uint32_t a, uint32_t b)
+ * @brief 0xFF in the byte lanes where a and b differ.
+ *
+ * @details
+ * Adding 0x7F to the low 7 bits of a lane carries into its top bit unless
+ * they are all 0.
+ */
+static inline uint32_t lanes_differ(uint32_t a, uint32_t b) {
+	uint32_t x = a ^ b;
+	uint32_t nonzero = (((x & 0x7F7F7F7FU) + 0x7F7F7F7FU) | x) & 0x80808080U;
+	return (nonzero >> 7) * 0xFFU;
+}
+
+/**
+ * @fn static inline uint32_t lanes_max(uint32_t a, uint32_t b)
+ * @brief Unsigned maximum of each byte lane.
+ */
+static inline uint32_t lanes_max(uint32_t a, uint32_t b) {
+	uint32_t ge = lanes_ge(a, b);
+	return (a & ge) | (b & ~ge);
+}
+
+/**
+ * @fn static inline uint32_t lanes_min(uint32_t a, uint32_t b)
+ * @brief Unsigned minimum of each byte lane.
+ */
+static inline uint32_t lanes_min(uint32_t a, uint32_t b) {
+	uint32_t ge = lanes_ge(a, b);
+	return (b & ge) | (a & ~ge);
+}
+
+/**
+ * @fn static inline uint32_t lanes_outside(uint32_t x, uint32_t low, uint32_t high)
+ * @brief 0xFF in the byte lanes where x is below low or above high.
+ */
+static inline uint32_t lanes_outside(uint32_t x, uint32_t low, uint32_t high) {
+	return ~(lanes_ge(x, low) & lanes_ge(high, x));
+}
+
+#endif /* __ARM_FEATURE_SIMD32 */
+
+/**
+ * @fn static inline uint32_t lane_bits(uint32_t lanes)
+ * @brief Gather the top bit of each byte lane into bits 0 to 3.
+ */
+static inline uint32_t lane_bits(uint32_t lanes) {
+	return ((((lanes >> 7) & 0x01010101U) * 0x01020408U) >> 24) & 0x0F;
+}
+
+/**
+ * @fn static inline uint32_t byte_bit_counts(uint32_t x)
+ * @brief Number of set bits of each byte of x, in that byte.
+ */
+static inline uint32_t byte_bit_counts(uint32_t x) {
+	x = x - ((x >> 1) & 0x55555555U);
+	x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);
+	return (x + (x >> 4)) & 0x0F0F0F0FU;
+}
+
+/**
+ * @fn static inline bool match(const uint8_t* data, const uint8_t* value, const uint8_t* mask, uint32_t size)
+ * @brief Masked compare over size bytes (multiple of 4), without early exit.
+ */
+static inline bool match(const uint8_t* data, const uint8_t* value, const uint8_t* mask, uint32_t size) {
+	uint32_t differ = 0;
+	for (uint32_t i = 0; i < size; i += 4) differ |= (load(&data[i]) ^ load(&value[i])) & load(&mask[i]);
+	return differ == 0;
+}
+
+/**
+ * @fn static inline void diff(const uint8_t* a, const uint8_t* b, uint8_t* changed, uint32_t size)
+ * @brief Changed-byte mask over size bytes (multiple of 4).
+ */
+static inline void diff(const uint8_t* a, const uint8_t* b, uint8_t* changed, uint32_t size) {
+	for (uint32_t i = 0; i < size; i += 4) store(&changed[i], lanes_differ(load(&a[i]), load(&b[i])));
+}
+
+/**
+ * @fn static inline uint64_t out_of_range(const uint8_t* data, const uint8_t* low, const uint8_t* high, uint32_t size)
+ * @brief Out-of-range byte bits over size bytes (multiple of 4, at most 64).
+ */
+static inline uint64_t out_of_range(const uint8_t* data, const uint8_t* low, const uint8_t* high, uint32_t size) {
+	uint64_t outside = 0;
+	for (uint32_t i = 0; i < size; i += 4) {
+		outside |= (uint64_t)lane_bits(lanes_outside(load(&data[i]), load(&low[i]), load(&high[i]))) << i;
+	}
+	return outside;
+}
+
+/**
+ * @fn static inline void minmax(const uint8_t* data, uint8_t* min, uint8_t* max, uint32_t size)
+ * @brief Byte-lane minimum and maximum update over size bytes (multiple of 4).
+ */
+static inline void minmax(const uint8_t* data, uint8_t* min, uint8_t* max, uint32_t size) {
+	for (uint32_t i = 0; i < size; i += 4) {
+		uint32_t x = load(&data[i]);
+		store(&min[i], lanes_min(x, load(&min[i])));
+		store(&max[i], lanes_max(x, load(&max[i])));
+	}
+}
+
+/**
+ * @fn static inline uint32_t changed_bits(const uint8_t* a, const uint8_t* b, uint32_t size)
+ * @brief Popcount of a ^ b over size bytes (multiple of 4, at most 124).
+ */
+static inline uint32_t changed_bits(const uint8_t* a, const uint8_t* b, uint32_t size) {
+	uint32_t counts = 0;
+	for (uint32_t i = 0; i < size; i += 4) counts += byte_bit_counts(load(&a[i]) ^ load(&b[i]));
+	counts = (counts & 0x00FF00FFU) + ((counts >> 8) & 0x00FF00FFU);
+	return (counts + (counts >> 16)) & 0xFFFF;
+}
+
+/**
+ * @fn bool my_payload_match8(const uint8_t* data, const uint8_t* value, const uint8_t* mask)
+ * @brief Compare a payload with a value on the bits of a mask.
+ *
+ * @param data Payload (8 bytes).
+ * @param value Expected value (8 bytes).
+ * @param mask Compared bits (8 bytes).
+ * @retval true If (data & mask) == (value & mask), else false.
+ */
+bool my_payload_match8(const uint8_t* data, const uint8_t* value, const uint8_t* mask) {
+	return match(data, value, mask, PAYLOAD_CLASSIC_SIZE);
+}
+
+/**
+ * @fn bool my_payload_match64(const uint8_t* data, const uint8_t* value, const uint8_t* mask)
+ * @brief Compare a payload with a value on the bits of a mask.
+ *
+ * @param data Payload (64 bytes).
+ * @param value Expected value (64 bytes).
+ * @param mask Compared bits (64 bytes).
+ * @retval true If (data & mask) == (value & mask), else false.
+ */
+bool my_payload_match64(const uint8_t* data, const uint8_t* value, const uint8_t* mask) {
+	return match(data, value, mask, PAYLOAD_FD_SIZE);
+}
+
+/**
+ * @fn void my_payload_diff8(const uint8_t* a, const uint8_t* b, uint8_t* changed)
+ * @brief Changed-byte mask of two payloads.
+ *
+ * @param a First payload (8 bytes).
+ * @param b Second payload (8 bytes).
+ * @param changed Output (8 bytes): 0xFF where the bytes differ, 0x00 elsewhere.
+ * @retval None
+ */
+void my_payload_diff8(const uint8_t* a, const uint8_t* b, uint8_t* changed) {
+	diff(a, b, changed, PAYLOAD_CLASSIC_SIZE);
+}
+
+/**
+ * @fn void my_payload_diff64(const uint8_t* a, const uint8_t* b, uint8_t* changed)
+ * @brief Changed-byte mask of two payloads.
+ *
+ * @param a First payload (64 bytes).
+ * @param b Second payload (64 bytes).
+ * @param changed Output (64 bytes): 0xFF where the bytes differ, 0x00 elsewhere.
+ * @retval None
+ */
+void my_payload_diff64(const uint8_t* a, const uint8_t* b, uint8_t* changed) {
+	diff(a, b, changed, PAYLOAD_FD_SIZE);
+}
+
+/**
+ * @fn uint32_t my_payload_out_of_range8(const uint8_t* data, const uint8_t* low, const uint8_t* high)
+ * @brief Check every byte of a payload against its own unsigned range.
+ *
+ * @param data Payload (8 bytes).
+ * @param low Lowest allowed value of each byte (8 bytes).
+ * @param high Highest allowed value of each byte (8 bytes).
+ * @retval Bit i set if byte i is below low[i] or above high[i].
+ */
+uint32_t my_payload_out_of_range8(const uint8_t* data, const uint8_t* low, const uint8_t* high) {
+	return (uint32_t)out_of_range(data, low, high, PAYLOAD_CLASSIC_SIZE);
+}
+
+/**
+ * @fn uint64_t my_payload_out_of_range64(const uint8_t* data, const uint8_t* low, const uint8_t* high)
+ * @brief Check every byte of a payload against its own unsigned range.
+ *
+ * @param data Payload (64 bytes).
+ * @param low Lowest allowed value of each byte (64 bytes).
+ * @param high Highest allowed value of each byte (64 bytes).
+ * @retval Bit i set if byte i is below low[i] or above high[i].
+ */
+uint64_t my_payload_out_of_range64(const uint8_t* data, const uint8_t* low, const uint8_t* high) {
+	return out_of_range(data, low, high, PAYLOAD_FD_SIZE);
+}
+
+/**
+ * @fn void my_payload_minmax8(const uint8_t* data, uint8_t* min, uint8_t* max)
+ * @brief Update byte-lane minimum and maximum with a payload.
+ *
+ * @param data Payload (8 bytes).
+ * @param min Unsigned minimum of each byte so far (8 bytes), updated.
+ * @param max Unsigned maximum of each byte so far (8 bytes), updated.
+ * @retval None
+ */
+void my_payload_minmax8(const uint8_t* data, uint8_t* min, uint8_t* max) {
+	minmax(data, min, max, PAYLOAD_CLASSIC_SIZE);
+}
+
+/**
+ * @fn void my_payload_minmax64(const uint8_t* data, uint8_t* min, uint8_t* max)
+ * @brief Update byte-lane minimum and maximum with a payload.
+ *
+ * @param data Payload (64 bytes).
+ * @param min Unsigned minimum of each byte so far (64 bytes), updated.
+ * @param max Unsigned maximum of each byte so far (64 bytes), updated.
+ * @retval None
+ */
+void my_payload_minmax64(const uint8_t* data, uint8_t* min, uint8_t* max) {
+	minmax(data, min, max, PAYLOAD_FD_SIZE);
+}
+
+/**
+ * @fn uint32_t my_payload_changed_bits8(const uint8_t* a, const uint8_t* b)
+ * @brief Number of bits that differ between two payloads.
+ *
+ * @param a First payload (8 bytes).
+ * @param b Second payload (8 bytes).
+ * @retval Population count of a ^ b (0 to 64).
+ */
+uint32_t my_payload_changed_bits8(const uint8_t* a, const uint8_t* b) {
+	return changed_bits(a, b, PAYLOAD_CLASSIC_SIZE);
+}
+
+/**
+ * @fn uint32_t my_payload_changed_bits64(const uint8_t* a, const uint8_t* b)
+ * @brief Number of bits that differ between two payloads.
+ *
+ * @param a First payload (64 bytes).
+ * @param b Second payload (64 bytes).
+ * @retval Population count of a ^ b (0 to 512).
+ */
+uint32_t my_payload_changed_bits64(const uint8_t* a, const uint8_t* b) {
+	return changed_bits(a, b, PAYLOAD_FD_SIZE);
+}
+
+/**
+ * @fn static uint32_t bench_match(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size)
+ * @brief Masked compare kernel (value and mask in work).
+ */
+static uint32_t bench_match(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size) {
+	(void)previous;
+	return (size == PAYLOAD_CLASSIC_SIZE) ? my_payload_match8(data, work, &work[PAYLOAD_FD_SIZE])
+										  : my_payload_match64(data, work, &work[PAYLOAD_FD_SIZE]);
+}
+
+/**
+ * @fn static uint32_t scalar_match(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size)
+ * @brief Byte-by-byte masked compare.
+ */
+static uint32_t scalar_match(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size) {
+	(void)previous;
+	for (uint32_t i = 0; i < size; i++) {
+		if ((data[i] ^ work[i]) & work[PAYLOAD_FD_SIZE + i]) return false;
+	}
+	return true;
+}
+
+/**
+ * @fn static uint32_t bench_diff(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size)
+ * @brief Changed-byte mask kernel (output at the end of work).
+ */
+static uint32_t bench_diff(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size) {
+	if (size == PAYLOAD_CLASSIC_SIZE) {
+		my_payload_diff8(data, previous, &work[2 * PAYLOAD_FD_SIZE]);
+	} else {
+		my_payload_diff64(data, previous, &work[2 * PAYLOAD_FD_SIZE]);
+	}
+	return work[2 * PAYLOAD_FD_SIZE];
+}
+
+/**
+ * @fn static uint32_t scalar_diff(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size)
+ * @brief Byte-by-byte changed-byte mask.
+ */
+static uint32_t scalar_diff(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size) {
+	for (uint32_t i = 0; i < size; i++) work[2 * PAYLOAD_FD_SIZE + i] = (data[i] != previous[i]) ? 0xFF : 0x00;
+	return work[2 * PAYLOAD_FD_SIZE];
+}
+
+/**
+ * @fn static uint32_t bench_range(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size)
+ * @brief Per-byte range check kernel (low and high in work).
+ */
+static uint32_t bench_range(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size) {
+	(void)previous;
+	if (size == PAYLOAD_CLASSIC_SIZE) return my_payload_out_of_range8(data, work, &work[PAYLOAD_FD_SIZE]);
+	uint64_t outside = my_payload_out_of_range64(data, work, &work[PAYLOAD_FD_SIZE]);
+	return (uint32_t)(outside ^ (outside >> 32));
+}
+
+/**
+ * @fn static uint32_t scalar_range(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size)
+ * @brief Byte-by-byte range check.
+ */
+static uint32_t scalar_range(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size) {
+	(void)previous;
+	uint64_t outside = 0;
+	for (uint32_t i = 0; i < size; i++) {
+		if (data[i] < work[i] || data[i] > work[PAYLOAD_FD_SIZE + i]) outside |= 1ULL << i;
+	}
+	return (uint32_t)(outside ^ (outside >> 32));
+}
+
+/**
+ * @fn static uint32_t bench_minmax(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size)
+ * @brief Byte-lane min/max kernel (min and max in work).
+ */
+static uint32_t bench_minmax(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size) {
+	(void)previous;
+	if (size == PAYLOAD_CLASSIC_SIZE) {
+		my_payload_minmax8(data, work, &work[PAYLOAD_FD_SIZE]);
+	} else {
+		my_payload_minmax64(data, work, &work[PAYLOAD_FD_SIZE]);
+	}
+	return work[0];
+}
+
+/**
+ * @fn static uint32_t scalar_minmax(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size)
+ * @brief Byte-by-byte min/max.
+ */
+static uint32_t scalar_minmax(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size) {
+	(void)previous;
+	for (uint32_t i = 0; i < size; i++) {
+		if (data[i] < work[i]) work[i] = data[i];
+		if (data[i] > work[PAYLOAD_FD_SIZE + i]) work[PAYLOAD_FD_SIZE + i] = data[i];
+	}
+	return work[0];
+}
+
+/**
+ * @fn static uint32_t bench_changed_bits(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size)
+ * @brief Changed-bit popcount kernel.
+ */
+static uint32_t bench_changed_bits(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size) {
+	(void)work;
+	return (size == PAYLOAD_CLASSIC_SIZE) ? my_payload_changed_bits8(data, previous) : my_payload_changed_bits64(data, previous);
+}
+
+/**
+ * @fn static uint32_t scalar_changed_bits(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size)
+ * @brief Bit-by-bit changed-bit count.
+ */
+static uint32_t scalar_changed_bits(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size) {
+	(void)work;
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < size; i++) {
+		for (uint8_t x = data[i] ^ previous[i]; x != 0; x >>= 1) count += x & 1;
+	}
+	return count;
+}
+
+/**
+ * @fn static uint32_t bench_empty(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size)
+ * @brief Loop and call overhead, subtracted from the other measurements.
+ */
+static uint32_t bench_empty(const uint8_t* data, const uint8_t* previous, uint8_t* work, uint32_t size) {
+	(void)data; (void)previous; (void)work;
+	return size;
+}
+
+/**
+ * @var bench_entries[]
+ * @brief Benchmarked kernels.
+ */
+static const bench_Entry bench_entries[] = {
+		{"Match/mask", bench_match, scalar_match},
+		{"Diff mask", bench_diff, scalar_diff},
+		{"Byte range", bench_range, scalar_range},
+		{"Byte min/max", bench_minmax, scalar_minmax},
+		{"Changed bits", bench_changed_bits, scalar_changed_bits},
+};
+
+/**
+ * @fn static void bench_reset(uint8_t* work)
+ * @brief Same kernel arguments for every run: value/mask, low/high, min/max.
+ */
+static void bench_reset(uint8_t* work) {
+	for (uint32_t i = 0; i < PAYLOAD_FD_SIZE; i++) {
+		work[i] = (uint8_t)(0x20 + i);
+		work[PAYLOAD_FD_SIZE + i] = (uint8_t)(0xE0 - i);
+	}
+	memset(&work[2 * PAYLOAD_FD_SIZE], 0, PAYLOAD_FD_SIZE);
+}
+
+/**
+ * @fn static uint32_t bench_run(bench_Kernel kernel, const uint8_t* payloads, uint8_t* work, uint32_t size, uint32_t* check)
+ * @brief Cycles of PAYLOAD_BENCH_FRAMES kernel calls, with a check value of their results.
+ */
+static uint32_t bench_run(bench_Kernel kernel, const uint8_t* payloads, uint8_t* work, uint32_t size, uint32_t* check) {
+	uint32_t result = 0;
+	bench_reset(work);
+
+	uint32_t start = my_DWT_GetCycles_start();
+	for (uint32_t i = 1; i <= PAYLOAD_BENCH_FRAMES; i++) {
+		result = result * 31 + kernel(&payloads[(i % BENCH_PAYLOADS) * PAYLOAD_FD_SIZE],
+									  &payloads[((i - 1) % BENCH_PAYLOADS) * PAYLOAD_FD_SIZE], work, size);
+	}
+	uint32_t cycles = my_DWT_GetCycles_end() - start;
+
+	for (uint32_t i = 0; i < BENCH_WORK_SIZE; i++) result = result * 31 + work[i];
+	*check = result;
+	return cycles;
+}
+
+/**
+ * @fn void my_payload_benchmark(void)
+ * @brief Print the cycles per frame of every kernel and of its byte-by-byte version.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * The payloads are borrowed from the memory pool (one 1024-byte block).
+ * The cycles of an empty kernel (loop and indirect call) are subtracted.
+ */
+void my_payload_benchmark(void) {
+	uint8_t work[BENCH_WORK_SIZE];
+	uint8_t* payloads = my_mempool_alloc(BENCH_PAYLOADS * PAYLOAD_FD_SIZE);
+	if (payloads == NULL) {
+		my_printf("Payload benchmark: memory pool exhausted.\r\n");
+		return;
+	}
+
+	uint32_t state = 0x12345678;
+	for (uint32_t i = 0; i < BENCH_PAYLOADS * PAYLOAD_FD_SIZE; i++) {
+		/* A few bytes change from one payload to the next (counters, signals) */
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		payloads[i] = (i < PAYLOAD_FD_SIZE || (state & 3) == 0) ? (uint8_t)(state >> 8) : payloads[i - PAYLOAD_FD_SIZE];
+	}
+
+	uint32_t check;
+	uint32_t overhead[2] = {bench_run(bench_empty, payloads, work, PAYLOAD_CLASSIC_SIZE, &check),
+							bench_run(bench_empty, payloads, work, PAYLOAD_FD_SIZE, &check)};
+
+	my_printf("Payload kernels, cycles per frame (%d frames)\r\n", PAYLOAD_BENCH_FRAMES);
+	my_printf("%-14s %8s %8s %8s %8s\r\n", "", "8 B", "scalar", "64 B", "scalar");
+	for (uint32_t k = 0; k < sizeof(bench_entries) / sizeof(bench_entries[0]); k++) {
+		const bench_Entry* entry = &bench_entries[k];
+		uint32_t cycles[4];
+		bool same = true;
+		for (uint32_t s = 0; s < 2; s++) {
+			uint32_t size = s ? PAYLOAD_FD_SIZE : PAYLOAD_CLASSIC_SIZE;
+			uint32_t kernel_check, scalar_check;
+			uint32_t kernel = bench_run(entry->kernel, payloads, work, size, &kernel_check);
+			uint32_t scalar = bench_run(entry->scalar, payloads, work, size, &scalar_check);
+			cycles[2 * s] = (kernel > overhead[s]) ? (kernel - overhead[s]) / PAYLOAD_BENCH_FRAMES : 0;
+			cycles[2 * s + 1] = (scalar > overhead[s]) ? (scalar - overhead[s]) / PAYLOAD_BENCH_FRAMES : 0;
+			if (kernel_check != scalar_check) same = false;
+		}
+		my_printf("%-14s %8lu %8lu %8lu %8lu%s\r\n", entry->name, cycles[0], cycles[1], cycles[2], cycles[3],
+				  same ? "" : "  MISMATCH");
+	}
+	my_mempool_free(payloads);
+}
@@ -0,0 +1,169 @@
+/**
+ * @file my_payload.h
+ * @brief Word-wide payload kernels (diff, compare, range, min/max, popcount).
+ *
+ * @details
+ * Operations over a whole CAN payload, shared by the analysis stages instead
+ * of byte-by-byte loops. Each kernel exists for a classic CAN payload
+ * (8 bytes) and a CAN FD payload (64 bytes). Payloads are read as 32-bit
+ * words, any alignment.
+ *
+ * On the Cortex-M7 the per-byte kernels use the ARMv7E-M SIMD instructions
+ * through the CMSIS intrinsics (USUB8 sets one GE flag per byte lane, SEL
+ * picks each byte by its flag), so four byte lanes are handled per
+ * instruction. Where __ARM_FEATURE_SIMD32 is not defined (host build), the
+ * same kernels are portable C with the same results.
+ *
+ * my_payload_benchmark() measures the cycles per frame of every kernel
+ * against its byte-by-byte version.
+ */
+
+#ifndef MY_PAYLOAD_H
+#define MY_PAYLOAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "my_debug.h"
+
+/**
+ * @def PAYLOAD_CLASSIC_SIZE
+ * @brief Size (in bytes) of a classic CAN payload.
+ */
+#define PAYLOAD_CLASSIC_SIZE 8
+
+/**
+ * @def PAYLOAD_FD_SIZE
+ * @brief Size (in bytes) of a CAN FD payload.
+ */
+#define PAYLOAD_FD_SIZE 64
+
+/**
+ * @def PAYLOAD_BENCH_FRAMES
+ * @brief Payloads per kernel in my_payload_benchmark().
+ */
+#define PAYLOAD_BENCH_FRAMES 256
+
+/**
+ * @fn bool my_payload_match8(const uint8_t* data, const uint8_t* value, const uint8_t* mask)
+ * @brief Compare a payload with a value on the bits of a mask.
+ *
+ * @param data Payload (8 bytes).
+ * @param value Expected value (8 bytes).
+ * @param mask Compared bits (8 bytes).
+ * @retval true If (data & mask) == (value & mask), else false.
+ */
+bool my_payload_match8(const uint8_t* data, const uint8_t* value, const uint8_t* mask);
+
+/**
+ * @fn bool my_payload_match64(const uint8_t* data, const uint8_t* value, const uint8_t* mask)
+ * @brief Compare a payload with a value on the bits of a mask.
+ *
+ * @param data Payload (64 bytes).
+ * @param value Expected value (64 bytes).
+ * @param mask Compared bits (64 bytes).
+ * @retval true If (data & mask) == (value & mask), else false.
+ */
+bool my_payload_match64(const uint8_t* data, const uint8_t* value, const uint8_t* mask);
+
+/**
+ * @fn void my_payload_diff8(const uint8_t* a, const uint8_t* b, uint8_t* changed)
+ * @brief Changed-byte mask of two payloads.
+ *
+ * @param a First payload (8 bytes).
+ * @param b Second payload (8 bytes).
+ * @param changed Output (8 bytes): 0xFF where the bytes differ, 0x00 elsewhere.
+ * @retval None
+ */
+void my_payload_diff8(const uint8_t* a, const uint8_t* b, uint8_t* changed);
+
+/**
+ * @fn void my_payload_diff64(const uint8_t* a, const uint8_t* b, uint8_t* changed)
+ * @brief Changed-byte mask of two payloads.
+ *
+ * @param a First payload (64 bytes).
+ * @param b Second payload (64 bytes).
+ * @param changed Output (64 bytes): 0xFF where the bytes differ, 0x00 elsewhere.
+ * @retval None
+ */
+void my_payload_diff64(const uint8_t* a, const uint8_t* b, uint8_t* changed);
+
+/**
+ * @fn uint32_t my_payload_out_of_range8(const uint8_t* data, const uint8_t* low, const uint8_t* high)
+ * @brief Check every byte of a payload against its own unsigned range.
+ *
+ * @param data Payload (8 bytes).
+ * @param low Lowest allowed value of each byte (8 bytes).
+ * @param high Highest allowed value of each byte (8 bytes).
+ * @retval Bit i set if byte i is below low[i] or above high[i].
+ */
+uint32_t my_payload_out_of_range8(const uint8_t* data, const uint8_t* low, const uint8_t* high);
+
+/**
+ * @fn uint64_t my_payload_out_of_range64(const uint8_t* data, const uint8_t* low, const uint8_t* high)
+ * @brief Check every byte of a payload against its own unsigned range.
+ *
+ * @param data Payload (64 bytes).
+ * @param low Lowest allowed value of each byte (64 bytes).
+ * @param high Highest allowed value of each byte (64 bytes).
+ * @retval Bit i set if byte i is below low[i] or above high[i].
+ */
+uint64_t my_payload_out_of_range64(const uint8_t* data, const uint8_t* low, const uint8_t* high);
+
+/**
+ * @fn void my_payload_minmax8(const uint8_t* data, uint8_t* min, uint8_t* max)
+ * @brief Update byte-lane minimum and maximum with a payload.
+ *
+ * @param data Payload (8 bytes).
+ * @param min Unsigned minimum of each byte so far (8 bytes), updated.
+ * @param max Unsigned maximum of each byte so far (8 bytes), updated.
+ * @retval None
+ */
+void my_payload_minmax8(const uint8_t* data, uint8_t* min, uint8_t* max);
+
+/**
+ * @fn void my_payload_minmax64(const uint8_t* data, uint8_t* min, uint8_t* max)
+ * @brief Update byte-lane minimum and maximum with a payload.
+ *
+ * @param data Payload (64 bytes).
+ * @param min Unsigned minimum of each byte so far (64 bytes), updated.
+ * @param max Unsigned maximum of each byte so far (64 bytes), updated.
+ * @retval None
+ */
+void my_payload_minmax64(const uint8_t* data, uint8_t* min, uint8_t* max);
+
+/**
+ * @fn uint32_t my_payload_changed_bits8(const uint8_t* a, const uint8_t* b)
+ * @brief Number of bits that differ between two payloads.
+ *
+ * @param a First payload (8 bytes).
+ * @param b Second payload (8 bytes).
+ * @retval Population count of a ^ b (0 to 64).
+ */
+uint32_t my_payload_changed_bits8(const uint8_t* a, const uint8_t* b);
+
+/**
+ * @fn uint32_t my_payload_changed_bits64(const uint8_t* a, const uint8_t* b)
+ * @brief Number of bits that differ between two payloads.
+ *
+ * @param a First payload (64 bytes).
+ * @param b Second payload (64 bytes).
+ * @retval Population count of a ^ b (0 to 512).
+ */
+uint32_t my_payload_changed_bits64(const uint8_t* a, const uint8_t* b);
+
+/**
+ * @fn void my_payload_benchmark(void)
+ * @brief Print the cycles per frame of every kernel and of its byte-by-byte version.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * Runs each kernel over PAYLOAD_BENCH_FRAMES pseudo-random payloads (a few
+ * bytes changing between consecutive ones, as on a real bus) and measures
+ * the loop with the DWT cycle counter. Also checks that both versions give
+ * the same results. Takes about a millisecond; CAN must be stopped.
+ */
+void my_payload_benchmark(void);
+
+#endif /* MY_PAYLOAD_H */
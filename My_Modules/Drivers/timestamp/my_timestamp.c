@@ -0,0 +1,48 @@
+/**
+ * @file my_timestamp.c
+ * @brief Free-running microsecond timestamp counter implementation.
+ *
+ * @details
+ * TIM2 is a 32-bit general purpose timer on APB1. It is programmed
+ * directly at register level as a free-running up-counter, so no
+ * CubeMX configuration or interrupt is required.
+ */
+
+#include "my_timestamp.h"
+
+/**
+ * @fn void my_timestamp_init(void)
+ * @brief Configure and start TIM2 as a free-running microsecond counter.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * On STM32H7 the APB1 timer clock is twice PCLK1 whenever the APB1
+ * prescaler is not 1. An update event is generated after writing the
+ * prescaler so that it takes effect immediately.
+ */
+void my_timestamp_init(void) {
+	uint32_t timer_clock = HAL_RCC_GetPCLK1Freq();
+	if ((RCC->D2CFGR & RCC_D2CFGR_D2PPRE1) != RCC_APB1_DIV1) timer_clock *= 2;
+
+	__HAL_RCC_TIM2_CLK_ENABLE();
+
+	TIM2->CR1 = 0;
+	TIM2->PSC = (timer_clock / TIMESTAMP_FREQUENCY) - 1;
+	TIM2->ARR = 0xFFFFFFFF;
+	TIM2->CNT = 0;
+	TIM2->EGR = TIM_EGR_UG;
+	TIM2->CR1 = TIM_CR1_CEN;
+}
+
+/**
+ * @fn uint32_t my_timestamp_get(void)
+ * @brief Read the current timestamp.
+ *
+ * @param None
+ * @retval Current counter value in microseconds.
+ */
+uint32_t my_timestamp_get(void) {
+	return TIM2->CNT;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file my_timestamp.h
+ * @brief Free-running microsecond timestamp counter.
+ *
+ * @details
+ * Provides a 32-bit microsecond time base on TIM2 used to stamp received
+ * CAN frames. The counter wraps every ~71.6 minutes, so time differences
+ * must always be computed with unsigned subtraction.
+ */
+
+#ifndef MY_TIMESTAMP_H
+#define MY_TIMESTAMP_H
+
+#include "stm32h7xx.h"
+
+/**
+ * @def TIMESTAMP_FREQUENCY
+ * @brief Tick frequency (in Hz) of the timestamp counter.
+ */
+#define TIMESTAMP_FREQUENCY 1000000
+
+/**
+ * @fn void my_timestamp_init(void)
+ * @brief Configure and start TIM2 as a free-running microsecond counter.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * Enables the TIM2 clock, sets the prescaler from the current APB1 timer
+ * clock so the counter ticks at TIMESTAMP_FREQUENCY, and starts counting
+ * over the full 32-bit range. Must be called after SystemClock_Config().
+ */
+void my_timestamp_init(void);
+
+/**
+ * @fn uint32_t my_timestamp_get(void)
+ * @brief Read the current timestamp.
+ *
+ * @param None
+ * @retval Current counter value in microseconds.
+ */
+uint32_t my_timestamp_get(void);
+
+#endif /* MY_TIMESTAMP_H */
@@ -6,10 +6,60 @@
  * Implements my_uart_transmit_buffer() and my_uart_receive_char()
  * for sending and receiving data over USART3 (huart3).
  * These functions are blocking and use HAL_MAX_DELAY.
+ * my_uart_try_receive_char() is the non-blocking receive variant.
+ *
+ * Also implements a DMA transmit arena: a byte ring where an interrupt
+ * writes complete records in their final wire format and the main loop
+ * hands contiguous spans of them to the USART3 TX DMA, without copies.
+ * The producer only writes `tx_head`, the consumer only writes `tx_tail`.
+ * When a record does not fit before the end of the arena, the producer
+ * records the end of valid data in `tx_wrap` and restarts at offset 0.
  */
 
 #include "my_uart.h"
 
+/**
+ * @var hdma_usart3_tx
+ * @brief DMA handle of the USART3 TX stream.
+ */
+static DMA_HandleTypeDef hdma_usart3_tx;
+
+/**
+ * @var tx_arena[UART_TX_ARENA_SIZE]
+ * @brief DMA transmit arena.
+ */
+static uint8_t tx_arena[UART_TX_ARENA_SIZE] UART_TX_ARENA_ATTRIBUTE;
+
+/**
+ * @var tx_head
+ * @brief Transmit arena head (write) byte offset.
+ */
+static volatile uint32_t tx_head = 0;
+
+/**
+ * @var tx_tail
+ * @brief Transmit arena tail (transmit) byte offset.
+ */
+static volatile uint32_t tx_tail = 0;
+
+/**
+ * @var tx_wrap
+ * @brief End of valid data before the producer wrapped to offset 0.
+ */
+static volatile uint32_t tx_wrap = UART_TX_ARENA_SIZE;
+
+/**
+ * @var tx_span
+ * @brief Length of the DMA transfer in progress, 0 if DMA is idle.
+ */
+static volatile uint32_t tx_span = 0;
+
+/**
+ * @var tx_complete_callback
+ * @brief Called at the end of every DMA transfer of the arena, NULL if none.
+ */
+static void (*tx_complete_callback)(void) = NULL;
+
 
 /**
  * @fn void my_uart_transmit_buffer(const char* buf)
@@ -23,6 +73,7 @@
  * is transmitted. Converts the input string to uint8_t* for HAL compatibility.
  */
 void my_uart_transmit_buffer(const char* buf) {
+	while (huart3.gState != HAL_UART_STATE_READY) {}
 	HAL_UART_Transmit(&huart3, (uint8_t*)buf, strlen(buf), HAL_MAX_DELAY);
 }
 
@@ -40,3 +91,223 @@ void my_uart_transmit_buffer(const char* buf) {
 void my_uart_receive_char(char* ch) {
 	HAL_UART_Receive(&huart3, (uint8_t*)ch, 1, HAL_MAX_DELAY);
 }
+
+/**
+ * @fn bool my_uart_try_receive_char(char* ch)
+ * @brief Receive a single character from USART3 if one is available.
+ *
+ * @param ch Pointer to a char variable where the received character will be stored.
+ * @retval true If a character was received, else false.
+ *
+ * @details
+ * Uses HAL_UART_Receive with a zero timeout, so it returns immediately
+ * when the receive FIFO is empty.
+ */
+bool my_uart_try_receive_char(char* ch) {
+	return HAL_UART_Receive(&huart3, (uint8_t*)ch, 1, 0) == HAL_OK;
+}
+
+/**
+ * @fn void my_uart_dma_init(void)
+ * @brief Configure DMA1 Stream0 for USART3 TX and enable the related interrupts.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * The USART3 interrupt is needed as well: HAL completes a DMA transmission
+ * on the UART transmission complete event.
+ */
+void my_uart_dma_init(void) {
+	__HAL_RCC_DMA1_CLK_ENABLE();
+
+	hdma_usart3_tx.Instance = DMA1_Stream0;
+	hdma_usart3_tx.Init.Request = DMA_REQUEST_USART3_TX;
+	hdma_usart3_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+	hdma_usart3_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+	hdma_usart3_tx.Init.MemInc = DMA_MINC_ENABLE;
+	hdma_usart3_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma_usart3_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+	hdma_usart3_tx.Init.Mode = DMA_NORMAL;
+	hdma_usart3_tx.Init.Priority = DMA_PRIORITY_LOW;
+	hdma_usart3_tx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+	HAL_DMA_Init(&hdma_usart3_tx);
+	__HAL_LINKDMA(&huart3, hdmatx, hdma_usart3_tx);
+
+	HAL_NVIC_SetPriority(DMA1_Stream0_IRQn, 0, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+	HAL_NVIC_SetPriority(USART3_IRQn, 0, 0);
+	HAL_NVIC_EnableIRQ(USART3_IRQn);
+}
+
+/**
+ * @fn uint8_t* my_uart_tx_arena_reserve(uint32_t size)
+ * @brief Reserve contiguous space for a record in the transmit arena.
+ *
+ * @param size Record size in bytes.
+ * @retval Pointer where the record must be written, or NULL if the arena is full.
+ *
+ * @details
+ * tx_head never catches up with tx_tail, so tx_head == tx_tail always means empty.
+ */
+uint8_t* my_uart_tx_arena_reserve(uint32_t size) {
+	uint32_t h = tx_head;
+	uint32_t t = tx_tail;
+
+	if (h < t) {
+		return (size < (t - h)) ? &tx_arena[h] : NULL;
+	}
+
+	uint32_t space_to_end = UART_TX_ARENA_SIZE - h;
+	if (size < space_to_end) return &tx_arena[h];
+	if (size == space_to_end && t != 0) {
+		tx_wrap = UART_TX_ARENA_SIZE;
+		return &tx_arena[h];
+	}
+	if (size >= t) return NULL;
+
+	tx_wrap = h;
+	return &tx_arena[0];
+}
+
+/**
+ * @fn void my_uart_tx_arena_commit(uint8_t* record, uint32_t size)
+ * @brief Mark a reserved and written record as ready to transmit.
+ *
+ * @param record Pointer returned by my_uart_tx_arena_reserve().
+ * @param size Record size in bytes (same as reserved).
+ * @retval None
+ */
+void my_uart_tx_arena_commit(uint8_t* record, uint32_t size) {
+	uint32_t next_head = (record - tx_arena) + size;
+	if (next_head == UART_TX_ARENA_SIZE) next_head = 0;
+
+	__DMB(); // Record contents must be visible before the new head
+	tx_head = next_head;
+}
+
+/**
+ * @fn uint32_t my_uart_tx_arena_flush(const uint8_t** span)
+ * @brief Start a DMA transfer of the committed records, if DMA is idle.
+ *
+ * @param span Set to the first byte of the transfer if one is started, may be NULL.
+ * @retval Number of bytes handed to the DMA, 0 if none.
+ *
+ * @details
+ * When the producer has wrapped, the span ends at tx_wrap. Spans are limited
+ * to 65535 bytes by the HAL transfer size.
+ */
+uint32_t my_uart_tx_arena_flush(const uint8_t** span) {
+	if (tx_span != 0 || huart3.gState != HAL_UART_STATE_READY) return 0;
+
+	uint32_t h = tx_head;
+	uint32_t t = tx_tail;
+	if (h < t && t == tx_wrap) {
+		tx_tail = t = 0;
+	}
+	if (h == t) return 0;
+
+	uint32_t size = (h > t) ? (h - t) : (tx_wrap - t);
+	if (size > UINT16_MAX) size = UINT16_MAX;
+
+	if (span != NULL) *span = &tx_arena[t];
+	tx_span = size;
+	if (HAL_UART_Transmit_DMA(&huart3, &tx_arena[t], (uint16_t)size) != HAL_OK) {
+		tx_span = 0;
+		return 0;
+	}
+	return size;
+}
+
+/**
+ * @fn void my_uart_tx_arena_reset(void)
+ * @brief Abort any DMA transfer and empty the transmit arena.
+ *
+ * @param None
+ * @retval None
+ */
+void my_uart_tx_arena_reset(void) {
+	if (tx_span != 0) {
+		HAL_UART_AbortTransmit(&huart3);
+	}
+	tx_span = 0;
+	tx_head = tx_tail = 0;
+	tx_wrap = UART_TX_ARENA_SIZE;
+}
+
+/**
+ * @fn bool my_uart_tx_idle(void)
+ * @brief Check that the transmit arena is empty and USART3 is not transmitting.
+ *
+ * @param None
+ * @retval true If nothing is left to transmit, else false.
+ *
+ * @details
+ * After the producer wrapped, the arena is empty when the consumer reached
+ * tx_wrap and the producer has not written past offset 0.
+ */
+bool my_uart_tx_idle(void) {
+	uint32_t h = tx_head;
+	uint32_t t = tx_tail;
+	if (tx_span != 0 || huart3.gState != HAL_UART_STATE_READY) return false;
+	return (h == t) || (h == 0 && t == tx_wrap);
+}
+
+/**
+ * @fn uint32_t my_uart_tx_arena_fill(void)
+ * @brief Get the bytes of the transmit arena in use.
+ *
+ * @param None
+ * @retval Bytes from the tail to the head, end skipped by a wrap included.
+ */
+uint32_t my_uart_tx_arena_fill(void) {
+	return (tx_head + UART_TX_ARENA_SIZE - tx_tail) % UART_TX_ARENA_SIZE;
+}
+
+/**
+ * @fn void my_uart_set_tx_complete_callback(void (*callback)(void))
+ * @brief Set the function called at the end of every DMA transfer of the arena.
+ *
+ * @param callback Function called from the transfer complete interrupt, NULL for none.
+ * @retval None
+ */
+void my_uart_set_tx_complete_callback(void (*callback)(void)) {
+	tx_complete_callback = callback;
+}
+
+/**
+ * @fn void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+ * @brief UART transmission complete callback.
+ *
+ * @param huart Pointer to the UART handle that completed a transmission.
+ * @retval None
+ *
+ * @details
+ * Gives the transmitted span back to the transmit arena producer, then
+ * calls the callback set by my_uart_set_tx_complete_callback().
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+	if (huart != &huart3 || tx_span == 0) return;
+
+	uint32_t next_tail = tx_tail + tx_span;
+	if (next_tail == UART_TX_ARENA_SIZE) next_tail = 0;
+	tx_tail = next_tail;
+	tx_span = 0;
+	if (tx_complete_callback != NULL) tx_complete_callback();
+}
+
+/**
+ * @fn void DMA1_Stream0_IRQHandler(void)
+ * @brief DMA1 Stream0 (USART3 TX) interrupt handler.
+ */
+void DMA1_Stream0_IRQHandler(void) {
+	HAL_DMA_IRQHandler(&hdma_usart3_tx);
+}
+
+/**
+ * @fn void USART3_IRQHandler(void)
+ * @brief USART3 global interrupt handler.
+ */
+void USART3_IRQHandler(void) {
+	HAL_UART_IRQHandler(&huart3);
+}
@@ -5,7 +5,8 @@
  * @details
  * Provides simple wrappers around STM32 HAL UART functions to:
  *   - Transmit a null-terminated string buffer
- *   - Receive a single character
+ *   - Receive a single character (blocking or non-blocking)
+ *   - Stream pre-serialized records from a transmit arena with DMA
  *
  * Uses USART3 (huart3) as the communication interface.
  */
@@ -13,9 +14,29 @@
 #ifndef MY_USART_H
 #define MY_USART_H
 
+#include <stdbool.h>
 #include <string.h>
 #include "stm32h7xx.h"
 
+/**
+ * @def UART_TX_ARENA_SIZE
+ * @brief Size (in bytes) of the DMA transmit arena.
+ */
+#define UART_TX_ARENA_SIZE 8192
+
+/**
+ * @def UART_TX_ARENA_ATTRIBUTE
+ * @brief Placement/alignment attribute of the DMA transmit arena.
+ *
+ * @details
+ * The arena must be in a RAM reachable by DMA1 (AXI SRAM or SRAM1-3, not
+ * DTCM). If the D-cache is enabled, it must also be placed in a
+ * non-cacheable MPU region, e.g. __attribute__((section(".RAM_D2"))) __ALIGNED(32).
+ */
+#ifndef UART_TX_ARENA_ATTRIBUTE
+#define UART_TX_ARENA_ATTRIBUTE __ALIGNED(32)
+#endif
+
 /**
  * @var huart3
  * @brief Global USART3 handle.
@@ -44,7 +65,8 @@ extern UART_HandleTypeDef huart3;
  * @details
  * This function wraps HAL_UART_Transmit, sending the full string and
  * blocking until all characters are transmitted. Uses HAL_MAX_DELAY
- * for blocking transmission.
+ * for blocking transmission. Waits for any DMA transfer from the
+ * transmit arena to complete first.
  */
 void my_uart_transmit_buffer(const char* buf);
 
@@ -61,4 +83,106 @@ void my_uart_transmit_buffer(const char* buf);
  */
 void my_uart_receive_char(char* ch);
 
+/**
+ * @fn bool my_uart_try_receive_char(char* ch)
+ * @brief Receive a single character from USART3 if one is available.
+ *
+ * @param ch Pointer to a char variable where the received character will be stored.
+ * @retval true If a character was received, else false.
+ *
+ * @details
+ * Non-blocking counterpart of my_uart_receive_char(), used to read commands
+ * while the sniffer is running.
+ */
+bool my_uart_try_receive_char(char* ch);
+
+/**
+ * @fn void my_uart_dma_init(void)
+ * @brief Configure DMA1 Stream0 for USART3 TX and enable the related interrupts.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * Must be called once after MX_USART3_UART_Init().
+ */
+void my_uart_dma_init(void);
+
+/**
+ * @fn uint8_t* my_uart_tx_arena_reserve(uint32_t size)
+ * @brief Reserve contiguous space for a record in the transmit arena.
+ *
+ * @param size Record size in bytes.
+ * @retval Pointer where the record must be written, or NULL if the arena is full.
+ *
+ * @details
+ * Lock-free, single producer: must always be called from the same
+ * interrupt. A reserved record is not transmitted before
+ * my_uart_tx_arena_commit() is called for it.
+ */
+uint8_t* my_uart_tx_arena_reserve(uint32_t size);
+
+/**
+ * @fn void my_uart_tx_arena_commit(uint8_t* record, uint32_t size)
+ * @brief Mark a reserved and written record as ready to transmit.
+ *
+ * @param record Pointer returned by my_uart_tx_arena_reserve().
+ * @param size Record size in bytes (same as reserved).
+ * @retval None
+ */
+void my_uart_tx_arena_commit(uint8_t* record, uint32_t size);
+
+/**
+ * @fn uint32_t my_uart_tx_arena_flush(const uint8_t** span)
+ * @brief Start a DMA transfer of the committed records, if DMA is idle.
+ *
+ * @param span Set to the first byte of the transfer if one is started, may be NULL.
+ * @retval Number of bytes handed to the DMA, 0 if none.
+ *
+ * @details
+ * Called from the main loop. Hands the longest contiguous span of committed
+ * records to the UART DMA. The space is given back to the producer when the
+ * transfer completes: the records of the span may be read until then.
+ */
+uint32_t my_uart_tx_arena_flush(const uint8_t** span);
+
+/**
+ * @fn void my_uart_tx_arena_reset(void)
+ * @brief Abort any DMA transfer and empty the transmit arena.
+ *
+ * @param None
+ * @retval None
+ *
+ * @note Must be called while the producer interrupt is disabled.
+ */
+void my_uart_tx_arena_reset(void);
+
+/**
+ * @fn void my_uart_set_tx_complete_callback(void (*callback)(void))
+ * @brief Set the function called at the end of every DMA transfer of the arena.
+ *
+ * @param callback Function called from the transfer complete interrupt, after
+ * 				   the span is given back, NULL for none.
+ * @retval None
+ */
+void my_uart_set_tx_complete_callback(void (*callback)(void));
+
+/**
+ * @fn bool my_uart_tx_idle(void)
+ * @brief Check that the transmit arena is empty and USART3 is not transmitting.
+ *
+ * @param None
+ * @retval true If nothing is left to transmit, else false.
+ */
+bool my_uart_tx_idle(void);
+
+/**
+ * @fn uint32_t my_uart_tx_arena_fill(void)
+ * @brief Get the bytes of the transmit arena in use.
+ *
+ * @param None
+ * @retval Bytes from the tail to the head, end skipped by a wrap included.
+ */
+uint32_t my_uart_tx_arena_fill(void);
+
 #endif /* MY_USART_H */
@@ -0,0 +1,122 @@
+/**
+ * @file command_channel.c
+ * @brief Run-time command channel implementation.
+ *
+ * @details
+ * Accumulates received characters into a line buffer and dispatches the
+ * line on CR or LF. The first character selects the command, like the
+ * options of the settings menu.
+ */
+
+#include <inttypes.h>
+#include "command_channel.h"
+
+/**
+ * @var command_buffer[COMMAND_BUFFER_SIZE]
+ * @brief Line buffer of the command being received.
+ */
+static char command_buffer[COMMAND_BUFFER_SIZE];
+
+/**
+ * @var command_length
+ * @brief Number of characters in command_buffer[].
+ */
+static uint8_t command_length = 0;
+
+/**
+ * @fn static void print_commands(void)
+ * @brief Prints the supported commands over UART.
+ */
+static void print_commands(void) {
+	my_printf("Commands:\r\n");
+	my_printf("h         : History status\r\n");
+	my_printf("h 0x<id>  : History of an ID\r\n");
+	my_printf("m         : Memory pool usage\r\n");
+	my_printf("b         : CAN buffer usage\r\n");
+	my_printf("c         : Cycles per frame\r\n");
+	my_printf("t         : Output latency histograms\r\n");
+	my_printf("e         : E2E counter/CRC checks\r\n");
+	my_printf("l         : SD card logging status\r\n");
+	my_printf("p         : Low-power idle status\r\n");
+	my_printf("?         : This list\r\n\n");
+}
+
+/**
+ * @fn static void execute_command(const char* command)
+ * @brief Parse and execute a complete command line.
+ */
+static void execute_command(const char* command) {
+	switch (command[0]) {
+		case 'h':
+			/* Per-ID history */
+			uint32_t identifier = 0;
+			if (sscanf(command + 1, " 0x%" SCNx32, &identifier) == 1) {
+				send_history_over_UART(identifier);
+			} else {
+				(void) get_can_history_status(true);
+				my_printf("\n");
+			}
+			break;
+		case 'm':
+			/* Memory pool usage */
+			(void) get_my_mempool_stats(true);
+			my_printf("\n");
+			break;
+		case 'b':
+			/* Software CAN buffer usage */
+			(void) get_my_CAN_buffer_stats(true);
+			my_printf("\n");
+			break;
+		case 'c':
+			/* Capture path cycle cost */
+			(void) get_my_CAN_cycle_stats(true);
+			my_printf("\n");
+			break;
+		case 't':
+			/* Ring residence and end-to-end latency */
+			(void) get_my_CAN_latency_stats(true);
+			my_printf("\n");
+			break;
+		case 'e':
+			/* Rolling counter and CRC checks */
+			(void) get_can_e2e_status(true);
+			my_printf("\n");
+			break;
+		case 'l':
+			/* SD card logging */
+			(void) get_can_logger_status(true);
+			my_printf("\n");
+			break;
+		case 'p':
+			/* Low-power idle */
+			(void) get_can_power_status(true);
+			my_printf("\n");
+			break;
+		case '?':
+			print_commands();
+			break;
+		default:
+			my_printf("Command not found: %s\r\n\n", command);
+	}
+}
+
+/**
+ * @fn void command_channel_poll(void)
+ * @brief Read pending command characters and execute completed commands.
+ *
+ * @param None
+ * @retval None
+ */
+void command_channel_poll(void) {
+	char ch;
+	while (my_uart_try_receive_char(&ch)) {
+		if (ch == '\r' || ch == '\n') {
+			if (command_length == 0) continue;
+			command_buffer[command_length] = '\0';
+			command_length = 0;
+			execute_command(command_buffer);
+		} else if (command_length < (COMMAND_BUFFER_SIZE - 1)) {
+			command_buffer[command_length++] = ch;
+		}
+	}
+}
@@ -0,0 +1,52 @@
+/**
+ * @file command_channel.h
+ * @brief Run-time command channel interface.
+ *
+ * @details
+ * While the sniffer runs (STATE_RUN), the settings menu is not available and
+ * stopping capture to inspect state would lose traffic. The command channel
+ * reads command lines over USART3 without blocking the main loop and answers
+ * them while frames keep being captured.
+ *
+ * Supported commands (terminated by CR or LF):
+ *   - h           : Print history status and tracked IDs
+ *   - h 0x<id>    : Print the recorded history of an ID
+ *   - m           : Print memory pool usage
+ *   - b           : Print software CAN buffer usage and capacity gain
+ *   - c           : Print capture path cycles per frame
+ *   - t           : Print ring residence and end-to-end latency histograms
+ *   - e           : Print rolling counter/CRC (E2E) check counters
+ *   - l           : Print SD card logging status
+ *   - p           : Print low-power idle status and wake latencies
+ *   - ?           : Print the command list
+ */
+
+#ifndef COMMAND_CHANNEL_H
+#define COMMAND_CHANNEL_H
+
+#include "my_debug.h"
+#include "can_history.h"
+#include "can_e2e.h"
+#include "can_logger.h"
+#include "can_power.h"
+
+/**
+ * @def COMMAND_BUFFER_SIZE
+ * @brief Maximum length of a command line (including null terminator).
+ */
+#define COMMAND_BUFFER_SIZE 32
+
+/**
+ * @fn void command_channel_poll(void)
+ * @brief Read pending command characters and execute completed commands.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * Called from the main loop in STATE_RUN. Returns immediately when no
+ * character is pending. Characters beyond COMMAND_BUFFER_SIZE are dropped.
+ */
+void command_channel_poll(void);
+
+#endif /* COMMAND_CHANNEL_H */
@@ -0,0 +1,330 @@
+/**
+ * @file can_e2e.c
+ * @brief Rolling counter and checksum (E2E) gap detection implementation.
+ *
+ * @details
+ * A byte per standard CAN ID gives the descriptor slot of the ID (0: not
+ * checked), so IDs without descriptor cost one load. When a descriptor is
+ * added, its counter position is turned into a byte index, shift and mask,
+ * and its CRC into a 256-byte table of the polynomial (shared by the
+ * descriptors using it) and the CRC value after the Data ID bytes. Checking
+ * a frame is then one table lookup per payload byte and a few comparisons.
+ *
+ * Counters are kept per descriptor and only summed when the status is read.
+ */
+
+#include "can_e2e.h"
+
+/**
+ * @struct e2e_Entry
+ * @brief Descriptor, precomputed check parameters and counters of one ID.
+ *
+ * @details
+ * sniffer_losses is the sniffer loss count before the interrupt that read
+ * last_counter.
+ */
+typedef struct {
+	can_E2E_Descriptor descriptor;
+	can_E2E_Counters counters;
+	const uint8_t* crc_table;
+	uint32_t sniffer_losses;
+	uint8_t crc_start;
+	uint8_t counter_byte;
+	uint8_t counter_shift;
+	uint8_t counter_mask;
+	uint8_t min_length;
+	uint8_t last_counter;
+	bool last_valid;
+} e2e_Entry;
+
+/**
+ * @var e2e_slots[CAN_E2E_ID_NUMBER]
+ * @brief Descriptor slot + 1 of each standard CAN ID, 0 if the ID is not checked.
+ */
+static uint8_t e2e_slots[CAN_E2E_ID_NUMBER];
+
+/**
+ * @var e2e_entries[CAN_E2E_MAX_DESCRIPTORS]
+ * @brief Checked IDs, in the order they were added.
+ */
+static e2e_Entry e2e_entries[CAN_E2E_MAX_DESCRIPTORS];
+
+/**
+ * @var crc_tables[CAN_E2E_MAX_POLYNOMIALS][256]
+ * @brief CRC-8 lookup tables (MSB first) of the polynomials in use.
+ */
+static uint8_t crc_tables[CAN_E2E_MAX_POLYNOMIALS][256];
+
+/**
+ * @var crc_polynomials[CAN_E2E_MAX_POLYNOMIALS]
+ * @brief Polynomial of each table of crc_tables.
+ */
+static uint8_t crc_polynomials[CAN_E2E_MAX_POLYNOMIALS];
+
+/**
+ * @var crc_table_count
+ * @brief Number of tables of crc_tables in use.
+ */
+static uint8_t crc_table_count = 0;
+
+/**
+ * @var e2e_status
+ * @brief Current status instance (totals are summed by get_can_e2e_status()).
+ */
+static can_E2E_Status e2e_status = {0};
+
+/**
+ * @fn void can_e2e_clear(void)
+ * @brief Remove all descriptors and reset the counters.
+ *
+ * @param None
+ * @retval None
+ */
+void can_e2e_clear(void) {
+	memset(e2e_slots, 0, sizeof(e2e_slots));
+	memset(e2e_entries, 0, sizeof(e2e_entries));
+	crc_table_count = 0;
+	e2e_status = (can_E2E_Status){0};
+}
+
+/**
+ * @fn static const uint8_t* get_crc_table(uint8_t polynomial)
+ * @brief Get the CRC-8 table of a polynomial, computing it on first use.
+ *
+ * @param polynomial CRC-8 polynomial (MSB first, x^8 implied).
+ * @retval Pointer to the 256-byte table, or NULL if no table is free.
+ */
+static const uint8_t* get_crc_table(uint8_t polynomial) {
+	for (uint32_t i = 0; i < crc_table_count; i++) {
+		if (crc_polynomials[i] == polynomial) return crc_tables[i];
+	}
+	if (crc_table_count == CAN_E2E_MAX_POLYNOMIALS) return NULL;
+
+	uint8_t* table = crc_tables[crc_table_count];
+	for (uint32_t value = 0; value < 256; value++) {
+		uint8_t crc = (uint8_t)value;
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ polynomial) : (uint8_t)(crc << 1);
+		}
+		table[value] = crc;
+	}
+	crc_polynomials[crc_table_count++] = polynomial;
+	return table;
+}
+
+/**
+ * @fn bool can_e2e_add(const can_E2E_Descriptor* descriptor)
+ * @brief Check the rolling counter and CRC of an ID.
+ *
+ * @param descriptor Pointer to the descriptor of the ID. Replaces an existing
+ * 					 descriptor of the same ID.
+ * @retval true If the descriptor is added, else false if it is invalid, no
+ * 		   descriptor is free or no CRC table is free for its polynomial.
+ */
+bool can_e2e_add(const can_E2E_Descriptor* descriptor) {
+	const can_E2E_Descriptor* d = descriptor;
+	bool has_counter = (d->counter_length > 0);
+	bool has_crc = (d->crc_byte != CAN_E2E_NO_CRC);
+
+	if (d->Identifier >= CAN_E2E_ID_NUMBER || (!has_counter && !has_crc) || d->data_id_bytes > 2) return false;
+	if (has_counter && (d->counter_length > 8 || d->counter_bit >= 64 || (d->counter_bit % 8) + d->counter_length > 8 ||
+						d->counter_max >= (1u << d->counter_length))) return false;
+	if (has_crc && (d->crc_byte >= 8 || (has_counter && d->crc_byte == d->counter_bit / 8))) return false;
+
+	uint8_t slot = e2e_slots[d->Identifier];
+	if (slot == 0) {
+		if (e2e_status.descriptors == CAN_E2E_MAX_DESCRIPTORS) return false;
+		slot = (uint8_t)(e2e_status.descriptors + 1);
+	}
+
+	e2e_Entry entry = {.descriptor = *d};
+	if (has_crc) {
+		entry.crc_table = get_crc_table(d->crc_polynomial);
+		if (entry.crc_table == NULL) return false;
+		uint8_t crc = d->crc_init;
+		for (uint32_t i = 0; i < d->data_id_bytes; i++) {
+			crc = entry.crc_table[crc ^ (uint8_t)(d->data_id >> (8 * i))];
+		}
+		entry.crc_start = crc;
+		entry.min_length = d->crc_byte + 1;
+	}
+	if (has_counter) {
+		entry.counter_byte = d->counter_bit / 8;
+		entry.counter_shift = d->counter_bit % 8;
+		entry.counter_mask = (uint8_t)((1u << d->counter_length) - 1);
+		if (entry.counter_byte + 1 > entry.min_length) entry.min_length = entry.counter_byte + 1;
+	}
+
+	e2e_entries[slot - 1] = entry;
+	if (e2e_slots[d->Identifier] == 0) {
+		e2e_slots[d->Identifier] = slot;
+		e2e_status.descriptors++;
+	}
+	return true;
+}
+
+/**
+ * @fn void can_e2e_resume(void)
+ * @brief Forget the last counter of every ID.
+ *
+ * @param None
+ * @retval None
+ */
+void can_e2e_resume(void) {
+	for (uint32_t i = 0; i < e2e_status.descriptors; i++) {
+		e2e_entries[i].last_valid = false;
+	}
+}
+
+/**
+ * @fn static void check(e2e_Entry* entry, const my_CAN_Frame* frame, uint32_t sniffer_losses_before, uint32_t sniffer_losses)
+ * @brief Check the CRC, then the counter of a frame of a described ID.
+ *
+ * @details
+ * The counter of a frame failing the CRC is not trusted, the counter is
+ * advanced by one instead.
+ */
+static void check(e2e_Entry* entry, const my_CAN_Frame* frame, uint32_t sniffer_losses_before, uint32_t sniffer_losses) {
+	const uint8_t* data = frame->Data;
+	can_E2E_Counters* counters = &entry->counters;
+
+	counters->frames++;
+	if (frame->DataLength < entry->min_length) {
+		counters->invalid++;
+		return;
+	}
+
+	if (entry->crc_table != NULL) {
+		const uint8_t* table = entry->crc_table;
+		uint32_t crc_byte = entry->descriptor.crc_byte;
+		uint8_t crc = entry->crc_start;
+		for (uint32_t i = 0; i < crc_byte; i++) crc = table[crc ^ data[i]];
+		for (uint32_t i = crc_byte + 1; i < frame->DataLength; i++) crc = table[crc ^ data[i]];
+		if ((uint8_t)(crc ^ entry->descriptor.crc_xor) != data[crc_byte]) {
+			/* The frame was sent: its counter is taken as the expected one */
+			counters->crc_failures++;
+			if (entry->last_valid) {
+				entry->last_counter = (entry->last_counter == entry->descriptor.counter_max) ? 0 : entry->last_counter + 1;
+				entry->sniffer_losses = sniffer_losses_before;
+			}
+			return;
+		}
+	}
+
+	if (entry->counter_mask == 0) return;
+
+	uint8_t counter = (data[entry->counter_byte] >> entry->counter_shift) & entry->counter_mask;
+	if (counter > entry->descriptor.counter_max) {
+		counters->invalid++;
+		return;
+	}
+
+	if (entry->last_valid) {
+		int32_t advance = (int32_t)counter - entry->last_counter;
+		if (advance < 0) advance += entry->descriptor.counter_max + 1;
+
+		if (advance == 0) {
+			counters->repeats++;
+		} else if (advance > 1) {
+			if (sniffer_losses != entry->sniffer_losses) {
+				counters->sniffer_skips++;
+				counters->sniffer_lost_frames += advance - 1;
+			} else {
+				counters->skips++;
+				counters->lost_frames += advance - 1;
+			}
+		}
+	}
+
+	entry->last_counter = counter;
+	entry->last_valid = true;
+	entry->sniffer_losses = sniffer_losses_before;
+}
+
+/**
+ * @fn void can_e2e_process_frame(const my_CAN_Frame* frame, uint32_t sniffer_losses_before, uint32_t sniffer_losses)
+ * @brief Check the rolling counter and CRC of a received frame.
+ *
+ * @param frame Pointer to the received frame.
+ * @param sniffer_losses_before Sniffer loss count (RX FIFO0 overflows and
+ * 								wakes from Stop) before the frames of the
+ * 								current interrupt were read.
+ * @param sniffer_losses Sniffer loss count including the current interrupt.
+ * @retval None
+ *
+ * @details
+ * The DWT cycle cost of each checked frame is recorded in the status.
+ */
+void can_e2e_process_frame(const my_CAN_Frame* frame, uint32_t sniffer_losses_before, uint32_t sniffer_losses) {
+	uint8_t slot = e2e_slots[frame->Identifier & (CAN_E2E_ID_NUMBER - 1)];
+	if (slot == 0) return;
+
+	uint32_t start_cycles = my_DWT_GetCycles_end();
+	check(&e2e_entries[slot - 1], frame, sniffer_losses_before, sniffer_losses);
+
+	uint32_t cycles = my_DWT_GetCycles_end() - start_cycles;
+	e2e_status.last_cycles = cycles;
+	e2e_status.total_cycles += cycles;
+	if (cycles > e2e_status.max_cycles) e2e_status.max_cycles = cycles;
+}
+
+/**
+ * @fn static void add_counters(can_E2E_Counters* total, const can_E2E_Counters* counters)
+ * @brief Add the counters of an ID to the totals.
+ */
+static void add_counters(can_E2E_Counters* total, const can_E2E_Counters* counters) {
+	total->frames += counters->frames;
+	total->skips += counters->skips;
+	total->lost_frames += counters->lost_frames;
+	total->sniffer_skips += counters->sniffer_skips;
+	total->sniffer_lost_frames += counters->sniffer_lost_frames;
+	total->repeats += counters->repeats;
+	total->crc_failures += counters->crc_failures;
+	total->invalid += counters->invalid;
+}
+
+/**
+ * @fn static void print_counters(const can_E2E_Counters* counters)
+ * @brief Print the check results of one ID or the totals.
+ */
+static void print_counters(const can_E2E_Counters* counters) {
+	my_printf("frames %lu, sender skips %lu (%lu frames), sniffer skips %lu (%lu frames), "
+			  "repeats %lu, CRC failures %lu, invalid %lu\r\n",
+			  counters->frames, counters->skips, counters->lost_frames, counters->sniffer_skips,
+			  counters->sniffer_lost_frames, counters->repeats, counters->crc_failures, counters->invalid);
+}
+
+/**
+ * @fn can_E2E_Status get_can_e2e_status(bool to_print)
+ * @brief Get the check totals.
+ *
+ * @param to_print If true, the totals and the counters of every checked ID
+ * 				   are printed. If false, nothing is printed.
+ * @retval Current status instance
+ *
+ * @note
+ * Counters are read while the RX interrupt may update them, so the totals
+ * can be off by the frames checked meanwhile.
+ */
+can_E2E_Status get_can_e2e_status(bool to_print) {
+	e2e_status.total = (can_E2E_Counters){0};
+	for (uint32_t i = 0; i < e2e_status.descriptors; i++) {
+		add_counters(&e2e_status.total, &e2e_entries[i].counters);
+	}
+
+	if (to_print) {
+		uint32_t frames = e2e_status.total.frames;
+		uint32_t average = frames ? (uint32_t)(e2e_status.total_cycles / frames) : 0;
+
+		my_printf("E2E checked IDs: %lu\r\n", e2e_status.descriptors);
+		for (uint32_t i = 0; i < e2e_status.descriptors; i++) {
+			my_printf("ID 0x%03lX: ", e2e_entries[i].descriptor.Identifier);
+			print_counters(&e2e_entries[i].counters);
+		}
+		my_printf("Total: ");
+		print_counters(&e2e_status.total);
+		my_printf("Frame cost (cycles): last %lu, max %lu, avg %lu over %lu frames\r\n",
+				  e2e_status.last_cycles, e2e_status.max_cycles, average, frames);
+	}
+	return e2e_status;
+}
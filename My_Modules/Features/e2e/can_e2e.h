@@ -0,0 +1,191 @@
+/**
+ * @file can_e2e.h
+ * @brief Rolling counter and checksum (E2E) gap detection API.
+ *
+ * @details
+ * Many periodic frames carry an AUTOSAR E2E style protection: a rolling
+ * counter incremented by the sender on every transmission and a CRC-8 over
+ * the payload (and a Data ID). A descriptor per ID gives where they are.
+ * Each received frame of a described ID is checked in the FDCAN RX interrupt:
+ *   - CRC failure (the counter of the frame is taken as the expected one)
+ *   - Skip: the counter advanced by more than one, the number of missing
+ *     frames is the advance minus one
+ *   - Repeat: the counter did not advance
+ *
+ * The check runs before the frame is put in the software buffer or the UART
+ * arena, so frames dropped there are never seen as skips. A skip is therefore
+ * either a loss on the sender side (ECU or bus) or a loss of the sniffer
+ * itself: an FDCAN RX FIFO0 overflow or a wake from low-power Stop, during
+ * which FDCAN is not receiving. Skips are attributed to the sniffer when one
+ * of these was counted between the previous and the current frame of the ID,
+ * and to the sender otherwise.
+ *
+ * @note A loss of a multiple of the counter range (e.g. 16 frames for a
+ * 4-bit counter) cannot be seen.
+ */
+
+#ifndef CAN_E2E_H
+#define CAN_E2E_H
+
+#include "my_can.h"
+
+/**
+ * @def CAN_E2E_ID_NUMBER
+ * @brief Number of IDs of the lookup table (full 11-bit standard ID space).
+ */
+#define CAN_E2E_ID_NUMBER 2048
+
+/**
+ * @def CAN_E2E_MAX_DESCRIPTORS
+ * @brief Maximum number of checked IDs.
+ */
+#define CAN_E2E_MAX_DESCRIPTORS 16
+
+/**
+ * @def CAN_E2E_MAX_POLYNOMIALS
+ * @brief Maximum number of different CRC-8 polynomials (one 256-byte table each).
+ */
+#define CAN_E2E_MAX_POLYNOMIALS 2
+
+/**
+ * @def CAN_E2E_NO_CRC
+ * @brief crc_byte value of a descriptor without CRC.
+ */
+#define CAN_E2E_NO_CRC 0xFF
+
+/**
+ * @struct can_E2E_Descriptor
+ * @brief Location of the rolling counter and CRC of an ID.
+ *
+ * @details
+ * counter_bit is the bit number of the counter LSB in the payload
+ * (byte * 8 + bit, bit 0 being the LSB of the byte). The counter must not
+ * span two bytes. It counts from 0 to counter_max and wraps to 0
+ * (e.g. 14 for AUTOSAR profile 1, where 15 is invalid). counter_length 0
+ * disables the counter check.
+ *
+ * The CRC-8 is computed with crc_polynomial (e.g. 0x1D SAE J1850, 0x2F
+ * AUTOSAR CRC8H2F) from crc_init over the data_id_bytes low bytes of
+ * data_id (LSB first), then over the payload bytes except crc_byte. The
+ * result is XORed with crc_xor.
+ */
+typedef struct {
+	uint32_t Identifier;
+	uint8_t counter_bit;
+	uint8_t counter_length;
+	uint8_t counter_max;
+	uint8_t crc_byte;
+	uint8_t crc_polynomial;
+	uint8_t crc_init;
+	uint8_t crc_xor;
+	uint8_t data_id_bytes;
+	uint16_t data_id;
+} can_E2E_Descriptor;
+
+/**
+ * @struct can_E2E_Counters
+ * @brief Check results of one ID.
+ *
+ * @details
+ * skips/lost_frames are attributed to the sender, sniffer_skips and
+ * sniffer_lost_frames to RX FIFO0 overflows and wakes from Stop. invalid
+ * counts frames too short for the descriptor or with a counter above
+ * counter_max.
+ */
+typedef struct {
+	uint32_t frames;
+	uint32_t skips;
+	uint32_t lost_frames;
+	uint32_t sniffer_skips;
+	uint32_t sniffer_lost_frames;
+	uint32_t repeats;
+	uint32_t crc_failures;
+	uint32_t invalid;
+} can_E2E_Counters;
+
+/**
+ * @struct can_E2E_Status
+ * @brief Totals of all checked IDs and per-frame cost.
+ *
+ * @details
+ * Cycle counts are measured with the DWT cycle counter around the check of
+ * a described ID in can_e2e_process_frame() and describe the cost added to
+ * the RX interrupt.
+ */
+typedef struct {
+	uint32_t descriptors;
+	can_E2E_Counters total;
+	uint32_t last_cycles;
+	uint32_t max_cycles;
+	uint64_t total_cycles;
+} can_E2E_Status;
+
+/**
+ * @fn void can_e2e_clear(void)
+ * @brief Remove all descriptors and reset the counters.
+ *
+ * @param None
+ * @retval None
+ *
+ * @note Must be called while CAN is stopped (e.g. from the settings menu).
+ */
+void can_e2e_clear(void);
+
+/**
+ * @fn bool can_e2e_add(const can_E2E_Descriptor* descriptor)
+ * @brief Check the rolling counter and CRC of an ID.
+ *
+ * @param descriptor Pointer to the descriptor of the ID. Replaces an existing
+ * 					 descriptor of the same ID.
+ * @retval true If the descriptor is added, else false if it is invalid, no
+ * 		   descriptor is free or no CRC table is free for its polynomial.
+ *
+ * @note Must be called while CAN is stopped (e.g. from the settings menu).
+ */
+bool can_e2e_add(const can_E2E_Descriptor* descriptor);
+
+/**
+ * @fn void can_e2e_resume(void)
+ * @brief Forget the last counter of every ID before the sniffer restarts.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * Frames sent while the sniffer was stopped are not skips. Must be called
+ * while CAN is stopped.
+ */
+void can_e2e_resume(void);
+
+/**
+ * @fn void can_e2e_process_frame(const my_CAN_Frame* frame, uint32_t sniffer_losses_before, uint32_t sniffer_losses)
+ * @brief Check the rolling counter and CRC of a received frame.
+ *
+ * @param frame Pointer to the received frame.
+ * @param sniffer_losses_before Sniffer loss count (RX FIFO0 overflows and
+ * 								wakes from Stop) before the frames of the
+ * 								current interrupt were read.
+ * @param sniffer_losses Sniffer loss count including the current interrupt.
+ * @retval None
+ *
+ * @details
+ * Frames lost by an overflow detected in an interrupt may have been sent
+ * before or after the frames read in it, so the window of a skip reaches
+ * from the interrupt of the previous frame of the ID (before its overflow
+ * check) to the current one (after it).
+ *
+ * @note Called from the FDCAN RX interrupt. Runs in constant time.
+ */
+void can_e2e_process_frame(const my_CAN_Frame* frame, uint32_t sniffer_losses_before, uint32_t sniffer_losses);
+
+/**
+ * @fn can_E2E_Status get_can_e2e_status(bool to_print)
+ * @brief Get the check totals.
+ *
+ * @param to_print If true, the totals and the counters of every checked ID
+ * 				   are printed. If false, nothing is printed.
+ * @retval Current status instance
+ */
+can_E2E_Status get_can_e2e_status(bool to_print);
+
+#endif /* CAN_E2E_H */
@@ -0,0 +1,250 @@
+/**
+ * @file can_history.c
+ * @brief Per-ID payload history implementation.
+ *
+ * @details
+ * Slabs are allocated from the memory pool (my_mempool), so allocation and
+ * release are O(1) and never fragment. A per-ID table maps each standard ID
+ * to its slab, so recording a frame is a table lookup and one entry write.
+ *
+ * The interrupt only writes entries and, in CAN_HISTORY_TOP mode, allocates
+ * slabs. The main loop only changes slab ownership inside short critical
+ * sections.
+ */
+
+#include "can_history.h"
+
+/**
+ * @var slab_table[CAN_HISTORY_ID_NUMBER]
+ * @brief Slab of every standard ID, NULL if untracked.
+ */
+static can_History_Slab* volatile slab_table[CAN_HISTORY_ID_NUMBER];
+
+/**
+ * @var activity[CAN_HISTORY_ID_NUMBER]
+ * @brief Frames received per ID during the current re-selection period.
+ */
+static volatile uint16_t activity[CAN_HISTORY_ID_NUMBER];
+
+/**
+ * @var history_status
+ * @brief Current history status instance.
+ */
+static can_History_Status history_status = {.mode = CAN_HISTORY_OFF};
+
+/**
+ * @var last_rebalance
+ * @brief Tick (ms) of the last re-selection.
+ */
+static uint32_t last_rebalance = 0;
+
+/**
+ * @fn static bool assign_slab(uint32_t identifier)
+ * @brief Allocate a slab for an ID.
+ *
+ * @retval true If the ID is tracked, else false if CAN_HISTORY_SLABS IDs are
+ * 		   already tracked or the memory pool is exhausted.
+ */
+static bool assign_slab(uint32_t identifier) {
+	if (history_status.tracked_ids >= CAN_HISTORY_SLABS) return false;
+
+	can_History_Slab* slab = my_mempool_alloc(sizeof(can_History_Slab));
+	if (slab == NULL) return false;
+
+	slab->Identifier = identifier;
+	slab->frames = 0;
+	slab->changed_bits = 0;
+	slab_table[identifier] = slab;
+	history_status.tracked_ids++;
+	return true;
+}
+
+/**
+ * @fn static void release_slab(uint32_t identifier)
+ * @brief Return the slab of a tracked ID to the memory pool.
+ */
+static void release_slab(uint32_t identifier) {
+	can_History_Slab* slab = slab_table[identifier];
+	slab_table[identifier] = NULL;
+	my_mempool_free(slab);
+	history_status.tracked_ids--;
+}
+
+/**
+ * @fn void can_history_set_mode(can_History_Mode mode)
+ * @brief Clear all histories and select the ID selection mode.
+ *
+ * @param mode The desired selection mode.
+ * @retval None
+ */
+void can_history_set_mode(can_History_Mode mode) {
+	for (uint32_t id = 0; id < CAN_HISTORY_ID_NUMBER; id++) {
+		if (slab_table[id] != NULL) release_slab(id);
+	}
+	memset((void*)activity, 0, sizeof(activity));
+	history_status = (can_History_Status){.mode = mode};
+	last_rebalance = HAL_GetTick();
+}
+
+/**
+ * @fn bool can_history_add_id(uint32_t identifier)
+ * @brief Track a specific ID in CAN_HISTORY_CONFIGURED mode.
+ *
+ * @param identifier The standard CAN ID to track.
+ * @retval true If the ID is tracked, else false if the mode is not
+ * 		   CAN_HISTORY_CONFIGURED or no slab can be allocated.
+ */
+bool can_history_add_id(uint32_t identifier) {
+	identifier &= (CAN_HISTORY_ID_NUMBER - 1);
+	if (history_status.mode != CAN_HISTORY_CONFIGURED) return false;
+	if (slab_table[identifier] != NULL) return true;
+
+	return assign_slab(identifier);
+}
+
+/**
+ * @fn void can_history_record_frame(const my_CAN_Frame* frame)
+ * @brief Record a received frame into the history of its ID.
+ *
+ * @param frame Pointer to the received frame.
+ * @retval None
+ *
+ * @details
+ * In CAN_HISTORY_TOP mode an untracked ID gets a slab if one can be allocated.
+ */
+void can_history_record_frame(const my_CAN_Frame* frame) {
+	if (history_status.mode == CAN_HISTORY_OFF) return;
+
+	uint32_t identifier = frame->Identifier & (CAN_HISTORY_ID_NUMBER - 1);
+	if (activity[identifier] < UINT16_MAX) activity[identifier]++;
+
+	can_History_Slab* history = slab_table[identifier];
+	if (history == NULL) {
+		if (history_status.mode != CAN_HISTORY_TOP || !assign_slab(identifier)) return;
+		history = slab_table[identifier];
+	}
+
+	can_History_Entry* entry = &history->entries[history->frames & (CAN_HISTORY_DEPTH - 1)];
+	entry->Timestamp = frame->Timestamp;
+	entry->DataLength = frame->DataLength;
+	memcpy(entry->Data, frame->Data, sizeof(entry->Data));
+	if (history->frames == 0) {
+		memcpy(history->min, frame->Data, sizeof(history->min));
+		memcpy(history->max, frame->Data, sizeof(history->max));
+	} else {
+		const can_History_Entry* previous = &history->entries[(history->frames - 1) & (CAN_HISTORY_DEPTH - 1)];
+		history->changed_bits += my_payload_changed_bits8(previous->Data, frame->Data);
+		my_payload_minmax8(frame->Data, history->min, history->max);
+	}
+	history->frames++;
+}
+
+/**
+ * @fn static bool swap_least_active(void)
+ * @brief Replace the least active tracked ID by the most active untracked ID.
+ *
+ * @retval true If a swap was done, else false if the tracked IDs are already
+ * 		   the most active ones.
+ */
+static bool swap_least_active(void) {
+	uint32_t best_id = 0, worst_id = 0;
+	uint16_t best = 0, worst = UINT16_MAX;
+
+	for (uint32_t id = 0; id < CAN_HISTORY_ID_NUMBER; id++) {
+		if (slab_table[id] == NULL) {
+			if (activity[id] > best) { best = activity[id]; best_id = id; }
+		} else if (activity[id] < worst) {
+			worst = activity[id];
+			worst_id = id;
+		}
+	}
+	if (best <= worst) return false;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	release_slab(worst_id);
+	assign_slab(best_id);
+	__set_PRIMASK(primask);
+
+	activity[best_id] = 0; // Do not pick it again in this period
+	history_status.swaps++;
+	return true;
+}
+
+/**
+ * @fn void can_history_poll(void)
+ * @brief Periodic history maintenance, called from the main loop.
+ *
+ * @param None
+ * @retval None
+ */
+void can_history_poll(void) {
+	if (history_status.mode != CAN_HISTORY_TOP) return;
+	if ((HAL_GetTick() - last_rebalance) < CAN_HISTORY_REBALANCE_MS) return;
+	last_rebalance = HAL_GetTick();
+
+	for (int i = 0; i < CAN_HISTORY_MAX_SWAPS; i++) {
+		if (!swap_least_active()) break;
+	}
+	memset((void*)activity, 0, sizeof(activity));
+}
+
+/**
+ * @fn can_History_Status get_can_history_status(bool to_print)
+ * @brief Get the current history store status.
+ *
+ * @param to_print If true, the status and the tracked IDs are printed.
+ * 				   If false, nothing is printed.
+ * @retval Current history status instance
+ */
+can_History_Status get_can_history_status(bool to_print) {
+	if (to_print) {
+		static const char* const mode_names[] = {"Off", "Configured IDs", "Most active IDs"};
+
+		my_printf("History mode: %s\r\n", mode_names[history_status.mode]);
+		my_printf("Tracked IDs: %lu/%d, Depth: %d frames\r\n", history_status.tracked_ids, CAN_HISTORY_SLABS, CAN_HISTORY_DEPTH);
+		for (uint32_t id = 0; id < CAN_HISTORY_ID_NUMBER; id++) {
+			if (slab_table[id] != NULL) my_printf(" 0x%03lX", id);
+		}
+		my_printf("\r\n");
+	}
+	return history_status;
+}
+
+/**
+ * @fn void send_history_over_UART(uint32_t identifier)
+ * @brief Print the recorded history of an ID, oldest frame first.
+ *
+ * @param identifier The standard CAN ID to print.
+ * @retval None
+ */
+void send_history_over_UART(uint32_t identifier) {
+	can_History_Slab history;
+	identifier &= (CAN_HISTORY_ID_NUMBER - 1);
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	can_History_Slab* slab = slab_table[identifier];
+	if (slab != NULL) history = *slab;
+	__set_PRIMASK(primask);
+
+	if (slab == NULL) {
+		my_printf("History ID: 0x%03lX not tracked.\r\n\n", identifier);
+		return;
+	}
+
+	uint32_t count = (history.frames < CAN_HISTORY_DEPTH) ? history.frames : CAN_HISTORY_DEPTH;
+	my_printf("History ID: 0x%03lX, Frames: %lu, Changed bits: %lu\r\n", identifier, history.frames, history.changed_bits);
+	my_printf("Byte min:");
+	for (int j = 0; j < 8; j++) my_printf(" %02X", history.min[j]);
+	my_printf(", max:");
+	for (int j = 0; j < 8; j++) my_printf(" %02X", history.max[j]);
+	my_printf("\r\n");
+	for (uint32_t i = history.frames - count; i != history.frames; i++) {
+		can_History_Entry* entry = &history.entries[i & (CAN_HISTORY_DEPTH - 1)];
+		my_printf("Time: %lu us, DLC: %d, Bytes:", entry->Timestamp, entry->DataLength);
+		for (int j = 0; j < entry->DataLength; j++) my_printf(" %02X", entry->Data[j]);
+		my_printf("\r\n");
+	}
+	my_printf("\n");
+}
@@ -0,0 +1,189 @@
+/**
+ * @file can_history.h
+ * @brief Per-ID payload history API.
+ *
+ * @details
+ * Keeps the last CAN_HISTORY_DEPTH payloads (with timestamps) of selected IDs,
+ * independently of the global software ring buffer that discards frames as
+ * soon as they are sent. Each tracked ID owns one fixed-size slab allocated
+ * from the memory pool (my_mempool). IDs are selected either:
+ *   - explicitly (configured IDs), or
+ *   - automatically, keeping the CAN_HISTORY_SLABS most active IDs.
+ *
+ * Frames are recorded from the FDCAN RX interrupt. Histories can be queried
+ * from the main loop (e.g. over the command channel) while capture runs.
+ *
+ * Besides the last frames, each slab keeps payload statistics over all the
+ * frames recorded since the ID got it, updated with the my_payload kernels:
+ * the unsigned minimum and maximum of each byte and the number of bits that
+ * changed from one frame to the next.
+ */
+
+#ifndef CAN_HISTORY_H
+#define CAN_HISTORY_H
+
+#include "my_can.h"
+#include "my_mempool.h"
+#include "my_payload.h"
+
+/**
+ * @def CAN_HISTORY_DEPTH
+ * @brief Number of frames kept per tracked ID.
+ *
+ * @note Must be a power of two for modulo masking to work correctly.
+ */
+#define CAN_HISTORY_DEPTH 16
+
+/**
+ * @def CAN_HISTORY_SLABS
+ * @brief Maximum number of tracked IDs (number of history slabs).
+ */
+#define CAN_HISTORY_SLABS 32
+
+/**
+ * @def CAN_HISTORY_ID_NUMBER
+ * @brief Number of trackable IDs (full 11-bit standard ID space).
+ */
+#define CAN_HISTORY_ID_NUMBER 2048
+
+/**
+ * @def CAN_HISTORY_REBALANCE_MS
+ * @brief Period (in ms) of the most-active ID re-selection in CAN_HISTORY_TOP mode.
+ */
+#define CAN_HISTORY_REBALANCE_MS 1000
+
+/**
+ * @def CAN_HISTORY_MAX_SWAPS
+ * @brief Maximum number of tracked IDs replaced per re-selection.
+ */
+#define CAN_HISTORY_MAX_SWAPS 4
+
+/**
+ * @enum can_History_Mode
+ * @brief ID selection mode of the history store.
+ *
+ * @details
+ * CAN_HISTORY_OFF:
+ *     No history is recorded.
+ *
+ * CAN_HISTORY_CONFIGURED:
+ *     Only IDs added with can_history_add_id() are recorded.
+ *
+ * CAN_HISTORY_TOP:
+ *     New IDs get a slab while slabs are free. Every CAN_HISTORY_REBALANCE_MS
+ *     the least active tracked IDs are replaced by more active untracked ones.
+ */
+typedef enum {
+	CAN_HISTORY_OFF,
+	CAN_HISTORY_CONFIGURED,
+	CAN_HISTORY_TOP
+} can_History_Mode;
+
+/**
+ * @struct can_History_Entry
+ * @brief One recorded payload.
+ */
+typedef struct {
+	uint32_t Timestamp;
+	uint8_t DataLength;
+	uint8_t Data[8];
+} can_History_Entry;
+
+/**
+ * @struct can_History_Slab
+ * @brief History of one tracked ID.
+ *
+ * @details
+ * frames counts all frames recorded since the ID got its slab. The next entry
+ * is written at index frames & (CAN_HISTORY_DEPTH - 1). min/max are the byte
+ * ranges and changed_bits the bit flips between consecutive frames over the
+ * same frames (bytes beyond the DLC count as 0).
+ */
+typedef struct {
+	uint32_t Identifier;
+	uint32_t frames;
+	uint32_t changed_bits;
+	uint8_t min[8];
+	uint8_t max[8];
+	can_History_Entry entries[CAN_HISTORY_DEPTH];
+} can_History_Slab;
+
+/**
+ * @struct can_History_Status
+ * @brief History store state and counters.
+ */
+typedef struct {
+	can_History_Mode mode;
+	uint32_t tracked_ids;
+	uint32_t swaps;
+} can_History_Status;
+
+/**
+ * @fn void can_history_set_mode(can_History_Mode mode)
+ * @brief Clear all histories and select the ID selection mode.
+ *
+ * @param mode The desired selection mode.
+ * @retval None
+ *
+ * @note Must be called while CAN is stopped (e.g. from the settings menu).
+ */
+void can_history_set_mode(can_History_Mode mode);
+
+/**
+ * @fn bool can_history_add_id(uint32_t identifier)
+ * @brief Track a specific ID in CAN_HISTORY_CONFIGURED mode.
+ *
+ * @param identifier The standard CAN ID to track.
+ * @retval true If the ID is tracked, else false if the mode is not
+ * 		   CAN_HISTORY_CONFIGURED or no slab can be allocated.
+ */
+bool can_history_add_id(uint32_t identifier);
+
+/**
+ * @fn void can_history_record_frame(const my_CAN_Frame* frame)
+ * @brief Record a received frame into the history of its ID.
+ *
+ * @param frame Pointer to the received frame.
+ * @retval None
+ *
+ * @note Called from the FDCAN RX interrupt. Runs in constant time.
+ */
+void can_history_record_frame(const my_CAN_Frame* frame);
+
+/**
+ * @fn void can_history_poll(void)
+ * @brief Periodic history maintenance, called from the main loop.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * In CAN_HISTORY_TOP mode, re-selects the most active IDs every
+ * CAN_HISTORY_REBALANCE_MS.
+ */
+void can_history_poll(void);
+
+/**
+ * @fn can_History_Status get_can_history_status(bool to_print)
+ * @brief Get the current history store status.
+ *
+ * @param to_print If true, the status and the tracked IDs are printed.
+ * 				   If false, nothing is printed.
+ * @retval Current history status instance
+ */
+can_History_Status get_can_history_status(bool to_print);
+
+/**
+ * @fn void send_history_over_UART(uint32_t identifier)
+ * @brief Print the recorded history of an ID, oldest frame first.
+ *
+ * @param identifier The standard CAN ID to print.
+ * @retval None
+ *
+ * @details
+ * The slab is copied with interrupts briefly disabled, so capture does not
+ * need to be stopped and the printed history is consistent.
+ */
+void send_history_over_UART(uint32_t identifier);
+
+#endif /* CAN_HISTORY_H */
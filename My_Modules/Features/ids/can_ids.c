@@ -0,0 +1,358 @@
+/**
+ * @file can_ids.c
+ * @brief Timing-based intrusion and anomaly detection implementation.
+ *
+ * @details
+ * Keeps one fixed-size entry per standard CAN ID, so looking up the model
+ * of a received frame is a single array index. During training each entry
+ * accumulates the minimum and maximum inter-arrival time and the DLC.
+ * On the first frame of an ID after training, its entry is finalized in
+ * place: min/max are widened by CAN_IDS_MARGIN_PERCENT of the mean period
+ * and become the early/late limits, so detection is two comparisons.
+ *
+ * Finalization is done lazily per entry to keep the interrupt cost constant
+ * (no full-table pass when the training window ends).
+ */
+
+#include "can_ids.h"
+
+/**
+ * @def ENTRY_SEEN
+ * @brief The ID was received during training (or already reported as unknown).
+ */
+#define ENTRY_SEEN (1 << 0)
+
+/**
+ * @def ENTRY_LAST_VALID
+ * @brief last_timestamp belongs to the current capture session.
+ */
+#define ENTRY_LAST_VALID (1 << 1)
+
+/**
+ * @def ENTRY_DLC_VARIES
+ * @brief Multiple DLCs were seen in training. DLC changes are not reported.
+ */
+#define ENTRY_DLC_VARIES (1 << 2)
+
+/**
+ * @def ENTRY_FINALIZED
+ * @brief min/max have been converted into early/late limits.
+ */
+#define ENTRY_FINALIZED (1 << 3)
+
+/**
+ * @def ENTRY_PERIODIC
+ * @brief Timing checks are applied to this ID.
+ */
+#define ENTRY_PERIODIC (1 << 4)
+
+/**
+ * @def ENTRY_UNKNOWN
+ * @brief ID was first seen after training.
+ */
+#define ENTRY_UNKNOWN (1 << 5)
+
+/**
+ * @def MAX_TRAINING_WINDOW_MS
+ * @brief Largest training window that fits the 32-bit microsecond timestamp.
+ */
+#define MAX_TRAINING_WINDOW_MS 3600000
+
+/**
+ * @struct ids_Entry
+ * @brief Learned model of one CAN ID.
+ *
+ * @details
+ * Before finalization min_period/max_period hold the observed extremes of the
+ * inter-arrival time. After finalization they hold the early/late limits.
+ */
+typedef struct {
+	uint32_t last_timestamp;
+	uint32_t min_period;
+	uint32_t max_period;
+	uint16_t periods;
+	uint8_t dlc;
+	uint8_t flags;
+} ids_Entry;
+
+/**
+ * @var ids_table[CAN_IDS_ID_NUMBER]
+ * @brief Per-ID model table, indexed by standard CAN ID.
+ */
+static ids_Entry ids_table[CAN_IDS_ID_NUMBER];
+
+/**
+ * @var ids_status
+ * @brief Current detector status instance.
+ */
+static can_IDS_Status ids_status = {.state = CAN_IDS_OFF};
+
+/**
+ * @var training_started
+ * @brief Flag indicating that the first training frame has been received.
+ */
+static bool training_started = false;
+
+/**
+ * @var training_start
+ * @brief Timestamp of the first training frame.
+ */
+static uint32_t training_start = 0;
+
+/**
+ * @var alert_head
+ * @brief Alert ring buffer head index.
+ */
+static volatile uint16_t alert_head = 0;
+
+/**
+ * @var alert_tail
+ * @brief Alert ring buffer tail index.
+ */
+static volatile uint16_t alert_tail = 0;
+
+/**
+ * @var alert_ring_buffer[CAN_IDS_ALERT_BUFFER_SIZE]
+ * @brief Alert ring buffer.
+ */
+static can_IDS_Alert alert_ring_buffer[CAN_IDS_ALERT_BUFFER_SIZE];
+
+/**
+ * @var alert_names[]
+ * @brief Printable names of can_IDS_AlertType values.
+ */
+static const char* const alert_names[] = {"EARLY", "LATE", "UNKNOWN ID", "DLC CHANGE"};
+
+/**
+ * @fn void can_ids_start_training(uint32_t training_window_ms)
+ * @brief Discard the learned model and start a new training window.
+ *
+ * @param training_window_ms Training window duration in ms. 0 disables the detector.
+ * @retval None
+ *
+ * @note Must be called while CAN is stopped (e.g. from the settings menu).
+ */
+void can_ids_start_training(uint32_t training_window_ms) {
+	if (training_window_ms > MAX_TRAINING_WINDOW_MS) training_window_ms = MAX_TRAINING_WINDOW_MS;
+
+	memset(ids_table, 0, sizeof(ids_table));
+	ids_status = (can_IDS_Status){.state = training_window_ms ? CAN_IDS_TRAINING : CAN_IDS_OFF, .training_window_ms = training_window_ms};
+	training_started = false;
+	alert_head = alert_tail = 0;
+}
+
+/**
+ * @fn void can_ids_resume(void)
+ * @brief Invalidate the last arrival time of every ID.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * The gap while the sniffer was stopped is not an inter-arrival time, so
+ * the first frame of each ID after a restart is not timed.
+ */
+void can_ids_resume(void) {
+	for (int i = 0; i < CAN_IDS_ID_NUMBER; i++) {
+		ids_table[i].flags &= ~ENTRY_LAST_VALID;
+	}
+}
+
+/**
+ * @fn static void push_alert(can_IDS_AlertType type, const my_CAN_Frame* frame, uint32_t observed, uint32_t expected)
+ * @brief Queue an alert record. Drops it if the alert ring buffer is full.
+ */
+static void push_alert(can_IDS_AlertType type, const my_CAN_Frame* frame, uint32_t observed, uint32_t expected) {
+	uint16_t next_head = (alert_head + 1) & (CAN_IDS_ALERT_BUFFER_SIZE - 1);
+	if (next_head == alert_tail) {
+		ids_status.dropped_alerts++;
+		return;
+	}
+	alert_ring_buffer[alert_head] = (can_IDS_Alert){frame->Timestamp, frame->Identifier, observed, expected, type};
+	alert_head = next_head;
+	ids_status.alerts++;
+}
+
+/**
+ * @fn static void train(ids_Entry* entry, const my_CAN_Frame* frame)
+ * @brief Update the model of an ID with a training frame.
+ */
+static void train(ids_Entry* entry, const my_CAN_Frame* frame) {
+	if (!(entry->flags & ENTRY_SEEN)) {
+		*entry = (ids_Entry){frame->Timestamp, UINT32_MAX, 0, 0, frame->DataLength, ENTRY_SEEN | ENTRY_LAST_VALID};
+		ids_status.trained_ids++;
+		return;
+	}
+
+	if (entry->flags & ENTRY_LAST_VALID) {
+		uint32_t period = frame->Timestamp - entry->last_timestamp;
+		if (period < entry->min_period) entry->min_period = period;
+		if (period > entry->max_period) entry->max_period = period;
+		if (entry->periods < UINT16_MAX) entry->periods++;
+	}
+	if (frame->DataLength != entry->dlc) entry->flags |= ENTRY_DLC_VARIES;
+
+	entry->last_timestamp = frame->Timestamp;
+	entry->flags |= ENTRY_LAST_VALID;
+}
+
+/**
+ * @fn static void finalize(ids_Entry* entry)
+ * @brief Convert the trained period extremes of an ID into early/late limits.
+ *
+ * @details
+ * The ID is considered periodic only if enough periods were observed and the
+ * observed jitter is below CAN_IDS_MAX_JITTER_PERCENT of the mean period.
+ */
+static void finalize(ids_Entry* entry) {
+	entry->flags |= ENTRY_FINALIZED;
+	if (entry->periods < CAN_IDS_MIN_TRAINING_FRAMES || entry->min_period == 0) return;
+
+	uint32_t period = entry->min_period + (entry->max_period - entry->min_period) / 2;
+	uint32_t jitter = entry->max_period - entry->min_period;
+	if ((uint64_t)jitter * 100 > (uint64_t)period * CAN_IDS_MAX_JITTER_PERCENT) return;
+
+	uint32_t margin = (uint32_t)(((uint64_t)period * CAN_IDS_MARGIN_PERCENT) / 100);
+	entry->min_period = (entry->min_period > margin) ? entry->min_period - margin : 0;
+	entry->max_period += margin;
+	entry->flags |= ENTRY_PERIODIC;
+	ids_status.periodic_ids++;
+}
+
+/**
+ * @fn static void detect(ids_Entry* entry, const my_CAN_Frame* frame)
+ * @brief Check a frame against the learned model of its ID.
+ *
+ * @details
+ * Unknown IDs are reported once and then tracked like trained non-periodic
+ * IDs so they do not flood the alert buffer.
+ */
+static void detect(ids_Entry* entry, const my_CAN_Frame* frame) {
+	if (!(entry->flags & ENTRY_SEEN)) {
+		*entry = (ids_Entry){frame->Timestamp, 0, 0, 0, frame->DataLength,
+							 ENTRY_SEEN | ENTRY_LAST_VALID | ENTRY_FINALIZED | ENTRY_DLC_VARIES | ENTRY_UNKNOWN};
+		push_alert(CAN_IDS_ALERT_UNKNOWN_ID, frame, 0, 0);
+		return;
+	}
+
+	if (!(entry->flags & ENTRY_FINALIZED)) finalize(entry);
+
+	if (!(entry->flags & ENTRY_DLC_VARIES) && frame->DataLength != entry->dlc) {
+		push_alert(CAN_IDS_ALERT_DLC_CHANGE, frame, frame->DataLength, entry->dlc);
+	}
+
+	if ((entry->flags & (ENTRY_PERIODIC | ENTRY_LAST_VALID)) == (ENTRY_PERIODIC | ENTRY_LAST_VALID)) {
+		uint32_t period = frame->Timestamp - entry->last_timestamp;
+		uint32_t expected = entry->min_period + (entry->max_period - entry->min_period) / 2;
+		if (period < entry->min_period) {
+			push_alert(CAN_IDS_ALERT_EARLY, frame, period, expected);
+		} else if (period > entry->max_period) {
+			push_alert(CAN_IDS_ALERT_LATE, frame, period, expected);
+		}
+	}
+
+	entry->last_timestamp = frame->Timestamp;
+	entry->flags |= ENTRY_LAST_VALID;
+}
+
+/**
+ * @fn void can_ids_process_frame(const my_CAN_Frame* frame)
+ * @brief Train on or check a received frame.
+ *
+ * @param frame Pointer to the received frame. Timestamp must be set.
+ * @retval None
+ *
+ * @details
+ * The training window is measured from the first frame received while
+ * training. The frame that closes the window is already checked.
+ * The DWT cycle cost of each call is recorded in the detector status.
+ */
+void can_ids_process_frame(const my_CAN_Frame* frame) {
+	if (ids_status.state == CAN_IDS_OFF) return;
+
+	uint32_t start_cycles = my_DWT_GetCycles_end();
+	ids_Entry* entry = &ids_table[frame->Identifier & (CAN_IDS_ID_NUMBER - 1)];
+
+	if (ids_status.state == CAN_IDS_TRAINING) {
+		if (!training_started) {
+			training_started = true;
+			training_start = frame->Timestamp;
+		} else if ((frame->Timestamp - training_start) >= ids_status.training_window_ms * 1000) {
+			ids_status.state = CAN_IDS_DETECTING;
+		}
+	}
+
+	if (ids_status.state == CAN_IDS_TRAINING) {
+		train(entry, frame);
+	} else {
+		detect(entry, frame);
+	}
+
+	uint32_t cycles = my_DWT_GetCycles_end() - start_cycles;
+	ids_status.frames++;
+	ids_status.last_cycles = cycles;
+	ids_status.total_cycles += cycles;
+	if (cycles > ids_status.max_cycles) ids_status.max_cycles = cycles;
+}
+
+/**
+ * @fn can_IDS_Status get_can_ids_status(bool to_print)
+ * @brief Get the current detector status.
+ *
+ * @param to_print If true, the detector status is printed.
+ * 				   If false, nothing is printed.
+ * @retval Current detector status instance
+ *
+ * @note
+ * Periodic IDs are counted as they are finalized, i.e. on their first frame
+ * after the training window.
+ */
+can_IDS_Status get_can_ids_status(bool to_print) {
+	if (to_print) {
+		static const char* const state_names[] = {"Off", "Training", "Detecting"};
+		uint32_t average = ids_status.frames ? (uint32_t)(ids_status.total_cycles / ids_status.frames) : 0;
+
+		my_printf("IDS state: %s\r\n", state_names[ids_status.state]);
+		my_printf("Training window: %lu ms\r\n", ids_status.training_window_ms);
+		my_printf("Trained IDs: %lu, Periodic IDs: %lu\r\n", ids_status.trained_ids, ids_status.periodic_ids);
+		my_printf("Alerts: %lu, Dropped alerts: %lu\r\n", ids_status.alerts, ids_status.dropped_alerts);
+		my_printf("Frame cost (cycles): last %lu, max %lu, avg %lu over %lu frames\r\n",
+				  ids_status.last_cycles, ids_status.max_cycles, average, ids_status.frames);
+	}
+	return ids_status;
+}
+
+/**
+ * @fn void send_ids_alerts_over_UART(void)
+ * @brief Print all queued alert records over UART.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * Nothing is printed in binary output mode: the alerts stay queued (new
+ * ones are counted as dropped once the queue is full) until text output is
+ * selected.
+ */
+void send_ids_alerts_over_UART(void) {
+	if (get_my_CAN_status(false).output_mode == CAN_OUTPUT_BINARY) return;
+
+	while (alert_head != alert_tail) {
+		can_IDS_Alert alert = alert_ring_buffer[alert_tail];
+		alert_tail = (alert_tail + 1) & (CAN_IDS_ALERT_BUFFER_SIZE - 1);
+
+		my_printf("IDS ALERT: %s, ID: 0x%03lX, Time: %lu us", alert_names[alert.type], alert.Identifier, alert.Timestamp);
+		switch (alert.type) {
+			case CAN_IDS_ALERT_EARLY:
+			case CAN_IDS_ALERT_LATE:
+				my_printf(", Period: %lu us, Expected: %lu us", alert.observed, alert.expected);
+				break;
+			case CAN_IDS_ALERT_DLC_CHANGE:
+				my_printf(", DLC: %lu, Expected: %lu", alert.observed, alert.expected);
+				break;
+			default:
+				break;
+		}
+		my_printf("\r\n\n");
+	}
+}
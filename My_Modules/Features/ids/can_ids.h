@@ -0,0 +1,178 @@
+/**
+ * @file can_ids.h
+ * @brief Timing-based intrusion and anomaly detection API.
+ *
+ * @details
+ * Learns, per standard CAN ID, the inter-arrival period, its jitter and the
+ * DLC during a training window. Afterwards each received frame is checked in
+ * O(1) against the learned model and the following anomalies are reported
+ * as alert records:
+ *   - Frame arriving too early (typical sign of injection on periodic IDs)
+ *   - Frame arriving too late
+ *   - ID never seen during training
+ *   - DLC different from the one seen during training
+ *
+ * Detection runs inside the FDCAN RX interrupt. Alerts are queued in a small
+ * ring buffer and printed from the main loop.
+ */
+
+#ifndef CAN_IDS_H
+#define CAN_IDS_H
+
+#include "my_can.h"
+
+/**
+ * @def CAN_IDS_ID_NUMBER
+ * @brief Number of tracked IDs (full 11-bit standard ID space).
+ */
+#define CAN_IDS_ID_NUMBER 2048
+
+/**
+ * @def CAN_IDS_MIN_TRAINING_FRAMES
+ * @brief Minimum frames of an ID seen in training to check its timing.
+ */
+#define CAN_IDS_MIN_TRAINING_FRAMES 8
+
+/**
+ * @def CAN_IDS_MAX_JITTER_PERCENT
+ * @brief Maximum learned jitter (max - min period) as a percentage of the
+ * mean period for an ID to be treated as strictly periodic.
+ */
+#define CAN_IDS_MAX_JITTER_PERCENT 50
+
+/**
+ * @def CAN_IDS_MARGIN_PERCENT
+ * @brief Tolerance added below the minimum and above the maximum learned
+ * period, as a percentage of the mean period.
+ */
+#define CAN_IDS_MARGIN_PERCENT 10
+
+/**
+ * @def CAN_IDS_ALERT_BUFFER_SIZE
+ * @brief Size of the alert ring buffer.
+ *
+ * @note Must be a power of two for modulo masking to work correctly.
+ */
+#define CAN_IDS_ALERT_BUFFER_SIZE 32
+
+/**
+ * @enum can_IDS_State
+ * @brief Operating state of the detector.
+ */
+typedef enum {
+	CAN_IDS_OFF,
+	CAN_IDS_TRAINING,
+	CAN_IDS_DETECTING
+} can_IDS_State;
+
+/**
+ * @enum can_IDS_AlertType
+ * @brief Kind of anomaly carried by an alert record.
+ */
+typedef enum {
+	CAN_IDS_ALERT_EARLY,
+	CAN_IDS_ALERT_LATE,
+	CAN_IDS_ALERT_UNKNOWN_ID,
+	CAN_IDS_ALERT_DLC_CHANGE
+} can_IDS_AlertType;
+
+/**
+ * @struct can_IDS_Alert
+ * @brief Alert record produced by the detector.
+ *
+ * @details
+ * For timing alerts, observed is the measured inter-arrival time and
+ * expected the learned mean period (both in microseconds). For DLC alerts,
+ * observed is the received DLC and expected the learned DLC.
+ */
+typedef struct {
+	uint32_t Timestamp;
+	uint32_t Identifier;
+	uint32_t observed;
+	uint32_t expected;
+	can_IDS_AlertType type;
+} can_IDS_Alert;
+
+/**
+ * @struct can_IDS_Status
+ * @brief Detector state, counters and per-frame cost.
+ *
+ * @details
+ * Cycle counts are measured with the DWT cycle counter around
+ * can_ids_process_frame() and describe the cost added to the RX interrupt.
+ */
+typedef struct {
+	can_IDS_State state;
+	uint32_t training_window_ms;
+	uint32_t trained_ids;
+	uint32_t periodic_ids;
+	uint32_t alerts;
+	uint32_t dropped_alerts;
+	uint32_t frames;
+	uint32_t last_cycles;
+	uint32_t max_cycles;
+	uint64_t total_cycles;
+} can_IDS_Status;
+
+/**
+ * @fn void can_ids_start_training(uint32_t training_window_ms)
+ * @brief Discard the learned model and start a new training window.
+ *
+ * @param training_window_ms Training window duration in ms. 0 disables the detector.
+ * @retval None
+ *
+ * @details
+ * The window starts with the first frame received after the sniffer is started,
+ * so the detector can be armed from the settings menu.
+ */
+void can_ids_start_training(uint32_t training_window_ms);
+
+/**
+ * @fn void can_ids_resume(void)
+ * @brief Forget the last arrival time of every ID before the sniffer restarts.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * Prevents the capture pause (e.g. while in the settings menu) from being
+ * reported as late frames. Must be called while CAN is stopped.
+ */
+void can_ids_resume(void);
+
+/**
+ * @fn void can_ids_process_frame(const my_CAN_Frame* frame)
+ * @brief Train on or check a received frame.
+ *
+ * @param frame Pointer to the received frame. Timestamp must be set.
+ * @retval None
+ *
+ * @note Called from the FDCAN RX interrupt. Runs in constant time.
+ */
+void can_ids_process_frame(const my_CAN_Frame* frame);
+
+/**
+ * @fn can_IDS_Status get_can_ids_status(bool to_print)
+ * @brief Get the current detector status.
+ *
+ * @param to_print If true, the detector status is printed.
+ * 				   If false, nothing is printed.
+ * @retval Current detector status instance
+ */
+can_IDS_Status get_can_ids_status(bool to_print);
+
+/**
+ * @fn void send_ids_alerts_over_UART(void)
+ * @brief Print all queued alert records over UART.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * Nothing is printed in binary output mode: the alerts stay queued (new
+ * ones are counted as dropped once the queue is full) until text output is
+ * selected.
+ */
+void send_ids_alerts_over_UART(void);
+
+#endif /* CAN_IDS_H */
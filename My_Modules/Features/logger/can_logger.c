@@ -0,0 +1,547 @@
+/**
+ * @file can_logger.c
+ * @brief SD card (FatFs) logging sink implementation.
+ *
+ * @details
+ * The RAM blocks form a ring. The interrupt only fills block `fill_index`
+ * and seals it by setting its `block_full` flag; the main loop only writes
+ * block `write_index` and frees it by clearing the flag. Sealing from the
+ * main loop (flush timeout, stop) is done with interrupts disabled.
+ *
+ * Everything touching FatFs is built only when ff.h is found.
+ */
+
+#include "can_logger.h"
+#include "my_can_wire.h"
+
+#if __has_include("ff.h")
+#include "ff.h"
+#define CAN_LOGGER_HAS_FATFS 1
+#if (defined(FF_USE_EXPAND) && (FF_USE_EXPAND == 0)) || (defined(_USE_EXPAND) && (_USE_EXPAND == 0))
+#error "can_logger needs f_expand(): enable USE_EXPAND in the FatFs configuration (ffconf.h)"
+#endif
+#else
+#define CAN_LOGGER_HAS_FATFS 0
+#endif
+
+/**
+ * @var logger_status
+ * @brief Current logger status instance.
+ */
+static can_Logger_Status logger_status = {0};
+
+/**
+ * @fn static uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint32_t length)
+ * @brief Continue a CRC-32 (polynomial 0xEDB88320, as zlib) over a buffer.
+ *
+ * @details
+ * Nibble-wise table: 64 bytes of flash, fast enough for the main loop.
+ */
+static uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint32_t length) {
+	static const uint32_t crc_table[16] = {
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+	};
+
+	crc = ~crc;
+	for (uint32_t i = 0; i < length; i++) {
+		crc ^= data[i];
+		crc = (crc >> 4) ^ crc_table[crc & 0x0F];
+		crc = (crc >> 4) ^ crc_table[crc & 0x0F];
+	}
+	return ~crc;
+}
+
+/**
+ * @fn static uint32_t block_crc(const uint8_t* block)
+ * @brief CRC-32 of a block header (crc field as 0) and its payload.
+ */
+static uint32_t block_crc(const uint8_t* block) {
+	const can_Logger_Block_Header* header = (const can_Logger_Block_Header*)block;
+	const uint32_t zero = 0;
+	uint32_t payload_bytes = header->payload_bytes;
+	if (payload_bytes > CAN_LOGGER_PAYLOAD_SIZE) payload_bytes = CAN_LOGGER_PAYLOAD_SIZE;
+
+	uint32_t crc = crc32_update(0, block, offsetof(can_Logger_Block_Header, crc));
+	crc = crc32_update(crc, (const uint8_t*)&zero, sizeof(zero));
+	return crc32_update(crc, block + sizeof(can_Logger_Block_Header), payload_bytes);
+}
+
+#if CAN_LOGGER_HAS_FATFS
+
+/**
+ * @var block_buffers[CAN_LOGGER_BUFFER_COUNT][CAN_LOGGER_BLOCK_SIZE]
+ * @brief RAM blocks, each a can_Logger_Block_Header followed by wire records.
+ */
+static uint8_t block_buffers[CAN_LOGGER_BUFFER_COUNT][CAN_LOGGER_BLOCK_SIZE] CAN_LOGGER_BUFFER_ATTRIBUTE;
+
+/**
+ * @var block_full[CAN_LOGGER_BUFFER_COUNT]
+ * @brief True while a block is sealed and waits to be written.
+ */
+static volatile bool block_full[CAN_LOGGER_BUFFER_COUNT];
+
+/**
+ * @var fill_index
+ * @brief Block being filled by the interrupt.
+ */
+static volatile uint32_t fill_index = 0;
+
+/**
+ * @var write_index
+ * @brief Next block to be written by the main loop.
+ */
+static uint32_t write_index = 0;
+
+/**
+ * @var fill_started_tick
+ * @brief Tick (ms) of the first record in the block being filled.
+ */
+static volatile uint32_t fill_started_tick = 0;
+
+/**
+ * @var log_sequence
+ * @brief Sequence number of the next wire record (counts dropped frames too).
+ */
+static uint16_t log_sequence = 0;
+
+/**
+ * @var file_system
+ * @brief FatFs work area of the SD card volume.
+ */
+static FATFS file_system;
+
+/**
+ * @var volume_mounted
+ * @brief True while file_system is mounted.
+ */
+static bool volume_mounted = false;
+
+/**
+ * @var log_file
+ * @brief Currently open log file.
+ */
+static FIL log_file;
+
+/**
+ * @var file_capacity
+ * @brief Number of blocks pre-allocated in the current file.
+ */
+static uint32_t file_capacity = 0;
+
+/**
+ * @var file_blocks
+ * @brief Number of blocks written to the current file.
+ */
+static uint32_t file_blocks = 0;
+
+/**
+ * @var file_opened_tick
+ * @brief Tick (ms) when the current file was opened.
+ */
+static uint32_t file_opened_tick = 0;
+
+/**
+ * @var file_id
+ * @brief Random id written in every block of the current file.
+ */
+static uint32_t file_id = 0;
+
+/**
+ * @fn static void clear_block(uint32_t index)
+ * @brief Empty a RAM block before it is filled.
+ */
+static void clear_block(uint32_t index) {
+	can_Logger_Block_Header* header = (can_Logger_Block_Header*)block_buffers[index];
+	header->payload_bytes = 0;
+	header->records = 0;
+}
+
+/**
+ * @fn static bool seal_fill_block(void)
+ * @brief Hand the block being filled to the main loop and move to the next one.
+ *
+ * @retval true If the next block was free, else false (all blocks wait for the card).
+ *
+ * @note Called from the interrupt, or from the main loop with interrupts disabled.
+ */
+static bool seal_fill_block(void) {
+	uint32_t index = fill_index;
+	uint32_t next = (index + 1) % CAN_LOGGER_BUFFER_COUNT;
+	if (block_full[next]) return false;
+
+	((can_Logger_Block_Header*)block_buffers[index])->dropped_frames = logger_status.dropped_frames;
+	__DMB(); // Block contents must be visible before the flag
+	block_full[index] = true;
+	clear_block(next);
+	fill_index = next;
+	return true;
+}
+
+/**
+ * @fn static void fail(FRESULT result)
+ * @brief Stop logging after a FatFs error.
+ */
+static void fail(FRESULT result) {
+	logger_status.running = false;
+	logger_status.last_error = result;
+	/* Binary output carries only wire records: the error stays in the logger status */
+	if (get_my_CAN_status(false).output_mode != CAN_OUTPUT_BINARY) DEBUG_printf("SD logging stopped (FatFs error %d)\r\n", result);
+}
+
+/**
+ * @fn static bool parse_file_number(const char* name, uint32_t* number)
+ * @brief Get <nnnnn> of a CAN<nnnnn>.LOG file name.
+ */
+static bool parse_file_number(const char* name, uint32_t* number) {
+	if (strncmp(name, "CAN", 3) != 0 || strcmp(&name[8], ".LOG") != 0) return false;
+
+	uint32_t value = 0;
+	for (int i = 3; i < 8; i++) {
+		if (name[i] < '0' || name[i] > '9') return false;
+		value = value * 10 + (uint32_t)(name[i] - '0');
+	}
+	*number = value;
+	return true;
+}
+
+/**
+ * @fn static uint32_t find_next_file_number(void)
+ * @brief Number following the highest CAN<nnnnn>.LOG in the root directory.
+ *
+ * @details
+ * Keeps file names increasing across power cycles.
+ */
+static uint32_t find_next_file_number(void) {
+	DIR directory;
+	FILINFO info;
+	uint32_t next = 0;
+
+	if (f_opendir(&directory, CAN_LOGGER_DRIVE) != FR_OK) return 0;
+	while (f_readdir(&directory, &info) == FR_OK && info.fname[0] != '\0') {
+		uint32_t number;
+		if (parse_file_number(info.fname, &number) && number >= next) next = number + 1;
+	}
+	f_closedir(&directory);
+	return next;
+}
+
+/**
+ * @fn static bool open_log_file(uint32_t number)
+ * @brief Create and pre-allocate log file CAN<number>.LOG.
+ *
+ * @details
+ * The first sector is cleared, so stale data in the new clusters never looks
+ * like block 0 of this file. f_sync() then commits the FAT chain and the
+ * directory entry, so later block writes only touch data sectors.
+ */
+static bool open_log_file(uint32_t number) {
+	char name[24];
+	snprintf(name, sizeof(name), "%sCAN%05lu.LOG", CAN_LOGGER_DRIVE, (unsigned long)(number % 100000));
+
+	FRESULT result = f_open(&log_file, name, FA_CREATE_NEW | FA_WRITE);
+	if (result != FR_OK) {
+		fail(result);
+		return false;
+	}
+
+	FSIZE_t size = CAN_LOGGER_FILE_SIZE;
+	while ((result = f_expand(&log_file, size, 1)) == FR_DENIED && size > CAN_LOGGER_MIN_FILE_SIZE) {
+		size /= 2;
+	}
+	if (result == FR_OK) {
+		static const uint8_t empty_sector[512] = {0};
+		UINT written = 0;
+		result = f_write(&log_file, empty_sector, sizeof(empty_sector), &written);
+		if (result == FR_OK) result = f_lseek(&log_file, 0);
+		if (result == FR_OK) result = f_sync(&log_file);
+	}
+	if (result != FR_OK) {
+		f_close(&log_file);
+		f_unlink(name);
+		fail(result);
+		return false;
+	}
+
+	file_capacity = (uint32_t)(size / CAN_LOGGER_BLOCK_SIZE);
+	file_blocks = 0;
+	file_opened_tick = HAL_GetTick();
+	file_id = (my_timestamp_get() ^ (file_opened_tick * 2654435761UL)) + number;
+	logger_status.file_number = number;
+	logger_status.files++;
+	return true;
+}
+
+/**
+ * @fn static void close_log_file(void)
+ * @brief Trim the unused pre-allocated space and close the current file.
+ *
+ * @details
+ * An empty file is removed.
+ */
+static void close_log_file(void) {
+	FRESULT result = f_truncate(&log_file);
+	if (result == FR_OK) result = f_close(&log_file);
+	if (result != FR_OK) {
+		fail(result);
+		return;
+	}
+
+	if (file_blocks == 0) {
+		char name[24];
+		snprintf(name, sizeof(name), "%sCAN%05lu.LOG", CAN_LOGGER_DRIVE, (unsigned long)(logger_status.file_number % 100000));
+		f_unlink(name);
+	}
+}
+
+/**
+ * @fn static void write_block(uint32_t index)
+ * @brief Finish a sealed block and write it to the current file.
+ *
+ * @details
+ * Rotates first if the file is full or CAN_LOGGER_ROTATE_MS has elapsed.
+ * The block is written with a single CAN_LOGGER_BLOCK_SIZE f_write(), which
+ * FatFs passes to the disk driver as one multi-sector transfer.
+ */
+static void write_block(uint32_t index) {
+	bool rotate = (file_blocks >= file_capacity);
+#if CAN_LOGGER_ROTATE_MS > 0
+	if (file_blocks > 0 && (HAL_GetTick() - file_opened_tick) >= CAN_LOGGER_ROTATE_MS) rotate = true;
+#endif
+	if (rotate) {
+		close_log_file();
+		if (!logger_status.running || !open_log_file(logger_status.file_number + 1)) return;
+	}
+
+	uint8_t* block = block_buffers[index];
+	can_Logger_Block_Header* header = (can_Logger_Block_Header*)block;
+	header->magic = CAN_LOGGER_BLOCK_MAGIC;
+	header->file_number = logger_status.file_number;
+	header->file_id = file_id;
+	header->block_index = file_blocks;
+	memset(block + sizeof(can_Logger_Block_Header) + header->payload_bytes, CAN_RECORD_PADDING,
+			CAN_LOGGER_PAYLOAD_SIZE - header->payload_bytes);
+	header->crc = block_crc(block);
+
+	uint32_t start = my_timestamp_get();
+	UINT written = 0;
+	FRESULT result = f_write(&log_file, block, CAN_LOGGER_BLOCK_SIZE, &written);
+	if (result == FR_OK && written != CAN_LOGGER_BLOCK_SIZE) result = FR_DENIED;
+	if (result == FR_OK && ((file_blocks + 1) % CAN_LOGGER_SYNC_BLOCKS) == 0) result = f_sync(&log_file);
+	if (result != FR_OK) {
+		fail(result);
+		return;
+	}
+	uint32_t elapsed = my_timestamp_get() - start;
+	if (elapsed > logger_status.max_write_us) logger_status.max_write_us = elapsed;
+
+	file_blocks++;
+	logger_status.blocks_written++;
+	logger_status.logged_frames += header->records;
+
+	block_full[index] = false;
+	write_index = (index + 1) % CAN_LOGGER_BUFFER_COUNT;
+}
+
+/**
+ * @fn bool can_logger_start(void)
+ * @brief Mount the card and open a new pre-allocated log file.
+ *
+ * @param None
+ * @retval true If logging runs or is disabled, else false if the card could
+ * 		   not be mounted or no file could be created.
+ */
+bool can_logger_start(void) {
+	if (!logger_status.enabled || logger_status.running) return true;
+
+	for (uint32_t i = 0; i < CAN_LOGGER_BUFFER_COUNT; i++) {
+		block_full[i] = false;
+		clear_block(i);
+	}
+	fill_index = write_index = 0;
+	logger_status.last_error = 0;
+	logger_status.running = true;
+
+	FRESULT result = f_mount(&file_system, CAN_LOGGER_DRIVE, 1);
+	if (result != FR_OK) {
+		fail(result);
+		return false;
+	}
+	volume_mounted = true;
+	return open_log_file(find_next_file_number());
+}
+
+/**
+ * @fn void can_logger_stop(void)
+ * @brief Write the buffered blocks, trim and close the log file.
+ *
+ * @param None
+ * @retval None
+ */
+void can_logger_stop(void) {
+	if (logger_status.running) {
+		/* Write the sealed blocks first, so the partial block can always be sealed */
+		while (logger_status.running && block_full[write_index]) {
+			write_block(write_index);
+		}
+		if (((can_Logger_Block_Header*)block_buffers[fill_index])->records != 0) {
+			(void) seal_fill_block();
+		}
+		while (logger_status.running && block_full[write_index]) {
+			write_block(write_index);
+		}
+		if (logger_status.running) {
+			close_log_file();
+		}
+		logger_status.running = false;
+	}
+
+	/* After an error the file is left open, unmounting releases it */
+	if (volume_mounted) {
+		f_mount(NULL, CAN_LOGGER_DRIVE, 0);
+		volume_mounted = false;
+	}
+}
+
+/**
+ * @fn void can_logger_record_frame(const my_CAN_Frame* frame)
+ * @brief Append a received frame to the current log block.
+ *
+ * @param frame Pointer to the received frame.
+ * @retval None
+ */
+void can_logger_record_frame(const my_CAN_Frame* frame) {
+	if (!logger_status.running) return;
+
+	can_Logger_Block_Header* header = (can_Logger_Block_Header*)block_buffers[fill_index];
+	if (header->payload_bytes + CAN_WIRE_SIZE(frame->DataLength) > CAN_LOGGER_PAYLOAD_SIZE) {
+		if (!seal_fill_block()) {
+			log_sequence++;
+			logger_status.dropped_frames++;
+			return;
+		}
+		header = (can_Logger_Block_Header*)block_buffers[fill_index];
+	}
+
+	if (header->records == 0) {
+		header->first_timestamp = frame->Timestamp;
+		fill_started_tick = HAL_GetTick();
+	}
+	header->last_timestamp = frame->Timestamp;
+	uint8_t* record = block_buffers[fill_index] + sizeof(can_Logger_Block_Header) + header->payload_bytes;
+	header->payload_bytes += my_CAN_wire_encode(frame, log_sequence++, record);
+	header->records++;
+}
+
+/**
+ * @fn void can_logger_poll(void)
+ * @brief Write sealed blocks to the card, called from the main loop.
+ *
+ * @param None
+ * @retval None
+ */
+void can_logger_poll(void) {
+	if (!logger_status.running) return;
+
+	if (!block_full[write_index]) {
+		if (((can_Logger_Block_Header*)block_buffers[fill_index])->records == 0) return;
+		if ((HAL_GetTick() - fill_started_tick) < CAN_LOGGER_FLUSH_MS) return;
+
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		(void) seal_fill_block();
+		__set_PRIMASK(primask);
+		if (!block_full[write_index]) return;
+	}
+
+	write_block(write_index);
+}
+
+/**
+ * @fn bool can_logger_idle(void)
+ * @brief Check that every logged frame has been written to the card.
+ *
+ * @param None
+ * @retval true If logging is not running or no block is waiting to be
+ * 		   written or sealed, else false.
+ */
+bool can_logger_idle(void) {
+	if (!logger_status.running) return true;
+	return !block_full[write_index] && ((can_Logger_Block_Header*)block_buffers[fill_index])->records == 0;
+}
+
+#else /* !CAN_LOGGER_HAS_FATFS */
+
+/* Without FatFs logging never starts */
+
+bool can_logger_start(void) {
+	if (!logger_status.enabled) return true;
+	DEBUG_printf("SD logging not available (FatFs not in the build)\r\n");
+	return false;
+}
+
+void can_logger_stop(void) {}
+
+void can_logger_record_frame(const my_CAN_Frame* frame) {
+	(void)frame;
+}
+
+void can_logger_poll(void) {}
+
+bool can_logger_idle(void) {
+	return true;
+}
+
+#endif /* CAN_LOGGER_HAS_FATFS */
+
+/**
+ * @fn void can_logger_enable(bool enable)
+ * @brief Select whether capture is logged to the SD card.
+ *
+ * @param enable true to log on the next can_logger_start().
+ * @retval None
+ */
+void can_logger_enable(bool enable) {
+	logger_status.enabled = enable;
+}
+
+/**
+ * @fn bool can_logger_check_block(const uint8_t* block, uint32_t file_id, uint32_t block_index)
+ * @brief Check that a block read back from a log file is complete.
+ *
+ * @param block CAN_LOGGER_BLOCK_SIZE bytes read from the file.
+ * @param file_id file_id of block 0 of the file (for block 0, its own).
+ * @param block_index Index of the block in the file.
+ * @retval true If the header matches and the CRC is correct.
+ */
+bool can_logger_check_block(const uint8_t* block, uint32_t file_id, uint32_t block_index) {
+	const can_Logger_Block_Header* header = (const can_Logger_Block_Header*)block;
+
+	return header->magic == CAN_LOGGER_BLOCK_MAGIC &&
+		   header->file_id == file_id &&
+		   header->block_index == block_index &&
+		   header->payload_bytes <= CAN_LOGGER_PAYLOAD_SIZE &&
+		   header->crc == block_crc(block);
+}
+
+/**
+ * @fn can_Logger_Status get_can_logger_status(bool to_print)
+ * @brief Get the current logging sink status.
+ *
+ * @param to_print If true, the status is printed. If false, nothing is printed.
+ * @retval Current logger status instance
+ */
+can_Logger_Status get_can_logger_status(bool to_print) {
+	if (to_print) {
+		my_printf("SD logging: %s (%s)\r\n", logger_status.enabled ? "On" : "Off",
+				CAN_LOGGER_HAS_FATFS ? (logger_status.running ? "Running" : "Stopped") : "FatFs not in the build");
+		if (logger_status.files != 0) {
+			my_printf("File: CAN%05lu.LOG, Files opened: %lu\r\n", logger_status.file_number % 100000, logger_status.files);
+		}
+		my_printf("Blocks written: %lu (%lu KB)\r\n", logger_status.blocks_written, logger_status.blocks_written * (CAN_LOGGER_BLOCK_SIZE / 1024));
+		my_printf("Frames logged: %lu, dropped: %lu\r\n", logger_status.logged_frames, logger_status.dropped_frames);
+		my_printf("Max block write: %lu us\r\n", logger_status.max_write_us);
+		if (logger_status.last_error != 0) my_printf("Last FatFs error: %d\r\n", logger_status.last_error);
+	}
+	return logger_status;
+}
@@ -0,0 +1,273 @@
+/**
+ * @file can_logger.h
+ * @brief SD card (FatFs) logging sink API.
+ *
+ * @details
+ * Writes captured frames to log files on a FAT formatted SD card, so a
+ * standalone sniffer can record for hours without a PC attached.
+ *
+ * Frames are encoded as binary wire records (my_can_wire.h) by the FDCAN RX
+ * interrupt into one of CAN_LOGGER_BUFFER_COUNT RAM blocks. A full block is
+ * sealed and written by the main loop as one aligned multi-sector f_write(),
+ * while the interrupt already fills the next block, so a slow card never
+ * blocks capture. If every block is still waiting for the card, frames are
+ * dropped and counted.
+ *
+ * Each log file (CAN<nnnnn>.LOG) is pre-allocated as one contiguous cluster
+ * run with f_expand() when opened, so no FAT or directory update is needed
+ * while logging. Files are rotated by size (when the pre-allocated space is
+ * full) or by time (CAN_LOGGER_ROTATE_MS).
+ *
+ * Power-loss safety: every block starts with a can_Logger_Block_Header that
+ * carries a random file id, the block index and a CRC-32. After a power loss
+ * the file keeps its pre-allocated size, and a reader keeps every block up
+ * to the first one that fails the check (see can_logger_check_block()), so
+ * stale data in the pre-allocated clusters is never taken for log blocks. At
+ * most the blocks in RAM and the block being written are lost. Partially
+ * filled blocks are sealed after CAN_LOGGER_FLUSH_MS to bound that window.
+ *
+ * Requires the FatFs middleware with f_expand() enabled (USE_EXPAND in the
+ * CubeMX FATFS parameters) and the SD card driver linked as CAN_LOGGER_DRIVE.
+ * Without FatFs in the build (no ff.h), logging only reports that it is not
+ * available and capture is unaffected.
+ */
+
+#ifndef CAN_LOGGER_H
+#define CAN_LOGGER_H
+
+#include "my_can.h"
+
+/**
+ * @def CAN_LOGGER_DRIVE
+ * @brief FatFs logical drive of the SD card.
+ */
+#ifndef CAN_LOGGER_DRIVE
+#define CAN_LOGGER_DRIVE "0:"
+#endif
+
+/**
+ * @def CAN_LOGGER_BLOCK_SIZE
+ * @brief Size (in bytes) of one log block, header included.
+ *
+ * @note Must be a multiple of the 512-byte sector size. Larger blocks give
+ * 		 higher card throughput at the cost of RAM.
+ */
+#ifndef CAN_LOGGER_BLOCK_SIZE
+#define CAN_LOGGER_BLOCK_SIZE 8192
+#endif
+
+/**
+ * @def CAN_LOGGER_BUFFER_COUNT
+ * @brief Number of RAM blocks (2 = double buffering).
+ */
+#ifndef CAN_LOGGER_BUFFER_COUNT
+#define CAN_LOGGER_BUFFER_COUNT 2
+#endif
+
+/**
+ * @def CAN_LOGGER_BUFFER_ATTRIBUTE
+ * @brief Placement/alignment attribute of the RAM blocks.
+ *
+ * @details
+ * The SDMMC1 internal DMA cannot access DTCM. If the linker script places
+ * .bss in DTCM, override this with a section in AXI SRAM, e.g.
+ * __attribute__((section(".axi_sram"))) __ALIGNED(32).
+ */
+#ifndef CAN_LOGGER_BUFFER_ATTRIBUTE
+#define CAN_LOGGER_BUFFER_ATTRIBUTE __ALIGNED(32)
+#endif
+
+/**
+ * @def CAN_LOGGER_FILE_SIZE
+ * @brief Pre-allocated size (in bytes) of each log file.
+ *
+ * @details
+ * When the card has no contiguous free space of this size, the size is
+ * halved down to CAN_LOGGER_MIN_FILE_SIZE. Must be a multiple of
+ * CAN_LOGGER_BLOCK_SIZE.
+ */
+#ifndef CAN_LOGGER_FILE_SIZE
+#define CAN_LOGGER_FILE_SIZE (64UL * 1024 * 1024)
+#endif
+
+/**
+ * @def CAN_LOGGER_MIN_FILE_SIZE
+ * @brief Smallest accepted pre-allocation (in bytes).
+ */
+#ifndef CAN_LOGGER_MIN_FILE_SIZE
+#define CAN_LOGGER_MIN_FILE_SIZE (64UL * CAN_LOGGER_BLOCK_SIZE)
+#endif
+
+/**
+ * @def CAN_LOGGER_ROTATE_MS
+ * @brief Start a new file after this many ms (0 rotates by size only).
+ */
+#ifndef CAN_LOGGER_ROTATE_MS
+#define CAN_LOGGER_ROTATE_MS (15UL * 60 * 1000)
+#endif
+
+/**
+ * @def CAN_LOGGER_FLUSH_MS
+ * @brief Seal a partially filled block after this many ms.
+ */
+#ifndef CAN_LOGGER_FLUSH_MS
+#define CAN_LOGGER_FLUSH_MS 500
+#endif
+
+/**
+ * @def CAN_LOGGER_SYNC_BLOCKS
+ * @brief Call f_sync() (card cache flush) every this many blocks.
+ */
+#ifndef CAN_LOGGER_SYNC_BLOCKS
+#define CAN_LOGGER_SYNC_BLOCKS 16
+#endif
+
+/**
+ * @def CAN_LOGGER_BLOCK_MAGIC
+ * @brief Magic of a log block header ("CLOG" in little-endian).
+ */
+#define CAN_LOGGER_BLOCK_MAGIC 0x474F4C43UL
+
+/**
+ * @struct can_Logger_Block_Header
+ * @brief Header at the start of every log block.
+ *
+ * @details
+ * payload_bytes of wire records follow the header. The rest of the block is
+ * CAN_RECORD_PADDING. crc is the CRC-32 (as zlib) of the header, with crc
+ * set to 0, and of the payload. file_id is chosen randomly when the file is
+ * opened and is the same in all its blocks. dropped_frames is the number of
+ * frames dropped since logging started, counted when the block is sealed.
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t file_number;
+	uint32_t file_id;
+	uint32_t block_index;
+	uint32_t first_timestamp;
+	uint32_t last_timestamp;
+	uint16_t payload_bytes;
+	uint16_t records;
+	uint32_t dropped_frames;
+	uint32_t crc;
+} can_Logger_Block_Header;
+
+/**
+ * @def CAN_LOGGER_PAYLOAD_SIZE
+ * @brief Bytes of wire records that fit in one log block.
+ */
+#define CAN_LOGGER_PAYLOAD_SIZE (CAN_LOGGER_BLOCK_SIZE - sizeof(can_Logger_Block_Header))
+
+/**
+ * @struct can_Logger_Status
+ * @brief Logging sink state and counters.
+ *
+ * @details
+ * last_error is the FatFs FRESULT that stopped logging (0 if none).
+ */
+typedef struct {
+	bool enabled;
+	bool running;
+	uint32_t file_number;
+	uint32_t files;
+	uint32_t blocks_written;
+	uint32_t logged_frames;
+	uint32_t dropped_frames;
+	uint32_t max_write_us;
+	int last_error;
+} can_Logger_Status;
+
+/**
+ * @fn void can_logger_enable(bool enable)
+ * @brief Select whether capture is logged to the SD card.
+ *
+ * @param enable true to log on the next can_logger_start().
+ * @retval None
+ *
+ * @note Must be called while CAN is stopped (e.g. from the settings menu).
+ */
+void can_logger_enable(bool enable);
+
+/**
+ * @fn bool can_logger_start(void)
+ * @brief Mount the card and open a new pre-allocated log file.
+ *
+ * @param None
+ * @retval true If logging runs or is disabled, else false if the card could
+ * 		   not be mounted or no file could be created.
+ *
+ * @details
+ * The file number continues after the highest CAN<nnnnn>.LOG on the card.
+ */
+bool can_logger_start(void);
+
+/**
+ * @fn void can_logger_stop(void)
+ * @brief Write the buffered blocks, trim and close the log file.
+ *
+ * @param None
+ * @retval None
+ *
+ * @note Must be called after capture is stopped (my_CAN_stop()).
+ */
+void can_logger_stop(void);
+
+/**
+ * @fn void can_logger_record_frame(const my_CAN_Frame* frame)
+ * @brief Append a received frame to the current log block.
+ *
+ * @param frame Pointer to the received frame.
+ * @retval None
+ *
+ * @note Called from the FDCAN RX interrupt. Never waits for the card.
+ */
+void can_logger_record_frame(const my_CAN_Frame* frame);
+
+/**
+ * @fn void can_logger_poll(void)
+ * @brief Write sealed blocks to the card, called from the main loop.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * Writes at most one block per call, seals a partial block after
+ * CAN_LOGGER_FLUSH_MS and rotates files. On a FatFs error logging stops
+ * and the error is kept in the status.
+ */
+void can_logger_poll(void);
+
+/**
+ * @fn bool can_logger_idle(void)
+ * @brief Check that every logged frame has been written to the card.
+ *
+ * @param None
+ * @retval true If logging is not running or no block is waiting to be
+ * 		   written or sealed, else false.
+ */
+bool can_logger_idle(void);
+
+/**
+ * @fn bool can_logger_check_block(const uint8_t* block, uint32_t file_id, uint32_t block_index)
+ * @brief Check that a block read back from a log file is complete.
+ *
+ * @param block CAN_LOGGER_BLOCK_SIZE bytes read from the file.
+ * @param file_id file_id of block 0 of the file (for block 0, its own).
+ * @param block_index Index of the block in the file.
+ * @retval true If the header matches and the CRC is correct.
+ *
+ * @details
+ * Blocks of a file are valid up to the first one that fails this check.
+ */
+bool can_logger_check_block(const uint8_t* block, uint32_t file_id, uint32_t block_index);
+
+/**
+ * @fn can_Logger_Status get_can_logger_status(bool to_print)
+ * @brief Get the current logging sink status.
+ *
+ * @param to_print If true, the status is printed. If false, nothing is printed.
+ * @retval Current logger status instance
+ */
+can_Logger_Status get_can_logger_status(bool to_print);
+
+#endif /* CAN_LOGGER_H */
@@ -0,0 +1,217 @@
+/**
+ * @file can_power.c
+ * @brief Low-power idle on bus silence implementation.
+ *
+ * @details
+ * Bus activity is taken from the RX frame count of the capture path, read
+ * once per main loop iteration. The Stop wake source is EXTI line 0 routed
+ * to PD0 (FDCAN1_RX in CAN_Sniffer.ioc) in event mode: the pin stays in its
+ * FDCAN alternate function (the input stage feeds EXTI in any mode) and no
+ * interrupt handler is needed, so nothing has to be restored on the wake
+ * path except the FDCAN kernel clock. The system clock is HSI, which is also
+ * the Stop wake-up clock, so SystemClock_Config() is not needed either.
+ */
+
+#include "can_power.h"
+#include "can_ids.h"
+#include "can_logger.h"
+
+/**
+ * @def WAKE_EXTI_LINE
+ * @brief EXTI line of the FDCAN1_RX pin (PD0).
+ */
+#define WAKE_EXTI_LINE EXTI_LINE_0
+
+/**
+ * @def WAKE_EXTI_PORT
+ * @brief GPIO port of the FDCAN1_RX pin (PD0).
+ */
+#define WAKE_EXTI_PORT EXTI_GPIOD
+
+/**
+ * @var power_status
+ * @brief Current status instance.
+ */
+static can_Power_Status power_status = {.mode = CAN_POWER_OFF, .silence_ms = CAN_POWER_SILENCE_MS};
+
+/**
+ * @var last_rx_frames
+ * @brief RX frame count at the last poll.
+ */
+static uint32_t last_rx_frames = 0;
+
+/**
+ * @var last_activity_tick
+ * @brief HAL tick of the last poll that saw new frames (or of the last wake).
+ */
+static uint32_t last_activity_tick = 0;
+
+/**
+ * @var idle
+ * @brief The current bus silence has already been counted in idle_periods.
+ */
+static bool idle = false;
+
+/**
+ * @var wake_exti
+ * @brief EXTI handle of the wake line.
+ */
+static EXTI_HandleTypeDef wake_exti;
+
+/**
+ * @fn void can_power_set_mode(can_Power_Mode mode, uint32_t silence_ms)
+ * @brief Select the idle mode and the bus silence before idling.
+ *
+ * @param mode The desired idle mode.
+ * @param silence_ms Bus silence before idling in ms (0: CAN_POWER_SILENCE_MS).
+ * @retval None
+ */
+void can_power_set_mode(can_Power_Mode mode, uint32_t silence_ms) {
+	power_status = (can_Power_Status){.mode = mode, .silence_ms = silence_ms ? silence_ms : CAN_POWER_SILENCE_MS};
+	idle = false;
+	last_activity_tick = HAL_GetTick();
+}
+
+/**
+ * @fn void can_power_resume(void)
+ * @brief Restart the bus silence measurement.
+ *
+ * @param None
+ * @retval None
+ */
+void can_power_resume(void) {
+	last_rx_frames = get_my_CAN_cycle_stats(false).rx_frames;
+	last_activity_tick = HAL_GetTick();
+	idle = false;
+}
+
+/**
+ * @fn static void enter_sleep(void)
+ * @brief Wait for the next interrupt with all clocks running.
+ */
+static void enter_sleep(void) {
+	uint32_t start = my_timestamp_get();
+	HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+	power_status.sleep_us += my_timestamp_get() - start;
+}
+
+/**
+ * @fn static void enter_stop(void)
+ * @brief Stop until the next falling edge on FDCAN1_RX, then restart FDCAN.
+ *
+ * @details
+ * The event register is cleared (SEV, WFE) first so a stale event does not
+ * end the Stop at once. SysTick is suspended as its interrupt would wake
+ * the CPU. The frame loss bound counts the frames that could have started
+ * between the wake-up edge and FDCAN start, the first one being the wake
+ * frame.
+ */
+static void enter_stop(void) {
+	EXTI_ConfigTypeDef exti_config = {0};
+	exti_config.Line = WAKE_EXTI_LINE;
+	exti_config.Mode = EXTI_MODE_EVENT;
+	exti_config.Trigger = EXTI_TRIGGER_FALLING;
+	exti_config.GPIOSel = WAKE_EXTI_PORT;
+
+	my_CAN_suspend();
+	HAL_EXTI_SetConfigLine(&wake_exti, &exti_config);
+	HAL_SuspendTick();
+	__SEV();
+	__WFE();
+	HAL_PWREx_EnterSTOPMode(CAN_POWER_STOP_REGULATOR, PWR_STOPENTRY_WFE, PWR_D1_DOMAIN);
+
+	/* Woken up: TIM2 runs again from here */
+	uint32_t wake = my_timestamp_get();
+	HAL_EXTI_ClearConfigLine(&wake_exti);
+
+	__HAL_RCC_PLL2_ENABLE();
+	while (__HAL_RCC_GET_FLAG(RCC_FLAG_PLL2RDY) == RESET) {}
+	can_ids_resume();
+	my_CAN_resume();
+	uint32_t started = my_timestamp_get() - wake;
+
+	FDCAN_ProtocolStatusTypeDef protocol_status;
+	uint32_t synced = my_timestamp_get() - wake;
+	HAL_FDCAN_GetProtocolStatus(&hfdcan1, &protocol_status);
+	while (protocol_status.Activity == FDCAN_COM_STATE_SYNC) {
+		HAL_FDCAN_GetProtocolStatus(&hfdcan1, &protocol_status);
+		synced = my_timestamp_get() - wake;
+		if (synced >= CAN_POWER_SYNC_TIMEOUT_US) {
+			power_status.sync_timeouts++;
+			break;
+		}
+	}
+	HAL_ResumeTick();
+
+	uint32_t baudrate = get_my_CAN_status(false).baudrate;
+	uint32_t lost_frames = 1 + (uint32_t)(((uint64_t)(CAN_POWER_STOP_WAKEUP_US + started) * baudrate) / (CAN_POWER_MIN_FRAME_BITS * 1000000ULL));
+
+	power_status.wakes++;
+	power_status.last_start_us = started;
+	power_status.last_sync_us = synced;
+	if (started > power_status.max_start_us) power_status.max_start_us = started;
+	if (synced > power_status.max_sync_us) power_status.max_sync_us = synced;
+	if (lost_frames > power_status.max_lost_frames) power_status.max_lost_frames = lost_frames;
+}
+
+/**
+ * @fn void can_power_poll(void)
+ * @brief Idle when the bus has been silent long enough.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * After a Stop the silence is measured again from the wake, so a wake by
+ * noise or by the User Button does not stop the sniffer again at once.
+ */
+void can_power_poll(void) {
+	if (power_status.mode == CAN_POWER_OFF) return;
+
+	uint32_t rx_frames = get_my_CAN_cycle_stats(false).rx_frames;
+	uint32_t now = HAL_GetTick();
+	if (rx_frames != last_rx_frames) {
+		last_rx_frames = rx_frames;
+		last_activity_tick = now;
+		idle = false;
+		return;
+	}
+	if ((now - last_activity_tick) < power_status.silence_ms) return;
+	if (!my_CAN_output_idle() || !can_logger_idle()) return;
+
+	if (!idle) {
+		idle = true;
+		power_status.idle_periods++;
+	}
+
+	if (power_status.mode == CAN_POWER_SLEEP) {
+		enter_sleep();
+	} else {
+		enter_stop();
+		last_activity_tick = HAL_GetTick();
+		idle = false;
+	}
+}
+
+/**
+ * @fn can_Power_Status get_can_power_status(bool to_print)
+ * @brief Get the idle mode, counters and wake latencies.
+ *
+ * @param to_print If true, the status is printed.
+ * 				   If false, nothing is printed.
+ * @retval Current status instance
+ */
+can_Power_Status get_can_power_status(bool to_print) {
+	if (to_print) {
+		static const char* const mode_names[] = {"Off", "Sleep (WFI)", "Stop"};
+
+		my_printf("Idle mode: %s after %lu ms of bus silence\r\n", mode_names[power_status.mode], power_status.silence_ms);
+		my_printf("Idle periods: %lu, time in WFI: %lu ms\r\n",
+				  power_status.idle_periods, (uint32_t)(power_status.sleep_us / 1000));
+		my_printf("Wakes from Stop: %lu, sync timeouts: %lu\r\n", power_status.wakes, power_status.sync_timeouts);
+		my_printf("Wake to FDCAN started (us): last %lu, max %lu\r\n", power_status.last_start_us, power_status.max_start_us);
+		my_printf("Wake to FDCAN synchronized (us): last %lu, max %lu\r\n", power_status.last_sync_us, power_status.max_sync_us);
+		my_printf("Frames lost per wake: at most %lu\r\n", power_status.max_lost_frames);
+	}
+	return power_status;
+}
@@ -0,0 +1,176 @@
+/**
+ * @file can_power.h
+ * @brief Low-power idle on bus silence API.
+ *
+ * @details
+ * In a parked vehicle the bus goes to sleep while the main loop keeps
+ * polling at full speed. After CAN_POWER_SILENCE_MS without received frames,
+ * once every captured frame has been sent and logged, the sniffer idles in
+ * one of two modes:
+ *
+ * CAN_POWER_SLEEP:
+ *     The CPU waits for interrupts (WFI) with all clocks running. FDCAN keeps
+ *     receiving and the RX interrupt wakes the CPU, so no frame is lost.
+ *     SysTick still wakes it every ms (the command channel is polled).
+ *
+ * CAN_POWER_STOP:
+ *     FDCAN is stopped and the D1 domain enters Stop (the CM4 must be in Stop
+ *     too for the system to stop). The falling edge of the first frame on
+ *     FDCAN1_RX (PD0) wakes the CPU through an EXTI event, without changing
+ *     the pin mode. The FDCAN kernel clock (PLL2) is restarted, then FDCAN,
+ *     which receives again after 11 recessive bits: the frame that woke the
+ *     sniffer, and any frame started before FDCAN was running, are lost.
+ *     The User Button wakes it too.
+ *
+ * For every wake the latency from the wake to FDCAN started and to FDCAN
+ * synchronized on the bus is measured with the timestamp counter. The number
+ * of frames lost per wake is bounded from the wake-to-start latency and the
+ * shortest frame at the configured bit rate. For IDs checked by can_e2e, the
+ * exact loss appears as sniffer skips.
+ *
+ * @note TIM2 and SysTick do not run in Stop: frame timestamps do not advance
+ * while the sniffer is stopped, so the time spent in Stop is missing from
+ * them, and the intrusion detector does not time the first frame of each ID
+ * after a wake.
+ */
+
+#ifndef CAN_POWER_H
+#define CAN_POWER_H
+
+#include "my_can.h"
+
+/**
+ * @def CAN_POWER_SILENCE_MS
+ * @brief Default bus silence before idling (ms).
+ *
+ * @note Should be longer than CAN_LOGGER_FLUSH_MS, so the last log block is
+ * sealed and written before the sniffer stops.
+ */
+#ifndef CAN_POWER_SILENCE_MS
+#define CAN_POWER_SILENCE_MS 5000
+#endif
+
+/**
+ * @def CAN_POWER_SYNC_TIMEOUT_US
+ * @brief Longest wait for FDCAN to synchronize on the bus after a wake (us).
+ */
+#define CAN_POWER_SYNC_TIMEOUT_US 10000
+
+/**
+ * @def CAN_POWER_STOP_WAKEUP_US
+ * @brief Time from the wake-up edge to the first instruction after Stop (us).
+ *
+ * @details
+ * Not measurable by the firmware (no timer runs in Stop). Upper bound of the
+ * datasheet Stop wake-up time for the regulator mode, rounded up: only used
+ * for the frame loss bound.
+ */
+#ifndef CAN_POWER_STOP_WAKEUP_US
+#define CAN_POWER_STOP_WAKEUP_US 50
+#endif
+
+/**
+ * @def CAN_POWER_MIN_FRAME_BITS
+ * @brief Bits of the shortest classic CAN frame (11-bit ID, no data, no
+ * stuff bits) including the interframe space.
+ */
+#define CAN_POWER_MIN_FRAME_BITS 47
+
+/**
+ * @def CAN_POWER_STOP_REGULATOR
+ * @brief Regulator mode in Stop.
+ *
+ * @details
+ * The main regulator wakes faster. PWR_LOWPOWERREGULATOR_ON lowers the Stop
+ * current at the cost of a longer wake.
+ */
+#ifndef CAN_POWER_STOP_REGULATOR
+#define CAN_POWER_STOP_REGULATOR PWR_MAINREGULATOR_ON
+#endif
+
+/**
+ * @enum can_Power_Mode
+ * @brief Idle mode used on bus silence.
+ */
+typedef enum {
+	CAN_POWER_OFF,
+	CAN_POWER_SLEEP,
+	CAN_POWER_STOP
+} can_Power_Mode;
+
+/**
+ * @struct can_Power_Status
+ * @brief Idle mode, counters and wake latencies.
+ *
+ * @details
+ * idle_periods counts the bus silences that made the sniffer idle.
+ * sleep_us is the time spent in WFI in CAN_POWER_SLEEP. Wake latencies
+ * (CAN_POWER_STOP) are measured from the first instruction after Stop, so
+ * they exclude the wake-up time of the chip itself (see the datasheet).
+ * max_lost_frames is the bound on frames lost by the slowest wake, which
+ * adds CAN_POWER_STOP_WAKEUP_US to the measured latency.
+ */
+typedef struct {
+	can_Power_Mode mode;
+	uint32_t silence_ms;
+	uint32_t idle_periods;
+	uint64_t sleep_us;
+	uint32_t wakes;
+	uint32_t sync_timeouts;
+	uint32_t last_start_us;
+	uint32_t max_start_us;
+	uint32_t last_sync_us;
+	uint32_t max_sync_us;
+	uint32_t max_lost_frames;
+} can_Power_Status;
+
+/**
+ * @fn void can_power_set_mode(can_Power_Mode mode, uint32_t silence_ms)
+ * @brief Select the idle mode and the bus silence before idling.
+ *
+ * @param mode The desired idle mode.
+ * @param silence_ms Bus silence before idling in ms (0: CAN_POWER_SILENCE_MS).
+ * @retval None
+ *
+ * @note Resets the counters. Must be called while CAN is stopped.
+ */
+void can_power_set_mode(can_Power_Mode mode, uint32_t silence_ms);
+
+/**
+ * @fn void can_power_resume(void)
+ * @brief Restart the bus silence measurement before the sniffer restarts.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * The time spent in the settings menu is not bus silence.
+ */
+void can_power_resume(void);
+
+/**
+ * @fn void can_power_poll(void)
+ * @brief Idle when the bus has been silent long enough.
+ *
+ * @param None
+ * @retval None
+ *
+ * @details
+ * Called from the main loop in STATE_RUN after the output and logger work.
+ * Returns immediately while frames are received or waiting to be sent or
+ * logged. Otherwise sleeps once (CAN_POWER_SLEEP) or until bus activity
+ * (CAN_POWER_STOP).
+ */
+void can_power_poll(void);
+
+/**
+ * @fn can_Power_Status get_can_power_status(bool to_print)
+ * @brief Get the idle mode, counters and wake latencies.
+ *
+ * @param to_print If true, the status is printed.
+ * 				   If false, nothing is printed.
+ * @retval Current status instance
+ */
+can_Power_Status get_can_power_status(bool to_print);
+
+#endif /* CAN_POWER_H */
@@ -6,7 +6,14 @@
  * Implements settings_menu() that calls functions for:
  *   - Auto/manual CAN baud rate configuration
  *   - Filter and mask setup
+ *   - Output format selection
  *   - Querying CAN status
+ *   - Intrusion detection training
+ *   - Rolling counter/CRC (E2E) descriptors
+ *   - Per-ID history selection
+ *   - SD card logging
+ *   - Low-power idle on bus silence
+ *   - Payload kernel benchmark
  *   - Starting the CAN sniffer
  *
  * The menu is blocking and returns only when:
@@ -46,7 +53,14 @@ volatile SystemState system_state = STATE_MENU;
  *   - a: Auto Configure CAN Baud Rate
  *   - m: Manual Configure CAN Baud Rate
  *   - s: Set CAN Filter-Mask
+ *   - o: Set Output Format
  *   - g: Get CAN Sniffer status
+ *   - i: Intrusion Detection (IDS)
+ *   - e: E2E Counter/CRC Checks
+ *   - h: Per-ID Frame History
+ *   - l: SD Card Logging
+ *   - p: Low-Power Idle
+ *   - k: Payload Kernel Benchmark
  *   - q: Quit and Start CAN Sniffer
  */
 static void print_menu(void) {
@@ -56,7 +70,14 @@ static void print_menu(void) {
 	my_printf("* a: Auto Configure CAN Baud Rate   *\r\n");
 	my_printf("* m: Manual Configure CAN Baud Rate *\r\n");
 	my_printf("* s: Set CAN Filter-Mask            *\r\n");
+	my_printf("* o: Set Output Format              *\r\n");
 	my_printf("* g: Get CAN Sniffer status         *\r\n");
+	my_printf("* i: Intrusion Detection (IDS)      *\r\n");
+	my_printf("* e: E2E Counter/CRC Checks         *\r\n");
+	my_printf("* h: Per-ID Frame History           *\r\n");
+	my_printf("* l: SD Card Logging                *\r\n");
+	my_printf("* p: Low-Power Idle                 *\r\n");
+	my_printf("* k: Payload Kernel Benchmark       *\r\n");
 	my_printf("* q: Quit and Start CAN Sniffer     *\r\n");
 	my_printf("*************************************\r\n\n");
 }
@@ -84,6 +105,8 @@ static void print_menu(void) {
 void settings_menu(void) {
 	/* Stop CAN communication to prevent traffic while configuring. */
 	my_CAN_stop();
+	/* Write the buffered log blocks and close the log file */
+	can_logger_stop();
 
 	/* Show options menu */
 	print_menu();
@@ -143,14 +166,136 @@ void settings_menu(void) {
 				my_printf("\n\n");
 				print_menu();
 				break;
+			case 'o':
+				/* Select text or binary output */
+				char output_format = '\0';
+				my_printf("Provide output format (t: text, b: binary)\r\n");
+				my_scanf(" %c", &output_format);
+				my_printf("\n");
+				(void) my_CAN_set_output_mode((output_format == 'b') ? CAN_OUTPUT_BINARY : CAN_OUTPUT_TEXT);
+				(void) get_my_CAN_status(true);
+				my_printf("\n\n");
+				print_menu();
+				break;
 			case 'g':
 				/* Query CAN status */
 				(void) get_my_CAN_status(true);
 				my_printf("\n");
 				print_menu();
 				break;
+			case 'i':
+				/* Intrusion detection status and training */
+				uint32_t training_window_ms = 0;
+				(void) get_can_ids_status(true);
+				my_printf("\n");
+				my_printf("Provide IDS training window in ms (0 disables IDS)\r\n");
+				my_scanf(" %lu", &training_window_ms);
+				can_ids_start_training(training_window_ms);
+				(void) get_can_ids_status(true);
+				my_printf("\n\n");
+				print_menu();
+				break;
+			case 'e':
+				/* Rolling counter and CRC descriptors */
+				char e2e_mode = '\0';
+				(void) get_can_e2e_status(true);
+				my_printf("\n");
+				my_printf("Provide E2E mode (a: add descriptor, c: clear all, other: keep)\r\n");
+				my_scanf(" %c", &e2e_mode);
+				if (e2e_mode == 'c') {
+					can_e2e_clear();
+				} else if (e2e_mode == 'a') {
+					uint32_t e2e_id = 0;
+					unsigned int counter_bit = 0, counter_length = 0, counter_max = 0, crc_byte = 0;
+					unsigned int polynomial = 0, crc_init = 0, crc_xor = 0, data_id = 0, data_id_bytes = 0;
+					my_printf("Provide 0x<id> <counter bit> <counter bits> <counter max> <CRC byte (255: none)>\r\n");
+					my_printf("        0x<CRC polynomial> 0x<CRC init> 0x<CRC xor> 0x<data id> <data id bytes>\r\n");
+					if (my_scanf(" 0x%lx %u %u %u %u 0x%x 0x%x 0x%x 0x%x %u", &e2e_id, &counter_bit, &counter_length,
+								 &counter_max, &crc_byte, &polynomial, &crc_init, &crc_xor, &data_id, &data_id_bytes) == 10) {
+						can_E2E_Descriptor descriptor = {.Identifier = e2e_id, .counter_bit = counter_bit,
+														 .counter_length = counter_length, .counter_max = counter_max,
+														 .crc_byte = crc_byte, .crc_polynomial = polynomial,
+														 .crc_init = crc_init, .crc_xor = crc_xor,
+														 .data_id_bytes = data_id_bytes, .data_id = data_id};
+						if (!can_e2e_add(&descriptor)) my_printf("Invalid descriptor or no free slot.\r\n");
+					} else {
+						my_printf("Invalid input.\r\n");
+					}
+				}
+				my_printf("\n");
+				(void) get_can_e2e_status(true);
+				my_printf("\n\n");
+				print_menu();
+				break;
+			case 'h':
+				/* Per-ID history selection */
+				char history_mode = '\0';
+				uint32_t history_id = 0;
+				(void) get_can_history_status(true);
+				my_printf("\n");
+				my_printf("Provide history mode (o: off, t: most active IDs, a: add configured ID)\r\n");
+				my_scanf(" %c", &history_mode);
+				if (history_mode == 't') {
+					can_history_set_mode(CAN_HISTORY_TOP);
+				} else if (history_mode == 'a') {
+					if (get_can_history_status(false).mode != CAN_HISTORY_CONFIGURED) {
+						can_history_set_mode(CAN_HISTORY_CONFIGURED);
+					}
+					my_printf("Provide ID in 0x<id> format\r\n");
+					my_scanf(" 0x%lx", &history_id);
+					if (!can_history_add_id(history_id)) my_printf("No free history slab.\r\n");
+				} else {
+					can_history_set_mode(CAN_HISTORY_OFF);
+				}
+				my_printf("\n");
+				(void) get_can_history_status(true);
+				my_printf("\n\n");
+				print_menu();
+				break;
+			case 'l':
+				/* SD card logging */
+				char logging = '\0';
+				(void) get_can_logger_status(true);
+				my_printf("\n");
+				my_printf("Provide SD card logging (o: off, s: on)\r\n");
+				my_scanf(" %c", &logging);
+				can_logger_enable(logging == 's');
+				my_printf("\n");
+				(void) get_can_logger_status(true);
+				my_printf("\n\n");
+				print_menu();
+				break;
+			case 'p':
+				/* Low-power idle on bus silence */
+				char power_mode = '\0';
+				uint32_t silence_ms = 0;
+				(void) get_can_power_status(true);
+				my_printf("\n");
+				my_printf("Provide idle mode (o: off, w: sleep (WFI), s: stop)\r\n");
+				my_scanf(" %c", &power_mode);
+				if (power_mode == 'w' || power_mode == 's') {
+					my_printf("Provide bus silence before idling in ms (0: %d)\r\n", CAN_POWER_SILENCE_MS);
+					my_scanf(" %lu", &silence_ms);
+				}
+				can_power_set_mode((power_mode == 'w') ? CAN_POWER_SLEEP : (power_mode == 's') ? CAN_POWER_STOP : CAN_POWER_OFF,
+								   silence_ms);
+				my_printf("\n");
+				(void) get_can_power_status(true);
+				my_printf("\n\n");
+				print_menu();
+				break;
+			case 'k':
+				/* Payload kernel cycles against byte-by-byte loops */
+				my_payload_benchmark();
+				my_printf("\n");
+				print_menu();
+				break;
 			case 'q':
 				/* Attempt to start CAN sniffer */
+				can_ids_resume();
+				can_e2e_resume();
+				can_power_resume();
+				if (!can_logger_start()) my_printf("SD card logging failed, capturing without it.\r\n\n");
 				if (my_CAN_start()) {
 					system_state = STATE_RUN; // Change global state
 					return; // Exit menu
@@ -17,6 +17,12 @@
 
 #include "my_debug.h"
 #include "my_can.h"
+#include "my_payload.h"
+#include "can_ids.h"
+#include "can_e2e.h"
+#include "can_history.h"
+#include "can_logger.h"
+#include "can_power.h"
 
 /**
  * @enum SystemState
@@ -63,7 +69,10 @@ extern volatile SystemState system_state;
  *   - Allows:
  *       - Auto/manual baud rate configuration
  *       - Filter/mask setup
+ *       - Output format selection
  *       - Querying CAN status
+ *       - Intrusion detection training
+ *       - Per-ID history selection
  *       - Starting the CAN sniffer.
  *   - Runs an internal infinite loop and returns only when:
  *         1) the user selects 'q', and
@@ -5,7 +5,7 @@
  *
  * @details
  * Contains the infinite main loop that switches between:
- *   - Capturing and sending CAN frames (STATE_RUN)
+ *   - Capturing and sending CAN frames and answering run-time commands (STATE_RUN)
  *   - Entering the settings menu (STATE_MENU)
  *
  * The user can press the User Button (PC13) to force menu entry asynchronously.
@@ -17,6 +17,7 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "settings_menu.h"
+#include "command_channel.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -137,6 +138,10 @@ Error_Handler();
   MX_FDCAN1_Init();
   MX_USART3_UART_Init();
   /* USER CODE BEGIN 2 */
+  my_timestamp_init();
+  (void) my_mempool_init();
+  (void) my_DWT_GetCycles_start(); // Enable cycle counter for per-frame cost measurements
+  my_uart_dma_init();
 
   /* USER CODE END 2 */
 
@@ -147,7 +152,9 @@ Error_Handler();
    *
    * @details
    * Continuously polls the system_state variable:
-   *   - If STATE_RUN: captures and sends CAN frames over UART.
+   *   - If STATE_RUN: captures and sends CAN frames over UART,
+   *     executes commands received over the command channel and
+   *     idles in low power on bus silence.
    *   - If STATE_MENU: enters the blocking settings menu to configure CAN.
    *
    * This loop runs indefinitely.
@@ -157,6 +164,16 @@ Error_Handler();
 	  if (system_state == STATE_RUN) {
 		  /* Capture CAN frames from buffer and send via UART */
 		  send_frame_over_UART();
+		  /* Report intrusion detection alerts */
+		  send_ids_alerts_over_UART();
+		  /* Keep the most active IDs in the per-ID history */
+		  can_history_poll();
+		  /* Write sealed log blocks to the SD card */
+		  can_logger_poll();
+		  /* Answer run-time queries without stopping capture */
+		  command_channel_poll();
+		  /* Idle on bus silence */
+		  can_power_poll();
 	  } else {
 		  settings_menu();
 	  }